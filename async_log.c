@@ -0,0 +1,399 @@
+/*
+ * async_log.c
+ *
+ * Logging with a runtime level and an asynchronous backend.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <syslog.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "async_log.h"
+
+
+#ifdef DEBUGGING
+int pfish_bovespa_log_level = LOG_DEBUG;
+#else
+int pfish_bovespa_log_level = LOG_INFO;
+#endif
+
+
+/*
+ * A ring of messages of a thread.
+ * Single producer (the owner thread) and single consumer (the background thread):
+ * the producer only moves 'tail', the consumer only moves 'head'.
+ */
+
+#define RING_SIZE 1024	// Messages of a ring; a power of two.
+#define MESSAGE_SIZE 480	// Octets of a message, terminator included; longer messages are truncated.
+
+struct message {
+
+	int priority;
+	char text[MESSAGE_SIZE];
+
+};
+
+typedef struct ring ring_t;
+
+struct ring {
+
+	volatile unsigned int head;	// Next message to be drained.
+	volatile unsigned int tail;	// Next message to be queued.
+	volatile int owned;	// Nonzero while a thread queues in this ring.
+	volatile int busy;	// Nonzero while the owner thread is queuing a message.
+	ring_t *next;	// Next ring of all rings.
+	struct message messages[RING_SIZE];
+
+};
+
+
+/*
+ * State of the backend.
+ */
+
+static ring_t *rings;	// All rings; rings are pushed atomically and never removed.
+static volatile int running;	// Nonzero while the background thread runs.
+static volatile int stopping;	// Set to have the background thread drain and exit.
+static volatile int sleeping;	// Nonzero while the background thread may be waiting for messages.
+static pthread_mutex_t wake_mutex = PTHREAD_MUTEX_INITIALIZER;	// Guards waits of the background thread.
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;	// Signaled on messages queued while the background thread sleeps.
+static unsigned long dropped;	// Messages dropped on full rings since last reported; updated atomically.
+static pthread_t drainer;	// The background thread.
+static pthread_key_t ring_key;	// Releases the ring of an exiting thread.
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static int exit_handler_set;	// Nonzero once pfish_bovespa_log_stop() is registered with atexit().
+static __thread ring_t *own_ring;	// Ring of this thread, once taken.
+
+
+/*
+ * Release the ring of an exiting thread, for reuse by another thread.
+ */
+
+static void ring_release (void *ring) {
+
+	((ring_t *) ring)->owned = 0;
+
+}
+
+
+static void ring_key_create () {
+
+	pthread_key_create (&ring_key, ring_release);
+
+}
+
+
+/*
+ * Take a ring for the calling thread: a released one if any, a new one otherwise.
+ *
+ * @return ring of the calling thread, NULL if no ring could be taken.
+ */
+
+static ring_t *ring_take () {
+
+	ring_t *ring;
+
+	for ( ring = rings; ring != NULL; ring = ring->next ) {
+
+		if ((ring->owned == 0) && (__sync_bool_compare_and_swap (&(ring->owned), 0, 1))) {
+
+			break;
+
+		}
+
+	}
+	if (ring == NULL) {
+
+		if ((ring = (ring_t *) malloc (sizeof (ring_t))) == NULL) {
+
+			return (NULL);
+
+		}
+		ring->head = 0;
+		ring->tail = 0;
+		ring->owned = 1;
+		ring->busy = 0;
+		do {
+
+			ring->next = rings;
+
+		} while (!__sync_bool_compare_and_swap (&rings, ring->next, ring));
+
+	}
+	pthread_once (&ring_key_once, ring_key_create);
+	pthread_setspecific (ring_key, ring);
+	own_ring = ring;
+	return (ring);
+
+}
+
+
+/*
+ * Drain all rings into pfish_syslog().
+ *
+ * @return how many messages were drained.
+ */
+
+static unsigned long rings_drain () {
+
+	ring_t *ring;
+	struct message *message;
+	unsigned long count;
+	unsigned long lost;
+
+	count = 0;
+	for ( ring = rings; ring != NULL; ring = ring->next ) {
+
+		while (ring->head != ring->tail) {
+
+			__sync_synchronize ();
+			message = &(ring->messages[ring->head & (RING_SIZE - 1)]);
+			pfish_syslog (message->priority, "%s", message->text);
+			__sync_synchronize ();
+			ring->head++;
+			count++;
+
+		}
+
+	}
+	if ((lost = __sync_fetch_and_and (&dropped, 0)) != 0) {
+
+		pfish_syslog (LOG_WARNING, "%lu log messages dropped (log rings full).", lost);
+
+	}
+	return (count);
+
+}
+
+
+/*
+ * Find out if any message is waiting to be drained (or any drop to be reported).
+ */
+
+static int rings_pending () {
+
+	ring_t *ring;
+
+	for ( ring = rings; ring != NULL; ring = ring->next ) {
+
+		if (ring->head != ring->tail) {
+
+			return (1);
+
+		}
+
+	}
+	return (dropped != 0);
+
+}
+
+
+/*
+ * The background thread: drain rings while messages keep coming, then sleep until woken.
+ * Producers test 'sleeping' after queuing, and the background thread tests the rings after
+ * setting it, both past a full barrier; so either the producer wakes it or it finds the message.
+ */
+
+static void *drainer_run (void *arg) {
+
+	while (1) {
+
+		if ((rings_drain ()) != 0) {
+
+			continue;
+
+		}
+		pthread_mutex_lock (&wake_mutex);
+		sleeping = 1;
+		__sync_synchronize ();
+		while ((stopping == 0) && ((rings_pending ()) == 0)) {
+
+			pthread_cond_wait (&wake, &wake_mutex);
+
+		}
+		sleeping = 0;
+		pthread_mutex_unlock (&wake_mutex);
+		if (stopping != 0) {
+
+			break;
+
+		}
+
+	}
+	rings_drain ();
+	return (NULL);
+
+}
+
+
+void pfish_bovespa_log (int priority, const char *format, ...) {
+
+	char text[MESSAGE_SIZE];	// Message, when logging synchronously.
+	struct message *message;
+	ring_t *ring;
+	va_list ap;
+
+	va_start (ap, format);
+
+	/*
+	 * Flag the ring busy before testing 'running', and pfish_bovespa_log_stop() clears 'running'
+	 * before waiting for busy rings; so a message either is drained at stop or goes synchronously.
+	 */
+
+	ring = NULL;
+	if ((running != 0) && (((ring = own_ring) != NULL) || ((ring = ring_take ()) != NULL))) {
+
+		ring->busy = 1;
+		__sync_synchronize ();
+		if (running == 0) {
+
+			ring->busy = 0;
+			ring = NULL;
+
+		}
+
+	}
+	if (ring == NULL) {
+
+		vsnprintf (text, MESSAGE_SIZE, format, ap);
+		va_end (ap);
+		pfish_syslog (priority, "%s", text);
+		return;
+
+	}
+	if ((ring->tail - ring->head) >= RING_SIZE) {
+
+		va_end (ap);
+		__sync_fetch_and_add (&dropped, 1);
+		__sync_synchronize ();
+		ring->busy = 0;
+		return;
+
+	}
+	message = &(ring->messages[ring->tail & (RING_SIZE - 1)]);
+	message->priority = priority;
+	vsnprintf (message->text, MESSAGE_SIZE, format, ap);
+	va_end (ap);
+	__sync_synchronize ();
+	ring->tail++;
+	__sync_synchronize ();
+	ring->busy = 0;
+	if (sleeping != 0) {
+
+		pthread_mutex_lock (&wake_mutex);
+		pthread_cond_signal (&wake);
+		pthread_mutex_unlock (&wake_mutex);
+
+	}
+
+}
+
+
+void pfish_bovespa_log_level_from_env () {
+
+	static const char *names[] = { "emerg", "alert", "crit", "err", "warning", "notice", "info", "debug" };
+	const char *value;
+	char *aux_charp;
+	long level;
+
+	if ((value = getenv ("PFISH_BOVESPA_LOG_LEVEL")) == NULL) {
+
+		return;
+
+	}
+	level = strtol (value, &aux_charp, 10);
+	if ((*value != 0) && (*aux_charp == 0) && (level >= LOG_EMERG) && (level <= LOG_DEBUG)) {
+
+		pfish_bovespa_log_level = level;
+		return;
+
+	}
+	for ( level = LOG_EMERG; level <= LOG_DEBUG; level++ ) {
+
+		if ((strcasecmp (value, names[level])) == 0) {
+
+			pfish_bovespa_log_level = level;
+			return;
+
+		}
+
+	}
+	WARNING ("ignoring invalid PFISH_BOVESPA_LOG_LEVEL '%s'.", value);
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int pfish_bovespa_log_start () {
+
+	if (running != 0) {
+
+		SUCCESS;
+
+	}
+	stopping = 0;
+	if ((pthread_create (&drainer, NULL, drainer_run, NULL)) != 0) {
+
+		WARNING ("cannot create log thread; logging synchronously.");
+		FAILURE;
+
+	}
+	running = 1;
+	if (exit_handler_set == 0) {
+
+		atexit (pfish_bovespa_log_stop);
+		exit_handler_set = 1;
+
+	}
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void pfish_bovespa_log_stop () {
+
+	ring_t *ring;
+
+	if (running == 0) {
+
+		return;
+
+	}
+	running = 0;
+	__sync_synchronize ();
+	pthread_mutex_lock (&wake_mutex);
+	stopping = 1;
+	pthread_cond_signal (&wake);
+	pthread_mutex_unlock (&wake_mutex);
+	pthread_join (drainer, NULL);
+
+	/*
+	 * Messages being queued meanwhile are drained here, once their producers are done.
+	 */
+
+	for ( ring = rings; ring != NULL; ring = ring->next ) {
+
+		while (ring->busy != 0) {
+
+			sched_yield ();
+
+		}
+
+	}
+	rings_drain ();
+
+}
@@ -0,0 +1,96 @@
+/*
+ * async_log.h
+ * Logging with a runtime level and an asynchronous backend.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_ASYNC_LOG_SEEN
+#define FILE_PFISH_BOVESPA_ASYNC_LOG_SEEN
+
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+
+/*
+ * Including this header replaces the pilot_fish syslog macros (DEBUG, INFO ... EMERG, ERRNO_ERR)
+ * with sites guarded by the runtime level 'pfish_bovespa_log_level': a site below the level costs
+ * a load and a not taken branch, and its arguments are not evaluated.
+ *
+ * Messages at or above the level are formatted by the calling thread and handed to pfish_bovespa_log().
+ * Until pfish_bovespa_log_start() they go synchronously to pfish_syslog(); afterwards, each thread
+ * queues them in its own lock-free ring, and a background thread drains rings into pfish_syslog();
+ * the background thread sleeps while there is nothing to drain, and is woken by the next message.
+ * Queuing never blocks: messages of a full ring are dropped (and the drops are reported).
+ * Messages of different threads may be logged out of order.
+ */
+
+extern int pfish_bovespa_log_level;	// Most verbose priority logged (LOG_EMERG ... LOG_DEBUG).
+
+
+/*
+ * Log a message.
+ *
+ * @param[in] priority syslog priority of the message.
+ * @param[in] format printf format of the message.
+ */
+
+void pfish_bovespa_log (int priority, const char *format, ...);
+
+
+/*
+ * Set the runtime level from the environment variable PFISH_BOVESPA_LOG_LEVEL, if set
+ * (a syslog priority number, or one of: emerg, alert, crit, err, warning, notice, info, debug).
+ */
+
+void pfish_bovespa_log_level_from_env ();
+
+
+/*
+ * Start the background thread of the asynchronous backend.
+ * Rings are drained at exit (atexit()); messages still queued at _exit() or on a crash are lost.
+ *
+ * @return 0 on success, negative on failure (logging stays synchronous).
+ */
+
+int pfish_bovespa_log_start ();
+
+
+/*
+ * Drain all rings and stop the background thread; logging becomes synchronous again.
+ */
+
+void pfish_bovespa_log_stop ();
+
+
+#define PFISH_BOVESPA_LOG_AT(PRIORITY,...) \
+	do { \
+		if (__builtin_expect ((PRIORITY) <= pfish_bovespa_log_level, (PRIORITY) <= LOG_INFO)) { \
+			pfish_bovespa_log ((PRIORITY), __VA_ARGS__); \
+		} \
+	} while (0)
+
+#undef DEBUG
+#undef INFO
+#undef NOTICE
+#undef WARNING
+#undef ERR
+#undef CRIT
+#undef ALERT
+#undef EMERG
+#undef ERRNO_ERR
+
+#define DEBUG(...) PFISH_BOVESPA_LOG_AT (LOG_DEBUG, __VA_ARGS__)
+#define INFO(...) PFISH_BOVESPA_LOG_AT (LOG_INFO, __VA_ARGS__)
+#define NOTICE(...) PFISH_BOVESPA_LOG_AT (LOG_NOTICE, __VA_ARGS__)
+#define WARNING(...) PFISH_BOVESPA_LOG_AT (LOG_WARNING, __VA_ARGS__)
+#define ERR(...) PFISH_BOVESPA_LOG_AT (LOG_ERR, __VA_ARGS__)
+#define CRIT(...) PFISH_BOVESPA_LOG_AT (LOG_CRIT, __VA_ARGS__)
+#define ALERT(...) PFISH_BOVESPA_LOG_AT (LOG_ALERT, __VA_ARGS__)
+#define EMERG(...) PFISH_BOVESPA_LOG_AT (LOG_EMERG, __VA_ARGS__)
+#define ERRNO_ERR ERR ("%s", strerror (errno))
+
+
+#endif	// FILE_PFISH_BOVESPA_ASYNC_LOG_SEEN
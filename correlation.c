@@ -0,0 +1,1027 @@
+/*
+ * correlation.c
+ *
+ * Return covariance and correlation matrices of the stocks of the pilot_fish bovespa database.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <syslog.h>
+#include <argp.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined (__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+#include <pilot_fish/bovespa.h>
+
+#include "async_log.h"
+
+
+/*
+ * Missing day policies.
+ */
+
+#define FILL_PREVIOUS 0
+#define FILL_MEAN 1
+#define FILL_PAIRWISE 2
+
+
+/*
+ * Blocking: matrix products are split in tasks of BLOCK_ROWS x BLOCK_ROWS stocks,
+ * and each task runs over CHUNK_DAYS days at a time.
+ */
+
+#define BLOCK_ROWS 32
+#define CHUNK_DAYS 256
+
+
+/*
+ * Output header magic.
+ */
+
+#define CORRELATION_MAGIC "PFBCORR1"
+#define CORRELATION_MAGIC_SIZE 8
+
+
+/*
+ * Command line argument parsing.
+ */
+
+const char *argp_program_version = PACKAGE_VERSION;
+const char *argp_program_bug_address = PACKAGE_BUGREPORT;
+
+static char doc[] = "pfish_bovespa_correlation -- return covariance and correlation matrices of the stocks of the pilot_fish bovespa database.\vThis routine aligns daily returns (unit closing price / previous unit closing price - 1) of all stocks by trading date from FROM to TO, and exports their covariance and correlation matrices through the standard output in binary format.\n\nFormat of date fields is YYYY-MM-DD.\n\nTrading dates are those with trades of any stock. A missing day of a stock is filled according to --fill:\n'previous' (default): the price of the previous trading day is carried forward (zero return);\n'mean': the mean return of the stock;\n'pairwise': each pair of stocks uses only the days both were traded.\nStocks with less than --min-observations returns in the range are left out.\n\nThe output is a header (char magic[8] = \"PFBCORR1\"; uint64 stocks; uint64 trading days; int64 first and last trading date, in seconds since the epoch), followed by the stock identifications (char[16] each, null padded), the covariance matrix and the correlation matrix (stocks x stocks doubles each, row major). Integers and doubles are in native byte order. Undefined elements (such as correlations of stocks without variance) are NaN.\n\nMatrix products are cache blocked and run in parallel.\n";
+
+static char args_doc[] = "FROM TO";
+
+static struct argp_option options[] = {
+
+	{"fill", 'f', "POLICY", 0, "fill missing days by POLICY: 'previous' (default), 'mean' or 'pairwise'.", 0 },
+	{"min-observations", 'n', "N", 0, "leave out stocks with less than N returns in the range (default: 2).", 0 },
+	{"adjusted", 'x', 0, 0, "use prices adjusted by inplits / splits.", 0 },
+	{"image", 'm', 0, 0, "read from the shared memory database image (see pfish_bovespa_image_load).", 0 },
+	{"jobs", 'j', "JOBS", 0, "use JOBS threads (default: number of online processors).", 0 },
+	{"stats", 'S', 0, 0, "print runtime metrics of the library to the standard error on exit.", 0 },
+	{ 0 }
+
+};
+
+struct arguments {
+
+	long from;	// Days since the epoch.
+	long to;	// Days since the epoch.
+	unsigned int fill;
+	size_t min_observations;
+	unsigned int adjusted;
+	unsigned int image;
+	long jobs;
+	unsigned int stats;
+
+};
+
+
+/*
+ * Parse a date.
+ *
+ * @param[in] text date in format YYYY-MM-DD.
+ * @param[out] answer days since the epoch.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int parse_date (const char *text, long *answer);
+
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+	char *aux_charp;
+
+	switch (key) {
+
+		case 'f':
+
+			if ((strcmp (arg, "previous")) == 0) {
+
+				arguments->fill = FILL_PREVIOUS;
+
+			}
+			else if ((strcmp (arg, "mean")) == 0) {
+
+				arguments->fill = FILL_MEAN;
+
+			}
+			else if ((strcmp (arg, "pairwise")) == 0) {
+
+				arguments->fill = FILL_PAIRWISE;
+
+			}
+			else {
+
+				argp_error (state, "unknown policy '%s'.", arg);
+
+			}
+			break;
+
+		case 'n':
+
+			arguments->min_observations = strtoul (arg, &aux_charp, 10);
+			if ((*arg == 0) || (*aux_charp != 0) || (arguments->min_observations < 2)) {
+
+				argp_error (state, "invalid number of observations '%s'.", arg);
+
+			}
+			break;
+
+		case 'x':
+
+			arguments->adjusted = 1;
+			break;
+
+		case 'm':
+
+			arguments->image = 1;
+			break;
+
+		case 'j':
+
+			arguments->jobs = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->jobs < 1)) {
+
+				argp_error (state, "invalid number of jobs '%s'.", arg);
+
+			}
+			break;
+
+		case 'S':
+
+			arguments->stats = 1;
+			break;
+
+		case ARGP_KEY_ARG:
+
+			switch (state->arg_num) {
+
+				case 0:
+
+					if ((parse_date (arg, &(arguments->from))) < 0) {
+
+						argp_error (state, "invalid date '%s'.", arg);
+
+					}
+					break;
+
+				case 1:
+
+					if ((parse_date (arg, &(arguments->to))) < 0) {
+
+						argp_error (state, "invalid date '%s'.", arg);
+
+					}
+					break;
+
+				default:
+
+					argp_usage (state);
+
+			}
+			break;
+
+		case ARGP_KEY_END:
+
+			if (state->arg_num < 2) {
+
+				argp_usage (state);
+
+			}
+			if (arguments->to < arguments->from) {
+
+				argp_error (state, "invalid date range.");
+
+			}
+			break;
+
+		default:
+
+			return (ARGP_ERR_UNKNOWN);
+
+	};
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+
+/*
+ * A daily return of a stock.
+ */
+
+struct stock_return {
+
+	long day;	// Days since the epoch.
+	double value;
+
+};
+
+struct stock_returns {
+
+	size_t size;	// How many elements in returns[].
+	struct stock_return *returns;	// Ordered by day.
+	double mean;	// Mean of returns.
+
+};
+
+
+/*
+ * Output header.
+ */
+
+struct correlation_header {
+
+	char magic[CORRELATION_MAGIC_SIZE];
+	uint64_t stocks_size;	// How many stocks.
+	uint64_t days_size;	// How many trading days.
+	int64_t first_trading_date;	// In seconds since the epoch.
+	int64_t last_trading_date;	// In seconds since the epoch.
+
+};
+
+
+/*
+ * Work shared among threads.
+ *
+ * Stock matrices have rows_size rows of stride doubles each; row r holds the returns of stock kept[r] by trading day.
+ * Rows and days beyond the kept stocks and the trading days are zero.
+ */
+
+struct correlation_work {
+
+	const pfish_bovespa_stock_list_t *stocks;	// All stocks.
+	unsigned int view;	// Stock history view.
+	unsigned int fill;	// One of FILL_* values.
+	long from;	// Days since the epoch.
+	long to;	// Days since the epoch.
+	size_t workers_size;	// How many threads work.
+
+	struct stock_returns *returns;	// Returns of each stock.
+	unsigned char *traded;	// Nonzero for each day of the range with trades of any stock.
+	size_t *columns;	// Column of each traded day of the range.
+
+	size_t *kept;	// Index of the stock list of each row.
+	size_t kept_size;	// How many stocks are kept.
+	size_t days_size;	// How many trading days.
+	size_t rows_size;	// kept_size rounded up to a multiple of BLOCK_ROWS.
+	size_t stride;	// days_size rounded up to a multiple of 4.
+	double *values;	// Returns, centered on their means; missing days filled by policy (zero if pairwise).
+	double *squares;	// Squared values (pairwise).
+	double *observed;	// 1 on observed days, 0 on missing ones (pairwise).
+	double *variances;	// Variance of each row.
+
+	double *covariance;	// kept_size x kept_size.
+	double *correlation;	// kept_size x kept_size.
+
+	size_t blocks_size;	// rows_size / BLOCK_ROWS.
+	size_t next;	// Next stock, row or block pair; taken atomically.
+	size_t failures;	// How many tasks failed; updated atomically.
+
+};
+
+
+/*
+ * Thread pool helpers.
+ *
+ * @param arg (struct correlation_work *).
+ */
+
+void *load_worker (void *arg);	// Retrieve the returns of each stock.
+void *fill_worker (void *arg);	// Fill stock matrices, one row at a time.
+void *product_worker (void *arg);	// Compute covariances and correlations, one block pair at a time.
+
+
+/*
+ * Run a worker function on all threads; this thread works too.
+ *
+ * @param[in] work work shared among threads.
+ * @param[in] worker worker function.
+ */
+
+void correlation_run (struct correlation_work *work, void *(*worker) (void *));
+
+
+/*
+ * The portal.
+ */
+
+#define SUCCESS return (EXIT_SUCCESS)
+#define FAILURE return (EXIT_FAILURE)
+
+int main (int argc, char **argv) {
+
+	struct arguments arguments;	// Arguments given in the command line.
+	struct correlation_work work;	// Work shared among threads.
+	struct correlation_header header;	// Output header.
+	char stock[16];	// Stock identification, null padded.
+	long first_day, last_day;	// First and last trading day.
+	size_t matrix_size;	// How many doubles in a stock matrix.
+	size_t range;	// How many days in the range.
+	size_t i;	// General, short ranged indexer.
+
+	/*
+	 * Begin.
+	 */
+
+	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	pfish_bovespa_log_level_from_env ();
+	DEBUG ("start.");
+
+	/*
+	 * Parse command line arguments.
+	 */
+
+	arguments.from = 0;
+	arguments.to = 0;
+	arguments.fill = FILL_PREVIOUS;
+	arguments.min_observations = 2;
+	arguments.adjusted = 0;
+	arguments.image = 0;
+	if ((arguments.jobs = sysconf (_SC_NPROCESSORS_ONLN)) < 1) {
+
+		arguments.jobs = 1;
+
+	}
+	arguments.stats = 0;
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+	/*
+	 * From now on, log messages are written by a background thread.
+	 */
+
+	pfish_bovespa_log_start ();
+
+	/*
+	 * Retrieve returns of all stocks.
+	 */
+
+	if ((arguments.image != 0) && ((pfish_bovespa_image_attach ()) < 0)) {
+
+		CRIT ("cannot attach to the database image.");
+		FAILURE;
+
+	}
+	if ((arguments.image == 0) && ((pfish_bovespa_snapshot_pin ()) < 0)) {
+
+		CRIT ("cannot pin a database snapshot.");
+		FAILURE;
+
+	}
+	memset (&work, 0, sizeof (struct correlation_work));
+	if ((work.stocks = pfish_bovespa_stock_list_alloc ()) == NULL) {
+
+		CRIT ("cannot retrieve stock list from database.");
+		FAILURE;
+
+	}
+	work.view = (arguments.adjusted != 0) ? PFISH_BOVESPA_VIEW_ADJUSTED : PFISH_BOVESPA_VIEW_RAW;
+	work.fill = arguments.fill;
+	work.from = arguments.from;
+	work.to = arguments.to;
+	work.workers_size = arguments.jobs;
+	range = arguments.to - arguments.from + 1;
+	if (((work.returns = (struct stock_returns *) calloc (work.stocks->stock_list_size + 1, sizeof (struct stock_returns))) == NULL) || ((work.traded = (unsigned char *) calloc (range, 1)) == NULL) || ((work.columns = (size_t *) malloc (range * sizeof (size_t))) == NULL) || ((work.kept = (size_t *) malloc ((work.stocks->stock_list_size + 1) * sizeof (size_t))) == NULL)) {
+
+		ALERT ("cannot allocate heap space for %u stocks and %u days.", work.stocks->stock_list_size, range);
+		FAILURE;
+
+	}
+	correlation_run (&work, load_worker);
+	if (work.failures != 0) {
+
+		CRIT ("cannot retrieve returns of %u stocks.", work.failures);
+		FAILURE;
+
+	}
+
+	/*
+	 * Align trading days and pick stocks.
+	 */
+
+	first_day = last_day = 0;
+	for ( i = 0, work.days_size = 0; i < range; i++ ) {
+
+		if (work.traded[i] == 0) {
+
+			continue;
+
+		}
+		if (work.days_size == 0) {
+
+			first_day = arguments.from + i;
+
+		}
+		last_day = arguments.from + i;
+		work.columns[i] = work.days_size++;
+
+	}
+	for ( i = 0, work.kept_size = 0; i < work.stocks->stock_list_size; i++ ) {
+
+		if (work.returns[i].size >= arguments.min_observations) {
+
+			work.kept[work.kept_size++] = i;
+
+		}
+
+	}
+	INFO ("%lu stocks over %lu trading days.", (unsigned long) work.kept_size, (unsigned long) work.days_size);
+	work.rows_size = ((work.kept_size + BLOCK_ROWS - 1) / BLOCK_ROWS) * BLOCK_ROWS;
+	work.stride = (work.days_size + 3) & ~((size_t) 3);
+	work.blocks_size = work.rows_size / BLOCK_ROWS;
+	matrix_size = work.rows_size * work.stride;
+	if (((work.values = (double *) calloc (matrix_size + 1, sizeof (double))) == NULL) || ((work.variances = (double *) calloc (work.rows_size + 1, sizeof (double))) == NULL) || ((work.covariance = (double *) malloc ((work.kept_size * work.kept_size + 1) * sizeof (double))) == NULL) || ((work.correlation = (double *) malloc ((work.kept_size * work.kept_size + 1) * sizeof (double))) == NULL)) {
+
+		ALERT ("cannot allocate heap space for %u stocks and %u days.", work.kept_size, work.days_size);
+		FAILURE;
+
+	}
+	if ((arguments.fill == FILL_PAIRWISE) && (((work.squares = (double *) calloc (matrix_size + 1, sizeof (double))) == NULL) || ((work.observed = (double *) calloc (matrix_size + 1, sizeof (double))) == NULL))) {
+
+		ALERT ("cannot allocate heap space for %u stocks and %u days.", work.kept_size, work.days_size);
+		FAILURE;
+
+	}
+
+	/*
+	 * Fill stock matrices, then compute covariances and correlations.
+	 */
+
+	work.next = 0;
+	correlation_run (&work, fill_worker);
+	work.next = 0;
+	correlation_run (&work, product_worker);
+	if (work.failures != 0) {
+
+		CRIT ("cannot compute %u blocks of the matrices.", work.failures);
+		FAILURE;
+
+	}
+
+	/*
+	 * Export matrices.
+	 */
+
+	memcpy (header.magic, CORRELATION_MAGIC, CORRELATION_MAGIC_SIZE);
+	header.stocks_size = work.kept_size;
+	header.days_size = work.days_size;
+	header.first_trading_date = (int64_t) first_day * 86400;
+	header.last_trading_date = (int64_t) last_day * 86400;
+	if ((fwrite (&header, sizeof (struct correlation_header), 1, stdout)) != 1) {
+
+		CRIT ("cannot write to standard output.");
+		FAILURE;
+
+	}
+	for ( i = 0; i < work.kept_size; i++ ) {
+
+		memset (stock, 0, sizeof (stock));
+		strncpy (stock, work.stocks->stock_list[work.kept[i]].id, sizeof (stock) - 1);
+		if ((fwrite (stock, sizeof (stock), 1, stdout)) != 1) {
+
+			CRIT ("cannot write to standard output.");
+			FAILURE;
+
+		}
+
+	}
+	if (((fwrite (work.covariance, sizeof (double), work.kept_size * work.kept_size, stdout)) != work.kept_size * work.kept_size) || ((fwrite (work.correlation, sizeof (double), work.kept_size * work.kept_size, stdout)) != work.kept_size * work.kept_size) || ((fflush (stdout)) != 0)) {
+
+		CRIT ("cannot write to standard output.");
+		FAILURE;
+
+	}
+
+	/*
+	 * Resource releasing.
+	 */
+
+	for ( i = 0; i < work.stocks->stock_list_size; i++ ) {
+
+		free (work.returns[i].returns);
+
+	}
+	free (work.returns);
+	free (work.traded);
+	free (work.columns);
+	free (work.kept);
+	free (work.values);
+	free (work.squares);
+	free (work.observed);
+	free (work.variances);
+	free (work.covariance);
+	free (work.correlation);
+	free ((void *) work.stocks);
+
+	/*
+	 * End.
+	 */
+
+	if (arguments.stats != 0) {
+
+		pfish_bovespa_metrics_print (stderr);
+
+	}
+	DEBUG ("end.");
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int parse_date (const char *text, long *answer) {
+
+	unsigned int year, month, day;
+	char tail;
+	struct tm calendar;
+	time_t t;
+
+	if ((sscanf (text, "%4u-%2u-%2u%c", &year, &month, &day, &tail)) != 3) {
+
+		FAILURE;
+
+	}
+	if ((year < 1970) || (month < 1) || (month > 12) || (day < 1) || (day > 31)) {
+
+		FAILURE;
+
+	}
+	memset (&calendar, 0, sizeof (struct tm));
+	calendar.tm_year = year - 1900;
+	calendar.tm_mon = month - 1;
+	calendar.tm_mday = day;
+	if ((t = timegm (&calendar)) == (time_t) (-1)) {
+
+		FAILURE;
+
+	}
+	*answer = t / 86400;
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void correlation_run (struct correlation_work *work, void *(*worker) (void *)) {
+
+	pthread_t *threads;	// Helper threads.
+	size_t threads_size;	// How many helper threads were started.
+	size_t i;
+
+	threads_size = work->workers_size - 1;
+	if ((threads = (pthread_t *) malloc ((threads_size + 1) * sizeof (pthread_t))) == NULL) {
+
+		WARNING ("cannot allocate %u bytes of heap space; going on with 1 thread.", (threads_size + 1) * sizeof (pthread_t));
+		threads_size = 0;
+
+	}
+	for ( i = 0; i < threads_size; i++ ) {
+
+		if ((pthread_create (&(threads[i]), NULL, worker, work)) != 0) {
+
+			WARNING ("cannot start thread; going on with %u threads.", i + 1);
+			threads_size = i;
+			break;
+
+		}
+
+	}
+	worker (work);
+	for ( i = 0; i < threads_size; i++ ) {
+
+		pthread_join (threads[i], NULL);
+
+	}
+	free (threads);
+
+}
+
+
+void *load_worker (void *arg) {
+
+	struct correlation_work *work = (struct correlation_work *) arg;
+	struct stock_returns *returns;	// Returns of the stock being retrieved.
+	pfish_bovespa_stock_history_t *history;	// History of the stock being retrieved.
+	double previous_close;	// Unit closing price of the previous daily quote.
+	double close;	// Unit closing price of a daily quote.
+	long day;	// Day of a daily quote, in days since the epoch.
+	size_t low, high, middle;	// Binary search delimiters.
+	size_t stock;	// Index of the stock list.
+	size_t i;
+
+	while ((stock = __sync_fetch_and_add (&(work->next), 1)) < work->stocks->stock_list_size) {
+
+		returns = &(work->returns[stock]);
+		if ((pfish_bovespa_stock_history_alloc_view (&(work->stocks->stock_list[stock]), work->view, &history)) < 0) {
+
+			CRIT ("cannot retrieve history of stock '%s' from database.", work->stocks->stock_list[stock].id);
+			__sync_fetch_and_add (&(work->failures), 1);
+			continue;
+
+		}
+		if (history == NULL) {
+
+			continue;
+
+		}
+
+		// Find the first daily quote of the range; the one before it gives the first return.
+
+		for ( low = 0, high = history->daily_quotes_size; low < high; ) {
+
+			middle = low + ((high - low) / 2);
+			if ((history->daily_quotes[middle].trading_date / 86400) < work->from) {
+
+				low = middle + 1;
+
+			}
+			else {
+
+				high = middle;
+
+			}
+
+		}
+		if ((returns->returns = (struct stock_return *) malloc ((history->daily_quotes_size - low + 1) * sizeof (struct stock_return))) == NULL) {
+
+			ALERT ("cannot allocate %u bytes of heap space.", (history->daily_quotes_size - low + 1) * sizeof (struct stock_return));
+			__sync_fetch_and_add (&(work->failures), 1);
+			pfish_bovespa_stock_history_free (history);
+			continue;
+
+		}
+
+#define UNIT_CLOSE(QUOTE) ((double) (QUOTE).closing_price / (((QUOTE).price_factor != 0) ? (QUOTE).price_factor : 1))
+
+		previous_close = (low > 0) ? UNIT_CLOSE (history->daily_quotes[low - 1]) : 0;
+		for ( i = low, returns->mean = 0; i < history->daily_quotes_size; i++ ) {
+
+			if ((day = history->daily_quotes[i].trading_date / 86400) > work->to) {
+
+				break;
+
+			}
+			work->traded[day - work->from] = 1;
+			close = UNIT_CLOSE (history->daily_quotes[i]);
+			if (previous_close > 0) {
+
+				returns->returns[returns->size].day = day;
+				returns->returns[returns->size].value = (close / previous_close) - 1;
+				returns->mean += returns->returns[returns->size].value;
+				returns->size++;
+
+			}
+			previous_close = close;
+
+		}
+
+#undef UNIT_CLOSE
+
+		if (returns->size > 0) {
+
+			returns->mean /= returns->size;
+
+		}
+		if ((pfish_bovespa_stock_history_free (history)) < 0) {
+
+			CRIT ("cannot release history of stock '%s'.", work->stocks->stock_list[stock].id);
+			__sync_fetch_and_add (&(work->failures), 1);
+
+		}
+
+	}
+	return (NULL);
+
+}
+
+
+void *fill_worker (void *arg) {
+
+	struct correlation_work *work = (struct correlation_work *) arg;
+	const struct stock_returns *returns;	// Returns of the stock of the row.
+	double *values;	// Row of work->values[].
+	double mean;	// Mean of the row.
+	double sum;	// Sum of squared deviations.
+	size_t observations;	// How many values make the variance.
+	size_t row;
+	size_t i;
+
+	while ((row = __sync_fetch_and_add (&(work->next), 1)) < work->kept_size) {
+
+		returns = &(work->returns[work->kept[row]]);
+		values = work->values + (row * work->stride);
+		switch (work->fill) {
+
+			case FILL_PREVIOUS:
+
+				// Missing days have zero returns, and count for the mean.
+
+				for ( i = 0, mean = 0; i < returns->size; i++ ) {
+
+					mean += returns->returns[i].value;
+
+				}
+				mean /= work->days_size;
+				for ( i = 0; i < work->days_size; i++ ) {
+
+					values[i] = -mean;
+
+				}
+				for ( i = 0; i < returns->size; i++ ) {
+
+					values[work->columns[returns->returns[i].day - work->from]] = returns->returns[i].value - mean;
+
+				}
+				observations = work->days_size;
+				break;
+
+			case FILL_MEAN:
+
+				// Missing days have the mean return; centered, zero.
+
+				for ( i = 0; i < returns->size; i++ ) {
+
+					values[work->columns[returns->returns[i].day - work->from]] = returns->returns[i].value - returns->mean;
+
+				}
+				observations = work->days_size;
+				break;
+
+			default:
+
+				// Missing days are left out by the observed mask.
+
+				for ( i = 0; i < returns->size; i++ ) {
+
+					values[work->columns[returns->returns[i].day - work->from]] = returns->returns[i].value - returns->mean;
+					work->squares[(row * work->stride) + work->columns[returns->returns[i].day - work->from]] = (returns->returns[i].value - returns->mean) * (returns->returns[i].value - returns->mean);
+					work->observed[(row * work->stride) + work->columns[returns->returns[i].day - work->from]] = 1;
+
+				}
+				observations = returns->size;
+
+		}
+		for ( i = 0, sum = 0; i < work->days_size; i++ ) {
+
+			sum += values[i] * values[i];
+
+		}
+		work->variances[row] = (observations > 1) ? (sum / (observations - 1)) : NAN;
+
+	}
+	return (NULL);
+
+}
+
+
+/*
+ * Tile kernels: accumulate the 4 x 4 dot products of 4 rows of a and 4 rows of b over size days.
+ * Rows are stride doubles apart; answer rows are BLOCK_ROWS doubles apart. Size is a multiple of 4.
+ */
+
+static void dot_tile_software (const double *a, const double *b, size_t stride, size_t size, double *answer) {
+
+	double sum;
+	size_t i, j, t;
+
+	for ( i = 0; i < 4; i++ ) {
+
+		for ( j = 0; j < 4; j++ ) {
+
+			for ( t = 0, sum = 0; t < size; t++ ) {
+
+				sum += a[(i * stride) + t] * b[(j * stride) + t];
+
+			}
+			answer[(i * BLOCK_ROWS) + j] += sum;
+
+		}
+
+	}
+
+}
+
+#if defined (__x86_64__)
+
+/*
+ * AVX kernel: four days per instruction, two rows of a by four rows of b at a time.
+ */
+
+__attribute__ ((target ("avx")))
+static void dot_tile_avx (const double *a, const double *b, size_t stride, size_t size, double *answer) {
+
+	__m256d sums[2][4];	// Partial sums of each dot product.
+	__m256d x[2];	// Values of rows of a.
+	__m256d y;	// Values of a row of b.
+	__m256d low, high;	// Horizontal reduction helpers.
+	size_t i, j, k, t;
+
+	for ( i = 0; i < 4; i += 2 ) {
+
+		for ( k = 0; k < 2; k++ ) {
+
+			for ( j = 0; j < 4; j++ ) {
+
+				sums[k][j] = _mm256_setzero_pd ();
+
+			}
+
+		}
+		for ( t = 0; t < size; t += 4 ) {
+
+			x[0] = _mm256_loadu_pd (a + (i * stride) + t);
+			x[1] = _mm256_loadu_pd (a + ((i + 1) * stride) + t);
+			for ( j = 0; j < 4; j++ ) {
+
+				y = _mm256_loadu_pd (b + (j * stride) + t);
+				sums[0][j] = _mm256_add_pd (sums[0][j], _mm256_mul_pd (x[0], y));
+				sums[1][j] = _mm256_add_pd (sums[1][j], _mm256_mul_pd (x[1], y));
+
+			}
+
+		}
+		for ( k = 0; k < 2; k++ ) {
+
+			// Reduce four vectors of partial sums to one vector of sums.
+
+			low = _mm256_hadd_pd (sums[k][0], sums[k][1]);
+			high = _mm256_hadd_pd (sums[k][2], sums[k][3]);
+			y = _mm256_add_pd (_mm256_permute2f128_pd (low, high, 0x20), _mm256_permute2f128_pd (low, high, 0x31));
+			_mm256_storeu_pd (answer + ((i + k) * BLOCK_ROWS), _mm256_add_pd (_mm256_loadu_pd (answer + ((i + k) * BLOCK_ROWS)), y));
+
+		}
+
+	}
+
+}
+
+#define KERNEL(NAME) (__builtin_cpu_supports ("avx") ? NAME ## _avx : NAME ## _software)
+
+#else	// __x86_64__
+
+#define KERNEL(NAME) NAME ## _software
+
+#endif	// __x86_64__
+
+
+/*
+ * Product of a block of rows of a by the transposed block of rows of b, in chunks of days.
+ *
+ * @param[in] dot_tile tile kernel.
+ * @param[in] a first row of the block of a.
+ * @param[in] b first row of the block of b.
+ * @param[in] stride how many doubles from one row to the next.
+ * @param[in] days_size how many days in each row; a multiple of 4.
+ * @param[out] answer BLOCK_ROWS x BLOCK_ROWS products.
+ */
+
+static void block_product (void (*dot_tile) (const double *, const double *, size_t, size_t, double *), const double *a, const double *b, size_t stride, size_t days_size, double *answer) {
+
+	size_t size;	// How many days in a chunk.
+	size_t i, j, t;
+
+	memset (answer, 0, BLOCK_ROWS * BLOCK_ROWS * sizeof (double));
+	for ( t = 0; t < days_size; t += size ) {
+
+		size = ((days_size - t) < CHUNK_DAYS) ? (days_size - t) : CHUNK_DAYS;
+		for ( i = 0; i < BLOCK_ROWS; i += 4 ) {
+
+			for ( j = 0; j < BLOCK_ROWS; j += 4 ) {
+
+				dot_tile (a + (i * stride) + t, b + (j * stride) + t, stride, size, answer + (i * BLOCK_ROWS) + j);
+
+			}
+
+		}
+
+	}
+
+}
+
+
+void *product_worker (void *arg) {
+
+	struct correlation_work *work = (struct correlation_work *) arg;
+	void (*dot_tile) (const double *, const double *, size_t, size_t, double *);	// Tile kernel.
+	double *products;	// Block products; six of BLOCK_ROWS x BLOCK_ROWS.
+	double covariance;
+	double correlation;
+	double n;	// How many days a pair of stocks was observed together.
+	double variance_i, variance_j;	// Variances of a pair of stocks over the days they were observed together.
+	size_t task;	// Index of block pair.
+	size_t bi, bj;	// Block pair.
+	size_t i, j;	// Rows of the stocks of a pair.
+	size_t k;	// Index of the block products of a pair.
+
+	dot_tile = KERNEL (dot_tile);
+	if ((products = (double *) malloc (6 * BLOCK_ROWS * BLOCK_ROWS * sizeof (double))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", 6 * BLOCK_ROWS * BLOCK_ROWS * sizeof (double));
+		__sync_fetch_and_add (&(work->failures), 1);
+		return (NULL);
+
+	}
+
+#define ROWS(MATRIX,BLOCK) (work->MATRIX + ((BLOCK) * BLOCK_ROWS * work->stride))
+#define PRODUCT(P) products[((P) * BLOCK_ROWS * BLOCK_ROWS) + k]
+
+	while ((task = __sync_fetch_and_add (&(work->next), 1)) < work->blocks_size * work->blocks_size) {
+
+		bi = task / work->blocks_size;
+		bj = task % work->blocks_size;
+		if (bi > bj) {
+
+			continue;
+
+		}
+
+		// Products: values x values, and for pairwise also the sums over days observed together.
+
+		block_product (dot_tile, ROWS (values, bi), ROWS (values, bj), work->stride, work->stride, products);
+		if (work->fill == FILL_PAIRWISE) {
+
+			block_product (dot_tile, ROWS (values, bi), ROWS (observed, bj), work->stride, work->stride, products + (1 * BLOCK_ROWS * BLOCK_ROWS));
+			block_product (dot_tile, ROWS (observed, bi), ROWS (values, bj), work->stride, work->stride, products + (2 * BLOCK_ROWS * BLOCK_ROWS));
+			block_product (dot_tile, ROWS (squares, bi), ROWS (observed, bj), work->stride, work->stride, products + (3 * BLOCK_ROWS * BLOCK_ROWS));
+			block_product (dot_tile, ROWS (observed, bi), ROWS (squares, bj), work->stride, work->stride, products + (4 * BLOCK_ROWS * BLOCK_ROWS));
+			block_product (dot_tile, ROWS (observed, bi), ROWS (observed, bj), work->stride, work->stride, products + (5 * BLOCK_ROWS * BLOCK_ROWS));
+
+		}
+		for ( i = bi * BLOCK_ROWS; (i < (bi + 1) * BLOCK_ROWS) && (i < work->kept_size); i++ ) {
+
+			for ( j = bj * BLOCK_ROWS; (j < (bj + 1) * BLOCK_ROWS) && (j < work->kept_size); j++ ) {
+
+				k = ((i - (bi * BLOCK_ROWS)) * BLOCK_ROWS) + (j - (bj * BLOCK_ROWS));
+				if (i == j) {
+
+					covariance = work->variances[i];
+					correlation = (covariance > 0) ? 1 : NAN;
+
+				}
+				else if (work->fill != FILL_PAIRWISE) {
+
+					covariance = PRODUCT (0) / (work->days_size - 1);
+					correlation = ((work->variances[i] > 0) && (work->variances[j] > 0)) ? (covariance / sqrt (work->variances[i] * work->variances[j])) : NAN;
+
+				}
+				else {
+
+					n = PRODUCT (5);
+					if (n < 2) {
+
+						covariance = NAN;
+						correlation = NAN;
+
+					}
+					else {
+
+						covariance = (PRODUCT (0) - ((PRODUCT (1) * PRODUCT (2)) / n)) / (n - 1);
+						variance_i = (PRODUCT (3) - ((PRODUCT (1) * PRODUCT (1)) / n)) / (n - 1);
+						variance_j = (PRODUCT (4) - ((PRODUCT (2) * PRODUCT (2)) / n)) / (n - 1);
+						correlation = ((variance_i > 0) && (variance_j > 0)) ? (covariance / sqrt (variance_i * variance_j)) : NAN;
+
+					}
+
+				}
+				work->covariance[(i * work->kept_size) + j] = work->covariance[(j * work->kept_size) + i] = covariance;
+				work->correlation[(i * work->kept_size) + j] = work->correlation[(j * work->kept_size) + i] = correlation;
+
+			}
+
+		}
+
+	}
+
+#undef PRODUCT
+#undef ROWS
+
+	free (products);
+	return (NULL);
+
+}
@@ -0,0 +1,124 @@
+/*
+ * crc32c.c
+ * CRC-32C (Castagnoli) checksum.
+ */
+
+#include <config.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined (__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include "crc32c.h"
+
+
+/*
+ * Reflected polynomial.
+ */
+
+#define CRC32C_POLYNOMIAL 0x82f63b78
+
+
+/*
+ * Portable implementation: one lookup per octet.
+ */
+
+static uint32_t crc32c_table[0x100];
+
+static pthread_once_t crc32c_table_once = PTHREAD_ONCE_INIT;
+
+static void crc32c_table_init () {
+
+	uint32_t crc;
+	unsigned int i;
+	unsigned int j;
+
+	for ( i = 0; i < 0x100; i++ ) {
+
+		crc = i;
+		for ( j = 0; j < 8; j++ ) {
+
+			crc = (crc & 1) ? ((crc >> 1) ^ CRC32C_POLYNOMIAL) : (crc >> 1);
+
+		}
+		crc32c_table[i] = crc;
+
+	}
+
+}
+
+static uint32_t crc32c_software (uint32_t crc, const unsigned char *data, size_t size) {
+
+	pthread_once (&crc32c_table_once, crc32c_table_init);
+	while (size-- > 0) {
+
+		crc = crc32c_table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+
+	}
+	return (crc);
+
+}
+
+
+#if defined (__x86_64__)
+
+/*
+ * SSE 4.2 implementation: eight octets per instruction.
+ */
+
+__attribute__ ((target ("sse4.2")))
+static uint32_t crc32c_hardware (uint32_t crc, const unsigned char *data, size_t size) {
+
+	uint64_t crc64;
+	uint64_t word;
+
+	while ((size > 0) && (((uintptr_t) data & 7) != 0)) {
+
+		crc = _mm_crc32_u8 (crc, *data++);
+		size--;
+
+	}
+	crc64 = crc;
+	while (size >= 8) {
+
+		memcpy (&word, data, 8);
+		crc64 = _mm_crc32_u64 (crc64, word);
+		data += 8;
+		size -= 8;
+
+	}
+	crc = (uint32_t) crc64;
+	while (size-- > 0) {
+
+		crc = _mm_crc32_u8 (crc, *data++);
+
+	}
+	return (crc);
+
+}
+
+#endif	// __x86_64__
+
+
+uint32_t pfish_bovespa_crc32c (uint32_t crc, const void *data, size_t size) {
+
+	crc = ~crc;
+
+#if defined (__x86_64__)
+
+	if (__builtin_cpu_supports ("sse4.2")) {
+
+		return (~crc32c_hardware (crc, (const unsigned char *) data, size));
+
+	}
+
+#endif	// __x86_64__
+
+	return (~crc32c_software (crc, (const unsigned char *) data, size));
+
+}
@@ -0,0 +1,27 @@
+/*
+ * crc32c.h
+ * CRC-32C (Castagnoli) checksum.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_CRC32C_SEEN
+#define FILE_PFISH_BOVESPA_CRC32C_SEEN
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ * Compute or continue a CRC-32C checksum.
+ * Uses the processor CRC instruction when available.
+ *
+ * @param[in] crc checksum of previous data, 0 to start.
+ * @param[in] data data to be checksummed.
+ * @param[in] size how many octets in data.
+ *
+ * @return checksum of previous data followed by data.
+ */
+
+uint32_t pfish_bovespa_crc32c (uint32_t crc, const void *data, size_t size);
+
+
+#endif	// FILE_PFISH_BOVESPA_CRC32C_SEEN
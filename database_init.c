@@ -18,6 +18,8 @@
 #include <pilot_fish/bovespa.h>
 
 #include "revision_marker.h"
+#include "stock_file.h"
+#include "snapshot.h"
 
 
 /*
@@ -178,13 +180,13 @@ int main (int argc, char **argv) {
 	 */
 
 	NOTICE ("initializing an empty database.");
-	if ((system ("/bin/rm -rf " DBPATH "/*")) != 0) {
+	if ((system ("/bin/rm -rf " DBPATH "/* " DBPATH "/.[!.]*")) != 0) {
 
 		CRIT ("cannot clean database directory '%s'.", DBPATH);
 		FAILURE;
 
 	}
-	if ((system ("/bin/mkdir -p " DBPATH)) != 0) {
+	if ((system ("/bin/mkdir -p " DBPATH " " STOCK_FILE_ADJUSTED_DIR " " STOCK_FILE_WEEKLY_DIR " " STOCK_FILE_MONTHLY_DIR " " STOCK_FILE_ADJUSTED_WEEKLY_DIR " " STOCK_FILE_ADJUSTED_MONTHLY_DIR " " XPLIT_FILE_DIR " " ISIN_FILE_DIR " " LOCK_FILE_DIR " " SNAPSHOT_DIR)) != 0) {
 
 		CRIT ("cannot create database directory '%s'.", DBPATH);
 		FAILURE;
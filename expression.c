@@ -0,0 +1,1311 @@
+/*
+ * expression.c
+ * Compiled filter expressions over stock histories.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <syslog.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+#include "expression.h"
+
+
+/*
+ * Daily quotes evaluated at once by each instruction.
+ */
+
+#define EXPRESSION_BLOCK_SIZE 0x100
+
+
+/*
+ * Upper bound of window lengths.
+ */
+
+#define EXPRESSION_MAX_WINDOW 0x10000
+
+
+/*
+ * Fields of daily quotes.
+ */
+
+#define FIELD_OPEN 0
+#define FIELD_CLOSE 1
+#define FIELD_MINIMUM 2
+#define FIELD_MAXIMUM 3
+#define FIELD_AVERAGE 4
+#define FIELD_TOTAL_TRADES 5
+#define FIELD_TOTAL_STOCKS 6
+#define FIELD_TOTAL_VOLUME 7
+#define FIELDS_SIZE 8
+
+static const char *field_names[FIELDS_SIZE] = { "open", "close", "minimum", "maximum", "average", "total_trades", "total_stocks", "total_volume" };
+
+
+/*
+ * Operations.
+ * Window operations keep state along the stock history.
+ */
+
+#define OP_CONST 0
+#define OP_LOAD 1
+#define OP_NEG 2
+#define OP_ABS 3
+#define OP_NOT 4
+#define OP_ADD 5
+#define OP_SUB 6
+#define OP_MUL 7
+#define OP_DIV 8
+#define OP_LT 9
+#define OP_LE 10
+#define OP_GT 11
+#define OP_GE 12
+#define OP_EQ 13
+#define OP_NE 14
+#define OP_AND_SKIP 15
+#define OP_AND 16
+#define OP_OR_SKIP 17
+#define OP_OR 18
+#define OP_SMA 19
+#define OP_EMA 20
+#define OP_LAG 21
+#define OP_HIGHEST 22
+#define OP_LOWEST 23
+
+#define OP_IS_WINDOW(OP) ((OP) >= OP_SMA)
+
+static const char *window_names[] = { "sma", "ema", "lag", "highest", "lowest" };
+
+#define WINDOW_NAMES_SIZE (sizeof (window_names) / sizeof (char *))
+
+
+/*
+ * Truth of a value: neither zero nor undefined.
+ */
+
+#define TRUTH(X) (((X) != 0) && ((X) == (X)))
+
+
+/*
+ * Plan instruction.
+ * Registers hold one block of values each.
+ */
+
+struct instruction {
+
+	unsigned int op;	// One of OP_* values.
+	size_t target;	// Target register.
+	size_t source[2];	// Source registers.
+	double constant;	// Value of OP_CONST.
+	unsigned int field;	// Field of OP_LOAD; one of FIELD_* values.
+	size_t window;	// Window length of window operations.
+	size_t state;	// Index of machine window states of window operations.
+	size_t jump;	// Index of the instruction after the operation skipped by OP_AND_SKIP / OP_OR_SKIP.
+
+};
+
+
+/*
+ * Instructions are laid out in sections:
+ * constants, filled once per machine;
+ * window operations and their operands, run on every block;
+ * the remaining of the expression, run only on blocks with screened daily quotes.
+ */
+
+struct pfish_bovespa_expression {
+
+	size_t registers_size;	// How many registers.
+	size_t windows_size;	// How many window operations.
+	size_t result;	// Register of the expression value.
+	size_t warmup;	// How many daily quotes before the first screened one are needed; SIZE_MAX for all.
+	size_t constants_end;	// Index of instructions[] after the constants.
+	size_t windows_end;	// Index of instructions[] after the window operations.
+	size_t instructions_size;	// How many elements in instructions[].
+	struct instruction instructions[];
+
+};
+
+
+/*
+ * Window operation state.
+ */
+
+struct window_state {
+
+	size_t fed;	// How many values were fed.
+	size_t last_undefined;	// 1 + ordinal of the last undefined value fed, 0 if none.
+	double sum;	// Sum of defined values in window.
+	double value;	// Running average of ema.
+	size_t valid;	// How many defined values were fed in a row (ema).
+	double *ring;	// Last fed values; window elements.
+	size_t ring_position;	// Index of ring[] of the oldest value.
+	size_t *deque_index;	// Ordinals of monotonic deque (highest, lowest); window elements.
+	double *deque_value;	// Values of monotonic deque; window elements.
+	size_t deque_head;	// Index of deque_*[] of the first element.
+	size_t deque_size;	// How many elements in deque.
+
+};
+
+struct pfish_bovespa_expression_machine {
+
+	const pfish_bovespa_expression_t *expression;
+	double *registers;	// registers_size blocks of values.
+	struct window_state *windows;	// windows_size elements.
+	unsigned int loaded;	// Bit mask of fields loaded in current block.
+	const pfish_bovespa_daily_quote_t *block;	// First daily quote of current block.
+
+};
+
+
+/*
+ * Syntax tree.
+ * Node indexes double as register numbers.
+ */
+
+struct node {
+
+	unsigned int op;	// One of OP_* values.
+	size_t operand[2];	// Indexes of operand nodes.
+	double constant;	// Value of OP_CONST.
+	unsigned int field;	// Field of OP_LOAD.
+	size_t window;	// Window length of window operations.
+	size_t warmup;	// How many earlier daily quotes the node value depends on; SIZE_MAX for all.
+	unsigned int emitted;	// Nonzero if a window operation was already emitted.
+
+};
+
+struct parser {
+
+	const char *text;	// Expression text.
+	const char *cursor;	// Current position in text.
+	struct node *nodes;
+	size_t nodes_size;	// How many elements in nodes[].
+	size_t nodes_capacity;	// How many elements fit in nodes[].
+	size_t fields[FIELDS_SIZE];	// Node of each loaded field; SIZE_MAX if not loaded yet.
+
+};
+
+
+static int parse_expression (struct parser *parser, size_t *answer);
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+static int syntax_error (struct parser *parser, const char *message) {
+
+	ERR ("syntax error at offset %u of expression: %s.", (unsigned int) (parser->cursor - parser->text), message);
+	FAILURE;
+
+}
+
+static size_t saturated_sum (size_t a, size_t b) {
+
+	return ((a > SIZE_MAX - b) ? SIZE_MAX : a + b);
+
+}
+
+static int new_node (struct parser *parser, unsigned int op, size_t a, size_t b, size_t *answer) {
+
+	struct node *nodes;	// Resized nodes.
+	struct node *node;	// New node.
+	size_t capacity;	// New capacity.
+
+	if (parser->nodes_size == parser->nodes_capacity) {
+
+		capacity = (parser->nodes_capacity == 0) ? 0x10 : (2 * parser->nodes_capacity);
+		if ((nodes = (struct node *) realloc (parser->nodes, capacity * sizeof (struct node))) == NULL) {
+
+			ALERT ("cannot allocate %zu bytes of heap space.", capacity * sizeof (struct node));
+			FAILURE;
+
+		}
+		parser->nodes = nodes;
+		parser->nodes_capacity = capacity;
+
+	}
+	node = &(parser->nodes[parser->nodes_size]);
+	memset (node, 0, sizeof (struct node));
+	node->op = op;
+	node->operand[0] = a;
+	node->operand[1] = b;
+	switch (op) {
+
+		case OP_CONST:
+		case OP_LOAD:
+
+			node->warmup = 0;
+			break;
+
+		case OP_NEG:
+		case OP_ABS:
+		case OP_NOT:
+		case OP_SMA:
+		case OP_EMA:
+		case OP_LAG:
+		case OP_HIGHEST:
+		case OP_LOWEST:
+
+			// Window operations complete their warmup when their window is known.
+
+			node->warmup = parser->nodes[a].warmup;
+			break;
+
+		default:
+
+			node->warmup = (parser->nodes[a].warmup > parser->nodes[b].warmup) ? parser->nodes[a].warmup : parser->nodes[b].warmup;
+
+	}
+	*answer = parser->nodes_size++;
+	SUCCESS;
+
+}
+
+static void skip_spaces (struct parser *parser) {
+
+	while (isspace ((unsigned char) *(parser->cursor))) {
+
+		parser->cursor++;
+
+	}
+
+}
+
+static int accept_symbol (struct parser *parser, const char *symbol) {
+
+	size_t length = strlen (symbol);
+
+	skip_spaces (parser);
+	if ((strncmp (parser->cursor, symbol, length)) != 0) {
+
+		return (0);
+
+	}
+	parser->cursor += length;
+	return (1);
+
+}
+
+static int accept_keyword (struct parser *parser, const char *keyword) {
+
+	size_t length = strlen (keyword);
+
+	skip_spaces (parser);
+	if (((strncmp (parser->cursor, keyword, length)) != 0) || (isalnum ((unsigned char) parser->cursor[length])) || (parser->cursor[length] == '_')) {
+
+		return (0);
+
+	}
+	parser->cursor += length;
+	return (1);
+
+}
+
+static int parse_primary (struct parser *parser, size_t *answer) {
+
+	const char *start;	// Start of a token.
+	size_t length;	// Length of an identifier.
+	char *tail;
+	double constant;
+	long window;
+	unsigned int op;
+	size_t operand;
+	size_t i;
+
+	skip_spaces (parser);
+	start = parser->cursor;
+
+	/*
+	 * Parenthesized expression.
+	 */
+
+	if (accept_symbol (parser, "(")) {
+
+		if ((parse_expression (parser, answer)) < 0) {
+
+			FAILURE;
+
+		}
+		if (!accept_symbol (parser, ")")) {
+
+			return (syntax_error (parser, "missing ')'"));
+
+		}
+		SUCCESS;
+
+	}
+
+	/*
+	 * Number.
+	 */
+
+	if ((isdigit ((unsigned char) *start)) || (*start == '.')) {
+
+		constant = strtod (start, &tail);
+		if (tail == start) {
+
+			return (syntax_error (parser, "invalid number"));
+
+		}
+		parser->cursor = tail;
+		if ((new_node (parser, OP_CONST, 0, 0, answer)) < 0) {
+
+			FAILURE;
+
+		}
+		parser->nodes[*answer].constant = constant;
+		SUCCESS;
+
+	}
+
+	/*
+	 * Field or function.
+	 */
+
+	for ( length = 0; (isalnum ((unsigned char) start[length])) || (start[length] == '_'); length++ );
+	if (length == 0) {
+
+		return (syntax_error (parser, "expected number, field, function or '('"));
+
+	}
+	parser->cursor += length;
+	for ( i = 0; i < FIELDS_SIZE; i++ ) {
+
+		if (((strncmp (start, field_names[i], length)) == 0) && (field_names[i][length] == 0)) {
+
+			// Each field is loaded by one node.
+
+			if (parser->fields[i] == SIZE_MAX) {
+
+				if ((new_node (parser, OP_LOAD, 0, 0, &(parser->fields[i]))) < 0) {
+
+					FAILURE;
+
+				}
+				parser->nodes[parser->fields[i]].field = i;
+
+			}
+			*answer = parser->fields[i];
+			SUCCESS;
+
+		}
+
+	}
+	if (((strncmp (start, "abs", length)) == 0) && (length == 3)) {
+
+		op = OP_ABS;
+
+	}
+	else {
+
+		for ( i = 0; i < WINDOW_NAMES_SIZE; i++ ) {
+
+			if (((strncmp (start, window_names[i], length)) == 0) && (window_names[i][length] == 0)) {
+
+				break;
+
+			}
+
+		}
+		if (i == WINDOW_NAMES_SIZE) {
+
+			parser->cursor = start;
+			return (syntax_error (parser, "unknown field or function"));
+
+		}
+		op = OP_SMA + i;
+
+	}
+	if (!accept_symbol (parser, "(")) {
+
+		return (syntax_error (parser, "missing '('"));
+
+	}
+	if ((parse_expression (parser, &operand)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((new_node (parser, op, operand, 0, answer)) < 0) {
+
+		FAILURE;
+
+	}
+	if (OP_IS_WINDOW (op)) {
+
+		if (!accept_symbol (parser, ",")) {
+
+			return (syntax_error (parser, "missing window length"));
+
+		}
+		skip_spaces (parser);
+		window = strtol (parser->cursor, &tail, 10);
+		if ((tail == parser->cursor) || (window < 1) || (window > EXPRESSION_MAX_WINDOW)) {
+
+			return (syntax_error (parser, "invalid window length"));
+
+		}
+		parser->cursor = tail;
+
+#define NODE parser->nodes[*answer]
+
+		NODE.window = window;
+		switch (op) {
+
+			case OP_EMA:
+
+				// Depends on all history since its seed.
+
+				NODE.warmup = SIZE_MAX;
+				break;
+
+			case OP_LAG:
+
+				NODE.warmup = saturated_sum (NODE.warmup, window);
+				break;
+
+			default:
+
+				NODE.warmup = saturated_sum (NODE.warmup, window - 1);
+
+		}
+
+#undef NODE
+
+	}
+	if (!accept_symbol (parser, ")")) {
+
+		return (syntax_error (parser, "missing ')'"));
+
+	}
+	SUCCESS;
+
+}
+
+static int parse_unary (struct parser *parser, size_t *answer) {
+
+	size_t operand;
+
+	if (accept_symbol (parser, "-")) {
+
+		if ((parse_unary (parser, &operand)) < 0) {
+
+			FAILURE;
+
+		}
+		return (new_node (parser, OP_NEG, operand, 0, answer));
+
+	}
+	return (parse_primary (parser, answer));
+
+}
+
+static int parse_product (struct parser *parser, size_t *answer) {
+
+	size_t operand;
+	unsigned int op;
+
+	if ((parse_unary (parser, answer)) < 0) {
+
+		FAILURE;
+
+	}
+	while (1) {
+
+		if (accept_symbol (parser, "*")) {
+
+			op = OP_MUL;
+
+		}
+		else if (accept_symbol (parser, "/")) {
+
+			op = OP_DIV;
+
+		}
+		else {
+
+			SUCCESS;
+
+		}
+		if (((parse_unary (parser, &operand)) < 0) || ((new_node (parser, op, *answer, operand, answer)) < 0)) {
+
+			FAILURE;
+
+		}
+
+	}
+
+}
+
+static int parse_sum (struct parser *parser, size_t *answer) {
+
+	size_t operand;
+	unsigned int op;
+
+	if ((parse_product (parser, answer)) < 0) {
+
+		FAILURE;
+
+	}
+	while (1) {
+
+		if (accept_symbol (parser, "+")) {
+
+			op = OP_ADD;
+
+		}
+		else if (accept_symbol (parser, "-")) {
+
+			op = OP_SUB;
+
+		}
+		else {
+
+			SUCCESS;
+
+		}
+		if (((parse_product (parser, &operand)) < 0) || ((new_node (parser, op, *answer, operand, answer)) < 0)) {
+
+			FAILURE;
+
+		}
+
+	}
+
+}
+
+static int parse_comparison (struct parser *parser, size_t *answer) {
+
+	size_t operand;
+	unsigned int op;
+
+	if ((parse_sum (parser, answer)) < 0) {
+
+		FAILURE;
+
+	}
+	if (accept_symbol (parser, "<=")) {
+
+		op = OP_LE;
+
+	}
+	else if (accept_symbol (parser, "<")) {
+
+		op = OP_LT;
+
+	}
+	else if (accept_symbol (parser, ">=")) {
+
+		op = OP_GE;
+
+	}
+	else if (accept_symbol (parser, ">")) {
+
+		op = OP_GT;
+
+	}
+	else if (accept_symbol (parser, "==")) {
+
+		op = OP_EQ;
+
+	}
+	else if (accept_symbol (parser, "!=")) {
+
+		op = OP_NE;
+
+	}
+	else {
+
+		SUCCESS;
+
+	}
+	if ((parse_sum (parser, &operand)) < 0) {
+
+		FAILURE;
+
+	}
+	return (new_node (parser, op, *answer, operand, answer));
+
+}
+
+static int parse_negation (struct parser *parser, size_t *answer) {
+
+	size_t operand;
+
+	if (accept_keyword (parser, "not")) {
+
+		if ((parse_negation (parser, &operand)) < 0) {
+
+			FAILURE;
+
+		}
+		return (new_node (parser, OP_NOT, operand, 0, answer));
+
+	}
+	return (parse_comparison (parser, answer));
+
+}
+
+static int parse_conjunction (struct parser *parser, size_t *answer) {
+
+	size_t operand;
+
+	if ((parse_negation (parser, answer)) < 0) {
+
+		FAILURE;
+
+	}
+	while (accept_keyword (parser, "and")) {
+
+		if (((parse_negation (parser, &operand)) < 0) || ((new_node (parser, OP_AND, *answer, operand, answer)) < 0)) {
+
+			FAILURE;
+
+		}
+
+	}
+	SUCCESS;
+
+}
+
+static int parse_expression (struct parser *parser, size_t *answer) {
+
+	size_t operand;
+
+	if ((parse_conjunction (parser, answer)) < 0) {
+
+		FAILURE;
+
+	}
+	while (accept_keyword (parser, "or")) {
+
+		if (((parse_conjunction (parser, &operand)) < 0) || ((new_node (parser, OP_OR, *answer, operand, answer)) < 0)) {
+
+			FAILURE;
+
+		}
+
+	}
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+/*
+ * Code generation.
+ * Nodes are emitted in operand order; window operations are emitted once, by emit_windows().
+ */
+
+static struct instruction *emit_instruction (pfish_bovespa_expression_t *expression, const struct node *nodes, size_t node, unsigned int op) {
+
+	struct instruction *instruction = &(expression->instructions[expression->instructions_size++]);
+
+	memset (instruction, 0, sizeof (struct instruction));
+	instruction->op = op;
+	instruction->target = node;
+	instruction->source[0] = nodes[node].operand[0];
+	instruction->source[1] = nodes[node].operand[1];
+	instruction->constant = nodes[node].constant;
+	instruction->field = nodes[node].field;
+	instruction->window = nodes[node].window;
+	return (instruction);
+
+}
+
+static void emit_node (pfish_bovespa_expression_t *expression, const struct node *nodes, size_t node) {
+
+	struct instruction *skip;	// Short circuit instruction.
+
+	switch (nodes[node].op) {
+
+		case OP_CONST:
+
+			break;
+
+		case OP_LOAD:
+
+			// Loads are emitted at every use, since a previous use might have been skipped.
+
+			emit_instruction (expression, nodes, node, OP_LOAD);
+			break;
+
+		case OP_NEG:
+		case OP_ABS:
+		case OP_NOT:
+
+			emit_node (expression, nodes, nodes[node].operand[0]);
+			emit_instruction (expression, nodes, node, nodes[node].op);
+			break;
+
+		case OP_AND:
+		case OP_OR:
+
+			emit_node (expression, nodes, nodes[node].operand[0]);
+			skip = emit_instruction (expression, nodes, node, (nodes[node].op == OP_AND) ? OP_AND_SKIP : OP_OR_SKIP);
+			emit_node (expression, nodes, nodes[node].operand[1]);
+			emit_instruction (expression, nodes, node, nodes[node].op);
+			skip->jump = expression->instructions_size;
+			break;
+
+		default:
+
+			if (!OP_IS_WINDOW (nodes[node].op)) {
+
+				emit_node (expression, nodes, nodes[node].operand[0]);
+				emit_node (expression, nodes, nodes[node].operand[1]);
+				emit_instruction (expression, nodes, node, nodes[node].op);
+
+			}
+
+	}
+
+}
+
+static void emit_windows (pfish_bovespa_expression_t *expression, struct node *nodes, size_t node) {
+
+	struct instruction *instruction;
+
+	switch (nodes[node].op) {
+
+		case OP_CONST:
+		case OP_LOAD:
+
+			return;
+
+		case OP_NEG:
+		case OP_ABS:
+		case OP_NOT:
+
+			emit_windows (expression, nodes, nodes[node].operand[0]);
+			return;
+
+		default:
+
+			if (!OP_IS_WINDOW (nodes[node].op)) {
+
+				emit_windows (expression, nodes, nodes[node].operand[0]);
+				emit_windows (expression, nodes, nodes[node].operand[1]);
+				return;
+
+			}
+
+	}
+
+	// Window operations nested in the operand go first.
+
+	emit_windows (expression, nodes, nodes[node].operand[0]);
+	if (nodes[node].emitted == 0) {
+
+		emit_node (expression, nodes, nodes[node].operand[0]);
+		instruction = emit_instruction (expression, nodes, node, nodes[node].op);
+		instruction->state = expression->windows_size++;
+		nodes[node].emitted = 1;
+
+	}
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int pfish_bovespa_expression_compile (const char *text, pfish_bovespa_expression_t **answer) {
+
+	struct parser parser;
+	size_t root;	// Root node.
+	pfish_bovespa_expression_t *expression;
+	size_t capacity;	// How many instructions fit in the plan.
+	size_t i;
+
+#define FREE free (parser.nodes)
+
+	/*
+	 * Parse.
+	 */
+
+	parser.text = text;
+	parser.cursor = text;
+	parser.nodes = NULL;
+	parser.nodes_size = 0;
+	parser.nodes_capacity = 0;
+	for ( i = 0; i < FIELDS_SIZE; i++ ) {
+
+		parser.fields[i] = SIZE_MAX;
+
+	}
+	if ((parse_expression (&parser, &root)) < 0) {
+
+		FREE;
+		FAILURE;
+
+	}
+	skip_spaces (&parser);
+	if (*(parser.cursor) != 0) {
+
+		syntax_error (&parser, "unexpected text");
+		FREE;
+		FAILURE;
+
+	}
+
+	/*
+	 * Generate the plan.
+	 * Each node emits at most two instructions, besides loads at each of at most two uses per node.
+	 */
+
+	capacity = 4 * parser.nodes_size;
+	if ((expression = (pfish_bovespa_expression_t *) malloc (sizeof (pfish_bovespa_expression_t) + (capacity * sizeof (struct instruction)))) == NULL) {
+
+		ALERT ("cannot allocate %zu bytes of heap space.", sizeof (pfish_bovespa_expression_t) + (capacity * sizeof (struct instruction)));
+		FREE;
+		FAILURE;
+
+	}
+	expression->registers_size = parser.nodes_size;
+	expression->windows_size = 0;
+	expression->result = root;
+	expression->warmup = parser.nodes[root].warmup;
+	expression->instructions_size = 0;
+	for ( i = 0; i < parser.nodes_size; i++ ) {
+
+		if (parser.nodes[i].op == OP_CONST) {
+
+			emit_instruction (expression, parser.nodes, i, OP_CONST);
+
+		}
+
+	}
+	expression->constants_end = expression->instructions_size;
+	emit_windows (expression, parser.nodes, root);
+	expression->windows_end = expression->instructions_size;
+	if (!OP_IS_WINDOW (parser.nodes[root].op)) {
+
+		emit_node (expression, parser.nodes, root);
+
+	}
+	DEBUG ("expression compiled: %lu registers, %lu window operations, %lu instructions, warmup %ld.", (unsigned long) expression->registers_size, (unsigned long) expression->windows_size, (unsigned long) expression->instructions_size, (expression->warmup == SIZE_MAX) ? -1L : (long) expression->warmup);
+	FREE;
+	*answer = expression;
+	SUCCESS;
+
+#undef FREE
+
+}
+
+int pfish_bovespa_expression_machine_alloc (const pfish_bovespa_expression_t *expression, pfish_bovespa_expression_machine_t **answer) {
+
+	pfish_bovespa_expression_machine_t *machine;
+	const struct instruction *instruction;
+	struct window_state *state;
+	size_t i, j;
+
+#define FREE pfish_bovespa_expression_machine_free (machine)
+
+	if ((machine = (pfish_bovespa_expression_machine_t *) calloc (1, sizeof (pfish_bovespa_expression_machine_t))) == NULL) {
+
+		ALERT ("cannot allocate %zu bytes of heap space.", sizeof (pfish_bovespa_expression_machine_t));
+		FAILURE;
+
+	}
+	machine->expression = expression;
+	if ((machine->registers = (double *) malloc (expression->registers_size * EXPRESSION_BLOCK_SIZE * sizeof (double))) == NULL) {
+
+		ALERT ("cannot allocate %zu bytes of heap space.", expression->registers_size * EXPRESSION_BLOCK_SIZE * sizeof (double));
+		FREE;
+		FAILURE;
+
+	}
+	if ((machine->windows = (struct window_state *) calloc (expression->windows_size + 1, sizeof (struct window_state))) == NULL) {
+
+		ALERT ("cannot allocate %zu bytes of heap space.", (expression->windows_size + 1) * sizeof (struct window_state));
+		FREE;
+		FAILURE;
+
+	}
+	for ( i = 0; i < expression->instructions_size; i++ ) {
+
+		instruction = &(expression->instructions[i]);
+		if (instruction->op == OP_CONST) {
+
+			for ( j = 0; j < EXPRESSION_BLOCK_SIZE; j++ ) {
+
+				machine->registers[(instruction->target * EXPRESSION_BLOCK_SIZE) + j] = instruction->constant;
+
+			}
+
+		}
+		if (!OP_IS_WINDOW (instruction->op)) {
+
+			continue;
+
+		}
+		state = &(machine->windows[instruction->state]);
+		if (((state->ring = (double *) malloc (instruction->window * sizeof (double))) == NULL) || ((state->deque_index = (size_t *) malloc (instruction->window * sizeof (size_t))) == NULL) || ((state->deque_value = (double *) malloc (instruction->window * sizeof (double))) == NULL)) {
+
+			ALERT ("cannot allocate %zu bytes of heap space.", instruction->window * sizeof (double));
+			FREE;
+			FAILURE;
+
+		}
+
+	}
+	*answer = machine;
+	SUCCESS;
+
+#undef FREE
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void pfish_bovespa_expression_machine_free (pfish_bovespa_expression_machine_t *target) {
+
+	size_t i;
+
+	if (target->windows != NULL) {
+
+		for ( i = 0; i < target->expression->windows_size; i++ ) {
+
+			free (target->windows[i].ring);
+			free (target->windows[i].deque_index);
+			free (target->windows[i].deque_value);
+
+		}
+		free (target->windows);
+
+	}
+	free (target->registers);
+	free (target);
+
+}
+
+
+/*
+ * Load a field of a block of daily quotes.
+ */
+
+static void load_field (const pfish_bovespa_daily_quote_t *quotes, unsigned int field, size_t size, double *answer) {
+
+	size_t i;
+
+#define UNIT(FIELD) for ( i = 0; i < size; i++ ) { answer[i] = (double) quotes[i].FIELD / ((quotes[i].price_factor != 0) ? quotes[i].price_factor : 1); }
+#define TOTAL(FIELD) for ( i = 0; i < size; i++ ) { answer[i] = quotes[i].FIELD; }
+
+	switch (field) {
+
+		case FIELD_OPEN: UNIT (opening_price); break;
+		case FIELD_CLOSE: UNIT (closing_price); break;
+		case FIELD_MINIMUM: UNIT (minimum_price); break;
+		case FIELD_MAXIMUM: UNIT (maximum_price); break;
+		case FIELD_AVERAGE: UNIT (average_price); break;
+		case FIELD_TOTAL_TRADES: TOTAL (total_trades); break;
+		case FIELD_TOTAL_STOCKS: TOTAL (total_stocks); break;
+		default: TOTAL (total_volume);
+
+	}
+
+#undef TOTAL
+#undef UNIT
+
+}
+
+
+/*
+ * Feed a block of values to a window operation.
+ */
+
+static void run_window (const struct instruction *instruction, struct window_state *state, const double *a, size_t size, double *answer) {
+
+	size_t n = instruction->window;
+	size_t ordinal;	// 1 + ordinal of the value being fed.
+	unsigned int full;	// Nonzero if the window is full of defined values.
+	double x;
+	double outgoing;	// Value leaving the window.
+	size_t back;	// Index of deque_*[] of the last element.
+	size_t i, j;
+
+	for ( i = 0; i < size; i++ ) {
+
+		x = a[i];
+		ordinal = ++(state->fed);
+		if (x != x) {
+
+			state->last_undefined = ordinal;
+
+		}
+		full = (ordinal >= n) && ((state->last_undefined == 0) || (ordinal - state->last_undefined >= n));
+		switch (instruction->op) {
+
+			case OP_SMA:
+
+				outgoing = (ordinal > n) ? state->ring[state->ring_position] : 0;
+				state->ring[state->ring_position] = x;
+				if (++(state->ring_position) == n) {
+
+					// Once per window, sum again to keep rounding errors from piling up.
+
+					state->ring_position = 0;
+					for ( j = 0, state->sum = 0; j < n; j++ ) {
+
+						if (state->ring[j] == state->ring[j]) {
+
+							state->sum += state->ring[j];
+
+						}
+
+					}
+
+				}
+				else {
+
+					if (outgoing == outgoing) {
+
+						state->sum -= outgoing;
+
+					}
+					if (x == x) {
+
+						state->sum += x;
+
+					}
+
+				}
+				answer[i] = full ? (state->sum / n) : NAN;
+				break;
+
+			case OP_EMA:
+
+				if (x != x) {
+
+					state->valid = 0;
+					state->sum = 0;
+					answer[i] = NAN;
+					break;
+
+				}
+				state->valid++;
+				if (state->valid < n) {
+
+					state->sum += x;
+					answer[i] = NAN;
+
+				}
+				else if (state->valid == n) {
+
+					state->value = (state->sum + x) / n;
+					answer[i] = state->value;
+
+				}
+				else {
+
+					state->value += (2.0 / (n + 1)) * (x - state->value);
+					answer[i] = state->value;
+
+				}
+				break;
+
+			case OP_LAG:
+
+				answer[i] = (ordinal > n) ? state->ring[state->ring_position] : NAN;
+				state->ring[state->ring_position] = x;
+				if (++(state->ring_position) == n) {
+
+					state->ring_position = 0;
+
+				}
+				break;
+
+			default:
+
+				// Monotonic deque: values in window order, each better than all later ones.
+
+				while ((state->deque_size > 0) && (state->deque_index[state->deque_head] + n <= ordinal)) {
+
+					state->deque_head = (state->deque_head + 1) % n;
+					state->deque_size--;
+
+				}
+				if (x == x) {
+
+					while (state->deque_size > 0) {
+
+						back = (state->deque_head + state->deque_size - 1) % n;
+						if ((instruction->op == OP_HIGHEST) ? (state->deque_value[back] > x) : (state->deque_value[back] < x)) {
+
+							break;
+
+						}
+						state->deque_size--;
+
+					}
+					back = (state->deque_head + state->deque_size) % n;
+					state->deque_index[back] = ordinal;
+					state->deque_value[back] = x;
+					state->deque_size++;
+
+				}
+				answer[i] = full ? state->deque_value[state->deque_head] : NAN;
+
+		}
+
+	}
+
+}
+
+
+/*
+ * Run a section of the plan over a block.
+ */
+
+static void run (pfish_bovespa_expression_machine_t *machine, size_t begin, size_t end, size_t size) {
+
+	const struct instruction *instruction;
+	double *t;	// Target register.
+	const double *a, *b;	// Source registers.
+	size_t pc;	// Index of the running instruction.
+	size_t i;
+
+#define REGISTER(R) (machine->registers + ((R) * EXPRESSION_BLOCK_SIZE))
+#define ELEMENTWISE(EXPRESSION) for ( i = 0; i < size; i++ ) { t[i] = (EXPRESSION); } break
+
+	for ( pc = begin; pc < end; pc++ ) {
+
+		instruction = &(machine->expression->instructions[pc]);
+		t = REGISTER (instruction->target);
+		a = REGISTER (instruction->source[0]);
+		b = REGISTER (instruction->source[1]);
+		switch (instruction->op) {
+
+			case OP_LOAD:
+
+				if ((machine->loaded & (1U << instruction->field)) == 0) {
+
+					load_field (machine->block, instruction->field, size, t);
+					machine->loaded |= 1U << instruction->field;
+
+				}
+				break;
+
+			case OP_NEG: ELEMENTWISE (-a[i]);
+			case OP_ABS: ELEMENTWISE (fabs (a[i]));
+			case OP_NOT: ELEMENTWISE (TRUTH (a[i]) ? 0.0 : 1.0);
+			case OP_ADD: ELEMENTWISE (a[i] + b[i]);
+			case OP_SUB: ELEMENTWISE (a[i] - b[i]);
+			case OP_MUL: ELEMENTWISE (a[i] * b[i]);
+			case OP_DIV: ELEMENTWISE (a[i] / b[i]);
+			case OP_LT: ELEMENTWISE ((a[i] < b[i]) ? 1.0 : 0.0);
+			case OP_LE: ELEMENTWISE ((a[i] <= b[i]) ? 1.0 : 0.0);
+			case OP_GT: ELEMENTWISE ((a[i] > b[i]) ? 1.0 : 0.0);
+			case OP_GE: ELEMENTWISE ((a[i] >= b[i]) ? 1.0 : 0.0);
+			case OP_EQ: ELEMENTWISE ((a[i] == b[i]) ? 1.0 : 0.0);
+			case OP_NE: ELEMENTWISE (((a[i] == a[i]) && (b[i] == b[i]) && (a[i] != b[i])) ? 1.0 : 0.0);
+			case OP_AND: ELEMENTWISE ((TRUTH (a[i]) && TRUTH (b[i])) ? 1.0 : 0.0);
+			case OP_OR: ELEMENTWISE ((TRUTH (a[i]) || TRUTH (b[i])) ? 1.0 : 0.0);
+
+			case OP_AND_SKIP:
+
+				// Skip the second operand if the first one is false all over the block.
+
+				for ( i = 0; (i < size) && !TRUTH (a[i]); i++ );
+				if (i == size) {
+
+					memset (t, 0, size * sizeof (double));
+					pc = instruction->jump - 1;
+
+				}
+				break;
+
+			case OP_OR_SKIP:
+
+				// Skip the second operand if the first one is true all over the block.
+
+				for ( i = 0; (i < size) && TRUTH (a[i]); i++ );
+				if (i == size) {
+
+					for ( i = 0; i < size; i++ ) {
+
+						t[i] = 1.0;
+
+					}
+					pc = instruction->jump - 1;
+
+				}
+				break;
+
+			default:
+
+				run_window (instruction, &(machine->windows[instruction->state]), a, size, t);
+
+		}
+
+	}
+
+#undef ELEMENTWISE
+#undef REGISTER
+
+}
+
+
+size_t pfish_bovespa_expression_screen (pfish_bovespa_expression_machine_t *machine, const pfish_bovespa_stock_history_t *history, size_t first, size_t last, unsigned char *answer) {
+
+	const pfish_bovespa_expression_t *expression = machine->expression;
+	struct window_state *state;
+	const double *result;	// Register of the expression value.
+	size_t start;	// Index of history->daily_quotes[] of the first evaluated daily quote.
+	size_t size;	// How many daily quotes in a block.
+	size_t count;	// How many daily quotes satisfy the expression.
+	size_t i, j;
+
+	for ( i = 0; i < expression->windows_size; i++ ) {
+
+		state = &(machine->windows[i]);
+		state->fed = 0;
+		state->last_undefined = 0;
+		state->sum = 0;
+		state->value = 0;
+		state->valid = 0;
+		state->ring_position = 0;
+		state->deque_head = 0;
+		state->deque_size = 0;
+
+	}
+	start = (expression->warmup >= first) ? 0 : (first - expression->warmup);
+	result = machine->registers + (expression->result * EXPRESSION_BLOCK_SIZE);
+	for ( i = start, count = 0; i < last; i += size ) {
+
+		size = ((last - i) < EXPRESSION_BLOCK_SIZE) ? (last - i) : EXPRESSION_BLOCK_SIZE;
+		machine->block = &(history->daily_quotes[i]);
+		machine->loaded = 0;
+		run (machine, expression->constants_end, expression->windows_end, size);
+		if (i + size <= first) {
+
+			continue;
+
+		}
+		run (machine, expression->windows_end, expression->instructions_size, size);
+		for ( j = (i < first) ? (first - i) : 0; j < size; j++ ) {
+
+			if ((answer[i + j - first] = TRUTH (result[j])) != 0) {
+
+				count++;
+
+			}
+
+		}
+
+	}
+	return (count);
+
+}
@@ -0,0 +1,96 @@
+/*
+ * expression.h
+ * Compiled filter expressions over stock histories.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_EXPRESSION_SEEN
+#define FILE_PFISH_BOVESPA_EXPRESSION_SEEN
+
+#include <stddef.h>
+
+#include <pilot_fish/bovespa.h>
+
+
+/*
+ * A filter expression, compiled into an evaluation plan.
+ *
+ * Grammar (lowest to highest precedence):
+ *   expression := conjunction { 'or' conjunction }
+ *   conjunction := negation { 'and' negation }
+ *   negation := 'not' negation | comparison
+ *   comparison := sum [ ( '<' | '<=' | '>' | '>=' | '==' | '!=' ) sum ]
+ *   sum := product { ( '+' | '-' ) product }
+ *   product := unary { ( '*' | '/' ) unary }
+ *   unary := '-' unary | primary
+ *   primary := number | field | function '(' expression [ ',' integer ] ')' | '(' expression ')'
+ *
+ * Fields: open, close, minimum, maximum, average (unit prices, in units of 1/100 of the stock currency),
+ * total_trades, total_stocks, total_volume (in units of 1/100 of the stock currency).
+ *
+ * Functions over the last integer daily quotes: sma, ema (seeded with the first simple average),
+ * highest, lowest; lag is the value integer daily quotes ago; abs takes no integer.
+ * Window functions are undefined until their window is full, and comparisons with undefined values are false.
+ * A daily quote satisfies the expression if it evaluates to neither zero nor undefined.
+ */
+
+typedef struct pfish_bovespa_expression pfish_bovespa_expression_t;
+
+
+/*
+ * Evaluation resources of a compiled expression, to be used by one thread at a time.
+ */
+
+typedef struct pfish_bovespa_expression_machine pfish_bovespa_expression_machine_t;
+
+
+/*
+ * Compile a filter expression.
+ * Syntax errors are logged.
+ *
+ * @param[in] text filter expression.
+ * @param[out] answer compiled expression. Caller must free() it after use.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_expression_compile (const char *text, pfish_bovespa_expression_t **answer);
+
+
+/*
+ * Allocate evaluation resources of a compiled expression.
+ *
+ * @param[in] expression compiled expression; must outlive the machine.
+ * @param[out] answer evaluation resources. Caller must pfish_bovespa_expression_machine_free() it after use.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_expression_machine_alloc (const pfish_bovespa_expression_t *expression, pfish_bovespa_expression_machine_t **answer);
+
+
+/*
+ * Release evaluation resources of a compiled expression.
+ *
+ * @param[in] target evaluation resources.
+ */
+
+void pfish_bovespa_expression_machine_free (pfish_bovespa_expression_machine_t *target);
+
+
+/*
+ * Screen a range of daily quotes of a stock history.
+ * Earlier daily quotes are evaluated only as far as window functions need them.
+ *
+ * @param[in] machine evaluation resources.
+ * @param[in] history stock history.
+ * @param[in] first index of history->daily_quotes[] of the first daily quote to be screened.
+ * @param[in] last index of history->daily_quotes[] after the last daily quote to be screened.
+ * @param[out] answer (last - first) elements; nonzero for each daily quote that satisfies the expression.
+ *
+ * @return how many daily quotes satisfy the expression.
+ */
+
+size_t pfish_bovespa_expression_screen (pfish_bovespa_expression_machine_t *machine, const pfish_bovespa_stock_history_t *history, size_t first, size_t last, unsigned char *answer);
+
+
+#endif	// FILE_PFISH_BOVESPA_EXPRESSION_SEEN
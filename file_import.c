@@ -7,19 +7,37 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <syslog.h>
 #include <argp.h>
 #include <unistd.h>
 #include <limits.h>
+#include <time.h>
 #include <regex.h>
 #include <assert.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
 
 #include <pilot_fish/syslog.h>
 #include <pilot_fish/syslog_macros.h>
 
 #include <pilot_fish/bovespa.h>
 
+#include "stock_file.h"
+#include "name_index.h"
+#include "ticker_dictionary.h"
+#include "import_kernel.h"
+#include "view_kernel.h"
+#include "snapshot.h"
+#include "metrics.h"
+#include "tracepoints.h"
+#include "async_log.h"
+
 
 /*
  * Command line argument parsing.
@@ -28,304 +46,160 @@
 const char *argp_program_version = PACKAGE_VERSION;
 const char *argp_program_bug_address = PACKAGE_BUGREPORT;
 
-static char doc[] = "pfish_bovespa_file_import -- import a Bovespa file into the pilot_fish bovespa database.\vThe bovespa file is read from standard input.\nHistory stock data previously existent in the database is overwritten on data timestamp collision.\n";
-
-static struct argp argp = { 0, 0, 0, doc };
-
-
-/*
- * Constraints from layout specs of Bovespa files.
- */
-
-/* Maximum number of useful characters of a line (350) + extra buffer. */
-
-#define BOVESPA_REGISTER_LENGTH 0x200
-
-/* Types of Bovespa files. */
-
-#define BOVESPA_FILE_TYPE_HIST 0
-#define BOVESPA_FILE_TYPE_BDIN 1
-
-/* Sections of Bovespa files. */
-
-#define BOVESPA_FILE_SECTION_HEADER 0
-#define BOVESPA_FILE_SECTION_QUOTES 1
-#define BOVESPA_FILE_SECTION_TRAILER 2
-#define BOVESPA_FILE_SECTION_OTHER 3
-
-
-/*
- * Positional mapping of register fields inside Bovespa files.
- *
- * HIST_* are subsets of the spec 'SeriesHistoricas_Layout.pdf'.
- * BDIN_* are subsets of the spec 'BDIN_Bovespa_v11.pdf'.
- *
- * N, X, V99 are subsets of field types of the specs above.
- * Although they mean the same here (that is, text), it was helpful 
- * differentiating among them for copying purposes.
- */
-
-#define N(FIELD_NAME,FROM,TO) BOVESPA_FIELD (FIELD_NAME, FROM, TO)
-#define X(FIELD_NAME,FROM,TO) BOVESPA_FIELD (FIELD_NAME, FROM, TO)
-#define V99(FIELD_NAME,FROM,TO) BOVESPA_FIELD (FIELD_NAME, FROM, TO)
-
-#define HIST_HEADER_REGISTER \
-	X (nome_arquivo, 3, 15); \
-	X (codigo_origem, 16, 23); \
-	N (data_geracao, 24, 31)
-
-#define BDIN_HEADER_REGISTER \
-	X (nome_arquivo, 3, 10); \
-	X (codigo_origem, 11, 18); \
-	N (codigo_destino, 19, 22); \
-	N (data_geracao, 23, 30); \
-	N (ano_pregao, 31, 34); \
-	N (mes_pregao, 35, 36); \
-	N (dia_pregao, 37, 38); \
-	N (hora_geracao, 39, 42)
-
-#define HIST_QUOTE_REGISTER \
-	N (ano_pregao, 3, 6); \
-	N (mes_pregao, 7, 8); \
-	N (dia_pregao, 9, 10); \
-	X (cod_bdi, 11, 12); \
-	X (cod_neg, 13, 24); \
-	N (tp_merc, 25, 27); \
-	X (nom_res, 28, 39); \
-	X (especi, 40, 49); \
-	X (mod_ref, 53, 56); \
-	V99 (pre_abe, 57, 69); \
-	V99 (pre_max, 70, 82); \
-	V99 (pre_min, 83, 95); \
-	V99 (pre_med, 96, 108); \
-	V99 (pre_ult, 109, 121); \
-	N (tot_neg, 148, 152); \
-	N (qua_tot, 153, 170); \
-	V99 (vol_tot, 171, 188); \
-	N (fat_cot, 211, 217); \
-	X (cod_isi, 231, 242)
-
-#define BDIN_QUOTE_REGISTER \
-	X (cod_bdi, 3, 4); \
-	X (cod_neg, 58, 69); \
-	N (tp_merc, 70, 72); \
-	X (nom_res, 35, 46); \
-	X (especi, 47, 56); \
-	V99 (pre_abe, 91, 101); \
-	V99 (pre_max, 102, 112); \
-	V99 (pre_min, 113, 123); \
-	V99 (pre_med, 124, 134); \
-	V99 (pre_ult, 135, 145); \
-	N (tot_neg, 174, 178); \
-	N (qua_tot, 179, 193); \
-	V99 (vol_tot, 194, 210); \
-	N (fat_cot, 246, 252); \
-	X (cod_isi, 266, 277)
-
-#define HIST_TRAILER_REGISTER \
-	X (nome_arquivo, 3, 15); \
-	X (codigo_origem, 16, 23); \
-	N (data_geracao, 24, 31); \
-	N (total_registros, 32, 42)
-
-#define BDIN_TRAILER_REGISTER \
-	X (nome_arquivo, 3, 10); \
-	X (codigo_origem, 11, 18); \
-	N (codigo_destino, 19, 22); \
-	N (data_geracao, 23, 30); \
-	N (total_registros, 31, 39)
-
-
-/*
- * Information containers of important registers (lines) of Bovespa files.
- */
-
-#define BOVESPA_FIELD(FIELD_NAME,FROM,TO) char FIELD_NAME[TO - FROM + 2]
-
-struct hist_header_register {
-
-	HIST_HEADER_REGISTER;
-
-};
-
-struct hist_quote_register {
-
-	HIST_QUOTE_REGISTER;
-
-};
-
-struct hist_trailer_register {
-
-	HIST_TRAILER_REGISTER;
-
-};
-
-struct bdin_header_register {
-
-	BDIN_HEADER_REGISTER;
-
-};
+static char doc[] = "pfish_bovespa_file_import -- import a Bovespa file into the pilot_fish bovespa database.\vThe bovespa file is read from standard input.\nHistory stock data previously existent in the database is overwritten on data timestamp collision.\n\nLog messages are queued and written by a background thread, so that diagnostics barely slow the import. The log level is taken from the environment variable PFISH_BOVESPA_LOG_LEVEL (a syslog priority name or number; default: info).\n";
 
-struct bdin_quote_register {
+static struct argp_option options[] = {
 
-	BDIN_QUOTE_REGISTER;
+	{"verbose", 'v', 0,  0, "log debugging diagnostics (as PFISH_BOVESPA_LOG_LEVEL=debug).", 0 },
+	{ 0 }
 
 };
 
-struct bdin_trailer_register {
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
 
-	BDIN_TRAILER_REGISTER;
+	switch (key) {
 
-};
-
-union bovespa_header_register {
+		case 'v':
 
-	struct hist_header_register hist;
-	struct bdin_header_register bdin;
-
-};
+			pfish_bovespa_log_level = LOG_DEBUG;
+			break;
 
-union bovespa_quote_register {
+		case ARGP_KEY_ARG:
 
-	struct hist_quote_register hist;
-	struct bdin_quote_register bdin;
+			argp_usage (state);
+			break;
 
-};
+		default:
 
-union bovespa_trailer_register {
+			return (ARGP_ERR_UNKNOWN);
 
-	struct hist_trailer_register hist;
-	struct bdin_trailer_register bdin;
+	};
+	return (0);
 
 };
 
-#undef BOVESPA_FIELD
+static struct argp argp = { options, parse_opt, 0, doc };
 
 
 /*
- * Discover the type of a Bovespa file.
+ * Build the list of inplits and splits of a stock.
+ * An inplit or split is detected at a daily quote whose spec matches 'xplit_regex' while the spec of the previous one does not.
+ * Events of the previous list before 'first_changed' are kept as they are; only the remaining daily quotes are scanned.
  *
- * @param[in] header_register first line of a Bovespa file.
- * @param[out] answer one of BOVESPA_FILE_TYPE_* values.
+ * @param[in] stock_id stock identification, for logging.
+ * @param[in] daily_quotes array of pointers to daily quotes, ordered by trading date.
+ * @param[in] daily_quotes_size how many elements in 'daily_quotes'.
+ * @param[in] previous inplit / split list currently in the database, NULL if none.
+ * @param[in] first_changed index of 'daily_quotes' of the first daily quote not in the database.
+ * @param[in] xplit_regex compiled regular expression for help finding inplits or splits.
+ * @param[out] answer dynamically allocated inplit / split list.
  *
  * @return 0 on success, negative on failure.
  */
 
-int discover_file_type (const char *header_register, unsigned int *answer);
+int xplit_list_build (const char *stock_id, pfish_bovespa_daily_quote_t **daily_quotes, size_t daily_quotes_size, const pfish_bovespa_xplit_list_t *previous, size_t first_changed, const regex_t *xplit_regex, pfish_bovespa_xplit_list_t **answer);
 
 
 /*
- * Discover the type of a Bovespa register.
+ * Build the list of ISIN segments of a stock.
+ * Segments of the previous list before 'first_changed' are kept, the one across 'first_changed' is cut there,
+ * and only the remaining daily quotes are scanned.
+ * The ISIN code of a daily quote is taken from its quote node if it comes from the Bovespa file,
+ * or from the previous list if it comes from the database.
  *
- * @param[in] file_type one of BOVESPA_FILE_TYPE_* values.
- * @param[in] bovespa_register a line of a Bovespa file.
- * @param[out] answer one of BOVESPA_FILE_SECTION_* values.
+ * @param[in] stock_id stock identification.
+ * @param[in] daily_quotes array of pointers to daily quotes, ordered by trading date.
+ * @param[in] daily_quotes_size how many elements in 'daily_quotes'.
+ * @param[in] database_history stock history currently in the database, NULL if none.
+ * @param[in] previous ISIN segment list currently in the database, NULL if none.
+ * @param[in] first_changed index of 'daily_quotes' of the first daily quote not in the database.
+ * @param[out] answer dynamically allocated ISIN segment list; release it with free().
  *
  * @return 0 on success, negative on failure.
  */
 
-int discover_register_type (unsigned int file_type, const char *bovespa_register, unsigned int *answer);
+int isin_segment_list_build (const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_daily_quote_t **daily_quotes, size_t daily_quotes_size, const pfish_bovespa_stock_history_t *database_history, const pfish_bovespa_isin_segment_list_t *previous, size_t first_changed, pfish_bovespa_isin_segment_list_t **answer);
 
 
 /*
- * Sanitize a field of a Bovespa register.
+ * Compare two ISIN segments by ISIN code, first trading date and stock.
+ * Arguments type hint: (const void *) == (pfish_bovespa_isin_segment_t *)
+ *
+ * @param a first ISIN segment.
+ * @param b second ISIN segment.
  *
- * @param[in,out] field field to be sanitized, will contain the result of sanitization..
- * @param[in] field_size size of the field.
+ * @return negative if a < b, positive if a > b, zero if a == b.
  */
 
-void sanitize_field (char *field, size_t field_size);
+int compare_isin_segments (const void *a, const void *b);
 
 
 /*
- * Mapper structure for fields of a Bovespa register.
+ * Replace the ISIN index.
+ * Segments of stocks not processed are taken from the current index.
+ *
+ * @param[in] segments ISIN segments of the processed stocks.
+ * @param[in] segments_size how many elements in 'segments'.
+ * @param[in] stock_ids processed stocks, ordered by id.
+ * @param[in] stock_ids_size how many elements in 'stock_ids'.
+ *
+ * @return 0 on success, negative on failure.
  */
 
-struct bovespa_mapper {
-
-	char *ano_pregao;
-	char *mes_pregao;
-	char *dia_pregao;
-	char *cod_bdi;
-	char *cod_neg;
-	char *tp_merc;
-	char *nom_res;
-	char *especi;
-	char *mod_ref;
-	char *pre_abe;
-	char *pre_max;
-	char *pre_min;
-	char *pre_med;
-	char *pre_ult;
-	char *tot_neg;
-	char *qua_tot;
-	char *vol_tot;
-	char *fat_cot;
-	char *cod_isi;
-
-};
-
-typedef struct bovespa_mapper bovespa_mapper_t;
+int isin_index_update (const pfish_bovespa_isin_segment_t *segments, size_t segments_size, const pfish_bovespa_stock_id_t *stock_ids, size_t stock_ids_size);
 
 
 /*
- * Wrapping structure to make possible for a daily quote of a specific stock to be part of a linked list.
+ * Replace the name index.
+ * Names of stocks not processed are taken from the current index;
+ * names of processed stocks replace the current ones unless these are more recent.
+ *
+ * @param[in] names names of the processed stocks, ordered by stock id.
+ * @param[in] names_size how many elements in 'names'.
+ *
+ * @return 0 on success, negative on failure.
  */
 
-typedef struct quote_node quote_node_t;
-
-struct quote_node {
-
-	pfish_bovespa_stock_id_t stock;
-	pfish_bovespa_daily_quote_t quote;
-	quote_node_t *next;
-
-};
+int name_index_update (const pfish_bovespa_name_t *names, size_t names_size);
 
 
 /*
- * Decide if a Bovespa mapping is useful. If so, transform it to a quote node, and then add it to the quotes linked list.
+ * Advisory locks among concurrent imports; readers never take them.
+ * Each lock is a file of LOCK_FILE_DIR:
  *
- * @param[in] mapper mapper structure of Bovespa textual fields containing quote information.
- * @param[in,out] last last node of the quotes linked list, will contain the new last node on successfull append.
+ * 	- one per stock (named by its id), held exclusively while the stock is read, merged and replaced;
+ * 	- INDEX_LOCK_NAME, held exclusively while indexes, the ticker dictionary and generations are replaced;
+ * 	- PUBLISH_LOCK_NAME, held shared while the files of a stock are renamed into place,
+ * 	  and exclusively while a generation is published, so that generations never catch a stock halfway.
  *
- * @return 0 on successful append, other positive on ignored node, negative on failure.
+ * Stocks are processed in stock id order, one at a time, and PUBLISH_LOCK_NAME is always the
+ * innermost lock, so imports never deadlock; they only wait for each other on shared stocks.
  */
 
-int quotes_list_append (const bovespa_mapper_t *mapper, quote_node_t **last);
+#define INDEX_LOCK_NAME ".indexes"
+#define PUBLISH_LOCK_NAME ".generation"
 
 
 /*
- * Compare two quote nodes.
- * Arguments type hint: (const void *) == (quote_node_t **)
+ * Take an advisory lock, waiting for conflicting ones.
  *
- * @param a first quote node.
- * @param b second quote node.
+ * @param[in] name name of the lock file in LOCK_FILE_DIR.
+ * @param[in] operation LOCK_SH or LOCK_EX.
+ * @param[out] answer descriptor of the lock file; close it to release the lock.
  *
- * @return negative if a < b, positive if a > b, zero if a == b.
+ * @return 0 on success, negative on failure.
  */
 
-int compare_quote_nodes (const void *a, const void *b);
+int lock_take (const char *name, int operation, int *answer);
 
 
 /*
- * Merge two arrays of (pointers to) daily quotes.
- *
- * @param[in] a first array of pointers to daily quotes.
- * @param[in] a_size how many elements in 'a'.
- * @param[in] b second array of pointers to daily quotes.
- * @param[in] b_size how many elements in 'b'.
- * @param[out] answer merged array.
- * @param[out] answer_size how many elements in 'answer'.
- *
- * Input arrays are suposed to be sorted by trading date.
- * Output array is sorted by trading date.
- * If there are elements with same trading date on both input arrays, the elements of the second array will prevail.
- *
- * @return 0 on success, negative on failure.
+ * Tracepoints of the importer (see tracepoints.h).
  */
 
-int merge_daily_quotes (pfish_bovespa_daily_quote_t **a, size_t a_size, pfish_bovespa_daily_quote_t **b, size_t b_size, pfish_bovespa_daily_quote_t ***answer, size_t *answer_size);
+TRACE_SEMAPHORE (register__parse);
+TRACE_SEMAPHORE (xplit__detect);
+TRACE_SEMAPHORE (stock__commit);
 
 
 /*
@@ -360,8 +234,12 @@ int main (int argc, char **argv) {
 
 	quote_node_t **quotes_array;	// Array of pointers to quote nodes.
 	size_t quotes_index;	// Quotes array indexer in search loops.
-	char current_stock_id[PFISH_BOVESPA_CODNEG_SIZE];	// Helps to find new stocks in the quotes array search loop.
+	ticker_table_t *tickers;	// Tickers of the database and of the Bovespa file.
+	uint64_t generation;	// Database generation published by this import.
+	pfish_bovespa_ticker_t current_ticker;	// Helps to find new stocks in the quotes array search loop.
+	pfish_bovespa_stock_id_t current_stock;	// Stock identification of 'current_ticker'.
 	size_t stock_count;	// How many stocks were processed.
+	uint64_t commit_start;	// Start of the commit of the stock files, while traced.
 	size_t quote_history_size;	// Size of the history sequence of a stock in the quotes array.
 
 	pfish_bovespa_stock_history_t *database_stock_history;
@@ -370,13 +248,42 @@ int main (int argc, char **argv) {
 	pfish_bovespa_daily_quote_t **database_daily_quotes;	// Array of pointers to daily quotes from the database.
 	pfish_bovespa_daily_quote_t **merged_daily_quotes;	// Result of the merge of new_daily_quotes with database_daily_quotes.
 	size_t merged_daily_quotes_size;	// Size of the merged array of daily quotes.
+	size_t first_changed;	// Index of 'merged_daily_quotes' of the first daily quote not in the database.
 	size_t last_xplit;	// Index of 'merged_daily_quotes' of the most recent inplit or split of the stock.
 	regex_t xplit_regex;	// Compiled regular expression for help finding stock inplits or splits.
-	int xplit_match_previous;	// Reminder if xplit_regex matched at the previous loop pass.
+	pfish_bovespa_xplit_list_t *database_xplits;	// Inplits and splits of the stock from the database.
+	pfish_bovespa_xplit_list_t *xplits;	// Inplits and splits of the merged array of daily quotes.
+	pfish_bovespa_daily_quote_t **adjusted_daily_quotes;	// Adjusted view of the merged array of daily quotes.
+	size_t adjusted_first_changed;	// Index of 'adjusted_daily_quotes' of the first adjusted daily quote not in the database.
+	size_t view;	// Index of pfish_bovespa_stock_file_views[].
+	pfish_bovespa_stock_history_t *database_views[STOCK_FILE_VIEWS_SIZE];	// Derived views of the stock from the database (raw view unused).
+	pfish_bovespa_daily_quote_t **views[STOCK_FILE_VIEWS_SIZE];	// Derived views of the merged array of daily quotes (raw view unused).
+	size_t views_size[STOCK_FILE_VIEWS_SIZE];	// How many elements in each of 'views'.
+	size_t views_last_xplit[STOCK_FILE_VIEWS_SIZE];	// Index of each of 'views' of the most recent inplit or split.
 
-	FILE *stock_file;	// Stream to the stock file currently being built.
 	char stock_pathname[PATH_MAX];	// Pathname of the stock file currently being built.
 	char stock_backup_pathname[PATH_MAX];	// Pathname of the backup file of the stock currently being built.
+	char view_pathname[PATH_MAX];	// Pathname of a derived view file of the stock currently being built.
+	char stock_temp_pathname[PATH_MAX];	// Pathname of the temporary file of the stock currently being built.
+	char view_temp_pathname[PATH_MAX];	// Pathname of the temporary file of a derived view.
+	char xplit_temp_pathname[PATH_MAX];	// Pathname of the temporary inplit / split list file.
+	char isin_temp_pathname[PATH_MAX];	// Pathname of the temporary ISIN segment list file.
+	int stock_lock_des;	// Lock of the stock currently being built.
+	int publish_lock_des;	// Lock against publication of generations.
+	int index_lock_des;	// Lock of the indexes.
+	ticker_table_t *database_tickers;	// Tickers of the database at the end of the import.
+	char xplit_pathname[PATH_MAX];	// Pathname of the inplit / split list file of the stock currently being built.
+	char isin_pathname[PATH_MAX];	// Pathname of the ISIN segment list file of the stock currently being built.
+
+	pfish_bovespa_isin_segment_list_t *database_isins;	// ISIN segments of the stock from the database.
+	pfish_bovespa_isin_segment_list_t *isins;	// ISIN segments of the merged array of daily quotes.
+	pfish_bovespa_isin_segment_t *index_segments;	// ISIN segments of all processed stocks.
+	size_t index_segments_size;	// How many elements in 'index_segments'.
+	size_t index_segments_room;	// How many elements fit in 'index_segments'.
+	pfish_bovespa_stock_id_t *index_stocks;	// Processed stocks, ordered by id.
+	pfish_bovespa_name_t *index_names;	// Names of the processed stocks.
+	size_t index_stocks_room;	// How many elements fit in 'index_stocks' and 'index_names'.
+	void *aux_voidp;	// General purpose short ranged pointer.
 
 
 	/*
@@ -384,6 +291,7 @@ int main (int argc, char **argv) {
 	 */
 
 	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	pfish_bovespa_log_level_from_env ();
 	DEBUG ("start.");
 
 	/*
@@ -392,6 +300,31 @@ int main (int argc, char **argv) {
 
 	argp_parse (&argp, argc, argv, 0, 0, 0);
 
+	/*
+	 * From now on, log messages are written by a background thread.
+	 */
+
+	pfish_bovespa_log_start ();
+
+	if (((mkdir (LOCK_FILE_DIR, 0755)) < 0) && (errno != EEXIST)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot create directory '%s'.", LOCK_FILE_DIR);
+		FAILURE;
+
+	}
+
+	/*
+	 * Load the tickers of the database; new stocks get the next tickers.
+	 */
+
+	if ((pfish_bovespa_ticker_table_alloc (&tickers)) < 0) {
+
+		CRIT ("cannot load ticker dictionary.");
+		FAILURE;
+
+	}
+
 	/*
 	 * Initialize the quotes linked list.
 	 */
@@ -416,7 +349,7 @@ int main (int argc, char **argv) {
 			 * First register of the Bovespa file. 
 			 */
 
-			if ((discover_file_type (bovespa_register, &file_type)) != 0) {
+			if ((pfish_bovespa_discover_file_type (bovespa_register, &file_type)) != 0) {
 
 				CRIT ("cannot discover the type of the bovespa file.");
 				FAILURE;
@@ -428,70 +361,22 @@ int main (int argc, char **argv) {
 			 * Adapt the Bovespa field mapper structure according to the file type.
 			 */
 
-			switch (file_type) {
-
-				case BOVESPA_FILE_TYPE_HIST:
-
-					mapper.ano_pregao = quote_register.hist.ano_pregao;
-					mapper.mes_pregao = quote_register.hist.mes_pregao;
-					mapper.dia_pregao = quote_register.hist.dia_pregao;
-					mapper.cod_bdi = quote_register.hist.cod_bdi;
-					mapper.cod_neg = quote_register.hist.cod_neg;
-					mapper.tp_merc = quote_register.hist.tp_merc;
-					mapper.nom_res = quote_register.hist.nom_res;
-					mapper.especi = quote_register.hist.especi;
-					mapper.mod_ref = quote_register.hist.mod_ref;
-					mapper.pre_abe = quote_register.hist.pre_abe;
-					mapper.pre_max = quote_register.hist.pre_max;
-					mapper.pre_min = quote_register.hist.pre_min;
-					mapper.pre_med = quote_register.hist.pre_med;
-					mapper.pre_ult = quote_register.hist.pre_ult;
-					mapper.tot_neg = quote_register.hist.tot_neg;
-					mapper.qua_tot = quote_register.hist.qua_tot;
-					mapper.vol_tot = quote_register.hist.vol_tot;
-					mapper.fat_cot = quote_register.hist.fat_cot;
-					mapper.cod_isi = quote_register.hist.cod_isi;
-					break;
-
-				case BOVESPA_FILE_TYPE_BDIN:
-
-					mapper.ano_pregao = header_register.bdin.ano_pregao;
-					mapper.mes_pregao = header_register.bdin.mes_pregao;
-					mapper.dia_pregao = header_register.bdin.dia_pregao;
-					mapper.cod_bdi = quote_register.bdin.cod_bdi;
-					mapper.cod_neg = quote_register.bdin.cod_neg;
-					mapper.tp_merc = quote_register.bdin.tp_merc;
-					mapper.nom_res = quote_register.bdin.nom_res;
-					mapper.especi = quote_register.bdin.especi;
-					mapper.mod_ref = "R$";
-					mapper.pre_abe = quote_register.bdin.pre_abe;
-					mapper.pre_max = quote_register.bdin.pre_max;
-					mapper.pre_min = quote_register.bdin.pre_min;
-					mapper.pre_med = quote_register.bdin.pre_med;
-					mapper.pre_ult = quote_register.bdin.pre_ult;
-					mapper.tot_neg = quote_register.bdin.tot_neg;
-					mapper.qua_tot = quote_register.bdin.qua_tot;
-					mapper.vol_tot = quote_register.bdin.vol_tot;
-					mapper.fat_cot = quote_register.bdin.fat_cot;
-					mapper.cod_isi = quote_register.bdin.cod_isi;
-					break;
-
-				default:
+			if ((pfish_bovespa_mapper_bind (file_type, &header_register, &quote_register, &mapper)) < 0) {
 
-					CRIT ("unknown bovespa file type '%u'.", file_type);
-					FAILURE;
+				FAILURE;
 
 			}
 
 		}
 		register_count++;
-		if (discover_register_type (file_type, bovespa_register, &register_type) < 0) {
+		if (pfish_bovespa_discover_register_type (file_type, bovespa_register, &register_type) < 0) {
 
 			CRIT ("cannot discover the type of the bovespa register.");
 			FAILURE;
 
 		}
 		DEBUG ("bovespa register type = '%u'.", register_type);
+		TRACE2 (register__parse, register_count, register_type);
 
 		/* 
 		 * Adapt to the current section of the Bovespa file.
@@ -511,9 +396,8 @@ int main (int argc, char **argv) {
 #define BOVESPA_FIELD(FIELD_NAME,FROM,TO) \
 	memcpy (UNION_NAME.STRUCT_NAME.FIELD_NAME, &bovespa_register[FROM - 1], TO - FROM + 1); \
 	UNION_NAME.STRUCT_NAME.FIELD_NAME[TO - FROM + 1] = 0; \
-	DEBUG (#FIELD_NAME " = '%s'", UNION_NAME.STRUCT_NAME.FIELD_NAME); \
-	sanitize_field (UNION_NAME.STRUCT_NAME.FIELD_NAME, TO - FROM + 1); \
-	DEBUG ("sanitized " #FIELD_NAME " = '%s'", UNION_NAME.STRUCT_NAME.FIELD_NAME)
+	pfish_bovespa_sanitize_field (UNION_NAME.STRUCT_NAME.FIELD_NAME, TO - FROM + 1); \
+	DEBUG (#FIELD_NAME " = '%s'", UNION_NAME.STRUCT_NAME.FIELD_NAME)
 
 #define UNION_NAME header_register
 
@@ -627,7 +511,7 @@ int main (int argc, char **argv) {
 						 * Append quote register data to the quotes linked list.
 						 */
 
-						if ((rcode = quotes_list_append (&mapper, &quotes_list_last)) < 0) {
+						if ((rcode = pfish_bovespa_quotes_list_append (&mapper, tickers, &quotes_list_last)) < 0) {
 
 							CRIT ("cannot append Bovespa data to the quotes list.");
 							FAILURE;
@@ -807,7 +691,14 @@ int main (int argc, char **argv) {
 	 * Sort the array of quotes.
 	 */
 
-	qsort (quotes_array, quotes_list_count, sizeof (quote_node_t *), compare_quote_nodes);
+	if ((pfish_bovespa_ticker_table_ranks (tickers, &pfish_bovespa_quote_ticker_ranks)) < 0) {
+
+		CRIT ("cannot rank tickers.");
+		FAILURE;
+
+	}
+	qsort (quotes_array, quotes_list_count, sizeof (quote_node_t *), pfish_bovespa_compare_quote_nodes);
+	free (pfish_bovespa_quote_ticker_ranks);
 	DEBUG ("quotes sorted.");
 
 	/*
@@ -831,18 +722,30 @@ int main (int argc, char **argv) {
 	 */
 
 	DEBUG ("scanning quotes array.");
-	memset (current_stock_id, 0, PFISH_BOVESPA_CODNEG_SIZE);
+	current_ticker = PFISH_BOVESPA_TICKER_NONE;
 	stock_count = 0;
+	index_segments = NULL;
+	index_segments_size = index_segments_room = 0;
+	index_stocks = NULL;
+	index_names = NULL;
+	index_stocks_room = 0;
 	for ( quotes_index = 0; quotes_index < quotes_list_count; quotes_index++ ) {
 
-		if ((memcmp (quotes_array[quotes_index]->stock.id, current_stock_id, PFISH_BOVESPA_CODNEG_SIZE)) != 0) {
+		if (quotes_array[quotes_index]->ticker != current_ticker) {
 
 			/*
 			 * New stock found.
 			 */
 
-			DEBUG ("found stock '%s'.", quotes_array[quotes_index]->stock.id);
-			memcpy (current_stock_id, quotes_array[quotes_index]->stock.id, PFISH_BOVESPA_CODNEG_SIZE);
+			current_ticker = quotes_array[quotes_index]->ticker;
+			memcpy (&current_stock, pfish_bovespa_ticker_table_stock (tickers, current_ticker), sizeof (pfish_bovespa_stock_id_t));
+			DEBUG ("found stock '%s'.", current_stock.id);
+			if ((lock_take (current_stock.id, LOCK_EX, &stock_lock_des)) < 0) {
+
+				CRIT ("cannot lock stock '%s'.", current_stock.id);
+				FAILURE;
+
+			}
 			stock_count++;
 
 			/*
@@ -851,7 +754,7 @@ int main (int argc, char **argv) {
 
 			for ( i = quotes_index + 1; i < quotes_list_count; i++ ) {
 
-				if ((memcmp (quotes_array[i]->stock.id, current_stock_id, PFISH_BOVESPA_CODNEG_SIZE)) != 0) {
+				if (quotes_array[i]->ticker != current_ticker) {
 
 					break;
 
@@ -881,9 +784,9 @@ int main (int argc, char **argv) {
 			 * Retrieve from database an array of pointers to the current daily quotes of this stock.
 			 */
 
-			if ((pfish_bovespa_stock_history_alloc (&(quotes_array[quotes_index]->stock), &database_stock_history)) < 0) {
+			if ((pfish_bovespa_stock_history_alloc (&current_stock, &database_stock_history)) < 0) {
 
-				CRIT ("cannot retrieve history of stock '%s' from the database.", current_stock_id);
+				CRIT ("cannot retrieve history of stock '%s' from the database.", current_stock.id);
 				FAILURE;
 
 			}
@@ -914,7 +817,7 @@ int main (int argc, char **argv) {
 
 			if (database_daily_quotes != NULL) {
 
-				if ((merge_daily_quotes (database_daily_quotes, database_stock_history->daily_quotes_size, new_daily_quotes, quote_history_size, &merged_daily_quotes, &merged_daily_quotes_size)) < 0) {
+				if ((pfish_bovespa_merge_daily_quotes (database_daily_quotes, database_stock_history->daily_quotes_size, new_daily_quotes, quote_history_size, &merged_daily_quotes, &merged_daily_quotes_size)) < 0) {
 
 					CRIT ("cannot merge daily quotes.");
 					FAILURE;
@@ -936,129 +839,243 @@ int main (int argc, char **argv) {
 			}
 
 			/*
-			 * Detect most recent inplit or split of the stock.
+			 * Find out where the merged array starts to differ from the database.
+			 * Everything before that position was already taken into account by previous imports.
 			 */
 
-#define xplit_match_current rcode
+			first_changed = 0;
+			if (database_daily_quotes != NULL) {
 
-			// Search the merged array backwards until the first detection.
-			// Obs.: logic of flags 'xplit_match_*' is negative.
+				while ((first_changed < database_stock_history->daily_quotes_size) && (merged_daily_quotes[first_changed] == database_daily_quotes[first_changed])) {
 
-			xplit_match_previous = 1;
-			xplit_match_current = 1;
+					first_changed++;
 
-#define XPLIT_MATCH_PREVIOUS (xplit_match_previous == 0)
-#define XPLIT_MATCH_CURRENT (xplit_match_current == 0)
-#define XPLIT_DETECTED (XPLIT_MATCH_PREVIOUS && !XPLIT_MATCH_CURRENT)
+				}
 
-			i = merged_daily_quotes_size;
-			do {
+			}
 
-				i--;
-				xplit_match_previous = xplit_match_current;
-				DEBUG ("stock %s, spec '%s', array pos %u", current_stock_id, merged_daily_quotes[i]->stock_spec, i);
-				if ((xplit_match_current = regexec (&xplit_regex, merged_daily_quotes[i]->stock_spec, 0, NULL, 0)) != 0) {
+			/*
+			 * Detect inplits and splits of the stock.
+			 */
 
-					switch (xplit_match_current) {
+			if ((pfish_bovespa_xplit_file_pathname (&current_stock, xplit_pathname)) < 0) {
 
-						case REG_NOMATCH:
+				FAILURE;
 
-							break;
+			}
+			if ((pfish_bovespa_xplit_file_read (xplit_pathname, &database_xplits)) < 0) {
 
-						default:
+				CRIT ("cannot retrieve inplits / splits of stock '%s' from the database.", current_stock.id);
+				FAILURE;
 
-							CRIT ("cannot match xplit regexp with spec string of stock '%s'.", current_stock_id);
-							FAILURE;
+			}
+			if (database_xplits == NULL) {
 
-					}
+				first_changed = 0;
 
-				}
-				if (i == 0) {
+			}
+			if ((xplit_list_build (current_stock.id, merged_daily_quotes, merged_daily_quotes_size, database_xplits, first_changed, &xplit_regex, &xplits)) < 0) {
 
-					break;
+				CRIT ("cannot detect inplits / splits of stock '%s'.", current_stock.id);
+				FAILURE;
+
+			}
+			if (xplits->xplit_list_size > 0) {
+
+				last_xplit = xplits->xplit_list[xplits->xplit_list_size - 1].daily_quote_index;
+				if ((database_stock_history == NULL) || (database_stock_history->last_xplit != last_xplit)) {
+
+					INFO ("inplit / split detected in stock '%s' at array position %u.", current_stock.id, last_xplit);
 
 				}
 
-			} while (!XPLIT_DETECTED);
+			}
+			else {
 
-#define LAST_XPLIT_POS (i + 1)
+				last_xplit = 0;
 
-			if (XPLIT_DETECTED) {
+			}
+			TRACE3 (xplit__detect, current_stock.id, xplits->xplit_list_size, last_xplit);
 
-				if ((database_stock_history == NULL) || (database_stock_history->last_xplit != LAST_XPLIT_POS)) {
+			/*
+			 * Track the ISIN codes of the stock.
+			 */
 
-					INFO ("inplit / split detected in stock '%s' at array position %u.", current_stock_id, LAST_XPLIT_POS);
+			if ((pfish_bovespa_isin_file_pathname (&current_stock, isin_pathname)) < 0) {
 
-				}
-				last_xplit = LAST_XPLIT_POS;
+				FAILURE;
 
 			}
-			else {
+			if ((pfish_bovespa_isin_file_read (isin_pathname, &database_isins)) < 0) {
 
-				last_xplit = 0;
+				CRIT ("cannot retrieve ISIN segments of stock '%s' from the database.", current_stock.id);
+				FAILURE;
+
+			}
+			if ((isin_segment_list_build (&current_stock, merged_daily_quotes, merged_daily_quotes_size, database_stock_history, database_isins, (database_isins != NULL) ? first_changed : 0, &isins)) < 0) {
+
+				CRIT ("cannot find ISIN segments of stock '%s'.", current_stock.id);
+				FAILURE;
+
+			}
+			if (stock_count > index_stocks_room) {
+
+				index_stocks_room = 2 * stock_count;
+				if ((aux_voidp = realloc (index_stocks, index_stocks_room * sizeof (pfish_bovespa_stock_id_t))) == NULL) {
+
+					ALERT ("cannot allocate %u bytes of heap space.", index_stocks_room * sizeof (pfish_bovespa_stock_id_t));
+					FAILURE;
+
+				}
+				index_stocks = (pfish_bovespa_stock_id_t *) aux_voidp;
+				if ((aux_voidp = realloc (index_names, index_stocks_room * sizeof (pfish_bovespa_name_t))) == NULL) {
+
+					ALERT ("cannot allocate %u bytes of heap space.", index_stocks_room * sizeof (pfish_bovespa_name_t));
+					FAILURE;
+
+				}
+				index_names = (pfish_bovespa_name_t *) aux_voidp;
 
 			}
+			memcpy (&(index_stocks[stock_count - 1]), &current_stock, sizeof (pfish_bovespa_stock_id_t));
+
+			// The name of the stock is the one of its most recent trading day in the Bovespa file.
+
+			memset (&(index_names[stock_count - 1]), 0, sizeof (pfish_bovespa_name_t));
+			memcpy (&(index_names[stock_count - 1].stock_id), &current_stock, sizeof (pfish_bovespa_stock_id_t));
+			memcpy (index_names[stock_count - 1].name, quotes_array[quotes_index + quote_history_size - 1]->name, PFISH_BOVESPA_NOMRES_SIZE);
+			index_names[stock_count - 1].trading_date = quotes_array[quotes_index + quote_history_size - 1]->quote.trading_date;
+
+			/*
+			 * Build derived views: prices adjusted by inplits and splits, and weekly and monthly rollups.
+			 * The raw view comes first in pfish_bovespa_stock_file_views[], and the adjusted view comes before its rollups.
+			 */
+
+			adjusted_daily_quotes = NULL;
+			adjusted_first_changed = 0;
+			for ( view = 1; view < STOCK_FILE_VIEWS_SIZE; view++ ) {
+
+#define VIEW pfish_bovespa_stock_file_views[view]
+#define PERIOD (VIEW & ~PFISH_BOVESPA_VIEW_ADJUSTED)
+
+				if ((pfish_bovespa_stock_history_alloc_view (&current_stock, VIEW, &(database_views[view]))) < 0) {
+
+					CRIT ("cannot retrieve view '%u' of stock '%s' from the database.", VIEW, current_stock.id);
+					FAILURE;
+
+				}
+				if (VIEW == PFISH_BOVESPA_VIEW_ADJUSTED) {
+
+					if ((pfish_bovespa_adjust_daily_quotes (merged_daily_quotes, merged_daily_quotes_size, xplits, database_views[view], database_xplits, first_changed, &(views[view]))) < 0) {
 
-#undef LAST_XPLIT_POS
-#undef XPLIT_MATCH_CURRENT
-#undef XPLIT_MATCH_PREVIOUS
-#undef XPLIT_DETECTED
+						CRIT ("cannot adjust daily quotes of stock '%s'.", current_stock.id);
+						FAILURE;
+
+					}
+					views_size[view] = merged_daily_quotes_size;
+					views_last_xplit[view] = last_xplit;
+					adjusted_daily_quotes = views[view];
+					if (database_views[view] != NULL) {
+
+						while ((adjusted_first_changed < database_views[view]->daily_quotes_size) && (adjusted_first_changed < merged_daily_quotes_size) && (adjusted_daily_quotes[adjusted_first_changed] == &(database_views[view]->daily_quotes[adjusted_first_changed]))) {
+
+							adjusted_first_changed++;
+
+						}
+
+					}
+
+				}
+				else if ((VIEW & PFISH_BOVESPA_VIEW_ADJUSTED) != 0) {
+
+					assert (adjusted_daily_quotes != NULL);
+					if ((pfish_bovespa_rollup_daily_quotes (adjusted_daily_quotes, merged_daily_quotes_size, last_xplit, PERIOD, database_views[view], adjusted_first_changed, &(views[view]), &(views_size[view]), &(views_last_xplit[view]))) < 0) {
+
+						CRIT ("cannot roll up adjusted daily quotes of stock '%s'.", current_stock.id);
+						FAILURE;
+
+					}
 
-#undef xplit_match_current
+				}
+				else {
+
+					if ((pfish_bovespa_rollup_daily_quotes (merged_daily_quotes, merged_daily_quotes_size, last_xplit, PERIOD, database_views[view], first_changed, &(views[view]), &(views_size[view]), &(views_last_xplit[view]))) < 0) {
+
+						CRIT ("cannot roll up daily quotes of stock '%s'.", current_stock.id);
+						FAILURE;
+
+					}
+
+				}
+
+#undef PERIOD
+#undef VIEW
+
+			}
 
 			/*
 			 * At this point:
 			 *
-			 * 	- the stock being processed is identified by 'current_stock_id'.
+			 * 	- the stock being processed is identified by 'current_stock'.
 			 * 	- the updated history of daily quotes of this stock is defined by 'merged_daily_quotes' and 'merged_daily_quotes_size'.
 			 * 	- the last inplit or split of the stock is pointed by the index 'last_xplit'.
+			 * 	- all inplits and splits of the stock are in 'xplits'.
+			 * 	- all ISIN segments of the stock are in 'isins'.
+			 * 	- derived views of the history are defined by 'views', 'views_size' and 'views_last_xplit'.
 			 *
-			 * No more information needed; let's build the stock history file.
+			 * No more information needed; let's build the stock history files.
+			 */
+
+			commit_start = (TRACE_ENABLED (stock__commit)) ? pfish_bovespa_metrics_clock () : 0;
+
+			/*
+			 * Temporary files are named after the stock, which is locked, so that concurrent imports never share them.
 			 */
 
-#define STOCK_TEMP_PATHNAME DBPATH "/.stock.tmp"
+#define TEMP_NAME_FORMAT "%s/.%s.tmp"
 
-			if ((stock_file = fopen (STOCK_TEMP_PATHNAME, "w")) == NULL) {
+			if (((snprintf (stock_temp_pathname, PATH_MAX, TEMP_NAME_FORMAT, DBPATH, current_stock.id)) >= PATH_MAX) || ((snprintf (xplit_temp_pathname, PATH_MAX, TEMP_NAME_FORMAT, XPLIT_FILE_DIR, current_stock.id)) >= PATH_MAX) || ((snprintf (isin_temp_pathname, PATH_MAX, TEMP_NAME_FORMAT, ISIN_FILE_DIR, current_stock.id)) >= PATH_MAX)) {
 
-				ERRNO_ERR;
-				CRIT ("cannot open file '%s' in write mode.", STOCK_TEMP_PATHNAME);
+				CRIT ("cannot build pathnames of temporary files of stock '%s'.", current_stock.id);
 				FAILURE;
 
 			}
-			
+
 			/*
-			 * The stock file is a dump of a 'pfish_bovespa_stock_history_t' instance.
+			 * The stock file is a dump of a 'pfish_bovespa_stock_history_t' instance, followed by checksums.
 			 */
 
-			if ((fwrite (&merged_daily_quotes_size, sizeof (size_t), 1, stock_file)) != 1) {
+			if ((pfish_bovespa_stock_file_write (stock_temp_pathname, merged_daily_quotes_size, last_xplit, merged_daily_quotes)) < 0) {
 
-				ERRNO_ERR;
-				CRIT ("cannot write field '%s' to temporary stock file.", "daily_quotes_size");
+				CRIT ("cannot write temporary stock file '%s'.", stock_temp_pathname);
 				FAILURE;
 
 			}
-			if ((fwrite (&last_xplit, sizeof (size_t), 1, stock_file)) != 1) {
+			for ( view = 1; view < STOCK_FILE_VIEWS_SIZE; view++ ) {
 
-				ERRNO_ERR;
-				CRIT ("cannot write field '%s' to temporary stock file.", "last_xplit");
-				FAILURE;
+				if ((snprintf (view_temp_pathname, PATH_MAX, TEMP_NAME_FORMAT, pfish_bovespa_stock_file_directory (pfish_bovespa_stock_file_views[view]), current_stock.id)) >= PATH_MAX) {
 
-			}
-			for ( i = 0; i < merged_daily_quotes_size; i++ ) {
+					CRIT ("cannot build pathname of temporary stock file.");
+					FAILURE;
 
-				if ((fwrite (merged_daily_quotes[i], sizeof (pfish_bovespa_daily_quote_t), 1, stock_file)) != 1) {
+				}
+				if ((pfish_bovespa_stock_file_write (view_temp_pathname, views_size[view], views_last_xplit[view], views[view])) < 0) {
 
-					ERRNO_ERR;
-					CRIT ("cannot write field '%s[%u]' to temporary stock file.", "daily_quotes", i);
+					CRIT ("cannot write temporary stock file '%s'.", view_temp_pathname);
 					FAILURE;
 
 				}
 
 			}
-			if ((fclose (stock_file)) != 0) {
+			if ((pfish_bovespa_xplit_file_write (xplit_temp_pathname, xplits)) < 0) {
 
-				ERRNO_ERR;
-				CRIT ("cannot close temporary stock file '%s'.", STOCK_TEMP_PATHNAME);
+				CRIT ("cannot write temporary inplit / split list file '%s'.", xplit_temp_pathname);
+				FAILURE;
+
+			}
+			if ((pfish_bovespa_isin_file_write (isin_temp_pathname, isins)) < 0) {
+
+				CRIT ("cannot write temporary ISIN segment list file '%s'.", isin_temp_pathname);
 				FAILURE;
 
 			}
@@ -1068,7 +1085,7 @@ int main (int argc, char **argv) {
 			 * Make the file official.
 			 */
 
-			// Detach database_stock_history from its database file.
+			// Detach database_stock_history and database views from their database files.
 			// Release other uneeded resources.
 
 			if (database_daily_quotes != NULL) {
@@ -1080,25 +1097,57 @@ int main (int argc, char **argv) {
 
 				if ((pfish_bovespa_stock_history_free (database_stock_history)) < 0) {
 
-					CRIT ("cannot release history of stock '%s'.", current_stock_id);
+					CRIT ("cannot release history of stock '%s'.", current_stock.id);
 					FAILURE;
 
 				}
 
 			};
+			for ( view = 1; view < STOCK_FILE_VIEWS_SIZE; view++ ) {
+
+				if (database_views[view] != NULL) {
+
+					if ((pfish_bovespa_stock_history_free (database_views[view])) < 0) {
+
+						CRIT ("cannot release view '%u' of stock '%s'.", pfish_bovespa_stock_file_views[view], current_stock.id);
+						FAILURE;
+
+					}
+
+				}
+				free (views[view]);
+
+			}
+			if (database_xplits != NULL) {
+
+				free (database_xplits);
+
+			}
+			if (database_isins != NULL) {
+
+				free (database_isins);
+
+			}
 			free (new_daily_quotes);
 
 			// Here I play with a backup file to maintain data existence at all times.
+			// No generation is published until all files of the stock are in place.
+
+			if ((lock_take (PUBLISH_LOCK_NAME, LOCK_SH, &publish_lock_des)) < 0) {
+
+				CRIT ("cannot lock generation publishing.");
+				FAILURE;
 
-			if ((snprintf (stock_pathname, PATH_MAX, "%s/%s", DBPATH, current_stock_id)) >= PATH_MAX) {
+			}
+			if ((snprintf (stock_pathname, PATH_MAX, "%s/%s", DBPATH, current_stock.id)) >= PATH_MAX) {
 
-				CRIT ("cannot build pathname of database file for stock '%s'.", current_stock_id);
+				CRIT ("cannot build pathname of database file for stock '%s'.", current_stock.id);
 				FAILURE;
 
 			}
-			if ((snprintf (stock_backup_pathname, PATH_MAX, "%s/.%s", DBPATH, current_stock_id)) >= PATH_MAX) {
+			if ((snprintf (stock_backup_pathname, PATH_MAX, "%s/.%s", DBPATH, current_stock.id)) >= PATH_MAX) {
 
-				CRIT ("cannot build pathname of database backup file for stock '%s'.", current_stock_id);
+				CRIT ("cannot build pathname of database backup file for stock '%s'.", current_stock.id);
 				FAILURE;
 
 			}
@@ -1136,10 +1185,10 @@ int main (int argc, char **argv) {
 				}
 
 			}
-			if ((rename (STOCK_TEMP_PATHNAME, stock_pathname)) == -1) {
+			if ((rename (stock_temp_pathname, stock_pathname)) == -1) {
 
 				ERRNO_ERR;
-				CRIT ("cannot move temporary stock file '%s' to official file for stock '%s'.", STOCK_TEMP_PATHNAME, current_stock_id);
+				CRIT ("cannot move temporary stock file '%s' to official file for stock '%s'.", stock_temp_pathname, current_stock.id);
 				FAILURE;
 
 			}
@@ -1161,174 +1210,209 @@ int main (int argc, char **argv) {
 
 			}
 
-#undef STOCK_TEMP_PATHNAME
+			// Views derived from the stock file are replaced atomically.
 
-			/*
-			 * Stock resource releasing.
-			 */
+			for ( view = 1; view < STOCK_FILE_VIEWS_SIZE; view++ ) {
 
-			free (merged_daily_quotes);
+				if ((pfish_bovespa_stock_file_pathname (&current_stock, pfish_bovespa_stock_file_views[view], view_pathname)) < 0) {
 
-		}
+					FAILURE;
 
-	}
+				}
+				if ((snprintf (view_temp_pathname, PATH_MAX, TEMP_NAME_FORMAT, pfish_bovespa_stock_file_directory (pfish_bovespa_stock_file_views[view]), current_stock.id)) >= PATH_MAX) {
 
-	/*
-	 * Global resource releasing.
-	 */
+					CRIT ("cannot build pathname of temporary stock file.");
+					FAILURE;
 
-	regfree (&xplit_regex);
+				}
+				if ((rename (view_temp_pathname, view_pathname)) == -1) {
 
-	/*
-	 * End.
-	 */
+					ERRNO_ERR;
+					CRIT ("cannot move temporary stock file '%s' to official file '%s'.", view_temp_pathname, view_pathname);
+					FAILURE;
 
-	INFO ("%u stocks processed.", stock_count);
-	SUCCESS;
+				}
 
-}
+			}
+			if ((rename (xplit_temp_pathname, xplit_pathname)) == -1) {
 
-#undef FAILURE
-#undef SUCCESS
+				ERRNO_ERR;
+				CRIT ("cannot move temporary inplit / split list file '%s' to official file for stock '%s'.", xplit_temp_pathname, current_stock.id);
+				FAILURE;
 
+			}
+			if ((rename (isin_temp_pathname, isin_pathname)) == -1) {
 
-#define SUCCESS return (0)
-#define FAILURE return (-1)
+				ERRNO_ERR;
+				CRIT ("cannot move temporary ISIN segment list file '%s' to official file for stock '%s'.", isin_temp_pathname, current_stock.id);
+				FAILURE;
 
+			}
+			close (publish_lock_des);
+			if (TRACE_ENABLED (stock__commit)) {
 
-int discover_file_type (const char *header_register, unsigned int *answer) {
+				TRACE3 (stock__commit, current_stock.id, merged_daily_quotes_size, pfish_bovespa_metrics_clock () - commit_start);
 
-	if ((memcmp (header_register, "00COTAHIST", 10)) == 0) {
+			}
 
-		*answer = BOVESPA_FILE_TYPE_HIST;
-		SUCCESS;
+#undef TEMP_NAME_FORMAT
 
-	}
-	else if ((memcmp (header_register, "00BDIN9999", 10)) == 0) {
+			/*
+			 * Stock resource releasing.
+			 */
 
-		*answer = BOVESPA_FILE_TYPE_BDIN;
-		SUCCESS;
+			close (stock_lock_des);
+			free (merged_daily_quotes);
+			free (xplits);
+			free (isins);
 
-	}
-	else {
+		}
 
-		CRIT ("unknown bovespa file type.");
-		FAILURE;
 	}
 
-}
-
+	/*
+	 * Replace the ISIN and name indexes once, with all processed stocks.
+	 * Indexes are read again under lock, so that stocks of concurrent imports are kept.
+	 */
 
-int discover_register_type (unsigned int file_type, const char *bovespa_register, unsigned int *answer) {
+	if ((lock_take (INDEX_LOCK_NAME, LOCK_EX, &index_lock_des)) < 0) {
 
-	/* 
-	 * Match the type code field of the Bovespa register to a type code.
-	 */
+		CRIT ("cannot lock database indexes.");
+		FAILURE;
 
-#define COMPARE_WITH(STRING) memcmp (bovespa_register, STRING, 2)
+	}
+	if (stock_count > 0) {
 
-	switch (file_type) {
+		// A concurrent import may have replaced ISIN segments of processed stocks since; take the current ones.
 
-		case BOVESPA_FILE_TYPE_HIST:
+		for ( i = 0; i < stock_count; i++ ) {
 
-			if ((COMPARE_WITH ("00")) == 0) {
+			if ((pfish_bovespa_isin_file_pathname (&(index_stocks[i]), isin_pathname)) < 0) {
 
-				*answer = BOVESPA_FILE_SECTION_HEADER;
-				SUCCESS;
+				FAILURE;
 
 			}
-			else if ((COMPARE_WITH ("01")) == 0) {
+			if ((pfish_bovespa_isin_file_read (isin_pathname, &isins)) < 0) {
 
-				*answer = BOVESPA_FILE_SECTION_QUOTES;
-				SUCCESS;
+				CRIT ("cannot retrieve ISIN segments of stock '%s' from the database.", index_stocks[i].id);
+				FAILURE;
 
 			}
-			else if ((COMPARE_WITH ("99")) == 0) {
+			if (isins == NULL) {
 
-				*answer = BOVESPA_FILE_SECTION_TRAILER;
-				SUCCESS;
+				continue;
 
 			}
-			else {
+			if (index_segments_size + isins->isin_segment_list_size > index_segments_room) {
 
-				ERR ("unknown bovespa type field value '%c%c' for file type '%u'.", bovespa_register[0], bovespa_register[1], file_type);
-				FAILURE;
+				index_segments_room = 2 * (index_segments_size + isins->isin_segment_list_size);
+				if ((aux_voidp = realloc (index_segments, index_segments_room * sizeof (pfish_bovespa_isin_segment_t))) == NULL) {
+
+					ALERT ("cannot allocate %u bytes of heap space.", index_segments_room * sizeof (pfish_bovespa_isin_segment_t));
+					FAILURE;
+
+				}
+				index_segments = (pfish_bovespa_isin_segment_t *) aux_voidp;
 
 			}
-			break;
+			memcpy (&(index_segments[index_segments_size]), isins->isin_segment_list, isins->isin_segment_list_size * sizeof (pfish_bovespa_isin_segment_t));
+			index_segments_size += isins->isin_segment_list_size;
+			free (isins);
 
-		case BOVESPA_FILE_TYPE_BDIN:
+		}
+		if ((isin_index_update (index_segments, index_segments_size, index_stocks, stock_count)) < 0) {
 
-			if ((COMPARE_WITH ("00")) == 0) {
+			CRIT ("cannot update ISIN index.");
+			FAILURE;
 
-				*answer = BOVESPA_FILE_SECTION_HEADER;
-				SUCCESS;
+		}
+		if ((name_index_update (index_names, stock_count)) < 0) {
 
-			}
-			else if ((COMPARE_WITH ("01")) == 0) {
+			CRIT ("cannot update name index.");
+			FAILURE;
 
-				*answer = BOVESPA_FILE_SECTION_OTHER;
-				SUCCESS;
+		}
+		free (index_segments);
+		free (index_stocks);
+		free (index_names);
 
-			}
-			else if ((COMPARE_WITH ("02")) == 0) {
+	}
 
-				*answer = BOVESPA_FILE_SECTION_QUOTES;
-				SUCCESS;
+	/*
+	 * Replace the ticker dictionary if new stocks showed up.
+	 * Concurrent imports may have taken tickers meanwhile, so new stocks of this import
+	 * are given the next free tickers of the current dictionary, in order of first appearance.
+	 */
 
-			}
-			else if ((COMPARE_WITH ("03")) == 0) {
+	if ((pfish_bovespa_ticker_table_alloc (&database_tickers)) < 0) {
 
-				*answer = BOVESPA_FILE_SECTION_OTHER;
-				SUCCESS;
+		CRIT ("cannot load ticker dictionary.");
+		FAILURE;
 
-			}
-			else if ((COMPARE_WITH ("04")) == 0) {
+	}
+	for ( i = 0; i < pfish_bovespa_ticker_table_size (tickers); i++ ) {
 
-				*answer = BOVESPA_FILE_SECTION_OTHER;
-				SUCCESS;
+		if ((pfish_bovespa_ticker_table_intern (database_tickers, pfish_bovespa_ticker_table_stock (tickers, i)->id, &current_ticker)) < 0) {
 
-			}
-			else if ((COMPARE_WITH ("05")) == 0) {
+			CRIT ("cannot assign ticker to stock '%s'.", pfish_bovespa_ticker_table_stock (tickers, i)->id);
+			FAILURE;
 
-				*answer = BOVESPA_FILE_SECTION_OTHER;
-				SUCCESS;
+		}
 
-			}
-			else if ((COMPARE_WITH ("06")) == 0) {
+	}
+	pfish_bovespa_ticker_table_free (tickers);
 
-				*answer = BOVESPA_FILE_SECTION_OTHER;
-				SUCCESS;
+#define TICKER_DICTIONARY_TEMP_PATHNAME DBPATH "/.tickers.tmp"
 
-			}
-			else if ((COMPARE_WITH ("07")) == 0) {
+	if ((rcode = pfish_bovespa_ticker_table_write (database_tickers, TICKER_DICTIONARY_TEMP_PATHNAME)) < 0) {
 
-				*answer = BOVESPA_FILE_SECTION_OTHER;
-				SUCCESS;
+		CRIT ("cannot write ticker dictionary.");
+		FAILURE;
 
-			}
-			else if ((COMPARE_WITH ("99")) == 0) {
+	}
+	if ((rcode == 0) && ((rename (TICKER_DICTIONARY_TEMP_PATHNAME, TICKER_DICTIONARY_FILE)) == -1)) {
 
-				*answer = BOVESPA_FILE_SECTION_TRAILER;
-				SUCCESS;
+		ERRNO_ERR;
+		CRIT ("cannot move temporary ticker dictionary file '%s' to official file.", TICKER_DICTIONARY_TEMP_PATHNAME);
+		FAILURE;
 
-			}
-			else {
+	}
+	pfish_bovespa_ticker_table_free (database_tickers);
 
-				ERR ("unknown bovespa type field value '%c%c' for file type '%u'.", bovespa_register[0], bovespa_register[1], file_type);
-				FAILURE;
+#undef TICKER_DICTIONARY_TEMP_PATHNAME
 
-			}
-			break;
+	/*
+	 * Publish the database files as a new generation, for readers that pin snapshots.
+	 */
 
-		default:
+	if ((lock_take (PUBLISH_LOCK_NAME, LOCK_EX, &publish_lock_des)) < 0) {
 
-			CRIT ("unknown bovespa file type '%u'.", file_type);
-			FAILURE;
+		CRIT ("cannot lock generation publishing.");
+		FAILURE;
 
 	}
+	if ((pfish_bovespa_snapshot_publish (&generation)) < 0) {
 
-#undef COMPARE_WITH
+		CRIT ("cannot publish database generation.");
+		FAILURE;
+
+	}
+	close (publish_lock_des);
+	close (index_lock_des);
+	DEBUG ("generation %" PRIu64 " published.", generation);
+
+	/*
+	 * Global resource releasing.
+	 */
+
+	regfree (&xplit_regex);
+
+	/*
+	 * End.
+	 */
+
+	INFO ("%u stocks processed.", stock_count);
+	SUCCESS;
 
 }
 
@@ -1336,192 +1420,209 @@ int discover_register_type (unsigned int file_type, const char *bovespa_register
 #undef SUCCESS
 
 
-void sanitize_field (char *field, size_t field_size) {
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int xplit_list_build (const char *stock_id, pfish_bovespa_daily_quote_t **daily_quotes, size_t daily_quotes_size, const pfish_bovespa_xplit_list_t *previous, size_t first_changed, const regex_t *xplit_regex, pfish_bovespa_xplit_list_t **answer) {
 
+	pfish_bovespa_xplit_list_t *list;	// The answer.
+	pfish_bovespa_xplit_t *xplit;	// Element of the answer being filled.
+	int match_previous;	// Result of matching xplit_regex against the spec of the previous daily quote.
+	int match_current;	// Result of matching xplit_regex against the spec of the current daily quote.
+	double opening_price;	// Unit opening price of the current daily quote.
+	double closing_price;	// Unit closing price of the previous daily quote.
 	size_t i;
 
-	/* 
-	 * Remove trailing spaces.
+	if ((list = (pfish_bovespa_xplit_list_t *) malloc (sizeof (pfish_bovespa_xplit_list_t) + (daily_quotes_size * sizeof (pfish_bovespa_xplit_t)))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", sizeof (pfish_bovespa_xplit_list_t) + (daily_quotes_size * sizeof (pfish_bovespa_xplit_t)));
+		FAILURE;
+
+	}
+
+#define FREE \
+	free (list)
+
+	/*
+	 * Keep known inplits and splits.
 	 */
 
-	for ( i = field_size - 1; i > 0; i-- ) {
+	list->xplit_list_size = 0;
+	if (previous != NULL) {
 
-		if (field[i] != ' ') {
+		while ((list->xplit_list_size < previous->xplit_list_size) && (previous->xplit_list[list->xplit_list_size].daily_quote_index < first_changed)) {
 
-			break;
+			memcpy (&(list->xplit_list[list->xplit_list_size]), &(previous->xplit_list[list->xplit_list_size]), sizeof (pfish_bovespa_xplit_t));
+			list->xplit_list_size++;
 
 		}
-		field[i] = 0;
-		field_size = i;
 
 	}
 
-	/* 
-	 * Remove consecutive spaces.
+	/*
+	 * Scan the remaining daily quotes.
+	 * Obs.: logic of flags 'match_*' is negative.
 	 */
 
-	for ( i = 0; i < field_size; i++ ) {
-
-		if (field[i] == ' ') {
+#define MATCH(SPEC,RESULT) \
+	if (((RESULT) = regexec (xplit_regex, (SPEC), 0, NULL, 0)) != 0) { \
+		if ((RESULT) != REG_NOMATCH) { \
+			CRIT ("cannot match xplit regexp with spec string of stock '%s'.", stock_id); \
+			FREE; \
+			FAILURE; \
+		} \
+	}
 
-			while (field[i + 1] == ' ') {
+	i = (first_changed > 0) ? first_changed : 1;
+	if (i < daily_quotes_size) {
 
-				memmove (&field[i], &field[i + 1], field_size - i);
-				field_size--;
+		MATCH (daily_quotes[i - 1]->stock_spec, match_current);
 
-			}
+	}
+	for ( ; i < daily_quotes_size; i++ ) {
 
-		}
+		match_previous = match_current;
+		MATCH (daily_quotes[i]->stock_spec, match_current);
+		if ((match_current != 0) || (match_previous == 0)) {
 
-	}
+			continue;
 
-	/* 
-	 * Remove leading zeros.
-	 */
+		}
+		DEBUG ("stock %s, spec '%s', array pos %u: inplit / split.", stock_id, daily_quotes[i]->stock_spec, i);
+		xplit = &(list->xplit_list[list->xplit_list_size++]);
+		xplit->daily_quote_index = i;
+		xplit->trading_date = daily_quotes[i]->trading_date;
+		opening_price = (daily_quotes[i]->price_factor != 0) ? ((double) daily_quotes[i]->opening_price / daily_quotes[i]->price_factor) : 0;
+		closing_price = (daily_quotes[i - 1]->price_factor != 0) ? ((double) daily_quotes[i - 1]->closing_price / daily_quotes[i - 1]->price_factor) : 0;
+		if ((opening_price > 0) && (closing_price > 0)) {
 
-	for ( i = 0; i < field_size; i++ ) {
+			xplit->price_ratio = opening_price / closing_price;
 
-		if (field[i] != '0') {
+		}
+		else {
 
-			break;
+			WARNING ("cannot figure out price ratio of inplit / split of stock '%s' at array position %u; assuming 1.", stock_id, i);
+			xplit->price_ratio = 1;
 
 		}
 
 	}
-	memmove (field, &field[i], field_size - i + 1);
 
-	/* 
-	 * End of sanitization.
-	 */
+#undef MATCH
 
-	return;
+	*answer = list;
+	SUCCESS;
+
+#undef FREE
 
 }
 
+#undef FAILURE
+#undef SUCCESS
+
 
 #define SUCCESS return (0)
-#define IGNORE return (1)
 #define FAILURE return (-1)
 
-int quotes_list_append (const bovespa_mapper_t *mapper, quote_node_t **last) {
+int isin_segment_list_build (const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_daily_quote_t **daily_quotes, size_t daily_quotes_size, const pfish_bovespa_stock_history_t *database_history, const pfish_bovespa_isin_segment_list_t *previous, size_t first_changed, pfish_bovespa_isin_segment_list_t **answer) {
 
-	char *aux_charp;	// General purpose short ranged character pointer.
-	struct tm cal_time;	// Help during date/time type conversion.
-	pfish_bovespa_daily_quote_t quote;	// Temporary quote structure for field type conversions.
-	quote_node_t *new_node;		// New node to be added to the quotes linked list.
-
-	/* 
-	 * Consider only:
-	 *
-	 * 	- tp_merc = '010' (mercado a vista)
-	 * 	- cod_bdi = '02' (lote padrão)
-	 * 	- mod_ref = 'R$'
-	 */
+	pfish_bovespa_isin_segment_list_t *list;	// The answer.
+	pfish_bovespa_isin_segment_t *segment;	// Element of the answer being filled.
+	static const char unknown_isin[PFISH_BOVESPA_CODISI_SIZE];	// ISIN code of daily quotes imported before ISIN codes were tracked.
+	const char *isin;	// ISIN code of the current daily quote.
+	size_t database_index;	// Index of database_history->daily_quotes[] of the current daily quote.
+	size_t k;	// Element of 'previous' that may hold 'database_index'.
+	size_t i;	// Short term generic counter.
 
-#define MATCH_AND_IGNORE(FIELD,STRING) \
-	if ((strcmp (mapper->FIELD, STRING)) != 0) { \
-		DEBUG ("register ignored due to field " #FIELD " ('%s') not be '%s'.", mapper->FIELD, STRING); \
-		IGNORE; \
-	}
+	if ((list = (pfish_bovespa_isin_segment_list_t *) malloc (sizeof (pfish_bovespa_isin_segment_list_t) + (daily_quotes_size * sizeof (pfish_bovespa_isin_segment_t)))) == NULL) {
 
-	MATCH_AND_IGNORE (tp_merc, "10");
-	MATCH_AND_IGNORE (cod_bdi, "2");
-	MATCH_AND_IGNORE (mod_ref, "R$");
+		ALERT ("cannot allocate %u bytes of heap space.", sizeof (pfish_bovespa_isin_segment_list_t) + (daily_quotes_size * sizeof (pfish_bovespa_isin_segment_t)));
+		FAILURE;
 
-#undef MATCH_AND_IGNORE
+	}
 
 	/*
-	 * End of ignoring; starting field type conversions.
+	 * Keep previous segments up to 'first_changed'.
 	 */
 
-	/* 
-	 * Convert field 'trading_date'.
-	 */
+	list->isin_segment_list_size = 0;
+	if (previous != NULL) {
 
-#define STR2INT(TARGET,SOURCE) \
-	cal_time.TARGET = strtol (mapper->SOURCE, &aux_charp, 10); \
-	if ((*aux_charp) != 0) { \
-		CRIT ("cannot understand bovespa field '" #SOURCE "' '%s' as a integer.", mapper->SOURCE); \
-		FAILURE; \
-	}
+		while ((list->isin_segment_list_size < previous->isin_segment_list_size) && (previous->isin_segment_list[list->isin_segment_list_size].daily_quote_index < first_changed)) {
 
-	cal_time.tm_sec = 0;
-	cal_time.tm_min = 0;
-	cal_time.tm_hour = 12;
-	STR2INT (tm_mday, dia_pregao);
-	STR2INT (tm_mon, mes_pregao);
-	cal_time.tm_mon -= 1;
-	STR2INT (tm_year, ano_pregao);
-	cal_time.tm_year -= 1900;
-	cal_time.tm_isdst = 0;
-	cal_time.tm_gmtoff = 0;
-	cal_time.tm_zone = NULL;
+			segment = &(list->isin_segment_list[list->isin_segment_list_size++]);
+			memcpy (segment, &(previous->isin_segment_list[list->isin_segment_list_size - 1]), sizeof (pfish_bovespa_isin_segment_t));
+			if ((segment->daily_quote_index + segment->daily_quotes_size) > first_changed) {
 
-#undef STR2INT
+				segment->daily_quotes_size = first_changed - segment->daily_quote_index;
+				segment->last_trading_date = daily_quotes[first_changed - 1]->trading_date;
 
-	quote.trading_date = timegm (&cal_time);
+			}
 
-	/*
-	 * Convert field 'stock_spec'.
-	 */
+		}
 
-	memset (quote.stock_spec, 0, PFISH_BOVESPA_ESPECI_SIZE);
-	strcpy (quote.stock_spec, mapper->especi);
+	}
 
 	/*
-	 * Convert unsigned integer fields.
+	 * Scan the remaining daily quotes.
 	 */
 
-#define STR2UINT(MAPPER_FIELD_NAME,QUOTE_FIELD_NAME) \
-	quote.QUOTE_FIELD_NAME = strtoul (mapper->MAPPER_FIELD_NAME, &aux_charp, 10); \
-	if (*aux_charp != 0) { \
-		CRIT ("cannot understand bovespa field %s ('%s') as an unsigned integer.", #MAPPER_FIELD_NAME, mapper->MAPPER_FIELD_NAME); \
-		FAILURE; \
-	}
+	k = 0;
+	for ( i = first_changed; i < daily_quotes_size; i++ ) {
 
-	STR2UINT (pre_abe, opening_price);
-	STR2UINT (pre_max, maximum_price);
-	STR2UINT (pre_min, minimum_price);
-	STR2UINT (pre_med, average_price);
-	STR2UINT (pre_ult, closing_price);
-	STR2UINT (tot_neg, total_trades);
-	STR2UINT (qua_tot, total_stocks);
-	STR2UINT (vol_tot, total_volume);
-	STR2UINT (fat_cot, price_factor);
+		if ((database_history != NULL) && (daily_quotes[i] >= database_history->daily_quotes) && (daily_quotes[i] < (database_history->daily_quotes + database_history->daily_quotes_size))) {
 
-#undef STR2UINT
+			database_index = daily_quotes[i] - database_history->daily_quotes;
+			while ((previous != NULL) && (k < previous->isin_segment_list_size) && ((previous->isin_segment_list[k].daily_quote_index + previous->isin_segment_list[k].daily_quotes_size) <= database_index)) {
 
-	/*
-	 * End of type conversions; add a new node to the end of the quotes linked list.
-	 */
+				k++;
 
-	if ((new_node = (quote_node_t *) malloc (sizeof (quote_node_t))) == NULL) {
+			}
+			if ((previous != NULL) && (k < previous->isin_segment_list_size) && (previous->isin_segment_list[k].daily_quote_index <= database_index)) {
 
-		ALERT ("cannot allocate %u bytes of heap space.", sizeof (quote_node_t));
-		FAILURE;
+				isin = previous->isin_segment_list[k].isin;
 
-	}
-	memset (new_node->stock.id, 0, PFISH_BOVESPA_CODNEG_SIZE);
-	strcpy (new_node->stock.id, mapper->cod_neg);
-	memcpy (&(new_node->quote), &quote, sizeof (pfish_bovespa_daily_quote_t));
-	new_node->next = NULL;
-	if (*last != NULL) {
+			}
+			else {
 
-		(*last)->next = new_node;
+				isin = unknown_isin;
 
-	}
-	*last = new_node;
-	
-	/*
-	 * All set.
-	 */
+			}
 
+		}
+		else {
+
+			isin = ((const quote_node_t *) ((const char *) daily_quotes[i] - offsetof (quote_node_t, quote)))->isin;
+
+		}
+		if ((list->isin_segment_list_size > 0) && ((strncmp (list->isin_segment_list[list->isin_segment_list_size - 1].isin, isin, PFISH_BOVESPA_CODISI_SIZE)) == 0)) {
+
+			segment = &(list->isin_segment_list[list->isin_segment_list_size - 1]);
+			segment->daily_quotes_size++;
+			segment->last_trading_date = daily_quotes[i]->trading_date;
+			continue;
+
+		}
+		segment = &(list->isin_segment_list[list->isin_segment_list_size++]);
+		memset (segment, 0, sizeof (pfish_bovespa_isin_segment_t));
+		memcpy (segment->isin, isin, PFISH_BOVESPA_CODISI_SIZE);
+		memcpy (&(segment->stock_id), stock_id, sizeof (pfish_bovespa_stock_id_t));
+		segment->daily_quote_index = i;
+		segment->daily_quotes_size = 1;
+		segment->first_trading_date = segment->last_trading_date = daily_quotes[i]->trading_date;
+		if (list->isin_segment_list_size > 1) {
+
+			INFO ("stock '%s' changed ISIN code from '%s' to '%s' at array position %u.", stock_id->id, list->isin_segment_list[list->isin_segment_list_size - 2].isin, isin, i);
+
+		}
+
+	}
+	*answer = list;
 	SUCCESS;
 
 }
 
 #undef FAILURE
-#undef IGNORE
 #undef SUCCESS
 
 
@@ -1529,18 +1630,18 @@ int quotes_list_append (const bovespa_mapper_t *mapper, quote_node_t **last) {
 #define GREATER return (1)
 #define EQUAL return (0)
 
-int compare_quote_nodes (const void *a, const void *b) {
+int compare_isin_segments (const void *a, const void *b) {
 
 	int rcode;
 
-#define CAST(X) (*((quote_node_t **) X))
-#define A (CAST (a))
-#define B (CAST (b))
+#define A ((const pfish_bovespa_isin_segment_t *) a)
+#define B ((const pfish_bovespa_isin_segment_t *) b)
 
-	/* Sort by stock name ascending,
-	 * then by timestamp ascending. */
+	/* Sort by ISIN code ascending,
+	 * then by first trading date ascending,
+	 * then by stock name ascending. */
 
-	if ((rcode = strcmp (A->stock.id, B->stock.id)) < 0) {
+	if ((rcode = strncmp (A->isin, B->isin, PFISH_BOVESPA_CODISI_SIZE)) < 0) {
 
 		LESSER;
 
@@ -1550,25 +1651,24 @@ int compare_quote_nodes (const void *a, const void *b) {
 		GREATER;
 
 	}
-	else if (A->quote.trading_date < B->quote.trading_date) {
+	else if (A->first_trading_date < B->first_trading_date) {
 
 		LESSER;
 
 	}
-	else if (A->quote.trading_date > B->quote.trading_date) {
+	else if (A->first_trading_date > B->first_trading_date) {
 
 		GREATER;
 
 	}
 	else {
 
-		EQUAL;
+		return (strncmp (A->stock_id.id, B->stock_id.id, PFISH_BOVESPA_CODNEG_SIZE));
 
 	}
 
 #undef B
 #undef A
-#undef CAST
 
 }
 
@@ -1577,123 +1677,238 @@ int compare_quote_nodes (const void *a, const void *b) {
 #undef LESSER
 
 
+/*
+ * Compare two stock identifications, for bsearch().
+ */
+
+static int compare_stock_ids (const void *a, const void *b) {
+
+	return (strncmp (((const pfish_bovespa_stock_id_t *) a)->id, ((const pfish_bovespa_stock_id_t *) b)->id, PFISH_BOVESPA_CODNEG_SIZE));
+
+}
+
+
 #define SUCCESS return (0)
 #define FAILURE return (-1)
 
-int merge_daily_quotes (pfish_bovespa_daily_quote_t **a, size_t a_size, pfish_bovespa_daily_quote_t **b, size_t b_size, pfish_bovespa_daily_quote_t ***answer, size_t *answer_size) {
+int isin_index_update (const pfish_bovespa_isin_segment_t *segments, size_t segments_size, const pfish_bovespa_stock_id_t *stock_ids, size_t stock_ids_size) {
+
+	pfish_bovespa_isin_segment_list_t *index;	// Current ISIN index, mapped.
+	size_t index_size;	// Octets of the mapping.
+	pfish_bovespa_isin_segment_list_t *list;	// New ISIN index.
+	size_t list_size;	// Octets of the new ISIN index.
+	size_t i;	// Short term generic counter.
+
+	if ((pfish_bovespa_isin_index_map (&index, &index_size)) < 0) {
+
+		CRIT ("cannot map ISIN index.");
+		FAILURE;
+
+	}
+	list_size = sizeof (pfish_bovespa_isin_segment_list_t) + (((index != NULL) ? index->isin_segment_list_size : 0) + segments_size) * sizeof (pfish_bovespa_isin_segment_t);
+	if ((list = (pfish_bovespa_isin_segment_list_t *) malloc (list_size)) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", list_size);
+		FAILURE;
+
+	}
+
+	/*
+	 * Segments of stocks left untouched, then segments of processed stocks with a known ISIN code.
+	 */
+
+	list->isin_segment_list_size = 0;
+	if (index != NULL) {
+
+		for ( i = 0; i < index->isin_segment_list_size; i++ ) {
+
+			if ((bsearch (&(index->isin_segment_list[i].stock_id), stock_ids, stock_ids_size, sizeof (pfish_bovespa_stock_id_t), compare_stock_ids)) == NULL) {
+
+				memcpy (&(list->isin_segment_list[list->isin_segment_list_size++]), &(index->isin_segment_list[i]), sizeof (pfish_bovespa_isin_segment_t));
 
-	pfish_bovespa_daily_quote_t **c;	// 'c' is the merged array.
+			}
+
+		}
+		if ((munmap (index, index_size)) < 0) {
+
+			ERRNO_ERR;
+			WARNING ("cannot unmap ISIN index.");
+
+		}
+
+	}
+	for ( i = 0; i < segments_size; i++ ) {
 
-	size_t a_count;		// Indexer for array 'a'.
-	size_t b_count;		// Indexer for array 'b'.
-	size_t c_count;		// Indexer for array 'c'.
+		if (segments[i].isin[0] != 0) {
+
+			memcpy (&(list->isin_segment_list[list->isin_segment_list_size++]), &(segments[i]), sizeof (pfish_bovespa_isin_segment_t));
+
+		}
+
+	}
+	qsort (list->isin_segment_list, list->isin_segment_list_size, sizeof (pfish_bovespa_isin_segment_t), compare_isin_segments);
 
 	/*
-	 * Make room for the worst case.
+	 * Replace the index file atomically.
 	 */
 
-	if ((c = (pfish_bovespa_daily_quote_t **) malloc ((a_size + b_size) * sizeof (pfish_bovespa_daily_quote_t *))) == NULL) {
+#define ISIN_INDEX_TEMP_PATHNAME DBPATH "/.isin_index.tmp"
+
+	if ((pfish_bovespa_isin_file_write (ISIN_INDEX_TEMP_PATHNAME, list)) < 0) {
+
+		CRIT ("cannot write temporary ISIN index file '%s'.", ISIN_INDEX_TEMP_PATHNAME);
+		free (list);
+		FAILURE;
+
+	}
+	free (list);
+	if ((rename (ISIN_INDEX_TEMP_PATHNAME, ISIN_INDEX_FILE)) == -1) {
 
-		ALERT ("cannot allocate %u bytes of heap space.", (a_size + b_size) * sizeof (pfish_bovespa_daily_quote_t *));
+		ERRNO_ERR;
+		CRIT ("cannot move temporary ISIN index file '%s' to '%s'.", ISIN_INDEX_TEMP_PATHNAME, ISIN_INDEX_FILE);
 		FAILURE;
 
 	}
 
+#undef ISIN_INDEX_TEMP_PATHNAME
+
+	SUCCESS;
+
+}
+
 #undef FAILURE
-#define FAILURE \
-	free (c); \
-	return (-1)
+#undef SUCCESS
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int name_index_update (const pfish_bovespa_name_t *names, size_t names_size) {
+
+	pfish_bovespa_name_list_t *index;	// Names of the current name index.
+	pfish_bovespa_name_t *list;	// Names of the new name index.
+	size_t list_size;	// How many elements in 'list'.
+	size_t i, j;	// Indexes of index->name_list[] and names[].
+	int rcode;	// Result of comparisons.
+
+	if ((pfish_bovespa_name_index_read (NAME_INDEX_FILE, &index)) < 0) {
+
+		CRIT ("cannot read name index.");
+		FAILURE;
+
+	}
+	if ((list = (pfish_bovespa_name_t *) malloc ((((index != NULL) ? index->name_list_size : 0) + names_size) * sizeof (pfish_bovespa_name_t))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (((index != NULL) ? index->name_list_size : 0) + names_size) * sizeof (pfish_bovespa_name_t));
+		free (index);
+		FAILURE;
+
+	}
 
 	/*
-	 * Merge arrays 'a' and 'b' into 'c'.
-	 * Assumptions:
-	 * 	- trading date is unique among elements of 'a'. Idem for 'b'. Idem for 'c'.
-	 * 	- 'a' is sorted by trading date. Idem for 'b'. Idem for 'c'.
-	 * 	- in case of elements in 'a' and 'b' with same trading date, element of 'b' takes precedence.
+	 * Merge both lists by stock id.
 	 */
 
-	a_count = 0;
-	b_count = 0;
-	c_count = 0;
-	while ((a_count < a_size) || (b_count < b_size)) {
+	list_size = 0;
+	i = j = 0;
+	while (((index != NULL) && (i < index->name_list_size)) || (j < names_size)) {
 
-		/*
-		 * There is at least one element to be merged from one of the input arrays.
-		 */
+		if ((index == NULL) || (i == index->name_list_size)) {
 
-		if (a_count >= a_size) {
+			rcode = 1;
 
-			/*
-			 * No elements left in 'a'.
-			 */
+		}
+		else if (j == names_size) {
 
-			c[c_count++] = b[b_count++];
+			rcode = -1;
 
 		}
-		else if (b_count >= b_size) {
+		else {
 
-			/*
-			 * No elements left in 'b'.
-			 */
+			rcode = strncmp (index->name_list[i].stock_id.id, names[j].stock_id.id, PFISH_BOVESPA_CODNEG_SIZE);
+
+		}
+		if (rcode < 0) {
 
-			c[c_count++] = a[a_count++];
+			memcpy (&(list[list_size++]), &(index->name_list[i++]), sizeof (pfish_bovespa_name_t));
+
+		}
+		else if (rcode > 0) {
+
+			memcpy (&(list[list_size++]), &(names[j++]), sizeof (pfish_bovespa_name_t));
 
 		}
 		else {
 
-			/*
-			 * Elements waiting in both input arrays; apply precedence rule.
-			 */
+			memcpy (&(list[list_size++]), (index->name_list[i].trading_date > names[j].trading_date) ? &(index->name_list[i]) : &(names[j]), sizeof (pfish_bovespa_name_t));
+			i++;
+			j++;
 
-#define TRADING_DATE(X) ((X[X##_count])->trading_date)
+		}
 
-			if (TRADING_DATE (a) < TRADING_DATE (b)) {
+	}
+	free (index);
 
-				/*
-				 * Trading of element in 'a' happened sooner.
-				 */
+	/*
+	 * Replace the index file atomically.
+	 */
 
-				c[c_count++] = a[a_count++];
+#define NAME_INDEX_TEMP_PATHNAME DBPATH "/.name_index.tmp"
 
-			}
-			else if (TRADING_DATE (a) > TRADING_DATE (b)) {
+	if ((pfish_bovespa_name_index_write (NAME_INDEX_TEMP_PATHNAME, list, list_size)) < 0) {
 
-				/*
-				 * Trading of element in 'b' happened sooner.
-				 */
+		CRIT ("cannot write temporary name index file '%s'.", NAME_INDEX_TEMP_PATHNAME);
+		free (list);
+		FAILURE;
 
-				c[c_count++] = b[b_count++];
+	}
+	free (list);
+	if ((rename (NAME_INDEX_TEMP_PATHNAME, NAME_INDEX_FILE)) == -1) {
 
-			}
-			else {
+		ERRNO_ERR;
+		CRIT ("cannot move temporary name index file '%s' to '%s'.", NAME_INDEX_TEMP_PATHNAME, NAME_INDEX_FILE);
+		FAILURE;
 
-				/*
-				 * Same trading date for both elements.
-				 * Element in 'b' wins, element in 'a' is discarded.
-				 */
+	}
 
-				c[c_count++] = b[b_count++];
-				a_count++;
+#undef NAME_INDEX_TEMP_PATHNAME
 
-			}
+	SUCCESS;
+
+}
 
-#undef TRADING_DATE
+int lock_take (const char *name, int operation, int *answer) {
 
-		}
+	char pathname[PATH_MAX];	// Pathname of the lock file.
+
+	if ((snprintf (pathname, PATH_MAX, "%s/%s", LOCK_FILE_DIR, name)) >= PATH_MAX) {
+
+		ALERT ("pathname buffer overflow.");
+		FAILURE;
 
 	}
+	if ((*answer = open (pathname, O_RDWR | O_CREAT, 0644)) < 0) {
 
-	/*
-	 * Merged array 'c' is mounted, containing 'c_count' elements.
-	 */
+		ERRNO_ERR;
+		CRIT ("cannot open lock file '%s'.", pathname);
+		FAILURE;
+
+	}
+	while ((flock (*answer, operation)) < 0) {
+
+		if (errno != EINTR) {
+
+			ERRNO_ERR;
+			CRIT ("cannot lock file '%s'.", pathname);
+			close (*answer);
+			FAILURE;
 
-	assert (c_count <= (a_count + b_count));
-	*answer = c;
-	*answer_size = c_count;
+		}
+
+	}
 	SUCCESS;
 
 }
 
 #undef FAILURE
 #undef SUCCESS
-
@@ -0,0 +1,526 @@
+/*
+ * fsck.c
+ *
+ * Integrity check of the pilot_fish bovespa database.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <argp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+#include <pilot_fish/bovespa.h>
+
+#include "stock_file.h"
+#include "name_index.h"
+#include "ticker_dictionary.h"
+#include "async_log.h"
+
+
+/*
+ * Command line argument parsing.
+ */
+
+const char *argp_program_version = PACKAGE_VERSION;
+const char *argp_program_bug_address = PACKAGE_BUGREPORT;
+
+static char doc[] = "pfish_bovespa_fsck -- integrity check of the pilot_fish bovespa database.\vThis routine verifies every stock file of the database (raw, adjusted, weekly, monthly, adjusted weekly and adjusted monthly views): file size against header, block and file checksums, and ordering of daily quotes. Inplit / split lists, ISIN segment lists, the ISIN index and the name index are verified against their checksums; the ticker dictionary, against its checksum and its perfect hash function. Stocks are verified in parallel.\n\nExit status is zero only if all stock files are sound.\n";
+
+static struct argp_option options[] = {
+
+	{"jobs", 'j', "JOBS", 0, "verify JOBS stock files at once (default: number of online processors).", 0 },
+	{ 0 }
+
+};
+
+struct arguments {
+
+	long jobs;
+
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+	char *aux_charp;
+
+	switch (key) {
+
+		case 'j':
+
+			arguments->jobs = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->jobs < 1)) {
+
+				argp_error (state, "invalid number of jobs '%s'.", arg);
+
+			}
+			break;
+
+		case ARGP_KEY_ARG:
+
+			argp_usage (state);
+			break;
+
+		default:
+
+			return (ARGP_ERR_UNKNOWN);
+
+	};
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, NULL, doc };
+
+
+/*
+ * Work shared among verifying threads.
+ */
+
+struct fsck_work {
+
+	const pfish_bovespa_stock_list_t *stocks;	// Stocks to be verified.
+	size_t next;	// Next stock to be verified; taken atomically.
+	size_t corrupt;	// How many stock files are corrupt; updated atomically.
+
+};
+
+
+/*
+ * Verify all files of one stock: stock files of every view, the inplit / split list and the ISIN segment list.
+ *
+ * @param[in] stock_id stock identification.
+ *
+ * @return 0 if all files of the stock are sound, negative otherwise.
+ */
+
+int fsck_stock (const pfish_bovespa_stock_id_t *stock_id);
+
+
+/*
+ * Verify one stock file.
+ *
+ * @param[in] pathname full pathname of the stock file.
+ * @param[in] optional nonzero if the stock file may be absent.
+ *
+ * @return 0 if stock file is sound (or absent and optional), negative otherwise.
+ */
+
+int fsck_stock_file (const char *pathname, unsigned int optional);
+
+
+/*
+ * Verify the ISIN index: checksum and ordering.
+ *
+ * @return 0 if the ISIN index is sound (or absent), negative otherwise.
+ */
+
+int fsck_isin_index (void);
+
+
+/*
+ * Verify the name index: sizes and checksum.
+ *
+ * @return 0 if the name index is sound (or absent), negative otherwise.
+ */
+
+int fsck_name_index (void);
+
+
+/*
+ * Verify the ticker dictionary: sizes, checksum and minimal perfect hash function.
+ *
+ * @return 0 if the ticker dictionary is sound (or absent), negative otherwise.
+ */
+
+int fsck_ticker_dictionary (void);
+
+
+/*
+ * Verifying thread.
+ *
+ * @param arg (struct fsck_work *).
+ */
+
+void *fsck_worker (void *arg);
+
+
+/*
+ * The portal.
+ */
+
+#define SUCCESS return (EXIT_SUCCESS)
+#define FAILURE return (EXIT_FAILURE)
+
+int main (int argc, char **argv) {
+
+	struct arguments arguments;	// Arguments given in the command line.
+	struct fsck_work work;	// Work shared among threads.
+	pthread_t *threads;	// Helper threads.
+	size_t threads_size;	// How many helper threads were started.
+	size_t i;	// General, short ranged indexer.
+
+	/*
+	 * Begin.
+	 */
+
+	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	pfish_bovespa_log_level_from_env ();
+	DEBUG ("start.");
+
+	/*
+	 * Parse command line arguments.
+	 */
+
+	if ((arguments.jobs = sysconf (_SC_NPROCESSORS_ONLN)) < 1) {
+
+		arguments.jobs = 1;
+
+	}
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+	/*
+	 * From now on, log messages are written by a background thread.
+	 */
+
+	pfish_bovespa_log_start ();
+
+	/*
+	 * Retrieve the stock list from database.
+	 */
+
+	if ((work.stocks = pfish_bovespa_stock_list_alloc ()) == NULL) {
+
+		CRIT ("cannot retrieve stock list from database.");
+		FAILURE;
+
+	}
+	work.next = 0;
+	work.corrupt = 0;
+
+	/*
+	 * Verify stock files in parallel; this thread works too.
+	 */
+
+	threads_size = arguments.jobs - 1;
+	if (threads_size > work.stocks->stock_list_size) {
+
+		threads_size = work.stocks->stock_list_size;
+
+	}
+	if ((threads = (pthread_t *) malloc ((threads_size + 1) * sizeof (pthread_t))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (threads_size + 1) * sizeof (pthread_t));
+		FAILURE;
+
+	}
+	for ( i = 0; i < threads_size; i++ ) {
+
+		if ((pthread_create (&(threads[i]), NULL, fsck_worker, &work)) != 0) {
+
+			WARNING ("cannot start verifying thread; going on with %u threads.", i + 1);
+			threads_size = i;
+			break;
+
+		}
+
+	}
+	fsck_worker (&work);
+	for ( i = 0; i < threads_size; i++ ) {
+
+		pthread_join (threads[i], NULL);
+
+	}
+	free (threads);
+	if ((fsck_isin_index ()) < 0) {
+
+		work.corrupt++;
+
+	}
+	if ((fsck_name_index ()) < 0) {
+
+		work.corrupt++;
+
+	}
+	if ((fsck_ticker_dictionary ()) < 0) {
+
+		work.corrupt++;
+
+	}
+
+	/*
+	 * End.
+	 */
+
+	if (work.corrupt != 0) {
+
+		ERR ("%u of %u stocks have corrupt files.", work.corrupt, work.stocks->stock_list_size);
+		FAILURE;
+
+	}
+	INFO ("%u stocks verified.", work.stocks->stock_list_size);
+	DEBUG ("end.");
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void *fsck_worker (void *arg) {
+
+	struct fsck_work *work = (struct fsck_work *) arg;
+	size_t i;
+
+	while ((i = __sync_fetch_and_add (&(work->next), 1)) < work->stocks->stock_list_size) {
+
+		if ((fsck_stock (&(work->stocks->stock_list[i]))) < 0) {
+
+			__sync_fetch_and_add (&(work->corrupt), 1);
+
+		}
+
+	}
+	return (NULL);
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int fsck_stock (const pfish_bovespa_stock_id_t *stock_id) {
+
+	char pathname[PATH_MAX];	// Pathname of a file of the stock.
+	pfish_bovespa_xplit_list_t *xplits;	// Inplit / split list of the stock.
+	pfish_bovespa_isin_segment_list_t *isins;	// ISIN segment list of the stock.
+	size_t view;	// Index of pfish_bovespa_stock_file_views[].
+	int rcode;	// Verification result.
+
+	rcode = 0;
+	for ( view = 0; view < STOCK_FILE_VIEWS_SIZE; view++ ) {
+
+		if ((pfish_bovespa_stock_file_pathname (stock_id, pfish_bovespa_stock_file_views[view], pathname)) < 0) {
+
+			FAILURE;
+
+		}
+		if ((fsck_stock_file (pathname, pfish_bovespa_stock_file_views[view] != PFISH_BOVESPA_VIEW_RAW)) < 0) {
+
+			rcode = -1;
+
+		}
+
+	}
+	if ((pfish_bovespa_xplit_file_pathname (stock_id, pathname)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_xplit_file_read (pathname, &xplits)) < 0) {
+
+		rcode = -1;
+
+	}
+	else {
+
+		free (xplits);
+
+	}
+	if ((pfish_bovespa_isin_file_pathname (stock_id, pathname)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_isin_file_read (pathname, &isins)) < 0) {
+
+		rcode = -1;
+
+	}
+	else {
+
+		free (isins);
+
+	}
+	return (rcode);
+
+}
+
+
+int fsck_stock_file (const char *pathname, unsigned int optional) {
+
+	int stock_des;	// Stock file descriptor.
+	struct stat stock_stat;	// Investigation about the stock file.
+	pfish_bovespa_stock_history_t *history;	// Mapped stock file.
+	int rcode;	// Verification result.
+
+	if ((stock_des = open (pathname, O_RDONLY)) < 0) {
+
+		if ((errno == ENOENT) && (optional != 0)) {
+
+			SUCCESS;
+
+		}
+		ERRNO_ERR;
+		ERR ("cannot open file '%s'.", pathname);
+		FAILURE;
+
+	}
+	if ((fstat (stock_des, &stock_stat)) < 0) {
+
+		ERRNO_ERR;
+		ERR ("cannot stat file '%s'.", pathname);
+		close (stock_des);
+		FAILURE;
+
+	}
+	if (stock_stat.st_size == 0) {
+
+		ERR ("stock file '%s' is empty.", pathname);
+		close (stock_des);
+		FAILURE;
+
+	}
+	if ((history = (pfish_bovespa_stock_history_t *) mmap (NULL, stock_stat.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, stock_des, 0)) == (pfish_bovespa_stock_history_t *) (-1)) {
+
+		ERRNO_ERR;
+		ERR ("cannot memory-map file '%s'.", pathname);
+		close (stock_des);
+		FAILURE;
+
+	}
+	close (stock_des);
+	rcode = pfish_bovespa_stock_file_verify (pathname, history, stock_stat.st_size, 1);
+	munmap (history, stock_stat.st_size);
+	if (rcode < 0) {
+
+		FAILURE;
+
+	}
+	DEBUG ("stock file '%s' is sound.", pathname);
+	SUCCESS;
+
+}
+
+int fsck_isin_index (void) {
+
+	pfish_bovespa_isin_segment_list_t *index;	// ISIN index.
+	size_t i;	// Short term generic counter.
+
+	if ((pfish_bovespa_isin_file_read (ISIN_INDEX_FILE, &index)) < 0) {
+
+		FAILURE;
+
+	}
+	if (index == NULL) {
+
+		SUCCESS;
+
+	}
+	for ( i = 1; i < index->isin_segment_list_size; i++ ) {
+
+		if ((strncmp (index->isin_segment_list[i - 1].isin, index->isin_segment_list[i].isin, PFISH_BOVESPA_CODISI_SIZE)) > 0) {
+
+			ERR ("ISIN index '%s' out of order at position %lu.", ISIN_INDEX_FILE, (unsigned long) i);
+			free (index);
+			FAILURE;
+
+		}
+
+	}
+	DEBUG ("ISIN index '%s' is sound.", ISIN_INDEX_FILE);
+	free (index);
+	SUCCESS;
+
+}
+
+int fsck_name_index (void) {
+
+	pfish_bovespa_name_list_t *names;	// Names of the name index.
+
+	if ((pfish_bovespa_name_index_read (NAME_INDEX_FILE, &names)) < 0) {
+
+		FAILURE;
+
+	}
+	if (names != NULL) {
+
+		DEBUG ("name index '%s' is sound.", NAME_INDEX_FILE);
+		free (names);
+
+	}
+	SUCCESS;
+
+}
+
+int fsck_ticker_dictionary (void) {
+
+	int dictionary_des;	// Ticker dictionary file descriptor.
+	struct stat dictionary_stat;	// Status of the ticker dictionary file.
+	ticker_dictionary_header_t *header;	// Mapped ticker dictionary.
+	int rcode;	// Result of verification.
+
+	if ((dictionary_des = open (TICKER_DICTIONARY_FILE, O_RDONLY)) < 0) {
+
+		if (errno == ENOENT) {
+
+			SUCCESS;
+
+		}
+		ERRNO_ERR;
+		ERR ("cannot open file '%s'.", TICKER_DICTIONARY_FILE);
+		FAILURE;
+
+	}
+	if ((fstat (dictionary_des, &dictionary_stat)) < 0) {
+
+		ERRNO_ERR;
+		ERR ("cannot stat file '%s'.", TICKER_DICTIONARY_FILE);
+		close (dictionary_des);
+		FAILURE;
+
+	}
+	if (dictionary_stat.st_size < (off_t) sizeof (ticker_dictionary_header_t)) {
+
+		ERR ("ticker dictionary '%s' is truncated.", TICKER_DICTIONARY_FILE);
+		close (dictionary_des);
+		FAILURE;
+
+	}
+	if ((header = (ticker_dictionary_header_t *) mmap (NULL, dictionary_stat.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, dictionary_des, 0)) == (ticker_dictionary_header_t *) (-1)) {
+
+		ERRNO_ERR;
+		ERR ("cannot memory-map file '%s'.", TICKER_DICTIONARY_FILE);
+		close (dictionary_des);
+		FAILURE;
+
+	}
+	close (dictionary_des);
+	rcode = pfish_bovespa_ticker_dictionary_verify (TICKER_DICTIONARY_FILE, header, dictionary_stat.st_size, 1);
+	munmap (header, dictionary_stat.st_size);
+	if (rcode < 0) {
+
+		FAILURE;
+
+	}
+	DEBUG ("ticker dictionary '%s' is sound.", TICKER_DICTIONARY_FILE);
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
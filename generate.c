@@ -0,0 +1,843 @@
+/*
+ * generate.c
+ *
+ * Generator of synthetic Bovespa files, for benchmarking of imports.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <argp.h>
+#include <time.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+
+/*
+ * Command line argument parsing.
+ */
+
+const char *argp_program_version = PACKAGE_VERSION;
+const char *argp_program_bug_address = PACKAGE_BUGREPORT;
+
+static char doc[] = "pfish_bovespa_generate -- generator of synthetic Bovespa files.\vThis routine writes to the standard output a valid Bovespa file with synthetic quotes, ready for pfish_bovespa_file_import. A COTAHIST ('hist') file covers DAYS trading days (Monday to Friday) starting at DATE; a BDIN ('bdin') file covers the single trading session at or after DATE.\n\nBesides standard lot quotes of STOCKS stocks (ON, PN and UNT classes with governance levels, some quoted per thousand, a few days without trades), files hold registers the import ignores (fractional lots, options, and index summaries in BDIN files), and stock specs marked ex-dividend, ex-interest, and ex-bonus / ex-grouping on inplits and splits. The same SEED gives the same stocks and quotes.\n";
+
+static struct argp_option options[] = {
+
+	{"type", 't', "TYPE",  0, "write a file of TYPE: 'hist' (default) or 'bdin'.", 0 },
+	{"stocks", 's', "STOCKS",  0, "quote STOCKS stocks (default: 400).", 0 },
+	{"days", 'd', "DAYS",  0, "cover DAYS trading days (default: 250; 'hist' only).", 0 },
+	{"megabytes", 'm', "MEGABYTES",  0, "cover as many trading days as fit in about MEGABYTES (overrides --days; 'hist' only).", 0 },
+	{"begin", 'b', "DATE",  0, "start at DATE, as YYYYMMDD (default: 20100104).", 0 },
+	{"seed", 'r', "SEED",  0, "seed the generation with SEED (default: 1).", 0 },
+	{ 0 }
+
+};
+
+#define FILE_TYPE_HIST 0
+#define FILE_TYPE_BDIN 1
+
+struct arguments {
+
+	unsigned int type;
+	long stocks;
+	long days;
+	long megabytes;
+	struct tm begin;
+	unsigned long seed;
+
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+	char *aux_charp;
+
+	switch (key) {
+
+		case 't':
+
+			if ((strcmp (arg, "hist")) == 0) {
+
+				arguments->type = FILE_TYPE_HIST;
+
+			}
+			else if ((strcmp (arg, "bdin")) == 0) {
+
+				arguments->type = FILE_TYPE_BDIN;
+
+			}
+			else {
+
+				argp_error (state, "unknown file type '%s'.", arg);
+
+			}
+			break;
+
+		case 's':
+
+			arguments->stocks = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->stocks < 1) || (arguments->stocks > 100000)) {
+
+				argp_error (state, "invalid number of stocks '%s'.", arg);
+
+			}
+			break;
+
+		case 'd':
+
+			arguments->days = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->days < 1)) {
+
+				argp_error (state, "invalid number of days '%s'.", arg);
+
+			}
+			break;
+
+		case 'm':
+
+			arguments->megabytes = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->megabytes < 1)) {
+
+				argp_error (state, "invalid size '%s'.", arg);
+
+			}
+			break;
+
+		case 'b':
+
+			memset (&(arguments->begin), 0, sizeof (struct tm));
+			if (((strlen (arg)) != 8) || ((strspn (arg, "0123456789")) != 8) || ((sscanf (arg, "%4d%2d%2d", &(arguments->begin.tm_year), &(arguments->begin.tm_mon), &(arguments->begin.tm_mday))) != 3) || (arguments->begin.tm_year < 1970) || (arguments->begin.tm_mon < 1) || (arguments->begin.tm_mon > 12) || (arguments->begin.tm_mday < 1) || (arguments->begin.tm_mday > 31)) {
+
+				argp_error (state, "invalid date '%s'.", arg);
+
+			}
+			arguments->begin.tm_year -= 1900;
+			arguments->begin.tm_mon -= 1;
+			break;
+
+		case 'r':
+
+			arguments->seed = strtoul (arg, &aux_charp, 10);
+			if (*aux_charp != 0) {
+
+				argp_error (state, "invalid seed '%s'.", arg);
+
+			}
+			break;
+
+		case ARGP_KEY_ARG:
+
+			argp_usage (state);
+			break;
+
+		default:
+
+			return (ARGP_ERR_UNKNOWN);
+
+	};
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, 0, doc };
+
+
+/*
+ * Layout of generated registers, after the specs 'SeriesHistoricas_Layout.pdf' (HIST_*)
+ * and 'BDIN_Bovespa_v11.pdf' (BDIN_*). Positions start at 1, as in the specs (and in file_import.c).
+ */
+
+#define HIST_REGISTER_LENGTH 245
+#define BDIN_REGISTER_LENGTH 350
+#define REGISTER_END "\r\n"
+
+#define HIST_QUOTE_FIELDS \
+	F (ano_pregao, 3, 6); \
+	F (mes_pregao, 7, 8); \
+	F (dia_pregao, 9, 10); \
+	F (cod_bdi, 11, 12); \
+	F (cod_neg, 13, 24); \
+	F (tp_merc, 25, 27); \
+	F (nom_res, 28, 39); \
+	F (especi, 40, 49); \
+	F (mod_ref, 53, 56); \
+	F (pre_abe, 57, 69); \
+	F (pre_max, 70, 82); \
+	F (pre_min, 83, 95); \
+	F (pre_med, 96, 108); \
+	F (pre_ult, 109, 121); \
+	F (pre_ofc, 122, 134); \
+	F (pre_ofv, 135, 147); \
+	F (tot_neg, 148, 152); \
+	F (qua_tot, 153, 170); \
+	F (vol_tot, 171, 188); \
+	F (pre_exe, 189, 201); \
+	F (ind_opc, 202, 202); \
+	F (dat_ven, 203, 210); \
+	F (fat_cot, 211, 217); \
+	F (pto_exe, 218, 230); \
+	F (cod_isi, 231, 242); \
+	F (dis_mes, 243, 245)
+
+#define BDIN_QUOTE_FIELDS \
+	F (ano_pregao, 0, 0); \
+	F (mes_pregao, 0, 0); \
+	F (dia_pregao, 0, 0); \
+	F (cod_bdi, 3, 4); \
+	F (cod_neg, 58, 69); \
+	F (tp_merc, 70, 72); \
+	F (nom_res, 35, 46); \
+	F (especi, 47, 56); \
+	F (mod_ref, 0, 0); \
+	F (pre_abe, 91, 101); \
+	F (pre_max, 102, 112); \
+	F (pre_min, 113, 123); \
+	F (pre_med, 124, 134); \
+	F (pre_ult, 135, 145); \
+	F (pre_ofc, 0, 0); \
+	F (pre_ofv, 0, 0); \
+	F (tot_neg, 174, 178); \
+	F (qua_tot, 179, 193); \
+	F (vol_tot, 194, 210); \
+	F (pre_exe, 0, 0); \
+	F (ind_opc, 0, 0); \
+	F (dat_ven, 0, 0); \
+	F (fat_cot, 246, 252); \
+	F (pto_exe, 0, 0); \
+	F (cod_isi, 266, 277); \
+	F (dis_mes, 0, 0)
+
+
+/*
+ * Positions of the quote fields of a file type; fields at position 0 are not in the file type.
+ */
+
+struct field_position {
+
+	unsigned int from;
+	unsigned int to;
+
+};
+
+struct quote_layout {
+
+#define F(FIELD_NAME,FROM,TO) struct field_position FIELD_NAME
+	HIST_QUOTE_FIELDS;
+#undef F
+
+	const char *type;	// Register type of quotes.
+
+};
+
+
+/*
+ * A generated stock.
+ */
+
+struct stock {
+
+	char ticker[13];	// Negotiation code.
+	char name[13];	// Short name of the company.
+	const char *kind;	// Stock spec kind: "ON", "PN" or "UNT".
+	const char *level;	// Governance level in the stock spec, or "".
+	char isin[13];	// ISIN code.
+	uint64_t price;	// Last closing price, in cents (per 'factor' stocks).
+	unsigned int factor;	// Price factor: 1, or 1000 for stocks quoted per thousand.
+	unsigned int options;	// How many option series of the stock are traded each day.
+
+};
+
+
+/*
+ * Pseudo random numbers (xorshift64*).
+ */
+
+uint64_t random_next (uint64_t *state);
+
+
+/*
+ * Pseudo random number in [0, limit).
+ */
+
+uint64_t random_below (uint64_t *state, uint64_t limit);
+
+
+/*
+ * Fill a field of a register with text, left aligned and padded with spaces.
+ *
+ * @param[out] record register.
+ * @param[in] position position of the field; nothing is done if the field is not in the register.
+ * @param[in] text text of the field; truncated if too big.
+ */
+
+void field_text (char *record, struct field_position position, const char *text);
+
+
+/*
+ * Fill a field of a register with a number, right aligned and padded with zeros.
+ *
+ * @param[out] record register.
+ * @param[in] position position of the field; nothing is done if the field is not in the register.
+ * @param[in] value number of the field; all nines if too big.
+ */
+
+void field_number (char *record, struct field_position position, uint64_t value);
+
+
+/*
+ * Write a register to the standard output.
+ *
+ * @param[in] record register.
+ * @param[in] length register length.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int register_write (const char *record, unsigned int length);
+
+
+/*
+ * The portal.
+ */
+
+#define SUCCESS return (EXIT_SUCCESS)
+#define FAILURE return (EXIT_FAILURE)
+
+int main (int argc, char **argv) {
+
+	struct arguments arguments;	// Arguments given in the command line.
+	struct quote_layout layout;	// Positions of quote fields in the file type.
+	struct stock *stocks;	// Generated stocks.
+	char record[BDIN_REGISTER_LENGTH];	// Register being generated.
+	char header[BDIN_REGISTER_LENGTH];	// Header register.
+	char spec[16];	// Stock spec of a quote.
+	char text[32];	// General purpose short ranged text.
+	char root[5];	// Root of the tickers of a company.
+	const char *marker;	// Ex marker of the stock spec of a quote, or "".
+	uint64_t state;	// Pseudo random number generator of stocks.
+	uint64_t day_state;	// Pseudo random number generator of a trading day.
+	uint64_t opening_price, closing_price, minimum_price, maximum_price;	// Prices of a quote.
+	uint64_t total_stocks;	// Traded stocks of a quote.
+	unsigned long register_count;	// How many registers were written.
+	unsigned int register_length;	// Register length of the file type.
+	time_t day;	// Trading day being generated (noon, UTC).
+	struct tm day_tm;	// Calendar date of 'day'.
+	long days_done;	// How many trading days were generated.
+	long i, j;	// General, short ranged indexers.
+
+	/*
+	 * Begin.
+	 */
+
+	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	DEBUG ("start.");
+
+	/*
+	 * Parse command line arguments.
+	 */
+
+	arguments.type = FILE_TYPE_HIST;
+	arguments.stocks = 400;
+	arguments.days = 250;
+	arguments.megabytes = 0;
+	memset (&(arguments.begin), 0, sizeof (struct tm));
+	arguments.begin.tm_year = 110;
+	arguments.begin.tm_mon = 0;
+	arguments.begin.tm_mday = 4;
+	arguments.seed = 1;
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+	if (arguments.type == FILE_TYPE_BDIN) {
+
+		arguments.days = 1;
+
+	}
+	else if (arguments.megabytes != 0) {
+
+		// Each stock makes about 2.3 registers a day (standard and fractional lots, options).
+
+		arguments.days = (arguments.megabytes << 20) / (arguments.stocks * (HIST_REGISTER_LENGTH + 2) * 23 / 10);
+		if (arguments.days < 1) {
+
+			arguments.days = 1;
+
+		}
+
+	}
+	arguments.begin.tm_hour = 12;
+	day = timegm (&(arguments.begin));
+
+	/*
+	 * Register layout of the file type.
+	 */
+
+	if (arguments.type == FILE_TYPE_HIST) {
+
+#define F(FIELD_NAME,FROM,TO) layout.FIELD_NAME.from = FROM; layout.FIELD_NAME.to = TO
+		HIST_QUOTE_FIELDS;
+#undef F
+		layout.type = "01";
+		register_length = HIST_REGISTER_LENGTH;
+
+	}
+	else {
+
+#define F(FIELD_NAME,FROM,TO) layout.FIELD_NAME.from = FROM; layout.FIELD_NAME.to = TO
+		BDIN_QUOTE_FIELDS;
+#undef F
+		layout.type = "02";
+		register_length = BDIN_REGISTER_LENGTH;
+
+	}
+	setvbuf (stdout, NULL, _IOFBF, 0x100000);
+
+	/*
+	 * Generate stocks.
+	 * Stock number i gets a four letter root derived from i, and a class: mostly ON, then PN, then a few UNT.
+	 */
+
+	if ((stocks = (struct stock *) malloc (arguments.stocks * sizeof (struct stock))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", arguments.stocks * sizeof (struct stock));
+		FAILURE;
+
+	}
+	state = (arguments.seed * 0x9E3779B97F4A7C15ULL) | 1;
+	for ( i = 0; i < arguments.stocks; i++ ) {
+
+		for ( j = 3; j >= 0; j-- ) {
+
+			root[j] = 'A' + (char) ((i / ((j == 3) ? 1 : (j == 2) ? 26 : (j == 1) ? 676 : 17576)) % 26);
+
+		}
+		root[4] = 0;
+		switch (random_below (&state, 10)) {
+
+			case 0: case 1: case 2: case 3: case 4: case 5:
+
+				stocks[i].kind = "ON";
+				snprintf (stocks[i].ticker, sizeof (stocks[i].ticker), "%s3", root);
+				snprintf (stocks[i].isin, sizeof (stocks[i].isin), "BR%sACNOR%c", root, (char) ('0' + random_below (&state, 10)));
+				break;
+
+			case 6: case 7: case 8:
+
+				stocks[i].kind = "PN";
+				snprintf (stocks[i].ticker, sizeof (stocks[i].ticker), "%s4", root);
+				snprintf (stocks[i].isin, sizeof (stocks[i].isin), "BR%sACNPR%c", root, (char) ('0' + random_below (&state, 10)));
+				break;
+
+			default:
+
+				stocks[i].kind = "UNT";
+				snprintf (stocks[i].ticker, sizeof (stocks[i].ticker), "%s11", root);
+				snprintf (stocks[i].isin, sizeof (stocks[i].isin), "BR%sCDAM0%c", root, (char) ('0' + random_below (&state, 10)));
+
+		}
+		switch (random_below (&state, 10)) {
+
+			case 0: case 1: case 2: case 3: case 4:
+
+				stocks[i].level = "NM";
+				break;
+
+			case 5:
+
+				stocks[i].level = "N1";
+				break;
+
+			case 6:
+
+				stocks[i].level = "N2";
+				break;
+
+			default:
+
+				stocks[i].level = "";
+
+		}
+		snprintf (stocks[i].name, sizeof (stocks[i].name), "%s S.A.", root);
+		stocks[i].factor = (random_below (&state, 50) == 0) ? 1000 : 1;
+		stocks[i].price = (100 + random_below (&state, 9900)) * stocks[i].factor;
+		stocks[i].options = (random_below (&state, 10) == 0) ? (4 + random_below (&state, 12)) : 0;
+
+	}
+
+	/*
+	 * Header register.
+	 */
+
+	if ((gmtime_r (&day, &day_tm)) == NULL) {
+
+		CRIT ("cannot convert date.");
+		FAILURE;
+
+	}
+	while ((day_tm.tm_wday == 0) || (day_tm.tm_wday == 6)) {
+
+		day += 86400;
+		gmtime_r (&day, &day_tm);
+
+	}
+	memset (record, ' ', register_length);
+	if (arguments.type == FILE_TYPE_HIST) {
+
+		memcpy (record, "00", 2);
+		snprintf (text, sizeof (text), "COTAHIST.%04d", day_tm.tm_year + 1900);
+		field_text (record, (struct field_position) { 3, 15 }, text);
+		field_text (record, (struct field_position) { 16, 23 }, "BOVESPA");
+		strftime (text, sizeof (text), "%Y%m%d", &day_tm);
+		field_text (record, (struct field_position) { 24, 31 }, text);
+
+	}
+	else {
+
+		memcpy (record, "00", 2);
+		field_text (record, (struct field_position) { 3, 10 }, "BDIN9999");
+		field_text (record, (struct field_position) { 11, 18 }, "BOVESPA");
+		field_number (record, (struct field_position) { 19, 22 }, 9999);
+		strftime (text, sizeof (text), "%Y%m%d", &day_tm);
+		field_text (record, (struct field_position) { 23, 30 }, text);
+		field_text (record, (struct field_position) { 31, 38 }, text);
+		field_number (record, (struct field_position) { 39, 42 }, 1900);
+
+	}
+	if ((register_write (record, register_length)) < 0) {
+
+		FAILURE;
+
+	}
+	memcpy (header, record, register_length);
+	register_count = 1;
+
+	/*
+	 * Index summaries (BDIN only; ignored by the import).
+	 */
+
+	if (arguments.type == FILE_TYPE_BDIN) {
+
+		for ( i = 0; i < 16; i++ ) {
+
+			memset (record, ' ', register_length);
+			memcpy (record, "01", 2);
+			snprintf (text, sizeof (text), "IND%03ld", i);
+			field_text (record, (struct field_position) { 3, 4 }, "01");
+			field_text (record, (struct field_position) { 5, 34 }, text);
+			field_number (record, (struct field_position) { 35, 40 }, 50000 + random_below (&state, 50000));
+			if ((register_write (record, register_length)) < 0) {
+
+				FAILURE;
+
+			}
+			register_count++;
+
+		}
+
+	}
+
+	/*
+	 * Quote registers, day by day.
+	 */
+
+	for ( days_done = 0; days_done < arguments.days; ) {
+
+		if ((day_tm.tm_wday == 0) || (day_tm.tm_wday == 6)) {
+
+			day += 86400;
+			gmtime_r (&day, &day_tm);
+			continue;
+
+		}
+		day_state = ((arguments.seed ^ (uint64_t) (day / 86400)) * 0x9E3779B97F4A7C15ULL) | 1;
+		memset (record, ' ', register_length);
+		memcpy (record, layout.type, 2);
+		field_number (record, layout.ano_pregao, day_tm.tm_year + 1900);
+		field_number (record, layout.mes_pregao, day_tm.tm_mon + 1);
+		field_number (record, layout.dia_pregao, day_tm.tm_mday);
+		field_text (record, layout.mod_ref, "R$");
+		for ( i = 0; i < arguments.stocks; i++ ) {
+
+			/*
+			 * Some days go without trades.
+			 */
+
+			if (random_below (&day_state, 40) == 0) {
+
+				continue;
+
+			}
+
+			/*
+			 * Ex markers, and the opening price after inplits and splits.
+			 */
+
+			opening_price = stocks[i].price;
+			marker = "";
+			switch (random_below (&day_state, 2000)) {
+
+				case 0:
+
+					marker = "EB";	// Bonus or split.
+					opening_price = opening_price / (2 + random_below (&day_state, 3));
+					break;
+
+				case 1:
+
+					marker = "EG";	// Grouping.
+					opening_price = opening_price * 10;
+					break;
+
+				case 2: case 3: case 4: case 5: case 6: case 7: case 8: case 9:
+
+					marker = "ED";	// Dividends.
+					opening_price = opening_price - (opening_price / 50);
+					break;
+
+				case 10: case 11: case 12: case 13: case 14: case 15: case 16: case 17:
+
+					marker = "EJ";	// Interest on capital.
+					opening_price = opening_price - (opening_price / 100);
+					break;
+
+			}
+			if (opening_price < 1) {
+
+				opening_price = 1;
+
+			}
+			closing_price = opening_price + (random_below (&day_state, (opening_price / 25) + 1)) - (opening_price / 50);
+			if (closing_price < 1) {
+
+				closing_price = 1;
+
+			}
+			minimum_price = ((opening_price < closing_price) ? opening_price : closing_price);
+			minimum_price -= random_below (&day_state, (minimum_price / 100) + 1);
+			if (minimum_price < 1) {
+
+				minimum_price = 1;
+
+			}
+			maximum_price = ((opening_price > closing_price) ? opening_price : closing_price);
+			maximum_price += random_below (&day_state, (maximum_price / 100) + 1);
+			stocks[i].price = closing_price;
+			total_stocks = (1 + random_below (&day_state, 10000)) * 100;
+			snprintf (spec, sizeof (spec), "%s%s%s%s%s", stocks[i].kind, (*marker != 0) ? " " : "", marker, (*(stocks[i].level) != 0) ? " " : "", stocks[i].level);
+
+			/*
+			 * Standard lot.
+			 */
+
+			field_number (record, layout.cod_bdi, 2);
+			field_text (record, layout.cod_neg, stocks[i].ticker);
+			field_number (record, layout.tp_merc, 10);
+			field_text (record, layout.nom_res, stocks[i].name);
+			field_text (record, layout.especi, spec);
+			field_number (record, layout.pre_abe, opening_price);
+			field_number (record, layout.pre_max, maximum_price);
+			field_number (record, layout.pre_min, minimum_price);
+			field_number (record, layout.pre_med, (minimum_price + maximum_price) / 2);
+			field_number (record, layout.pre_ult, closing_price);
+			field_number (record, layout.pre_ofc, closing_price);
+			field_number (record, layout.pre_ofv, closing_price + 1);
+			field_number (record, layout.tot_neg, 1 + random_below (&day_state, 50000));
+			field_number (record, layout.qua_tot, total_stocks);
+			field_number (record, layout.vol_tot, total_stocks * ((minimum_price + maximum_price) / 2) / stocks[i].factor);
+			field_number (record, layout.pre_exe, 0);
+			field_number (record, layout.ind_opc, 0);
+			field_number (record, layout.dat_ven, 99991231);
+			field_number (record, layout.fat_cot, stocks[i].factor);
+			field_number (record, layout.pto_exe, 0);
+			field_text (record, layout.cod_isi, stocks[i].isin);
+			field_number (record, layout.dis_mes, 100);
+			if ((register_write (record, register_length)) < 0) {
+
+				FAILURE;
+
+			}
+			register_count++;
+
+			/*
+			 * Fractional lot, most days (ignored by the import).
+			 */
+
+			if (random_below (&day_state, 10) < 6) {
+
+				snprintf (text, sizeof (text), "%sF", stocks[i].ticker);
+				field_number (record, layout.cod_bdi, 96);
+				field_text (record, layout.cod_neg, text);
+				field_number (record, layout.tp_merc, 20);
+				field_number (record, layout.qua_tot, total_stocks / 100);
+				field_number (record, layout.vol_tot, (total_stocks / 100) * closing_price / stocks[i].factor);
+				if ((register_write (record, register_length)) < 0) {
+
+					FAILURE;
+
+				}
+				register_count++;
+
+			}
+
+			/*
+			 * Option series (ignored by the import).
+			 */
+
+			for ( j = 0; j < stocks[i].options; j++ ) {
+
+				snprintf (text, sizeof (text), "%.4s%c%03u", stocks[i].ticker, (char) (((j % 2) == 0 ? 'A' : 'M') + day_tm.tm_mon), (unsigned int) (10 + j * 5));
+				field_number (record, layout.cod_bdi, ((j % 2) == 0) ? 78 : 82);
+				field_text (record, layout.cod_neg, text);
+				field_number (record, layout.tp_merc, ((j % 2) == 0) ? 70 : 80);
+				field_number (record, layout.pre_abe, 1 + random_below (&day_state, 500));
+				field_number (record, layout.pre_max, 501 + random_below (&day_state, 500));
+				field_number (record, layout.pre_min, 1);
+				field_number (record, layout.pre_med, 250);
+				field_number (record, layout.pre_ult, 1 + random_below (&day_state, 1000));
+				field_number (record, layout.qua_tot, total_stocks * 10);
+				field_number (record, layout.vol_tot, total_stocks * 2500);
+				field_number (record, layout.pre_exe, (stocks[i].price / stocks[i].factor) * (90 + j * 5) / 100);
+				field_number (record, layout.dat_ven, (day_tm.tm_year + 1900) * 10000 + (day_tm.tm_mon + 1) * 100 + 15);
+				if ((register_write (record, register_length)) < 0) {
+
+					FAILURE;
+
+				}
+				register_count++;
+
+			}
+
+		}
+		days_done++;
+		day += 86400;
+		gmtime_r (&day, &day_tm);
+
+	}
+	free (stocks);
+
+	/*
+	 * Trailer register: the identification of the header, and the register count (header and trailer included).
+	 */
+
+	memcpy (record, header, register_length);
+	memcpy (record, "99", 2);
+	if (arguments.type == FILE_TYPE_HIST) {
+
+		memset (record + 31, ' ', register_length - 31);
+		field_number (record, (struct field_position) { 32, 42 }, register_count + 1);
+
+	}
+	else {
+
+		memset (record + 30, ' ', register_length - 30);
+		field_number (record, (struct field_position) { 31, 39 }, register_count + 1);
+
+	}
+	if ((register_write (record, register_length)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((fflush (stdout)) != 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot write to the standard output.");
+		FAILURE;
+
+	}
+
+	/*
+	 * End.
+	 */
+
+	DEBUG ("%lu registers written.", register_count + 1);
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+uint64_t random_next (uint64_t *state) {
+
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return (*state * 0x2545F4914F6CDD1DULL);
+
+}
+
+
+uint64_t random_below (uint64_t *state, uint64_t limit) {
+
+	return ((limit != 0) ? (random_next (state) % limit) : 0);
+
+}
+
+
+void field_text (char *record, struct field_position position, const char *text) {
+
+	unsigned int i;
+
+	if (position.from == 0) {
+
+		return;
+
+	}
+	for ( i = position.from - 1; i < position.to; i++ ) {
+
+		record[i] = (*text != 0) ? *(text++) : ' ';
+
+	}
+
+}
+
+
+void field_number (char *record, struct field_position position, uint64_t value) {
+
+	unsigned int i;
+
+	if (position.from == 0) {
+
+		return;
+
+	}
+	for ( i = position.to; i >= position.from; i-- ) {
+
+		record[i - 1] = '0' + (char) (value % 10);
+		value /= 10;
+
+	}
+	if (value != 0) {
+
+		memset (record + position.from - 1, '9', position.to - position.from + 1);
+
+	}
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int register_write (const char *record, unsigned int length) {
+
+	if (((fwrite (record, length, 1, stdout)) != 1) || ((fwrite (REGISTER_END, sizeof (REGISTER_END) - 1, 1, stdout)) != 1)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot write to the standard output.");
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
@@ -0,0 +1,571 @@
+/*
+ * history_cache.c
+ * In-process cache of mapped stock histories.
+ *
+ * Entries are reachable by stock id and view (lookups) and by mapped address (releases),
+ * both through chained hash tables. All entries not yet invalidated are kept
+ * in a list ordered by last use; unreferenced entries are unmapped from its
+ * least recently used end whenever mapped octets exceed the configured bound.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <syslog.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+#include <pilot_fish/bovespa.h>
+
+#include "revision_marker.h"
+#include "stock_file.h"
+#include "snapshot.h"
+#include "history_cache.h"
+#include "async_log.h"
+
+
+/*
+ * Number of buckets of each hash table.
+ */
+
+#define CACHE_BUCKETS 0x400
+
+
+/*
+ * Cached mapping of a stock file.
+ */
+
+typedef struct cache_entry cache_entry_t;
+
+struct cache_entry {
+
+	pfish_bovespa_stock_id_t stock_id;	// Stock identification.
+	unsigned int view;	// Stock history view.
+	pfish_bovespa_stock_history_t *history;	// Mapped stock file.
+	struct stat history_stat;	// Status of the stock file at mapping time; mapping length is history_stat.st_size.
+	unsigned int references;	// How many allocated histories point to this mapping.
+	unsigned int stale;	// Nonzero if the stock file was replaced; entry is out of the id table and the use list.
+	unsigned int pinned;	// Nonzero if the stock file was last validated in a pinned generation.
+	uint64_t generation;	// Pinned generation of the last validation.
+	cache_entry_t *id_next;		// Next entry of the same id bucket.
+	cache_entry_t *address_next;	// Next entry of the same address bucket.
+	cache_entry_t *use_prev;	// More recently used entry.
+	cache_entry_t *use_next;	// Less recently used entry.
+
+};
+
+
+/*
+ * Cache state.
+ */
+
+static struct {
+
+	unsigned int enabled;	// Nonzero if cache is enabled.
+	size_t max_mapped_size;	// Bound of mapped octets.
+	size_t mapped_size;	// Mapped octets of all entries.
+	cache_entry_t *by_id[CACHE_BUCKETS];	// Entries by stock id.
+	cache_entry_t *by_address[CACHE_BUCKETS];	// Entries by mapped address.
+	cache_entry_t *use_first;	// Most recently used entry.
+	cache_entry_t *use_last;	// Least recently used entry.
+	pthread_mutex_t mutex;	// Protects all of the above, except 'enabled'.
+
+} cache = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+
+static size_t id_bucket (const pfish_bovespa_stock_id_t *stock_id, unsigned int view) {
+
+	size_t hash;
+	size_t i;
+
+	hash = (2166136261u ^ view) * 16777619u;
+	for ( i = 0; (i < PFISH_BOVESPA_CODNEG_SIZE) && (stock_id->id[i] != 0); i++ ) {
+
+		hash = (hash ^ (unsigned char) stock_id->id[i]) * 16777619u;
+
+	}
+	return (hash % CACHE_BUCKETS);
+
+}
+
+
+static size_t address_bucket (const void *address) {
+
+	return ((((uintptr_t) address) >> 12) % CACHE_BUCKETS);
+
+}
+
+
+static int same_file (const struct stat *a, const struct stat *b) {
+
+	return ((a->st_dev == b->st_dev) && (a->st_ino == b->st_ino) && (a->st_size == b->st_size) && (a->st_mtim.tv_sec == b->st_mtim.tv_sec) && (a->st_mtim.tv_nsec == b->st_mtim.tv_nsec));
+
+}
+
+
+/*
+ * List manipulation; cache mutex must be held.
+ */
+
+static void use_unlink (cache_entry_t *entry) {
+
+	if (entry->use_prev != NULL) {
+
+		entry->use_prev->use_next = entry->use_next;
+
+	}
+	else {
+
+		cache.use_first = entry->use_next;
+
+	}
+	if (entry->use_next != NULL) {
+
+		entry->use_next->use_prev = entry->use_prev;
+
+	}
+	else {
+
+		cache.use_last = entry->use_prev;
+
+	}
+	entry->use_prev = NULL;
+	entry->use_next = NULL;
+
+}
+
+
+static void use_push (cache_entry_t *entry) {
+
+	entry->use_prev = NULL;
+	entry->use_next = cache.use_first;
+	if (cache.use_first != NULL) {
+
+		cache.use_first->use_prev = entry;
+
+	}
+	else {
+
+		cache.use_last = entry;
+
+	}
+	cache.use_first = entry;
+
+}
+
+
+static void id_unlink (cache_entry_t *entry) {
+
+	cache_entry_t **link;
+
+	for ( link = &(cache.by_id[id_bucket (&(entry->stock_id), entry->view)]); *link != NULL; link = &((*link)->id_next) ) {
+
+		if (*link == entry) {
+
+			*link = entry->id_next;
+			break;
+
+		}
+
+	}
+	entry->id_next = NULL;
+
+}
+
+
+static void address_unlink (cache_entry_t *entry) {
+
+	cache_entry_t **link;
+
+	for ( link = &(cache.by_address[address_bucket (entry->history)]); *link != NULL; link = &((*link)->address_next) ) {
+
+		if (*link == entry) {
+
+			*link = entry->address_next;
+			break;
+
+		}
+
+	}
+	entry->address_next = NULL;
+
+}
+
+
+/*
+ * Unmap and forget an unreferenced entry; cache mutex must be held.
+ */
+
+static void entry_drop (cache_entry_t *entry) {
+
+	if (entry->stale == 0) {
+
+		id_unlink (entry);
+		use_unlink (entry);
+
+	}
+	address_unlink (entry);
+	if ((munmap (entry->history, entry->history_stat.st_size)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot memory-unmap stock file of '%s'.", entry->stock_id.id);
+
+	}
+	cache.mapped_size -= entry->history_stat.st_size;
+	free (entry);
+
+}
+
+
+/*
+ * Take an entry out of lookups since its stock file was replaced; cache mutex must be held.
+ * Referenced entries remain mapped until their last release.
+ */
+
+static void entry_invalidate (cache_entry_t *entry) {
+
+	DEBUG ("stock file of '%s' was replaced.", entry->stock_id.id);
+	if (entry->references == 0) {
+
+		entry_drop (entry);
+		return;
+
+	}
+	id_unlink (entry);
+	use_unlink (entry);
+	entry->stale = 1;
+
+}
+
+
+/*
+ * Unmap least recently used, unreferenced entries until the bound is respected; cache mutex must be held.
+ */
+
+static void cache_evict () {
+
+	cache_entry_t *entry;
+	cache_entry_t *prev;
+
+	for ( entry = cache.use_last; (entry != NULL) && (cache.mapped_size > cache.max_mapped_size); entry = prev ) {
+
+		prev = entry->use_prev;
+		if (entry->references == 0) {
+
+			DEBUG ("evicting stock '%s'.", entry->stock_id.id);
+			entry_drop (entry);
+
+		}
+
+	}
+
+}
+
+
+static cache_entry_t *id_find (const pfish_bovespa_stock_id_t *stock_id, unsigned int view) {
+
+	cache_entry_t *entry;
+
+	for ( entry = cache.by_id[id_bucket (stock_id, view)]; entry != NULL; entry = entry->id_next ) {
+
+		if ((entry->view == view) && ((strcmp (entry->stock_id.id, stock_id->id)) == 0)) {
+
+			return (entry);
+
+		}
+
+	}
+	return (NULL);
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int pfish_bovespa_cache_enable (size_t max_mapped_size) {
+
+	if ((pfish_bovespa_revision_marker_check ()) < 0) {
+
+		ALERT ("database revision mismatch; please reinitialize it.");
+		FAILURE;
+
+	}
+	pthread_mutex_lock (&cache.mutex);
+	cache.max_mapped_size = max_mapped_size;
+	cache_evict ();
+	pthread_mutex_unlock (&cache.mutex);
+	cache.enabled = 1;
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_cache_disable () {
+
+	size_t i;
+	cache_entry_t *entry;
+
+	pthread_mutex_lock (&cache.mutex);
+	for ( i = 0; i < CACHE_BUCKETS; i++ ) {
+
+		for ( entry = cache.by_address[i]; entry != NULL; entry = entry->address_next ) {
+
+			if (entry->references != 0) {
+
+				ERR ("cannot disable cache while history of stock '%s' is allocated.", entry->stock_id.id);
+				pthread_mutex_unlock (&cache.mutex);
+				FAILURE;
+
+			}
+
+		}
+
+	}
+	cache.enabled = 0;
+	for ( i = 0; i < CACHE_BUCKETS; i++ ) {
+
+		while (cache.by_address[i] != NULL) {
+
+			entry_drop (cache.by_address[i]);
+
+		}
+
+	}
+	pthread_mutex_unlock (&cache.mutex);
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_cache_enabled () {
+
+	return (cache.enabled);
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+#define HIT return (0)
+#define MISS return (1)
+#define FAILURE return (-1)
+
+int pfish_bovespa_cache_lookup (const pfish_bovespa_stock_id_t *stock_id, unsigned int view, pfish_bovespa_stock_history_t **answer) {
+
+	cache_entry_t *entry;
+	char pathname[PATH_MAX];
+	struct stat current_stat;
+	uint64_t generation;	// Pinned generation, if any.
+	int pinned;	// Nonzero if a generation is pinned.
+	int stat_errno;	// Error of stat(), zero on success.
+
+	/*
+	 * An entry validated in the pinned generation is still valid; answer it from the tables alone.
+	 */
+
+	if ((pinned = ((pfish_bovespa_snapshot_generation (&generation)) == 0)) != 0) {
+
+		pthread_mutex_lock (&cache.mutex);
+		if ((entry = id_find (stock_id, view)) == NULL) {
+
+			pthread_mutex_unlock (&cache.mutex);
+			MISS;
+
+		}
+		if ((entry->pinned != 0) && (entry->generation == generation)) {
+
+			entry->references++;
+			use_unlink (entry);
+			use_push (entry);
+			*answer = entry->history;
+			pthread_mutex_unlock (&cache.mutex);
+			HIT;
+
+		}
+		pthread_mutex_unlock (&cache.mutex);
+
+	}
+
+	/*
+	 * Otherwise revalidate against the stock file, which may have been replaced by an import.
+	 * The file is checked before taking the mutex, so that readers do not serialize on the system call.
+	 */
+
+	if ((pfish_bovespa_stock_file_pathname (stock_id, view, pathname)) < 0) {
+
+		FAILURE;
+
+	}
+	stat_errno = ((stat (pathname, &current_stat)) < 0) ? errno : 0;
+	pthread_mutex_lock (&cache.mutex);
+	if ((entry = id_find (stock_id, view)) == NULL) {
+
+		pthread_mutex_unlock (&cache.mutex);
+		MISS;
+
+	}
+	switch (stat_errno) {
+
+		case 0:
+
+			break;
+
+		case ENOENT:
+
+			entry_invalidate (entry);
+			pthread_mutex_unlock (&cache.mutex);
+			*answer = NULL;
+			HIT;
+
+		default:
+
+			pthread_mutex_unlock (&cache.mutex);
+			errno = stat_errno;
+			ERRNO_ERR;
+			CRIT ("cannot stat file '%s'.", pathname);
+			FAILURE;
+
+	}
+	if ((same_file (&current_stat, &(entry->history_stat))) == 0) {
+
+		entry_invalidate (entry);
+		pthread_mutex_unlock (&cache.mutex);
+		MISS;
+
+	}
+	entry->pinned = pinned;
+	entry->generation = generation;
+	entry->references++;
+	use_unlink (entry);
+	use_push (entry);
+	*answer = entry->history;
+	pthread_mutex_unlock (&cache.mutex);
+	HIT;
+
+}
+
+#undef FAILURE
+#undef MISS
+#undef HIT
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int pfish_bovespa_cache_insert (const pfish_bovespa_stock_id_t *stock_id, unsigned int view, pfish_bovespa_stock_history_t **history, const struct stat *history_stat) {
+
+	cache_entry_t *entry;
+	size_t bucket;
+
+	pthread_mutex_lock (&cache.mutex);
+	if ((entry = id_find (stock_id, view)) != NULL) {
+
+		if ((same_file (history_stat, &(entry->history_stat))) != 0) {
+
+			/*
+			 * Somebody else mapped the same file meanwhile; keep theirs.
+			 */
+
+			entry->references++;
+			use_unlink (entry);
+			use_push (entry);
+			pthread_mutex_unlock (&cache.mutex);
+			if ((munmap (*history, history_stat->st_size)) < 0) {
+
+				ERRNO_ERR;
+				CRIT ("cannot memory-unmap stock file of '%s'.", stock_id->id);
+				FAILURE;
+
+			}
+			*history = entry->history;
+			SUCCESS;
+
+		}
+		entry_invalidate (entry);
+
+	}
+	if ((entry = (cache_entry_t *) malloc (sizeof (cache_entry_t))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", sizeof (cache_entry_t));
+		pthread_mutex_unlock (&cache.mutex);
+		FAILURE;
+
+	}
+	memcpy (&(entry->stock_id), stock_id, sizeof (pfish_bovespa_stock_id_t));
+	entry->view = view;
+	entry->history = *history;
+	memcpy (&(entry->history_stat), history_stat, sizeof (struct stat));
+	entry->references = 1;
+	entry->stale = 0;
+	entry->pinned = ((pfish_bovespa_snapshot_generation (&(entry->generation))) == 0);
+	bucket = id_bucket (stock_id, view);
+	entry->id_next = cache.by_id[bucket];
+	cache.by_id[bucket] = entry;
+	bucket = address_bucket (entry->history);
+	entry->address_next = cache.by_address[bucket];
+	cache.by_address[bucket] = entry;
+	use_push (entry);
+	cache.mapped_size += history_stat->st_size;
+	cache_evict ();
+	pthread_mutex_unlock (&cache.mutex);
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+#define SUCCESS return (0)
+#define NOT_CACHED return (1)
+
+int pfish_bovespa_cache_release (pfish_bovespa_stock_history_t *target) {
+
+	cache_entry_t *entry;
+
+	pthread_mutex_lock (&cache.mutex);
+	for ( entry = cache.by_address[address_bucket (target)]; entry != NULL; entry = entry->address_next ) {
+
+		if (entry->history == target) {
+
+			break;
+
+		}
+
+	}
+	if (entry == NULL) {
+
+		pthread_mutex_unlock (&cache.mutex);
+		NOT_CACHED;
+
+	}
+	if (--(entry->references) == 0) {
+
+		if (entry->stale != 0) {
+
+			entry_drop (entry);
+
+		}
+		else {
+
+			cache_evict ();
+
+		}
+
+	}
+	pthread_mutex_unlock (&cache.mutex);
+	SUCCESS;
+
+}
+
+#undef NOT_CACHED
+#undef SUCCESS
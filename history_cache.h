@@ -0,0 +1,68 @@
+/*
+ * history_cache.h
+ * In-process cache of mapped stock histories.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_HISTORY_CACHE_SEEN
+#define FILE_PFISH_BOVESPA_HISTORY_CACHE_SEEN
+
+#include <sys/stat.h>
+
+#include <pilot_fish/bovespa.h>
+
+
+/*
+ * Check if the cache is enabled.
+ *
+ * @return nonzero if enabled, zero otherwise.
+ */
+
+int pfish_bovespa_cache_enabled ();
+
+
+/*
+ * Look up a stock history in the cache.
+ * A cached history is valid only if its stock file was not replaced since mapping
+ * (same device, inode, size and modification time). Files of a pinned generation are never replaced,
+ * so an entry already validated in the pinned generation is answered without checking its file.
+ * On a hit, the history gains a reference.
+ *
+ * @param[in] stock_id stock identification.
+ * @param[in] view one of PFISH_BOVESPA_VIEW_* values.
+ * @param[out] answer cached stock history on a hit, NULL if the stock file does not exist.
+ *
+ * @return 0 on hit or inexistent stock, positive on miss, negative on failure.
+ */
+
+int pfish_bovespa_cache_lookup (const pfish_bovespa_stock_id_t *stock_id, unsigned int view, pfish_bovespa_stock_history_t **answer);
+
+
+/*
+ * Insert a freshly mapped stock history in the cache.
+ * If another thread inserted the same mapping meanwhile, the fresh mapping is released
+ * and the cached one is answered instead.
+ * The answered history holds one reference.
+ *
+ * @param[in] stock_id stock identification.
+ * @param[in] view one of PFISH_BOVESPA_VIEW_* values.
+ * @param[in,out] history mapped stock history; will contain the cached history.
+ * @param[in] history_stat status of the mapped stock file.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_cache_insert (const pfish_bovespa_stock_id_t *stock_id, unsigned int view, pfish_bovespa_stock_history_t **history, const struct stat *history_stat);
+
+
+/*
+ * Drop a reference of a cached stock history.
+ *
+ * @param[in] target stock history.
+ *
+ * @return 0 on success, positive if target is not cached, negative on failure.
+ */
+
+int pfish_bovespa_cache_release (pfish_bovespa_stock_history_t *target);
+
+
+#endif	// FILE_PFISH_BOVESPA_HISTORY_CACHE_SEEN
@@ -0,0 +1,1314 @@
+/*
+ * history_writer.c
+ * Buffered export of stock histories.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <syslog.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+#include <pilot_fish/bovespa.h>
+
+#include "history_writer.h"
+
+
+/*
+ * Room for the longest row: a JSON object with all field names, a date, an escaped stock identification
+ * and specification, nine 20 digit integers and separators.
+ */
+
+#define ROW_SIZE_MAX 1024
+
+
+/*
+ * A formatted date: up to DATE_SLOT_SIZE - 1 characters, with its length in the last octet.
+ */
+
+#define DATE_SLOT_SIZE 16
+
+#define SECONDS_PER_DAY 86400
+
+
+/*
+ * Exported fields.
+ */
+
+#define FIELD_TYPE_DATE 0	// time_t, exported as a date.
+#define FIELD_TYPE_TEXT 1	// String of PFISH_BOVESPA_ESPECI_SIZE octets.
+#define FIELD_TYPE_UINT16 2	// pfish_uint16_t, exported as unsigned int.
+#define FIELD_TYPE_UINT64 3	// pfish_uint64_t.
+#define FIELD_TYPE_STOCK_ID 4	// Not in the daily quote: identification of the exported stock.
+
+struct field {
+
+	const char *name;	// Name of the field; also the JSON key.
+	size_t name_size;	// strlen (name).
+	size_t offset;	// Offset of the field in a daily quote.
+	size_t size;	// Size of the field in a daily quote.
+	unsigned int type;	// FIELD_TYPE_*.
+	unsigned int mask;	// PFISH_BOVESPA_HISTORY_FIELD_*.
+
+};
+
+#define FIELD(member, type, mask) { #member, sizeof (#member) - 1, offsetof (pfish_bovespa_daily_quote_t, member), sizeof (((pfish_bovespa_daily_quote_t *) NULL)->member), type, mask }
+
+static const struct field fields[] = {
+
+	{ "stock_id", sizeof ("stock_id") - 1, 0, PFISH_BOVESPA_CODNEG_SIZE, FIELD_TYPE_STOCK_ID, PFISH_BOVESPA_HISTORY_FIELD_STOCK_ID },
+	FIELD (trading_date, FIELD_TYPE_DATE, PFISH_BOVESPA_HISTORY_FIELD_TRADING_DATE),
+	FIELD (stock_spec, FIELD_TYPE_TEXT, PFISH_BOVESPA_HISTORY_FIELD_STOCK_SPEC),
+	FIELD (price_factor, FIELD_TYPE_UINT16, PFISH_BOVESPA_HISTORY_FIELD_PRICE_FACTOR),
+	FIELD (opening_price, FIELD_TYPE_UINT64, PFISH_BOVESPA_HISTORY_FIELD_OPENING_PRICE),
+	FIELD (closing_price, FIELD_TYPE_UINT64, PFISH_BOVESPA_HISTORY_FIELD_CLOSING_PRICE),
+	FIELD (minimum_price, FIELD_TYPE_UINT64, PFISH_BOVESPA_HISTORY_FIELD_MINIMUM_PRICE),
+	FIELD (maximum_price, FIELD_TYPE_UINT64, PFISH_BOVESPA_HISTORY_FIELD_MAXIMUM_PRICE),
+	FIELD (average_price, FIELD_TYPE_UINT64, PFISH_BOVESPA_HISTORY_FIELD_AVERAGE_PRICE),
+	FIELD (total_trades, FIELD_TYPE_UINT16, PFISH_BOVESPA_HISTORY_FIELD_TOTAL_TRADES),
+	FIELD (total_stocks, FIELD_TYPE_UINT64, PFISH_BOVESPA_HISTORY_FIELD_TOTAL_STOCKS),
+	FIELD (total_volume, FIELD_TYPE_UINT64, PFISH_BOVESPA_HISTORY_FIELD_TOTAL_VOLUME),
+
+};
+
+#undef FIELD
+
+#define FIELDS_SIZE (sizeof (fields) / sizeof (struct field))
+
+
+struct pfish_bovespa_history_writer {
+
+	FILE *stream;	// Destination of the export.
+	unsigned int format;	// PFISH_BOVESPA_HISTORY_FORMAT_*.
+	unsigned int fields;	// PFISH_BOVESPA_HISTORY_FIELD_* to be exported.
+	pfish_bovespa_stock_id_t stock_id;	// Identification of the stock being exported.
+	char *buffer;	// Formatted rows not yet written; PFISH_BOVESPA_HISTORY_WRITER_BLOCK_SIZE + ROW_SIZE_MAX octets.
+	size_t buffer_size;	// Octets used in 'buffer'.
+	char (*dates)[DATE_SLOT_SIZE];	// Formatted dates, by day number since 'first_day'.
+	long first_day;	// Day number of dates[0].
+	size_t dates_size;	// How many elements in 'dates'.
+
+};
+
+
+/*
+ * Decimal digits of 0 to 99, two characters each.
+ */
+
+static const char digit_pairs[] =
+	"0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+	"5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+
+/*
+ * Day number (days since 1970-01-01, UTC) of a timestamp.
+ */
+
+static long day_number (time_t timestamp) {
+
+	return ((timestamp >= 0) ? (timestamp / SECONDS_PER_DAY) : -((-timestamp + SECONDS_PER_DAY - 1) / SECONDS_PER_DAY));
+
+}
+
+
+/*
+ * Format the date of a day number, as strftime ("%F") would for its UTC timestamp.
+ *
+ * @param[in] day day number.
+ * @param[out] target date slot.
+ */
+
+static void date_format (long day, char *target) {
+
+	long era, year;	// Civil date computation from days (proleptic Gregorian calendar, eras of 400 years).
+	unsigned long day_of_era, year_of_era, day_of_year, month_index;
+	unsigned int month, day_of_month;
+
+	day += 719468;
+	era = ((day >= 0) ? day : (day - 146096)) / 146097;
+	day_of_era = day - (era * 146097);
+	year_of_era = (day_of_era - (day_of_era / 1460) + (day_of_era / 36524) - (day_of_era / 146096)) / 365;
+	day_of_year = day_of_era - ((365 * year_of_era) + (year_of_era / 4) - (year_of_era / 100));
+	month_index = ((5 * day_of_year) + 2) / 153;
+	day_of_month = day_of_year - (((153 * month_index) + 2) / 5) + 1;
+	month = (month_index < 10) ? (month_index + 3) : (month_index - 9);
+	year = year_of_era + (era * 400) + ((month <= 2) ? 1 : 0);
+	target[DATE_SLOT_SIZE - 1] = snprintf (target, DATE_SLOT_SIZE - 1, "%ld-%02u-%02u", year, month, day_of_month);
+
+}
+
+
+/*
+ * Append the decimal representation of an integer.
+ *
+ * @return position after the last digit.
+ */
+
+static char *uint_format (char *cursor, uint64_t value) {
+
+	char digits[20];
+	char *start;
+
+	start = digits + sizeof (digits);
+	while (value >= 100) {
+
+		start -= 2;
+		memcpy (start, &(digit_pairs[2 * (value % 100)]), 2);
+		value /= 100;
+
+	}
+	if (value >= 10) {
+
+		start -= 2;
+		memcpy (start, &(digit_pairs[2 * value]), 2);
+
+	}
+	else {
+
+		*(--start) = '0' + value;
+
+	}
+	memcpy (cursor, start, digits + sizeof (digits) - start);
+	return (cursor + (digits + sizeof (digits) - start));
+
+}
+
+
+/*
+ * Append a string of at most 'size' octets as the contents of a JSON string.
+ * Octets outside ASCII are taken as ISO-8859-1, as in Bovespa files.
+ *
+ * @return position after the last character.
+ */
+
+static char *text_escape (char *cursor, const char *text, size_t size) {
+
+	static const char hex_digits[] = "0123456789abcdef";
+	unsigned char c;
+	size_t i;
+
+	for ( i = 0; (i < size) && ((c = text[i]) != 0); i++ ) {
+
+		if ((c == '"') || (c == '\\')) {
+
+			*(cursor++) = '\\';
+			*(cursor++) = c;
+
+		}
+		else if ((c < 0x20) || (c >= 0x7F)) {
+
+			memcpy (cursor, "\\u00", 4);
+			cursor[4] = hex_digits[c >> 4];
+			cursor[5] = hex_digits[c & 0xF];
+			cursor += 6;
+
+		}
+		else {
+
+			*(cursor++) = c;
+
+		}
+
+	}
+	return (cursor);
+
+}
+
+
+/*
+ * Address of a field of a daily quote, or of the stock identification; text fields are not necessarily terminated.
+ */
+
+static const char *field_address (const pfish_bovespa_history_writer_t *writer, const pfish_bovespa_daily_quote_t *quote, const struct field *field) {
+
+	if (field->type == FIELD_TYPE_STOCK_ID) {
+
+		return (writer->stock_id.id);
+
+	}
+	return (((const char *) quote) + field->offset);
+
+}
+
+
+/*
+ * Value of an integer field of a daily quote.
+ */
+
+static uint64_t field_value (const pfish_bovespa_daily_quote_t *quote, const struct field *field) {
+
+	if (field->type == FIELD_TYPE_UINT16) {
+
+		// As exported since always: unsigned int.
+
+		return ((unsigned int) *((const pfish_uint16_t *) (((const char *) quote) + field->offset)));
+
+	}
+	return (*((const pfish_uint64_t *) (((const char *) quote) + field->offset)));
+
+}
+
+
+/*
+ * Apache Arrow IPC stream encoding.
+ *
+ * Messages are encapsulated as: continuation marker (0xFFFFFFFF), 32 bit size of the metadata,
+ * metadata (a Message flatbuffer, padded to 8 octets), message body.
+ * Flatbuffers are built back to front, as the reference implementation does:
+ * objects are referenced by their distance to the end of the buffer, children are built before parents,
+ * and alignment is relative to the end of the buffer, whose size is rounded up at the end.
+ * Only what the schema and record batches of a stock history need is implemented.
+ */
+
+#define ARROW_CONTINUATION 0xFFFFFFFF
+#define ARROW_ALIGNMENT 8
+
+#define ARROW_METADATA_V5 4	// MetadataVersion.V5.
+#define ARROW_HEADER_SCHEMA 1	// MessageHeader.Schema.
+#define ARROW_HEADER_RECORD_BATCH 3	// MessageHeader.RecordBatch.
+#define ARROW_TYPE_INT 2	// Type.Int.
+#define ARROW_TYPE_UTF8 5	// Type.Utf8.
+#define ARROW_TYPE_DATE 8	// Type.Date.
+#define ARROW_DATE_DAY 0	// DateUnit.DAY.
+
+#define FLATBUFFER_SIZE_MAX 0x2000
+#define FLATBUFFER_FIELDS_MAX 8
+
+struct flatbuffer {
+
+	uint8_t data[FLATBUFFER_SIZE_MAX];	// Contents occupy the last 'size' octets.
+	size_t size;	// Octets built.
+	size_t alignment;	// Largest alignment required so far.
+	unsigned int overflow;	// Not zero if FLATBUFFER_SIZE_MAX was not enough.
+	size_t table;	// 'size' when the table being built was begun.
+	size_t table_fields[FLATBUFFER_FIELDS_MAX];	// References to fields of the table being built, 0 for absent fields.
+	unsigned int table_fields_size;	// Fields of the table being built, present or not.
+
+};
+
+typedef struct flatbuffer flatbuffer_t;
+
+
+/*
+ * Prepend octets.
+ */
+
+static void flatbuffer_bytes (flatbuffer_t *buffer, const void *source, size_t size) {
+
+	if ((buffer->overflow != 0) || (size > (FLATBUFFER_SIZE_MAX - buffer->size))) {
+
+		buffer->overflow = 1;
+		return;
+
+	}
+	buffer->size += size;
+	memcpy (buffer->data + FLATBUFFER_SIZE_MAX - buffer->size, source, size);
+
+}
+
+
+/*
+ * Prepend zeros so that 'size' octets prepended later end up aligned.
+ */
+
+static void flatbuffer_prepare (flatbuffer_t *buffer, size_t alignment, size_t size) {
+
+	static const uint8_t zeros[ARROW_ALIGNMENT] = { 0 };
+
+	if (alignment > buffer->alignment) {
+
+		buffer->alignment = alignment;
+
+	}
+	flatbuffer_bytes (buffer, zeros, (alignment - ((buffer->size + size) % alignment)) % alignment);
+
+}
+
+
+/*
+ * Encode an integer of 'size' octets, little endian.
+ */
+
+static void little_endian (uint8_t *target, uint64_t value, size_t size) {
+
+	size_t i;
+
+	for ( i = 0; i < size; i++ ) {
+
+		target[i] = (uint8_t) (value >> (8 * i));
+
+	}
+
+}
+
+
+/*
+ * Prepend an aligned integer of 'size' octets.
+ *
+ * @return reference to the integer.
+ */
+
+static size_t flatbuffer_scalar (flatbuffer_t *buffer, uint64_t value, size_t size) {
+
+	uint8_t octets[8];
+
+	flatbuffer_prepare (buffer, size, 0);
+	little_endian (octets, value, size);
+	flatbuffer_bytes (buffer, octets, size);
+	return (buffer->size);
+
+}
+
+
+/*
+ * Prepend an offset to a referenced object.
+ *
+ * @return reference to the offset.
+ */
+
+static size_t flatbuffer_offset (flatbuffer_t *buffer, size_t reference) {
+
+	flatbuffer_prepare (buffer, 4, 0);
+	return (flatbuffer_scalar (buffer, buffer->size + 4 - reference, 4));
+
+}
+
+
+/*
+ * Prepend a string.
+ *
+ * @return reference to the string.
+ */
+
+static size_t flatbuffer_string (flatbuffer_t *buffer, const char *string, size_t size) {
+
+	flatbuffer_prepare (buffer, 4, size + 1);
+	flatbuffer_bytes (buffer, "", 1);
+	flatbuffer_bytes (buffer, string, size);
+	return (flatbuffer_scalar (buffer, size, 4));
+
+}
+
+
+/*
+ * Prepend a vector of structures made of pairs of 64 bit integers (FieldNode, Buffer).
+ *
+ * @return reference to the vector.
+ */
+
+static size_t flatbuffer_pairs (flatbuffer_t *buffer, const uint64_t (*pairs)[2], size_t pairs_size) {
+
+	uint8_t octets[16];
+	size_t i;
+
+	flatbuffer_prepare (buffer, 4, pairs_size * sizeof (octets));
+	flatbuffer_prepare (buffer, 8, pairs_size * sizeof (octets));
+	for ( i = pairs_size; i > 0; i-- ) {
+
+		little_endian (octets, pairs[i - 1][0], 8);
+		little_endian (octets + 8, pairs[i - 1][1], 8);
+		flatbuffer_bytes (buffer, octets, sizeof (octets));
+
+	}
+	return (flatbuffer_scalar (buffer, pairs_size, 4));
+
+}
+
+
+/*
+ * Prepend a vector of offsets to referenced objects.
+ *
+ * @return reference to the vector.
+ */
+
+static size_t flatbuffer_offsets (flatbuffer_t *buffer, const size_t *references, size_t references_size) {
+
+	size_t i;
+
+	flatbuffer_prepare (buffer, 4, references_size * 4);
+	for ( i = references_size; i > 0; i-- ) {
+
+		flatbuffer_offset (buffer, references[i - 1]);
+
+	}
+	return (flatbuffer_scalar (buffer, references_size, 4));
+
+}
+
+
+/*
+ * Table building: begin, prepend fields (any order), end.
+ */
+
+static void flatbuffer_table_begin (flatbuffer_t *buffer) {
+
+	memset (buffer->table_fields, 0, sizeof (buffer->table_fields));
+	buffer->table_fields_size = 0;
+	buffer->table = buffer->size;
+
+}
+
+static void flatbuffer_table_field (flatbuffer_t *buffer, unsigned int field, size_t reference) {
+
+	buffer->table_fields[field] = reference;
+	if (field >= buffer->table_fields_size) {
+
+		buffer->table_fields_size = field + 1;
+
+	}
+
+}
+
+#define flatbuffer_table_scalar(buffer, field, value, size) flatbuffer_table_field ((buffer), (field), flatbuffer_scalar ((buffer), (value), (size)))
+#define flatbuffer_table_offset(buffer, field, reference) flatbuffer_table_field ((buffer), (field), flatbuffer_offset ((buffer), (reference)))
+
+/*
+ * @return reference to the table.
+ */
+
+static size_t flatbuffer_table_end (flatbuffer_t *buffer) {
+
+	size_t table;	// Reference to the table.
+	size_t vtable;	// Reference to the vtable of the table.
+	uint8_t octets[4];
+	unsigned int i;
+
+	table = flatbuffer_scalar (buffer, 0, 4);
+	for ( i = buffer->table_fields_size; i > 0; i-- ) {
+
+		flatbuffer_scalar (buffer, (buffer->table_fields[i - 1] != 0) ? (table - buffer->table_fields[i - 1]) : 0, 2);
+
+	}
+	flatbuffer_scalar (buffer, table - buffer->table, 2);
+	vtable = flatbuffer_scalar (buffer, 4 + (2 * buffer->table_fields_size), 2);
+	if (buffer->overflow == 0) {
+
+		little_endian (octets, vtable - table, 4);
+		memcpy (buffer->data + FLATBUFFER_SIZE_MAX - table, octets, 4);
+
+	}
+	return (table);
+
+}
+
+
+/*
+ * Prepend the offset to the root table and round the buffer size up to its alignment.
+ */
+
+static void flatbuffer_finish (flatbuffer_t *buffer, size_t root) {
+
+	flatbuffer_prepare (buffer, (buffer->alignment > ARROW_ALIGNMENT) ? buffer->alignment : ARROW_ALIGNMENT, 4);
+	flatbuffer_offset (buffer, root);
+
+}
+
+
+/*
+ * Prepend a Message table.
+ *
+ * @return reference to the table.
+ */
+
+static size_t arrow_message (flatbuffer_t *buffer, unsigned int header_type, size_t header, uint64_t body_size) {
+
+	flatbuffer_table_begin (buffer);
+	flatbuffer_table_scalar (buffer, 3, body_size, 8);	// bodyLength.
+	flatbuffer_table_offset (buffer, 2, header);	// header.
+	flatbuffer_table_scalar (buffer, 0, ARROW_METADATA_V5, 2);	// version.
+	flatbuffer_table_scalar (buffer, 1, header_type, 1);	// header_type.
+	return (flatbuffer_table_end (buffer));
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+/*
+ * Make the date table span the given days.
+ * The table only grows, so dates of successive histories are formatted once.
+ */
+
+static int dates_prepare (pfish_bovespa_history_writer_t *writer, long first_day, long last_day) {
+
+	char (*dates)[DATE_SLOT_SIZE];
+	size_t dates_size;
+	size_t i;
+
+	if ((writer->dates_size != 0) && (first_day >= writer->first_day) && (last_day < (writer->first_day + (long) writer->dates_size))) {
+
+		SUCCESS;
+
+	}
+	if (writer->dates_size != 0) {
+
+		if (writer->first_day < first_day) {
+
+			first_day = writer->first_day;
+
+		}
+		if ((writer->first_day + (long) writer->dates_size - 1) > last_day) {
+
+			last_day = writer->first_day + writer->dates_size - 1;
+
+		}
+
+	}
+	dates_size = last_day - first_day + 1;
+	if ((dates = malloc (dates_size * DATE_SLOT_SIZE)) == NULL) {
+
+		ALERT ("cannot allocate %zu bytes of heap space.", dates_size * DATE_SLOT_SIZE);
+		FAILURE;
+
+	}
+	for ( i = 0; i < dates_size; i++ ) {
+
+		date_format (first_day + i, dates[i]);
+
+	}
+	free (writer->dates);
+	writer->dates = dates;
+	writer->first_day = first_day;
+	writer->dates_size = dates_size;
+	SUCCESS;
+
+}
+
+
+/*
+ * Write the buffer to the stream.
+ */
+
+static int buffer_write (pfish_bovespa_history_writer_t *writer) {
+
+	if ((writer->buffer_size != 0) && ((fwrite (writer->buffer, writer->buffer_size, 1, writer->stream)) != 1)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot write history export.");
+		FAILURE;
+
+	}
+	writer->buffer_size = 0;
+	SUCCESS;
+
+}
+
+
+/*
+ * Write octets to the stream after the buffer contents.
+ * Large blocks bypass the buffer and stdio altogether.
+ */
+
+static int stream_write (pfish_bovespa_history_writer_t *writer, const void *source, size_t size) {
+
+	size_t done;	// Octets written so far.
+	ssize_t count;	// Octets written by each write().
+	int stream_des;	// File descriptor of the stream, if any.
+
+	if (size < PFISH_BOVESPA_HISTORY_WRITER_BLOCK_SIZE) {
+
+		if ((writer->buffer_size + size) > PFISH_BOVESPA_HISTORY_WRITER_BLOCK_SIZE) {
+
+			if ((buffer_write (writer)) < 0) {
+
+				FAILURE;
+
+			}
+
+		}
+		memcpy (writer->buffer + writer->buffer_size, source, size);
+		writer->buffer_size += size;
+		SUCCESS;
+
+	}
+	if ((buffer_write (writer)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((stream_des = fileno (writer->stream)) < 0) {
+
+		// Memory streams have no file descriptor.
+
+		if ((fwrite (source, size, 1, writer->stream)) != 1) {
+
+			ERRNO_ERR;
+			CRIT ("cannot write history export.");
+			FAILURE;
+
+		}
+		SUCCESS;
+
+	}
+	if ((fflush (writer->stream)) != 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot flush history export.");
+		FAILURE;
+
+	}
+	for ( done = 0; done < size; done += count ) {
+
+		if ((count = write (stream_des, ((const char *) source) + done, size - done)) < 0) {
+
+			ERRNO_ERR;
+			CRIT ("cannot write history export.");
+			FAILURE;
+
+		}
+
+	}
+	SUCCESS;
+
+}
+
+
+/*
+ * Write an encapsulated Arrow message: its metadata, then the first 'body_size' octets of 'body'.
+ */
+
+static int arrow_write (pfish_bovespa_history_writer_t *writer, const flatbuffer_t *metadata, const void *body, size_t body_size) {
+
+	static const uint8_t zeros[ARROW_ALIGNMENT] = { 0 };
+	uint8_t prefix[8];	// Continuation marker and metadata size.
+	size_t padding;	// Zeros after the metadata.
+
+	if (metadata->overflow != 0) {
+
+		CRIT ("cannot encode Arrow message metadata.");
+		FAILURE;
+
+	}
+	padding = (ARROW_ALIGNMENT - (metadata->size % ARROW_ALIGNMENT)) % ARROW_ALIGNMENT;
+	little_endian (prefix, ARROW_CONTINUATION, 4);
+	little_endian (prefix + 4, metadata->size + padding, 4);
+	if (((stream_write (writer, prefix, sizeof (prefix))) < 0) || ((stream_write (writer, metadata->data + FLATBUFFER_SIZE_MAX - metadata->size, metadata->size)) < 0) || ((stream_write (writer, zeros, padding)) < 0)) {
+
+		FAILURE;
+
+	}
+	if ((body_size != 0) && ((stream_write (writer, body, body_size)) < 0)) {
+
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+/*
+ * Write the Arrow schema of the exported fields.
+ */
+
+static int arrow_schema (pfish_bovespa_history_writer_t *writer) {
+
+	flatbuffer_t *buffer;	// Message being built.
+	size_t field_references[FIELDS_SIZE];	// Field tables of the schema.
+	size_t field_references_size;
+	size_t children;	// Empty vector of children, shared by all fields.
+	size_t name, type;
+	size_t schema;
+	uint16_t endianness;	// Endianness.Little (0) or Endianness.Big (1).
+	size_t i;
+
+	if ((buffer = (flatbuffer_t *) calloc (1, sizeof (flatbuffer_t))) == NULL) {
+
+		ALERT ("cannot allocate %zu bytes of heap space.", sizeof (flatbuffer_t));
+		FAILURE;
+
+	}
+	endianness = 1;
+	endianness = (*((uint8_t *) &endianness) == 1) ? 0 : 1;
+	children = flatbuffer_offsets (buffer, NULL, 0);
+	field_references_size = 0;
+	for ( i = 0; i < FIELDS_SIZE; i++ ) {
+
+		if ((writer->fields & fields[i].mask) == 0) {
+
+			continue;
+
+		}
+		flatbuffer_table_begin (buffer);
+		switch (fields[i].type) {
+
+			case FIELD_TYPE_DATE:
+
+				flatbuffer_table_scalar (buffer, 0, ARROW_DATE_DAY, 2);	// unit.
+				break;
+
+			case FIELD_TYPE_TEXT:
+			case FIELD_TYPE_STOCK_ID:
+
+				break;
+
+			default:
+
+				flatbuffer_table_scalar (buffer, 0, (fields[i].type == FIELD_TYPE_UINT16) ? 32 : 64, 4);	// bitWidth.
+				flatbuffer_table_scalar (buffer, 1, 0, 1);	// is_signed.
+
+		}
+		type = flatbuffer_table_end (buffer);
+		name = flatbuffer_string (buffer, fields[i].name, fields[i].name_size);
+		flatbuffer_table_begin (buffer);
+		flatbuffer_table_offset (buffer, 0, name);	// name.
+		flatbuffer_table_offset (buffer, 3, type);	// type.
+		flatbuffer_table_offset (buffer, 5, children);	// children.
+		flatbuffer_table_scalar (buffer, 1, 0, 1);	// nullable.
+		flatbuffer_table_scalar (buffer, 2, (fields[i].type == FIELD_TYPE_DATE) ? ARROW_TYPE_DATE : (((fields[i].type == FIELD_TYPE_TEXT) || (fields[i].type == FIELD_TYPE_STOCK_ID)) ? ARROW_TYPE_UTF8 : ARROW_TYPE_INT), 1);	// type_type.
+		field_references[field_references_size++] = flatbuffer_table_end (buffer);
+
+	}
+	schema = flatbuffer_offsets (buffer, field_references, field_references_size);
+	flatbuffer_table_begin (buffer);
+	flatbuffer_table_offset (buffer, 1, schema);	// fields.
+	flatbuffer_table_scalar (buffer, 0, endianness, 2);	// endianness.
+	schema = flatbuffer_table_end (buffer);
+	flatbuffer_finish (buffer, arrow_message (buffer, ARROW_HEADER_SCHEMA, schema, 0));
+	if ((arrow_write (writer, buffer, NULL, 0)) < 0) {
+
+		free (buffer);
+		FAILURE;
+
+	}
+	free (buffer);
+	SUCCESS;
+
+}
+
+
+/*
+ * Write daily quotes as an Arrow record batch.
+ * Each column is a validity buffer (empty, as nothing is null), an offsets buffer for strings,
+ * and a data buffer; buffers are padded to ARROW_ALIGNMENT octets.
+ */
+
+static int arrow_record_batch (pfish_bovespa_history_writer_t *writer, const pfish_bovespa_stock_history_t *history, size_t first) {
+
+	flatbuffer_t *buffer;	// Message being built.
+	uint64_t nodes[FIELDS_SIZE][2];	// Length and null count of each column.
+	uint64_t buffers[3 * FIELDS_SIZE][2];	// Offset and length of each buffer in the body.
+	size_t nodes_size, buffers_size;
+	uint8_t *body;	// Message body.
+	size_t body_size;
+	size_t rows;	// Daily quotes in the batch.
+	size_t column_size;
+	size_t nodes_reference, buffers_reference, batch;
+	uint8_t *column;
+	const char *text;
+	uint64_t value;
+	size_t i, j;
+
+#define PADDED(size) ((((size) + ARROW_ALIGNMENT - 1) / ARROW_ALIGNMENT) * ARROW_ALIGNMENT)
+
+	/*
+	 * Lay out the body.
+	 */
+
+	rows = history->daily_quotes_size - first;
+	nodes_size = 0;
+	buffers_size = 0;
+	body_size = 0;
+	for ( i = 0; i < FIELDS_SIZE; i++ ) {
+
+		if ((writer->fields & fields[i].mask) == 0) {
+
+			continue;
+
+		}
+		nodes[nodes_size][0] = rows;
+		nodes[nodes_size++][1] = 0;
+		buffers[buffers_size][0] = body_size;
+		buffers[buffers_size++][1] = 0;
+		switch (fields[i].type) {
+
+			case FIELD_TYPE_DATE:
+
+				column_size = rows * sizeof (int32_t);
+				break;
+
+			case FIELD_TYPE_TEXT:
+			case FIELD_TYPE_STOCK_ID:
+
+				buffers[buffers_size][0] = body_size;
+				buffers[buffers_size++][1] = (rows + 1) * sizeof (int32_t);
+				body_size += PADDED ((rows + 1) * sizeof (int32_t));
+				for ( j = first, column_size = 0; j < history->daily_quotes_size; j++ ) {
+
+					column_size += strnlen (field_address (writer, &(history->daily_quotes[j]), &(fields[i])), fields[i].size);
+
+				}
+				break;
+
+			case FIELD_TYPE_UINT16:
+
+				column_size = rows * sizeof (uint32_t);
+				break;
+
+			default:
+
+				column_size = rows * sizeof (uint64_t);
+
+		}
+		buffers[buffers_size][0] = body_size;
+		buffers[buffers_size++][1] = column_size;
+		body_size += PADDED (column_size);
+
+	}
+
+	/*
+	 * Fill the body, column by column.
+	 */
+
+	if ((body = (uint8_t *) calloc (1, body_size + 1)) == NULL) {
+
+		ALERT ("cannot allocate %zu bytes of heap space.", body_size + 1);
+		FAILURE;
+
+	}
+	for ( i = 0, buffers_size = 0; i < FIELDS_SIZE; i++ ) {
+
+		if ((writer->fields & fields[i].mask) == 0) {
+
+			continue;
+
+		}
+		buffers_size++;
+		switch (fields[i].type) {
+
+			case FIELD_TYPE_DATE:
+
+				column = body + buffers[buffers_size++][0];
+				for ( j = first; j < history->daily_quotes_size; j++, column += sizeof (int32_t) ) {
+
+					little_endian (column, (uint32_t) (int32_t) day_number (history->daily_quotes[j].trading_date), sizeof (int32_t));
+
+				}
+				break;
+
+			case FIELD_TYPE_TEXT:
+			case FIELD_TYPE_STOCK_ID:
+
+				column = body + buffers[buffers_size][0];
+				value = 0;
+				little_endian (column, value, sizeof (int32_t));
+				for ( j = first; j < history->daily_quotes_size; j++ ) {
+
+					text = field_address (writer, &(history->daily_quotes[j]), &(fields[i]));
+					column_size = strnlen (text, fields[i].size);
+					memcpy (body + buffers[buffers_size + 1][0] + value, text, column_size);
+					value += column_size;
+					column += sizeof (int32_t);
+					little_endian (column, value, sizeof (int32_t));
+
+				}
+				buffers_size += 2;
+				break;
+
+			default:
+
+				column_size = (fields[i].type == FIELD_TYPE_UINT16) ? sizeof (uint32_t) : sizeof (uint64_t);
+				column = body + buffers[buffers_size++][0];
+				for ( j = first; j < history->daily_quotes_size; j++, column += column_size ) {
+
+					little_endian (column, field_value (&(history->daily_quotes[j]), &(fields[i])), column_size);
+
+				}
+
+		}
+
+	}
+
+	/*
+	 * Describe it.
+	 */
+
+	if ((buffer = (flatbuffer_t *) calloc (1, sizeof (flatbuffer_t))) == NULL) {
+
+		ALERT ("cannot allocate %zu bytes of heap space.", sizeof (flatbuffer_t));
+		free (body);
+		FAILURE;
+
+	}
+	buffers_reference = flatbuffer_pairs (buffer, (const uint64_t (*)[2]) buffers, buffers_size);
+	nodes_reference = flatbuffer_pairs (buffer, (const uint64_t (*)[2]) nodes, nodes_size);
+	flatbuffer_table_begin (buffer);
+	flatbuffer_table_scalar (buffer, 0, rows, 8);	// length.
+	flatbuffer_table_offset (buffer, 1, nodes_reference);	// nodes.
+	flatbuffer_table_offset (buffer, 2, buffers_reference);	// buffers.
+	batch = flatbuffer_table_end (buffer);
+	flatbuffer_finish (buffer, arrow_message (buffer, ARROW_HEADER_RECORD_BATCH, batch, body_size));
+	if ((arrow_write (writer, buffer, body, body_size)) < 0) {
+
+		free (buffer);
+		free (body);
+		FAILURE;
+
+	}
+	free (buffer);
+	free (body);
+	SUCCESS;
+
+#undef PADDED
+
+}
+
+
+/*
+ * Write daily quotes in the raw format.
+ */
+
+static int raw_write (pfish_bovespa_history_writer_t *writer, const pfish_bovespa_stock_history_t *history, size_t first) {
+
+	const pfish_bovespa_daily_quote_t *quote;	// Daily quote being exported.
+	char *cursor;	// Next octet of the buffer.
+	size_t i, j;
+
+	if (writer->fields == PFISH_BOVESPA_HISTORY_FIELDS_ALL) {
+
+		// The records themselves, with no copy besides the kernel's.
+
+		return (stream_write (writer, &(history->daily_quotes[first]), (history->daily_quotes_size - first) * sizeof (pfish_bovespa_daily_quote_t)));
+
+	}
+	cursor = writer->buffer + writer->buffer_size;
+	for ( i = first; i < history->daily_quotes_size; i++ ) {
+
+		quote = &(history->daily_quotes[i]);
+		for ( j = 0; j < FIELDS_SIZE; j++ ) {
+
+			if ((writer->fields & fields[j].mask) != 0) {
+
+				memcpy (cursor, field_address (writer, quote, &(fields[j])), fields[j].size);
+				cursor += fields[j].size;
+
+			}
+
+		}
+		writer->buffer_size = cursor - writer->buffer;
+		if (writer->buffer_size >= PFISH_BOVESPA_HISTORY_WRITER_BLOCK_SIZE) {
+
+			if ((buffer_write (writer)) < 0) {
+
+				FAILURE;
+
+			}
+			cursor = writer->buffer;
+
+		}
+
+	}
+	SUCCESS;
+
+}
+
+
+/*
+ * Write daily quotes in CSV or JSONL format.
+ */
+
+static int text_write (pfish_bovespa_history_writer_t *writer, const pfish_bovespa_stock_history_t *history, size_t first) {
+
+	const pfish_bovespa_daily_quote_t *quote;	// Daily quote being exported.
+	const char *date;	// Formatted trading date of the daily quote.
+	char *cursor;	// Next octet of the buffer.
+	char separator;	// Character before the next field.
+	unsigned int jsonl;	// Not zero for JSONL, zero for CSV.
+	size_t i, j;
+
+	if ((dates_prepare (writer, day_number (history->daily_quotes[first].trading_date), day_number (history->daily_quotes[history->daily_quotes_size - 1].trading_date))) < 0) {
+
+		FAILURE;
+
+	}
+	jsonl = (writer->format == PFISH_BOVESPA_HISTORY_FORMAT_JSONL) ? 1 : 0;
+	cursor = writer->buffer + writer->buffer_size;
+	for ( i = first; i < history->daily_quotes_size; i++ ) {
+
+		quote = &(history->daily_quotes[i]);
+		separator = (jsonl != 0) ? '{' : 0;
+		for ( j = 0; j < FIELDS_SIZE; j++ ) {
+
+			if ((writer->fields & fields[j].mask) == 0) {
+
+				continue;
+
+			}
+			if (separator != 0) {
+
+				*(cursor++) = separator;
+
+			}
+			separator = ',';
+			if (jsonl != 0) {
+
+				*(cursor++) = '"';
+				memcpy (cursor, fields[j].name, fields[j].name_size);
+				cursor += fields[j].name_size;
+				*(cursor++) = '"';
+				*(cursor++) = ':';
+
+			}
+			switch (fields[j].type) {
+
+				case FIELD_TYPE_DATE:
+
+					date = writer->dates[day_number (quote->trading_date) - writer->first_day];
+					if (jsonl != 0) {
+
+						*(cursor++) = '"';
+
+					}
+					memcpy (cursor, date, DATE_SLOT_SIZE);
+					cursor += date[DATE_SLOT_SIZE - 1];
+					if (jsonl != 0) {
+
+						*(cursor++) = '"';
+
+					}
+					break;
+
+				case FIELD_TYPE_TEXT:
+				case FIELD_TYPE_STOCK_ID:
+
+					if (jsonl != 0) {
+
+						*(cursor++) = '"';
+						cursor = text_escape (cursor, field_address (writer, quote, &(fields[j])), fields[j].size);
+						*(cursor++) = '"';
+
+					}
+					else {
+
+						cursor += strnlen (memcpy (cursor, field_address (writer, quote, &(fields[j])), fields[j].size), fields[j].size);
+
+					}
+					break;
+
+				default:
+
+					cursor = uint_format (cursor, field_value (quote, &(fields[j])));
+
+			}
+
+		}
+		if (jsonl != 0) {
+
+			*(cursor++) = '}';
+
+		}
+		*(cursor++) = '\n';
+		writer->buffer_size = cursor - writer->buffer;
+		if (writer->buffer_size >= PFISH_BOVESPA_HISTORY_WRITER_BLOCK_SIZE) {
+
+			if ((buffer_write (writer)) < 0) {
+
+				FAILURE;
+
+			}
+			cursor = writer->buffer;
+
+		}
+
+	}
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_history_writer_format (const char *name, unsigned int *answer) {
+
+	if ((strcmp (name, "csv")) == 0) {
+
+		*answer = PFISH_BOVESPA_HISTORY_FORMAT_CSV;
+
+	}
+	else if ((strcmp (name, "raw")) == 0) {
+
+		*answer = PFISH_BOVESPA_HISTORY_FORMAT_RAW;
+
+	}
+	else if ((strcmp (name, "arrow")) == 0) {
+
+		*answer = PFISH_BOVESPA_HISTORY_FORMAT_ARROW;
+
+	}
+	else if ((strcmp (name, "jsonl")) == 0) {
+
+		*answer = PFISH_BOVESPA_HISTORY_FORMAT_JSONL;
+
+	}
+	else {
+
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_history_writer_fields (const char *list, unsigned int *answer) {
+
+	const char *name;	// Name being parsed.
+	size_t name_size;
+	size_t i;
+
+	*answer = 0;
+	for ( name = list; ; name += name_size + 1 ) {
+
+		name_size = strcspn (name, ",");
+		for ( i = 0; (i < FIELDS_SIZE) && ((fields[i].name_size != name_size) || ((strncmp (fields[i].name, name, name_size)) != 0)); i++ );
+		if (i >= FIELDS_SIZE) {
+
+			FAILURE;
+
+		}
+		*answer |= fields[i].mask;
+		if (name[name_size] == 0) {
+
+			break;
+
+		}
+
+	}
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_history_writer_alloc (FILE *stream, unsigned int format, unsigned int fields, pfish_bovespa_history_writer_t **answer) {
+
+	pfish_bovespa_history_writer_t *writer;
+
+	if ((fields & (PFISH_BOVESPA_HISTORY_FIELDS_ALL | PFISH_BOVESPA_HISTORY_FIELD_STOCK_ID)) == 0) {
+
+		CRIT ("no fields to be exported.");
+		FAILURE;
+
+	}
+	if ((writer = (pfish_bovespa_history_writer_t *) calloc (1, sizeof (pfish_bovespa_history_writer_t))) == NULL) {
+
+		ALERT ("cannot allocate %zu bytes of heap space.", sizeof (pfish_bovespa_history_writer_t));
+		FAILURE;
+
+	}
+	if ((writer->buffer = (char *) malloc (PFISH_BOVESPA_HISTORY_WRITER_BLOCK_SIZE + ROW_SIZE_MAX)) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", PFISH_BOVESPA_HISTORY_WRITER_BLOCK_SIZE + ROW_SIZE_MAX);
+		free (writer);
+		FAILURE;
+
+	}
+	writer->stream = stream;
+	writer->format = format;
+	writer->fields = fields & (PFISH_BOVESPA_HISTORY_FIELDS_ALL | PFISH_BOVESPA_HISTORY_FIELD_STOCK_ID);
+	*answer = writer;
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_history_writer_begin (pfish_bovespa_history_writer_t *writer) {
+
+	if (writer->format == PFISH_BOVESPA_HISTORY_FORMAT_ARROW) {
+
+		return (arrow_schema (writer));
+
+	}
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_history_writer_write (pfish_bovespa_history_writer_t *writer, const pfish_bovespa_stock_id_t *stock_id, const pfish_bovespa_stock_history_t *history, size_t first) {
+
+	if (first >= history->daily_quotes_size) {
+
+		SUCCESS;
+
+	}
+	if (stock_id != NULL) {
+
+		writer->stock_id = *stock_id;
+
+	}
+	else {
+
+		memset (writer->stock_id.id, 0, PFISH_BOVESPA_CODNEG_SIZE);
+
+	}
+	switch (writer->format) {
+
+		case PFISH_BOVESPA_HISTORY_FORMAT_RAW:
+
+			return (raw_write (writer, history, first));
+
+		case PFISH_BOVESPA_HISTORY_FORMAT_ARROW:
+
+			return (arrow_record_batch (writer, history, first));
+
+		default:
+
+			return (text_write (writer, history, first));
+
+	}
+
+}
+
+
+int pfish_bovespa_history_writer_flush (pfish_bovespa_history_writer_t *writer) {
+
+	if ((buffer_write (writer)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((fflush (writer->stream)) != 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot flush history export.");
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+int pfish_bovespa_history_writer_end (pfish_bovespa_history_writer_t *writer) {
+
+	uint8_t end[8];	// Arrow end of stream marker.
+
+	if (writer->format == PFISH_BOVESPA_HISTORY_FORMAT_ARROW) {
+
+		little_endian (end, ARROW_CONTINUATION, 4);
+		little_endian (end + 4, 0, 4);
+		if ((stream_write (writer, end, sizeof (end))) < 0) {
+
+			FAILURE;
+
+		}
+
+	}
+	return (pfish_bovespa_history_writer_flush (writer));
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void pfish_bovespa_history_writer_free (pfish_bovespa_history_writer_t *target) {
+
+	free (target->buffer);
+	free (target->dates);
+	free (target);
+
+}
@@ -0,0 +1,173 @@
+/*
+ * history_writer.h
+ * Buffered export of stock histories.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_HISTORY_WRITER_SEEN
+#define FILE_PFISH_BOVESPA_HISTORY_WRITER_SEEN
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <pilot_fish/bovespa.h>
+
+
+/*
+ * A buffered writer of stock histories.
+ *
+ * Rows are formatted straight into a large buffer, without stdio conversions:
+ * integers digit pair by digit pair, and trading dates copied from a table of
+ * "YYYY-MM-DD" strings indexed by day number, built once for the span of dates seen.
+ * The buffer goes to the stream in blocks of PFISH_BOVESPA_HISTORY_WRITER_BLOCK_SIZE octets.
+ */
+
+typedef struct pfish_bovespa_history_writer pfish_bovespa_history_writer_t;
+
+#define PFISH_BOVESPA_HISTORY_WRITER_BLOCK_SIZE 0x40000
+
+
+/*
+ * Export formats.
+ *
+ * PFISH_BOVESPA_HISTORY_FORMAT_CSV: one line per daily quote, fields separated by commas.
+ * PFISH_BOVESPA_HISTORY_FORMAT_JSONL: one JSON object per daily quote and line, keyed by field name;
+ * trading dates, stock identifications and specifications are strings, everything else is an integer.
+ * PFISH_BOVESPA_HISTORY_FORMAT_RAW: daily quotes as stored in the database (struct pfish_bovespa_daily_quote,
+ * native byte order and alignment), written straight from the history without formatting;
+ * with a projection of fields, only the selected structure members (and the stock identification as
+ * PFISH_BOVESPA_CODNEG_SIZE octets), packed with no padding.
+ * PFISH_BOVESPA_HISTORY_FORMAT_ARROW: an Apache Arrow IPC stream: a schema, then one record batch
+ * per exported history. Trading dates are date32 (days since 1970-01-01), stock identifications and specifications are utf8,
+ * price factor and total trades are uint32, and everything else is uint64. No field is nullable.
+ */
+
+#define PFISH_BOVESPA_HISTORY_FORMAT_CSV 0
+#define PFISH_BOVESPA_HISTORY_FORMAT_RAW 1
+#define PFISH_BOVESPA_HISTORY_FORMAT_ARROW 2
+#define PFISH_BOVESPA_HISTORY_FORMAT_JSONL 3
+
+
+/*
+ * Exported fields, or'ed together for a projection; fields are always exported in this order.
+ * Names of fields are the names of the corresponding members of struct pfish_bovespa_daily_quote,
+ * except for 'stock_id': the identification of the exported stock, which tells stocks apart in a combined export.
+ * PFISH_BOVESPA_HISTORY_FIELDS_ALL are all members of the daily quote.
+ */
+
+#define PFISH_BOVESPA_HISTORY_FIELD_STOCK_ID 0x800	// Exported first.
+#define PFISH_BOVESPA_HISTORY_FIELD_TRADING_DATE 0x001
+#define PFISH_BOVESPA_HISTORY_FIELD_STOCK_SPEC 0x002
+#define PFISH_BOVESPA_HISTORY_FIELD_PRICE_FACTOR 0x004
+#define PFISH_BOVESPA_HISTORY_FIELD_OPENING_PRICE 0x008
+#define PFISH_BOVESPA_HISTORY_FIELD_CLOSING_PRICE 0x010
+#define PFISH_BOVESPA_HISTORY_FIELD_MINIMUM_PRICE 0x020
+#define PFISH_BOVESPA_HISTORY_FIELD_MAXIMUM_PRICE 0x040
+#define PFISH_BOVESPA_HISTORY_FIELD_AVERAGE_PRICE 0x080
+#define PFISH_BOVESPA_HISTORY_FIELD_TOTAL_TRADES 0x100
+#define PFISH_BOVESPA_HISTORY_FIELD_TOTAL_STOCKS 0x200
+#define PFISH_BOVESPA_HISTORY_FIELD_TOTAL_VOLUME 0x400
+#define PFISH_BOVESPA_HISTORY_FIELDS_ALL 0x7FF
+
+
+/*
+ * Parse the name of an export format: 'csv', 'raw', 'arrow' or 'jsonl'.
+ *
+ * @param[in] name name of the format.
+ * @param[out] answer one of PFISH_BOVESPA_HISTORY_FORMAT_*.
+ *
+ * @return 0 on success, negative if the name is unknown.
+ */
+
+int pfish_bovespa_history_writer_format (const char *name, unsigned int *answer);
+
+
+/*
+ * Parse a comma separated list of field names.
+ *
+ * @param[in] list list of field names.
+ * @param[out] answer PFISH_BOVESPA_HISTORY_FIELD_* of the listed fields, or'ed together.
+ *
+ * @return 0 on success, negative if a name is unknown or the list is empty.
+ */
+
+int pfish_bovespa_history_writer_fields (const char *list, unsigned int *answer);
+
+
+/*
+ * Allocate a history writer.
+ * A complete export is: pfish_bovespa_history_writer_begin(), any number of pfish_bovespa_history_writer_write(),
+ * then pfish_bovespa_history_writer_end(). Exports of several writers may be concatenated into one stream
+ * by writing and flushing only, between the begin and end of another writer of the same format and fields.
+ *
+ * @param[in] stream destination of the export.
+ * @param[in] format one of PFISH_BOVESPA_HISTORY_FORMAT_*.
+ * @param[in] fields PFISH_BOVESPA_HISTORY_FIELD_* to be exported, or'ed together.
+ * @param[out] answer history writer. Caller must pfish_bovespa_history_writer_free() it after use.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_history_writer_alloc (FILE *stream, unsigned int format, unsigned int fields, pfish_bovespa_history_writer_t **answer);
+
+
+/*
+ * Begin an export: write the stream preamble of the format, if any (the Arrow schema).
+ *
+ * @param[in] writer history writer.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_history_writer_begin (pfish_bovespa_history_writer_t *writer);
+
+
+/*
+ * Export daily quotes of a stock history.
+ * With all fields in CSV format, each line holds: trading date (YYYY-MM-DD), stock specification,
+ * price factor, opening price, closing price, minimum price, maximum price, average price,
+ * total trades, total stocks, total volume.
+ *
+ * @param[in] writer history writer.
+ * @param[in] stock_id identification of the stock (or ISIN code) of the history, for the 'stock_id' field; may be NULL.
+ * @param[in] history stock history.
+ * @param[in] first index of the first daily quote to be exported.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_history_writer_write (pfish_bovespa_history_writer_t *writer, const pfish_bovespa_stock_id_t *stock_id, const pfish_bovespa_stock_history_t *history, size_t first);
+
+
+/*
+ * Write everything buffered to the stream, and flush the stream.
+ *
+ * @param[in] writer history writer.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_history_writer_flush (pfish_bovespa_history_writer_t *writer);
+
+
+/*
+ * End an export: write the end of stream marker of the format, if any (the Arrow end of stream),
+ * then flush as pfish_bovespa_history_writer_flush().
+ *
+ * @param[in] writer history writer.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_history_writer_end (pfish_bovespa_history_writer_t *writer);
+
+
+/*
+ * Release a history writer; buffered data not flushed is lost.
+ *
+ * @param[in] target history writer.
+ */
+
+void pfish_bovespa_history_writer_free (pfish_bovespa_history_writer_t *target);
+
+
+#endif	// FILE_PFISH_BOVESPA_HISTORY_WRITER_SEEN
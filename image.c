@@ -0,0 +1,199 @@
+/*
+ * image.c
+ * Shared memory database image functions.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+#include <pilot_fish/bovespa.h>
+
+#include "revision_marker.h"
+#include "image.h"
+#include "async_log.h"
+
+
+const image_header_t *pfish_bovespa_image = NULL;
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int pfish_bovespa_image_attach () {
+
+	int image_des;	// Shared memory object descriptor.
+	struct stat image_stat;	// Investigation about the shared memory object.
+	image_header_t *image;	// Mapped image.
+	char *revision_marker_content;	// Expected revision marker content.
+
+	if (pfish_bovespa_image != NULL) {
+
+		WARNING ("database image already attached.");
+		SUCCESS;
+
+	}
+
+	/*
+	 * Map the whole image.
+	 */
+
+	if ((image_des = shm_open (IMAGE_SHM_NAME, O_RDONLY, 0)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open shared memory object '%s'.", IMAGE_SHM_NAME);
+		FAILURE;
+
+	}
+	if ((fstat (image_des, &image_stat)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot stat shared memory object '%s'.", IMAGE_SHM_NAME);
+		close (image_des);
+		FAILURE;
+
+	}
+	if (image_stat.st_size < sizeof (image_header_t)) {
+
+		CRIT ("shared memory object '%s' is too small to hold a database image.", IMAGE_SHM_NAME);
+		close (image_des);
+		FAILURE;
+
+	}
+	if ((image = (image_header_t *) mmap (NULL, image_stat.st_size, PROT_READ, MAP_SHARED, image_des, 0)) == (image_header_t *) (-1)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot memory-map shared memory object '%s'.", IMAGE_SHM_NAME);
+		close (image_des);
+		FAILURE;
+
+	}
+	if ((close (image_des)) < 0) {
+
+		ERRNO_ERR;
+		WARNING ("cannot close file descriptor '%d'.", image_des);
+
+	}
+
+#define FREE \
+	munmap (image, image_stat.st_size)
+
+	/*
+	 * Validate the image.
+	 */
+
+	if ((memcmp (image->magic, IMAGE_MAGIC, IMAGE_MAGIC_SIZE)) != 0) {
+
+		ERR ("database image is incomplete or unknown.");
+		FREE;
+		FAILURE;
+
+	}
+	if (image->image_size != image_stat.st_size) {
+
+		ERR ("database image size mismatch (header = %lu, object = %lu).", (unsigned long) image->image_size, (unsigned long) image_stat.st_size);
+		FREE;
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_revision_marker_content_alloc (&revision_marker_content)) < 0) {
+
+		CRIT ("cannot build expected revision marker content.");
+		FREE;
+		FAILURE;
+
+	}
+	if ((strncmp (image->revision_marker, revision_marker_content, IMAGE_REVISION_MARKER_SIZE)) != 0) {
+
+		ALERT ("database image revision mismatch; please reload it.");
+		free (revision_marker_content);
+		FREE;
+		FAILURE;
+
+	}
+	free (revision_marker_content);
+
+#undef FREE
+
+	/*
+	 * All set.
+	 */
+
+	pfish_bovespa_image = image;
+	DEBUG ("database image attached (%lu stocks).", (unsigned long) image->directory_size);
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_image_detach () {
+
+	if (pfish_bovespa_image == NULL) {
+
+		SUCCESS;
+
+	}
+	if ((munmap ((void *) pfish_bovespa_image, pfish_bovespa_image->image_size)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot memory-unmap database image.");
+		FAILURE;
+
+	}
+	pfish_bovespa_image = NULL;
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+static int image_entry_compare (const void *a, const void *b) {
+
+#define A ((const image_entry_t *) a)
+#define B ((const image_entry_t *) b)
+
+	if (A->view != B->view) {
+
+		return ((A->view < B->view) ? -1 : 1);
+
+	}
+	return (strcmp (A->stock_id.id, B->stock_id.id));
+
+#undef B
+#undef A
+
+}
+
+
+const image_entry_t *pfish_bovespa_image_lookup (const pfish_bovespa_stock_id_t *stock_id, unsigned int view) {
+
+	image_entry_t key;
+
+	key.view = view;
+	memcpy (&(key.stock_id), stock_id, sizeof (pfish_bovespa_stock_id_t));
+	return ((const image_entry_t *) bsearch (&key, pfish_bovespa_image->directory, pfish_bovespa_image->directory_size, sizeof (image_entry_t), image_entry_compare));
+
+}
+
+
+int pfish_bovespa_image_contains (const void *address) {
+
+	if (pfish_bovespa_image == NULL) {
+
+		return (0);
+
+	}
+	return (((const char *) address >= (const char *) pfish_bovespa_image) && ((const char *) address < (const char *) pfish_bovespa_image + pfish_bovespa_image->image_size));
+
+}
@@ -0,0 +1,111 @@
+/*
+ * image.h
+ * Shared memory database image layout and functions.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_IMAGE_SEEN
+#define FILE_PFISH_BOVESPA_IMAGE_SEEN
+
+#include <stddef.h>
+
+#include <pilot_fish/bovespa.h>
+
+
+/*
+ * Name of the POSIX shared memory object holding the database image.
+ */
+
+#define IMAGE_SHM_NAME "/pfish_bovespa"
+
+
+/*
+ * Magic string of a complete image.
+ * It is the last thing written by the image loader,
+ * so a partially built image is never attached.
+ */
+
+#define IMAGE_MAGIC "PFBVIMG1"
+#define IMAGE_MAGIC_SIZE 8
+
+
+/*
+ * Room for the database revision marker content inside the image header.
+ */
+
+#define IMAGE_REVISION_MARKER_SIZE 0x100
+
+
+/*
+ * Stock file contents are placed at offsets aligned to this many octets.
+ */
+
+#define IMAGE_ALIGNMENT 0x40
+
+#define IMAGE_ALIGN(SIZE) (((SIZE) + IMAGE_ALIGNMENT - 1) & ~((size_t) (IMAGE_ALIGNMENT - 1)))
+
+
+/*
+ * Directory entry of the image; one per stock file of each view.
+ */
+
+struct image_entry {
+
+	unsigned int view;	// Stock history view.
+	pfish_bovespa_stock_id_t stock_id;	// Stock identification.
+	size_t offset;	// Offset of the stock file contents from the start of the image.
+	size_t size;	// Size of the stock file contents.
+
+};
+
+typedef struct image_entry image_entry_t;
+
+
+/*
+ * Image header, followed by the directory.
+ * Stock file contents follow the directory.
+ */
+
+struct image_header {
+
+	char magic[IMAGE_MAGIC_SIZE];	// IMAGE_MAGIC when the image is complete.
+	char revision_marker[IMAGE_REVISION_MARKER_SIZE];	// Database revision marker content, null terminated.
+	size_t image_size;	// Size of the whole image.
+	size_t directory_size;	// How many elements in directory[].
+	image_entry_t directory[];	// Elements are ordered (view, stock id, ascending); raw view entries come first.
+
+};
+
+typedef struct image_header image_header_t;
+
+
+/*
+ * Currently attached image, NULL if none.
+ */
+
+extern const image_header_t *pfish_bovespa_image;
+
+
+/*
+ * Find a stock in the attached image.
+ *
+ * @param[in] stock_id stock identification.
+ * @param[in] view one of PFISH_BOVESPA_VIEW_* values.
+ *
+ * @return directory entry of the stock, NULL if stock is not in the image.
+ */
+
+const image_entry_t *pfish_bovespa_image_lookup (const pfish_bovespa_stock_id_t *stock_id, unsigned int view);
+
+
+/*
+ * Check if a memory area belongs to the attached image.
+ *
+ * @param[in] address start of the memory area.
+ *
+ * @return nonzero if address lies inside the attached image, zero otherwise.
+ */
+
+int pfish_bovespa_image_contains (const void *address);
+
+
+#endif	// FILE_PFISH_BOVESPA_IMAGE_SEEN
@@ -0,0 +1,386 @@
+/*
+ * image_load.c
+ *
+ * Build a shared memory image of the pilot_fish bovespa database.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <argp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+#include <pilot_fish/bovespa.h>
+
+#include "revision_marker.h"
+#include "image.h"
+#include "stock_file.h"
+#include "async_log.h"
+
+
+/*
+ * Command line argument parsing.
+ */
+
+const char *argp_program_version = PACKAGE_VERSION;
+const char *argp_program_bug_address = PACKAGE_BUGREPORT;
+
+static char doc[] = "pfish_bovespa_image_load -- build a shared memory image of the pilot_fish bovespa database.\vThis routine copies all stock files of the database into one read-only POSIX shared memory object, so that many reader processes can attach to it (see pfish_bovespa_image_attach()) instead of opening stock files.\n\nThe image is a snapshot; reload it after importing Bovespa files.\n";
+
+static struct argp_option options[] = {
+
+	{"unload", 'u', 0, 0, "remove the database image instead of building it.", 0 },
+	{ 0 }
+
+};
+
+struct arguments {
+
+	unsigned int unload;
+
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+
+	switch (key) {
+
+		case 'u':
+
+			arguments->unload = 1;
+			break;
+
+		case ARGP_KEY_ARG:
+
+			argp_usage (state);
+			break;
+
+		default:
+
+			return (ARGP_ERR_UNKNOWN);
+
+	};
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, NULL, doc };
+
+
+/*
+ * Read exactly entry->size octets of a stock file into the image.
+ *
+ * @param[in] entry directory entry of the stock file.
+ * @param[out] target where to put the stock file contents.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int read_stock_file (const image_entry_t *entry, char *target);
+
+
+/*
+ * The portal.
+ */
+
+#define SUCCESS return (EXIT_SUCCESS)
+#define FAILURE return (EXIT_FAILURE)
+
+int main (int argc, char **argv) {
+
+	struct arguments arguments;	// Arguments given in the command line.
+
+	pfish_bovespa_stock_list_t *stocks;	// Stock list.
+	char stock_pathname[PATH_MAX];	// Pathname of a stock file.
+	struct stat stock_stat;	// Investigation about a stock file.
+
+	char *revision_marker_content;	// Revision marker content of the database.
+	size_t image_size;	// Size of the image.
+	image_entry_t *entries;	// Directory of the image.
+	size_t entries_size;	// How many elements in entries[].
+	size_t view;	// Index of pfish_bovespa_stock_file_views[].
+	int image_des;	// Shared memory object descriptor.
+	image_header_t *image;	// Mapped image.
+
+	size_t i;	// General, short ranged indexer.
+
+	/*
+	 * Begin.
+	 */
+
+	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	pfish_bovespa_log_level_from_env ();
+	DEBUG ("start.");
+
+	/*
+	 * Parse command line arguments.
+	 */
+
+	arguments.unload = 0;
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+	/*
+	 * From now on, log messages are written by a background thread.
+	 */
+
+	pfish_bovespa_log_start ();
+
+	/*
+	 * Get rid of any previous image.
+	 * Processes already attached to it keep their mappings.
+	 */
+
+	if ((shm_unlink (IMAGE_SHM_NAME)) < 0) {
+
+		switch (errno) {
+
+			case ENOENT:
+
+				break;
+
+			default:
+
+				ERRNO_ERR;
+				CRIT ("cannot remove shared memory object '%s'.", IMAGE_SHM_NAME);
+				FAILURE;
+
+		}
+
+	}
+	if (arguments.unload != 0) {
+
+		INFO ("database image removed.");
+		SUCCESS;
+
+	}
+
+	/*
+	 * Retrieve the stock list from database.
+	 * The image is built from one database generation, even if an import runs meanwhile.
+	 */
+
+	if ((pfish_bovespa_snapshot_pin ()) < 0) {
+
+		CRIT ("cannot pin a database snapshot.");
+		FAILURE;
+
+	}
+	if ((stocks = pfish_bovespa_stock_list_alloc ()) == NULL) {
+
+		CRIT ("cannot retrieve stock list from database.");
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_revision_marker_content_alloc (&revision_marker_content)) < 0) {
+
+		CRIT ("cannot build revision marker content.");
+		FAILURE;
+
+	}
+	if ((strlen (revision_marker_content)) >= IMAGE_REVISION_MARKER_SIZE) {
+
+		CRIT ("revision marker content does not fit in image header.");
+		FAILURE;
+
+	}
+
+	/*
+	 * Find out the image layout: stock files of every view, raw view first.
+	 */
+
+	if ((entries = (image_entry_t *) malloc (STOCK_FILE_VIEWS_SIZE * stocks->stock_list_size * sizeof (image_entry_t))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", STOCK_FILE_VIEWS_SIZE * stocks->stock_list_size * sizeof (image_entry_t));
+		FAILURE;
+
+	}
+	entries_size = 0;
+	for ( view = 0; view < STOCK_FILE_VIEWS_SIZE; view++ ) {
+
+		for ( i = 0; i < stocks->stock_list_size; i++ ) {
+
+			if ((pfish_bovespa_stock_file_pathname (&(stocks->stock_list[i]), pfish_bovespa_stock_file_views[view], stock_pathname)) < 0) {
+
+				FAILURE;
+
+			}
+			if ((stat (stock_pathname, &stock_stat)) < 0) {
+
+				if ((errno == ENOENT) && (pfish_bovespa_stock_file_views[view] != PFISH_BOVESPA_VIEW_RAW)) {
+
+					continue;
+
+				}
+				ERRNO_ERR;
+				CRIT ("cannot stat file '%s'.", stock_pathname);
+				FAILURE;
+
+			}
+			entries[entries_size].view = pfish_bovespa_stock_file_views[view];
+			memcpy (&(entries[entries_size].stock_id), &(stocks->stock_list[i]), sizeof (pfish_bovespa_stock_id_t));
+			entries[entries_size].size = stock_stat.st_size;
+			entries_size++;
+
+		}
+
+	}
+	image_size = IMAGE_ALIGN (sizeof (image_header_t) + (entries_size * sizeof (image_entry_t)));
+	for ( i = 0; i < entries_size; i++ ) {
+
+		entries[i].offset = image_size;
+		image_size += IMAGE_ALIGN (entries[i].size);
+
+	}
+	DEBUG ("image size = %lu", (unsigned long) image_size);
+
+	/*
+	 * Create the shared memory object.
+	 */
+
+	if ((image_des = shm_open (IMAGE_SHM_NAME, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot create shared memory object '%s'.", IMAGE_SHM_NAME);
+		FAILURE;
+
+	}
+	if ((ftruncate (image_des, image_size)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot resize shared memory object '%s' to %lu octets.", IMAGE_SHM_NAME, (unsigned long) image_size);
+		shm_unlink (IMAGE_SHM_NAME);
+		FAILURE;
+
+	}
+	if ((image = (image_header_t *) mmap (NULL, image_size, PROT_READ | PROT_WRITE, MAP_SHARED, image_des, 0)) == (image_header_t *) (-1)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot memory-map shared memory object '%s'.", IMAGE_SHM_NAME);
+		shm_unlink (IMAGE_SHM_NAME);
+		FAILURE;
+
+	}
+	if ((close (image_des)) < 0) {
+
+		ERRNO_ERR;
+		WARNING ("cannot close file descriptor '%d'.", image_des);
+
+	}
+
+	/*
+	 * Fill header, directory and stock file contents.
+	 * The magic string goes last.
+	 */
+
+	memset (image->magic, 0, IMAGE_MAGIC_SIZE);
+	memset (image->revision_marker, 0, IMAGE_REVISION_MARKER_SIZE);
+	strcpy (image->revision_marker, revision_marker_content);
+	image->image_size = image_size;
+	image->directory_size = entries_size;
+	memcpy (image->directory, entries, entries_size * sizeof (image_entry_t));
+	for ( i = 0; i < entries_size; i++ ) {
+
+		if ((read_stock_file (&(entries[i]), (char *) image + entries[i].offset)) < 0) {
+
+			CRIT ("cannot copy stock '%s' to the database image.", entries[i].stock_id.id);
+			shm_unlink (IMAGE_SHM_NAME);
+			FAILURE;
+
+		}
+
+	}
+	__sync_synchronize ();
+	memcpy (image->magic, IMAGE_MAGIC, IMAGE_MAGIC_SIZE);
+
+	/*
+	 * Resource releasing.
+	 */
+
+	if ((munmap (image, image_size)) < 0) {
+
+		ERRNO_ERR;
+		WARNING ("cannot memory-unmap database image.");
+
+	}
+	free (revision_marker_content);
+	free (entries);
+
+	/*
+	 * End.
+	 */
+
+	INFO ("database image of %lu stocks (%lu octets) loaded.", (unsigned long) stocks->stock_list_size, (unsigned long) image_size);
+	free (stocks);
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int read_stock_file (const image_entry_t *entry, char *target) {
+
+	char stock_pathname[PATH_MAX];	// Pathname of the stock file.
+	int stock_des;	// Stock file descriptor.
+	struct stat stock_stat;	// Investigation about the stock file.
+	ssize_t count;	// Octets read at each pass.
+	size_t done;	// Octets read so far.
+
+	if ((pfish_bovespa_stock_file_pathname (&(entry->stock_id), entry->view, stock_pathname)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((stock_des = open (stock_pathname, O_RDONLY)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s'.", stock_pathname);
+		FAILURE;
+
+	}
+	if (((fstat (stock_des, &stock_stat)) < 0) || (stock_stat.st_size != entry->size)) {
+
+		ERR ("file '%s' changed while building the image; please retry.", stock_pathname);
+		close (stock_des);
+		FAILURE;
+
+	}
+	for ( done = 0; done < entry->size; done += count ) {
+
+		if ((count = read (stock_des, target + done, entry->size - done)) <= 0) {
+
+			if (count < 0) {
+
+				ERRNO_ERR;
+
+			}
+			CRIT ("cannot read file '%s'.", stock_pathname);
+			close (stock_des);
+			FAILURE;
+
+		}
+
+	}
+	close (stock_des);
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
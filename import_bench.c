@@ -0,0 +1,697 @@
+/*
+ * import_bench.c
+ *
+ * End to end benchmark of imports into the pilot_fish bovespa database.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <argp.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+#include <pilot_fish/bovespa.h>
+
+
+/*
+ * Command line argument parsing.
+ */
+
+const char *argp_program_version = PACKAGE_VERSION;
+const char *argp_program_bug_address = PACKAGE_BUGREPORT;
+
+static char doc[] = "pfish_bovespa_import_bench -- end to end benchmark of imports into the pilot_fish bovespa database.\vThis routine generates synthetic Bovespa files with pfish_bovespa_generate, imports them with pfish_bovespa_file_import, and writes the measures to the standard output as JSON, for comparison between builds. Runs are: 'hist_empty', a COTAHIST file of DAYS trading days into an empty database; 'hist_populated', a COTAHIST file of the following DAYS trading days on top of it; and 'bdin_populated', a BDIN file of the next trading session on top of both.\n\nEach run measures octets and registers of the file, stock files written, elapsed time and peak resident set size of the import.\n\nThe database is reinitialized (all its contents are lost). This routine refuses to run on a database holding stocks unless forced; benchmark with a build configured with its own --localstatedir.\n";
+
+static struct argp_option options[] = {
+
+	{"stocks", 's', "STOCKS",  0, "quote STOCKS stocks (default: 400).", 0 },
+	{"days", 'd', "DAYS",  0, "cover DAYS trading days in each COTAHIST file (default: 250).", 0 },
+	{"seed", 'r', "SEED",  0, "generate files with SEED (default: 1).", 0 },
+	{"bindir", 'B', "DIR",  0, "run programs found in DIR (default: current directory).", 0 },
+	{"work-dir", 'w', "DIR",  0, "keep generated files in DIR while running (default: '" P_tmpdir "').", 0 },
+	{"label", 'l', "LABEL",  0, "tag the measures with LABEL (the build being measured, for instance).", 0 },
+	{"force", 'f', 0,  0, "run even if the database holds stocks.", 0 },
+	{ 0 }
+
+};
+
+struct arguments {
+
+	long stocks;
+	long days;
+	unsigned long seed;
+	char *bindir;
+	char *work_dir;
+	char *label;
+	unsigned int force;
+
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+	char *aux_charp;
+
+	switch (key) {
+
+		case 's':
+
+			arguments->stocks = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->stocks < 1)) {
+
+				argp_error (state, "invalid number of stocks '%s'.", arg);
+
+			}
+			break;
+
+		case 'd':
+
+			arguments->days = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->days < 1)) {
+
+				argp_error (state, "invalid number of days '%s'.", arg);
+
+			}
+			break;
+
+		case 'r':
+
+			arguments->seed = strtoul (arg, &aux_charp, 10);
+			if (*aux_charp != 0) {
+
+				argp_error (state, "invalid seed '%s'.", arg);
+
+			}
+			break;
+
+		case 'B':
+
+			arguments->bindir = arg;
+			break;
+
+		case 'w':
+
+			arguments->work_dir = arg;
+			break;
+
+		case 'l':
+
+			for ( aux_charp = arg; *aux_charp != 0; aux_charp++ ) {
+
+				if ((*aux_charp < ' ') || (*aux_charp == '"') || (*aux_charp == '\\')) {
+
+					argp_error (state, "invalid label '%s': control characters, quotes and backslashes are not allowed.", arg);
+
+				}
+
+			}
+			arguments->label = arg;
+			break;
+
+		case 'f':
+
+			arguments->force = 1;
+			break;
+
+		case ARGP_KEY_ARG:
+
+			argp_usage (state);
+			break;
+
+		default:
+
+			return (ARGP_ERR_UNKNOWN);
+
+	};
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, 0, doc };
+
+
+#define GENERATE_NAME "pfish_bovespa_generate"
+#define DATABASE_INIT_NAME "pfish_bovespa_database_init"
+#define FILE_IMPORT_NAME "pfish_bovespa_file_import"
+#define FIRST_DATE "20100104"	// A Monday.
+
+
+/*
+ * Measures of an import.
+ */
+
+struct measure {
+
+	const char *name;	// Name of the run.
+	off_t bytes;	// Size of the imported file.
+	unsigned long registers;	// Registers (lines) of the imported file.
+	unsigned long stock_files;	// Stock files written by the import.
+	double seconds;	// Elapsed time of the import.
+	long peak_rss;	// Peak resident set size of the import, in kilobytes.
+
+};
+
+
+/*
+ * State of the stock files of the database.
+ */
+
+struct stock_state {
+
+	pfish_bovespa_stock_id_t stock_id;
+	ino_t ino;
+	struct timespec mtime;
+
+};
+
+
+/*
+ * Run a program and wait for it.
+ *
+ * @param[in] argv program (argv[0]) and its arguments, NULL terminated.
+ * @param[in] input pathname of the standard input of the program, NULL to inherit.
+ * @param[in] output pathname of the standard output of the program (truncated), NULL to inherit.
+ * @param[out] seconds elapsed time of the program; may be NULL.
+ * @param[out] peak_rss peak resident set size of the program, in kilobytes; may be NULL.
+ *
+ * @return 0 if the program exited successfully, negative otherwise.
+ */
+
+int program_run (char *const argv[], const char *input, const char *output, double *seconds, long *peak_rss);
+
+
+/*
+ * Take the state of the stock files of the database.
+ *
+ * @param[out] answer states, ordered by stock id. Caller must free() it after use.
+ * @param[out] answer_size how many elements in 'answer'.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int stock_states_alloc (struct stock_state **answer, size_t *answer_size);
+
+
+/*
+ * Import a file, and measure the import.
+ *
+ * @param[in] bindir directory of the programs.
+ * @param[in] pathname pathname of the file.
+ * @param[in,out] measure measures (all but the name are filled).
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int import_measure (const char *bindir, const char *pathname, struct measure *measure);
+
+
+/*
+ * Format a date some trading weeks after FIRST_DATE, as YYYYMMDD.
+ *
+ * @param[in] days trading days to skip; whole weeks are skipped, so that the date is past the skipped days.
+ * @param[out] buffer formatted date (at least 9 octets).
+ */
+
+void date_after (long days, char *buffer);
+
+
+/*
+ * The portal.
+ */
+
+#define SUCCESS return (EXIT_SUCCESS)
+#define FAILURE return (EXIT_FAILURE)
+
+int main (int argc, char **argv) {
+
+	struct arguments arguments;	// Arguments given in the command line.
+	pfish_bovespa_stock_list_t *stock_list;	// Stocks of the database.
+	struct measure measures[3];	// Measures of each run.
+	char pathname[PATH_MAX];	// Pathname of the generated file.
+	char program[PATH_MAX];	// Pathname of a program.
+	char stocks[32], days[32], seed[32], begin[16];	// Arguments of the generator.
+	char *program_argv[16];	// Arguments of a program.
+	int des;
+	size_t i;
+
+	/*
+	 * Begin.
+	 */
+
+	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	DEBUG ("start.");
+
+	/*
+	 * Parse command line arguments.
+	 */
+
+	arguments.stocks = 400;
+	arguments.days = 250;
+	arguments.seed = 1;
+	arguments.bindir = ".";
+	arguments.work_dir = P_tmpdir;
+	arguments.label = "";
+	arguments.force = 0;
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+	/*
+	 * Refuse to destroy a database holding stocks.
+	 */
+
+	if ((stock_list = pfish_bovespa_stock_list_alloc ()) != NULL) {
+
+		if ((stock_list->stock_list_size != 0) && (arguments.force == 0)) {
+
+			CRIT ("database '%s' holds %u stocks; benchmarks reinitialize it (use --force to run anyway).", DBPATH, stock_list->stock_list_size);
+			free (stock_list);
+			FAILURE;
+
+		}
+		free (stock_list);
+
+	}
+
+	/*
+	 * Start with an empty database.
+	 */
+
+#define PROGRAM(NAME) \
+	if ((snprintf (program, PATH_MAX, "%s/%s", arguments.bindir, NAME)) >= PATH_MAX) { \
+		CRIT ("pathname of program '%s' is too big.", NAME); \
+		FAILURE; \
+	}
+
+	PROGRAM (DATABASE_INIT_NAME);
+	program_argv[0] = program;
+	program_argv[1] = "-f";
+	program_argv[2] = NULL;
+	if ((program_run (program_argv, NULL, NULL, NULL, NULL)) < 0) {
+
+		CRIT ("cannot initialize the database.");
+		FAILURE;
+
+	}
+	if ((snprintf (pathname, PATH_MAX, "%s/pfish_bovespa_bench.XXXXXX", arguments.work_dir)) >= PATH_MAX) {
+
+		CRIT ("pathname of work directory '%s' is too big.", arguments.work_dir);
+		FAILURE;
+
+	}
+	if ((des = mkstemp (pathname)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot create file in '%s'.", arguments.work_dir);
+		FAILURE;
+
+	}
+	close (des);
+
+	/*
+	 * Runs.
+	 */
+
+	snprintf (stocks, sizeof (stocks), "%ld", arguments.stocks);
+	snprintf (days, sizeof (days), "%ld", arguments.days);
+	snprintf (seed, sizeof (seed), "%lu", arguments.seed);
+	for ( i = 0; i < 3; i++ ) {
+
+		switch (i) {
+
+			case 0:
+
+				measures[i].name = "hist_empty";
+				strcpy (begin, FIRST_DATE);
+				break;
+
+			case 1:
+
+				measures[i].name = "hist_populated";
+				date_after (arguments.days, begin);
+				break;
+
+			default:
+
+				measures[i].name = "bdin_populated";
+				date_after (arguments.days * 2, begin);
+
+		}
+		PROGRAM (GENERATE_NAME);
+		program_argv[0] = program;
+		program_argv[1] = "--type";
+		program_argv[2] = (i < 2) ? "hist" : "bdin";
+		program_argv[3] = "--stocks";
+		program_argv[4] = stocks;
+		program_argv[5] = "--days";
+		program_argv[6] = days;
+		program_argv[7] = "--begin";
+		program_argv[8] = begin;
+		program_argv[9] = "--seed";
+		program_argv[10] = seed;
+		program_argv[11] = NULL;
+		if ((program_run (program_argv, NULL, pathname, NULL, NULL)) < 0) {
+
+			CRIT ("cannot generate file for run '%s'.", measures[i].name);
+			unlink (pathname);
+			FAILURE;
+
+		}
+		if ((import_measure (arguments.bindir, pathname, &(measures[i]))) < 0) {
+
+			CRIT ("cannot measure run '%s'.", measures[i].name);
+			unlink (pathname);
+			FAILURE;
+
+		}
+		INFO ("%s: %.3f seconds.", measures[i].name, measures[i].seconds);
+
+	}
+	unlink (pathname);
+
+#undef PROGRAM
+
+	/*
+	 * Report.
+	 */
+
+	printf ("{\n");
+	printf ("\t\"label\": \"%s\",\n", arguments.label);
+	printf ("\t\"version\": \"%s\",\n", PACKAGE_VERSION);
+	printf ("\t\"stocks\": %ld,\n", arguments.stocks);
+	printf ("\t\"days\": %ld,\n", arguments.days);
+	printf ("\t\"seed\": %lu,\n", arguments.seed);
+	printf ("\t\"runs\": [\n");
+	for ( i = 0; i < 3; i++ ) {
+
+#define RATE(X) ((measures[i].seconds > 0) ? ((double) (X) / measures[i].seconds) : 0)
+
+		printf ("\t\t{\n");
+		printf ("\t\t\t\"name\": \"%s\",\n", measures[i].name);
+		printf ("\t\t\t\"bytes\": %lld,\n", (long long) measures[i].bytes);
+		printf ("\t\t\t\"registers\": %lu,\n", measures[i].registers);
+		printf ("\t\t\t\"stock_files\": %lu,\n", measures[i].stock_files);
+		printf ("\t\t\t\"seconds\": %.6f,\n", measures[i].seconds);
+		printf ("\t\t\t\"megabytes_per_second\": %.3f,\n", RATE (measures[i].bytes) / 1048576);
+		printf ("\t\t\t\"registers_per_second\": %.1f,\n", RATE (measures[i].registers));
+		printf ("\t\t\t\"stock_files_per_second\": %.1f,\n", RATE (measures[i].stock_files));
+		printf ("\t\t\t\"peak_rss_kilobytes\": %ld\n", measures[i].peak_rss);
+		printf ("\t\t}%s\n", (i < 2) ? "," : "");
+
+#undef RATE
+
+	}
+	printf ("\t]\n");
+	printf ("}\n");
+	if ((fflush (stdout)) != 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot write to the standard output.");
+		FAILURE;
+
+	}
+
+	/*
+	 * End.
+	 */
+
+	DEBUG ("end.");
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int program_run (char *const argv[], const char *input, const char *output, double *seconds, long *peak_rss) {
+
+	struct timespec start, stop;	// Elapsed time measurement.
+	struct rusage usage;	// Resource usage of the program.
+	pid_t pid;	// Process of the program.
+	int status;	// Exit status of the program.
+	int des;
+
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	if ((pid = fork ()) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot fork.");
+		FAILURE;
+
+	}
+	if (pid == 0) {
+
+		if (input != NULL) {
+
+			if (((des = open (input, O_RDONLY)) < 0) || ((dup2 (des, STDIN_FILENO)) < 0)) {
+
+				ERRNO_ERR;
+				CRIT ("cannot open file '%s'.", input);
+				_exit (127);
+
+			}
+			close (des);
+
+		}
+		if (output != NULL) {
+
+			if (((des = open (output, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) || ((dup2 (des, STDOUT_FILENO)) < 0)) {
+
+				ERRNO_ERR;
+				CRIT ("cannot open file '%s'.", output);
+				_exit (127);
+
+			}
+			close (des);
+
+		}
+		execv (argv[0], argv);
+		ERRNO_ERR;
+		CRIT ("cannot run program '%s'.", argv[0]);
+		_exit (127);
+
+	}
+	while ((wait4 (pid, &status, 0, &usage)) < 0) {
+
+		if (errno != EINTR) {
+
+			ERRNO_ERR;
+			CRIT ("cannot wait for program '%s'.", argv[0]);
+			FAILURE;
+
+		}
+
+	}
+	clock_gettime (CLOCK_MONOTONIC, &stop);
+	if ((!WIFEXITED (status)) || (WEXITSTATUS (status) != EXIT_SUCCESS)) {
+
+		ERR ("program '%s' failed (status %d).", argv[0], status);
+		FAILURE;
+
+	}
+	if (seconds != NULL) {
+
+		*seconds = (stop.tv_sec - start.tv_sec) + ((stop.tv_nsec - start.tv_nsec) / 1e9);
+
+	}
+	if (peak_rss != NULL) {
+
+		*peak_rss = usage.ru_maxrss;
+
+	}
+	SUCCESS;
+
+}
+
+
+int stock_states_alloc (struct stock_state **answer, size_t *answer_size) {
+
+	pfish_bovespa_stock_list_t *stock_list;	// Stocks of the database.
+	struct stock_state *states;	// The answer.
+	char pathname[PATH_MAX];	// Pathname of a stock file.
+	struct stat stock_stat;	// Status of a stock file.
+	size_t i;
+
+	if ((stock_list = pfish_bovespa_stock_list_alloc ()) == NULL) {
+
+		CRIT ("cannot retrieve stock list from database.");
+		FAILURE;
+
+	}
+	if ((states = (struct stock_state *) malloc ((stock_list->stock_list_size + 1) * sizeof (struct stock_state))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (stock_list->stock_list_size + 1) * sizeof (struct stock_state));
+		free (stock_list);
+		FAILURE;
+
+	}
+	for ( i = 0; i < stock_list->stock_list_size; i++ ) {
+
+		states[i].stock_id = stock_list->stock_list[i];
+		if ((snprintf (pathname, PATH_MAX, "%s/%s", DBPATH, stock_list->stock_list[i].id)) >= PATH_MAX) {
+
+			CRIT ("pathname of stock '%s' is too big.", stock_list->stock_list[i].id);
+			free (states);
+			free (stock_list);
+			FAILURE;
+
+		}
+		if ((stat (pathname, &stock_stat)) < 0) {
+
+			ERRNO_ERR;
+			CRIT ("cannot stat file '%s'.", pathname);
+			free (states);
+			free (stock_list);
+			FAILURE;
+
+		}
+		states[i].ino = stock_stat.st_ino;
+		states[i].mtime = stock_stat.st_mtim;
+
+	}
+	*answer_size = stock_list->stock_list_size;
+	*answer = states;
+	free (stock_list);
+	SUCCESS;
+
+}
+
+
+int import_measure (const char *bindir, const char *pathname, struct measure *measure) {
+
+	struct stock_state *before, *after;	// Stock files before and after the import.
+	size_t before_size, after_size;	// How many elements in 'before' and 'after'.
+	char program[PATH_MAX];	// Pathname of the import program.
+	char *program_argv[2];	// Arguments of the import program.
+	char buffer[0x10000];	// Reads of the imported file.
+	struct stat file_stat;	// Status of the imported file.
+	size_t count;	// Octets read.
+	FILE *stream;
+	size_t i, j;
+	int compare;
+
+	/*
+	 * Size of the file.
+	 */
+
+	if ((stream = fopen (pathname, "r")) == NULL) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s'.", pathname);
+		FAILURE;
+
+	}
+	if ((fstat (fileno (stream), &file_stat)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot stat file '%s'.", pathname);
+		fclose (stream);
+		FAILURE;
+
+	}
+	measure->bytes = file_stat.st_size;
+	measure->registers = 0;
+	while ((count = fread (buffer, 1, sizeof (buffer), stream)) != 0) {
+
+		for ( i = 0; i < count; i++ ) {
+
+			measure->registers += (buffer[i] == '\n');
+
+		}
+
+	}
+	fclose (stream);
+
+	/*
+	 * Import.
+	 */
+
+	if ((snprintf (program, PATH_MAX, "%s/%s", bindir, FILE_IMPORT_NAME)) >= PATH_MAX) {
+
+		CRIT ("pathname of program '%s' is too big.", FILE_IMPORT_NAME);
+		FAILURE;
+
+	}
+	if ((stock_states_alloc (&before, &before_size)) < 0) {
+
+		FAILURE;
+
+	}
+	program_argv[0] = program;
+	program_argv[1] = NULL;
+	if ((program_run (program_argv, pathname, NULL, &(measure->seconds), &(measure->peak_rss))) < 0) {
+
+		CRIT ("cannot import file '%s'.", pathname);
+		free (before);
+		FAILURE;
+
+	}
+	if ((stock_states_alloc (&after, &after_size)) < 0) {
+
+		free (before);
+		FAILURE;
+
+	}
+
+	/*
+	 * Stock files written: new ones, and those replaced (imports rename new stock files into place).
+	 */
+
+	measure->stock_files = 0;
+	for ( i = 0, j = 0; i < after_size; i++ ) {
+
+		compare = 1;
+		while ((j < before_size) && ((compare = strcmp (before[j].stock_id.id, after[i].stock_id.id)) < 0)) {
+
+			j++;
+
+		}
+		if ((compare != 0) || (before[j].ino != after[i].ino) || (before[j].mtime.tv_sec != after[i].mtime.tv_sec) || (before[j].mtime.tv_nsec != after[i].mtime.tv_nsec)) {
+
+			measure->stock_files++;
+
+		}
+
+	}
+	free (after);
+	free (before);
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void date_after (long days, char *buffer) {
+
+	struct tm date;	// Calendar date.
+	time_t day;	// Date as time.
+
+	memset (&date, 0, sizeof (struct tm));
+	date.tm_year = 110;
+	date.tm_mon = 0;
+	date.tm_mday = 4;
+	date.tm_hour = 12;
+	day = timegm (&date) + (((days + 4) / 5) * 7 * 86400);
+	gmtime_r (&day, &date);
+	strftime (buffer, 9, "%Y%m%d", &date);
+
+}
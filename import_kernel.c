@@ -0,0 +1,619 @@
+/*
+ * import_kernel.c
+ * Kernels of imports of Bovespa files: parsing of registers, lists of quotes, and merging of histories.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <assert.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+#include <pilot_fish/bovespa.h>
+
+#include "ticker_dictionary.h"
+#include "import_kernel.h"
+#include "metrics.h"
+#include "tracepoints.h"
+#include "async_log.h"
+
+
+uint32_t *pfish_bovespa_quote_ticker_ranks;
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+
+int pfish_bovespa_discover_file_type (const char *header_register, unsigned int *answer) {
+
+	if ((memcmp (header_register, "00COTAHIST", 10)) == 0) {
+
+		*answer = BOVESPA_FILE_TYPE_HIST;
+		SUCCESS;
+
+	}
+	else if ((memcmp (header_register, "00BDIN9999", 10)) == 0) {
+
+		*answer = BOVESPA_FILE_TYPE_BDIN;
+		SUCCESS;
+
+	}
+	else {
+
+		CRIT ("unknown bovespa file type.");
+		FAILURE;
+	}
+
+}
+
+
+int pfish_bovespa_discover_register_type (unsigned int file_type, const char *bovespa_register, unsigned int *answer) {
+
+	/* 
+	 * Match the type code field of the Bovespa register to a type code.
+	 */
+
+#define COMPARE_WITH(STRING) memcmp (bovespa_register, STRING, 2)
+
+	switch (file_type) {
+
+		case BOVESPA_FILE_TYPE_HIST:
+
+			if ((COMPARE_WITH ("00")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_HEADER;
+				SUCCESS;
+
+			}
+			else if ((COMPARE_WITH ("01")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_QUOTES;
+				SUCCESS;
+
+			}
+			else if ((COMPARE_WITH ("99")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_TRAILER;
+				SUCCESS;
+
+			}
+			else {
+
+				ERR ("unknown bovespa type field value '%c%c' for file type '%u'.", bovespa_register[0], bovespa_register[1], file_type);
+				FAILURE;
+
+			}
+			break;
+
+		case BOVESPA_FILE_TYPE_BDIN:
+
+			if ((COMPARE_WITH ("00")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_HEADER;
+				SUCCESS;
+
+			}
+			else if ((COMPARE_WITH ("01")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_OTHER;
+				SUCCESS;
+
+			}
+			else if ((COMPARE_WITH ("02")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_QUOTES;
+				SUCCESS;
+
+			}
+			else if ((COMPARE_WITH ("03")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_OTHER;
+				SUCCESS;
+
+			}
+			else if ((COMPARE_WITH ("04")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_OTHER;
+				SUCCESS;
+
+			}
+			else if ((COMPARE_WITH ("05")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_OTHER;
+				SUCCESS;
+
+			}
+			else if ((COMPARE_WITH ("06")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_OTHER;
+				SUCCESS;
+
+			}
+			else if ((COMPARE_WITH ("07")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_OTHER;
+				SUCCESS;
+
+			}
+			else if ((COMPARE_WITH ("99")) == 0) {
+
+				*answer = BOVESPA_FILE_SECTION_TRAILER;
+				SUCCESS;
+
+			}
+			else {
+
+				ERR ("unknown bovespa type field value '%c%c' for file type '%u'.", bovespa_register[0], bovespa_register[1], file_type);
+				FAILURE;
+
+			}
+			break;
+
+		default:
+
+			CRIT ("unknown bovespa file type '%u'.", file_type);
+			FAILURE;
+
+	}
+
+#undef COMPARE_WITH
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int pfish_bovespa_mapper_bind (unsigned int file_type, union bovespa_header_register *header_register, union bovespa_quote_register *quote_register, bovespa_mapper_t *answer) {
+
+	switch (file_type) {
+
+		case BOVESPA_FILE_TYPE_HIST:
+
+			answer->ano_pregao = quote_register->hist.ano_pregao;
+			answer->mes_pregao = quote_register->hist.mes_pregao;
+			answer->dia_pregao = quote_register->hist.dia_pregao;
+			answer->cod_bdi = quote_register->hist.cod_bdi;
+			answer->cod_neg = quote_register->hist.cod_neg;
+			answer->tp_merc = quote_register->hist.tp_merc;
+			answer->nom_res = quote_register->hist.nom_res;
+			answer->especi = quote_register->hist.especi;
+			answer->mod_ref = quote_register->hist.mod_ref;
+			answer->pre_abe = quote_register->hist.pre_abe;
+			answer->pre_max = quote_register->hist.pre_max;
+			answer->pre_min = quote_register->hist.pre_min;
+			answer->pre_med = quote_register->hist.pre_med;
+			answer->pre_ult = quote_register->hist.pre_ult;
+			answer->tot_neg = quote_register->hist.tot_neg;
+			answer->qua_tot = quote_register->hist.qua_tot;
+			answer->vol_tot = quote_register->hist.vol_tot;
+			answer->fat_cot = quote_register->hist.fat_cot;
+			answer->cod_isi = quote_register->hist.cod_isi;
+			SUCCESS;
+
+		case BOVESPA_FILE_TYPE_BDIN:
+
+			answer->ano_pregao = header_register->bdin.ano_pregao;
+			answer->mes_pregao = header_register->bdin.mes_pregao;
+			answer->dia_pregao = header_register->bdin.dia_pregao;
+			answer->cod_bdi = quote_register->bdin.cod_bdi;
+			answer->cod_neg = quote_register->bdin.cod_neg;
+			answer->tp_merc = quote_register->bdin.tp_merc;
+			answer->nom_res = quote_register->bdin.nom_res;
+			answer->especi = quote_register->bdin.especi;
+			answer->mod_ref = "R$";
+			answer->pre_abe = quote_register->bdin.pre_abe;
+			answer->pre_max = quote_register->bdin.pre_max;
+			answer->pre_min = quote_register->bdin.pre_min;
+			answer->pre_med = quote_register->bdin.pre_med;
+			answer->pre_ult = quote_register->bdin.pre_ult;
+			answer->tot_neg = quote_register->bdin.tot_neg;
+			answer->qua_tot = quote_register->bdin.qua_tot;
+			answer->vol_tot = quote_register->bdin.vol_tot;
+			answer->fat_cot = quote_register->bdin.fat_cot;
+			answer->cod_isi = quote_register->bdin.cod_isi;
+			SUCCESS;
+
+		default:
+
+			CRIT ("unknown bovespa file type '%u'.", file_type);
+			FAILURE;
+
+	}
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void pfish_bovespa_sanitize_field (char *field, size_t field_size) {
+
+	size_t i;
+
+	/* 
+	 * Remove trailing spaces.
+	 */
+
+	for ( i = field_size - 1; i > 0; i-- ) {
+
+		if (field[i] != ' ') {
+
+			break;
+
+		}
+		field[i] = 0;
+		field_size = i;
+
+	}
+
+	/* 
+	 * Remove consecutive spaces.
+	 */
+
+	for ( i = 0; i < field_size; i++ ) {
+
+		if (field[i] == ' ') {
+
+			while (field[i + 1] == ' ') {
+
+				memmove (&field[i], &field[i + 1], field_size - i);
+				field_size--;
+
+			}
+
+		}
+
+	}
+
+	/* 
+	 * Remove leading zeros.
+	 */
+
+	for ( i = 0; i < field_size; i++ ) {
+
+		if (field[i] != '0') {
+
+			break;
+
+		}
+
+	}
+	memmove (field, &field[i], field_size - i + 1);
+
+	/* 
+	 * End of sanitization.
+	 */
+
+	return;
+
+}
+
+
+TRACE_SEMAPHORE (quote__accept);
+TRACE_SEMAPHORE (quote__ignore);
+
+#define SUCCESS return (0)
+#define IGNORE return (1)
+#define FAILURE return (-1)
+
+int pfish_bovespa_quotes_list_append (const bovespa_mapper_t *mapper, ticker_table_t *tickers, quote_node_t **last) {
+
+	char *aux_charp;	// General purpose short ranged character pointer.
+	struct tm cal_time;	// Help during date/time type conversion.
+	pfish_bovespa_daily_quote_t quote;	// Temporary quote structure for field type conversions.
+	quote_node_t *new_node;		// New node to be added to the quotes linked list.
+
+	/* 
+	 * Consider only:
+	 *
+	 * 	- tp_merc = '010' (mercado a vista)
+	 * 	- cod_bdi = '02' (lote padrão)
+	 * 	- mod_ref = 'R$'
+	 */
+
+#define MATCH_AND_IGNORE(FIELD,STRING) \
+	if ((strcmp (mapper->FIELD, STRING)) != 0) { \
+		DEBUG ("register ignored due to field " #FIELD " ('%s') not be '%s'.", mapper->FIELD, STRING); \
+		TRACE2 (quote__ignore, mapper->cod_neg, #FIELD); \
+		IGNORE; \
+	}
+
+	MATCH_AND_IGNORE (tp_merc, "10");
+	MATCH_AND_IGNORE (cod_bdi, "2");
+	MATCH_AND_IGNORE (mod_ref, "R$");
+
+#undef MATCH_AND_IGNORE
+
+	/*
+	 * End of ignoring; starting field type conversions.
+	 */
+
+	/* 
+	 * Convert field 'trading_date'.
+	 */
+
+#define STR2INT(TARGET,SOURCE) \
+	cal_time.TARGET = strtol (mapper->SOURCE, &aux_charp, 10); \
+	if ((*aux_charp) != 0) { \
+		CRIT ("cannot understand bovespa field '" #SOURCE "' '%s' as a integer.", mapper->SOURCE); \
+		FAILURE; \
+	}
+
+	cal_time.tm_sec = 0;
+	cal_time.tm_min = 0;
+	cal_time.tm_hour = 12;
+	STR2INT (tm_mday, dia_pregao);
+	STR2INT (tm_mon, mes_pregao);
+	cal_time.tm_mon -= 1;
+	STR2INT (tm_year, ano_pregao);
+	cal_time.tm_year -= 1900;
+	cal_time.tm_isdst = 0;
+	cal_time.tm_gmtoff = 0;
+	cal_time.tm_zone = NULL;
+
+#undef STR2INT
+
+	quote.trading_date = timegm (&cal_time);
+
+	/*
+	 * Convert field 'stock_spec'.
+	 */
+
+	memset (quote.stock_spec, 0, PFISH_BOVESPA_ESPECI_SIZE);
+	strcpy (quote.stock_spec, mapper->especi);
+
+	/*
+	 * Convert unsigned integer fields.
+	 */
+
+#define STR2UINT(MAPPER_FIELD_NAME,QUOTE_FIELD_NAME) \
+	quote.QUOTE_FIELD_NAME = strtoul (mapper->MAPPER_FIELD_NAME, &aux_charp, 10); \
+	if (*aux_charp != 0) { \
+		CRIT ("cannot understand bovespa field %s ('%s') as an unsigned integer.", #MAPPER_FIELD_NAME, mapper->MAPPER_FIELD_NAME); \
+		FAILURE; \
+	}
+
+	STR2UINT (pre_abe, opening_price);
+	STR2UINT (pre_max, maximum_price);
+	STR2UINT (pre_min, minimum_price);
+	STR2UINT (pre_med, average_price);
+	STR2UINT (pre_ult, closing_price);
+	STR2UINT (tot_neg, total_trades);
+	STR2UINT (qua_tot, total_stocks);
+	STR2UINT (vol_tot, total_volume);
+	STR2UINT (fat_cot, price_factor);
+
+#undef STR2UINT
+
+	/*
+	 * End of type conversions; add a new node to the end of the quotes linked list.
+	 */
+
+	if ((new_node = (quote_node_t *) malloc (sizeof (quote_node_t))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", sizeof (quote_node_t));
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_ticker_table_intern (tickers, mapper->cod_neg, &(new_node->ticker))) < 0) {
+
+		free (new_node);
+		FAILURE;
+
+	}
+	memcpy (&(new_node->quote), &quote, sizeof (pfish_bovespa_daily_quote_t));
+	memset (new_node->isin, 0, PFISH_BOVESPA_CODISI_SIZE);
+	strncpy (new_node->isin, mapper->cod_isi, PFISH_BOVESPA_CODISI_SIZE - 1);
+	memset (new_node->name, 0, PFISH_BOVESPA_NOMRES_SIZE);
+	strncpy (new_node->name, mapper->nom_res, PFISH_BOVESPA_NOMRES_SIZE - 1);
+	new_node->next = NULL;
+	if (*last != NULL) {
+
+		(*last)->next = new_node;
+
+	}
+	*last = new_node;
+	TRACE3 (quote__accept, mapper->cod_neg, new_node->ticker, quote.trading_date);
+	
+	/*
+	 * All set.
+	 */
+
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef IGNORE
+#undef SUCCESS
+
+
+#define LESSER return (-1)
+#define GREATER return (1)
+#define EQUAL return (0)
+
+int pfish_bovespa_compare_quote_nodes (const void *a, const void *b) {
+
+#define CAST(X) (*((quote_node_t **) X))
+#define A (CAST (a))
+#define B (CAST (b))
+
+	/* Sort by stock name ascending,
+	 * then by timestamp ascending. */
+
+	if (pfish_bovespa_quote_ticker_ranks[A->ticker] < pfish_bovespa_quote_ticker_ranks[B->ticker]) {
+
+		LESSER;
+
+	}
+	else if (pfish_bovespa_quote_ticker_ranks[A->ticker] > pfish_bovespa_quote_ticker_ranks[B->ticker]) {
+
+		GREATER;
+
+	}
+	else if (A->quote.trading_date < B->quote.trading_date) {
+
+		LESSER;
+
+	}
+	else if (A->quote.trading_date > B->quote.trading_date) {
+
+		GREATER;
+
+	}
+	else {
+
+		EQUAL;
+
+	}
+
+#undef B
+#undef A
+#undef CAST
+
+}
+
+#undef EQUAL
+#undef GREATER
+#undef LESSER
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+TRACE_SEMAPHORE (merge__daily_quotes);
+
+int pfish_bovespa_merge_daily_quotes (pfish_bovespa_daily_quote_t **a, size_t a_size, pfish_bovespa_daily_quote_t **b, size_t b_size, pfish_bovespa_daily_quote_t ***answer, size_t *answer_size) {
+
+	pfish_bovespa_daily_quote_t **c;	// 'c' is the merged array.
+
+	size_t a_count;		// Indexer for array 'a'.
+	size_t b_count;		// Indexer for array 'b'.
+	size_t c_count;		// Indexer for array 'c'.
+
+	uint64_t start;		// Start of the merge, while traced.
+
+	start = (TRACE_ENABLED (merge__daily_quotes)) ? pfish_bovespa_metrics_clock () : 0;
+
+	/*
+	 * Make room for the worst case.
+	 */
+
+	if ((c = (pfish_bovespa_daily_quote_t **) malloc ((a_size + b_size) * sizeof (pfish_bovespa_daily_quote_t *))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (a_size + b_size) * sizeof (pfish_bovespa_daily_quote_t *));
+		FAILURE;
+
+	}
+
+#undef FAILURE
+#define FAILURE \
+	free (c); \
+	return (-1)
+
+	/*
+	 * Merge arrays 'a' and 'b' into 'c'.
+	 * Assumptions:
+	 * 	- trading date is unique among elements of 'a'. Idem for 'b'. Idem for 'c'.
+	 * 	- 'a' is sorted by trading date. Idem for 'b'. Idem for 'c'.
+	 * 	- in case of elements in 'a' and 'b' with same trading date, element of 'b' takes precedence.
+	 */
+
+	a_count = 0;
+	b_count = 0;
+	c_count = 0;
+	while ((a_count < a_size) || (b_count < b_size)) {
+
+		/*
+		 * There is at least one element to be merged from one of the input arrays.
+		 */
+
+		if (a_count >= a_size) {
+
+			/*
+			 * No elements left in 'a'.
+			 */
+
+			c[c_count++] = b[b_count++];
+
+		}
+		else if (b_count >= b_size) {
+
+			/*
+			 * No elements left in 'b'.
+			 */
+
+			c[c_count++] = a[a_count++];
+
+		}
+		else {
+
+			/*
+			 * Elements waiting in both input arrays; apply precedence rule.
+			 */
+
+#define TRADING_DATE(X) ((X[X##_count])->trading_date)
+
+			if (TRADING_DATE (a) < TRADING_DATE (b)) {
+
+				/*
+				 * Trading of element in 'a' happened sooner.
+				 */
+
+				c[c_count++] = a[a_count++];
+
+			}
+			else if (TRADING_DATE (a) > TRADING_DATE (b)) {
+
+				/*
+				 * Trading of element in 'b' happened sooner.
+				 */
+
+				c[c_count++] = b[b_count++];
+
+			}
+			else {
+
+				/*
+				 * Same trading date for both elements.
+				 * Element in 'b' wins, element in 'a' is discarded.
+				 */
+
+				c[c_count++] = b[b_count++];
+				a_count++;
+
+			}
+
+#undef TRADING_DATE
+
+		}
+
+	}
+
+	/*
+	 * Merged array 'c' is mounted, containing 'c_count' elements.
+	 */
+
+	assert (c_count <= (a_count + b_count));
+	*answer = c;
+	*answer_size = c_count;
+	if (TRACE_ENABLED (merge__daily_quotes)) {
+
+		TRACE4 (merge__daily_quotes, a_size, b_size, c_count, pfish_bovespa_metrics_clock () - start);
+
+	}
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
@@ -0,0 +1,337 @@
+/*
+ * import_kernel.h
+ * Kernels of imports of Bovespa files: parsing of registers, lists of quotes, and merging of histories.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_IMPORT_KERNEL_SEEN
+#define FILE_PFISH_BOVESPA_IMPORT_KERNEL_SEEN
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pilot_fish/bovespa.h>
+
+#include "ticker_dictionary.h"
+
+
+/*
+ * Constraints from layout specs of Bovespa files.
+ */
+
+/* Maximum number of useful characters of a line (350) + extra buffer. */
+
+#define BOVESPA_REGISTER_LENGTH 0x200
+
+/* Types of Bovespa files. */
+
+#define BOVESPA_FILE_TYPE_HIST 0
+#define BOVESPA_FILE_TYPE_BDIN 1
+
+/* Sections of Bovespa files. */
+
+#define BOVESPA_FILE_SECTION_HEADER 0
+#define BOVESPA_FILE_SECTION_QUOTES 1
+#define BOVESPA_FILE_SECTION_TRAILER 2
+#define BOVESPA_FILE_SECTION_OTHER 3
+
+
+/*
+ * Positional mapping of register fields inside Bovespa files.
+ *
+ * HIST_* are subsets of the spec 'SeriesHistoricas_Layout.pdf'.
+ * BDIN_* are subsets of the spec 'BDIN_Bovespa_v11.pdf'.
+ *
+ * N, X, V99 are subsets of field types of the specs above.
+ * Although they mean the same here (that is, text), it was helpful 
+ * differentiating among them for copying purposes.
+ */
+
+#define N(FIELD_NAME,FROM,TO) BOVESPA_FIELD (FIELD_NAME, FROM, TO)
+#define X(FIELD_NAME,FROM,TO) BOVESPA_FIELD (FIELD_NAME, FROM, TO)
+#define V99(FIELD_NAME,FROM,TO) BOVESPA_FIELD (FIELD_NAME, FROM, TO)
+
+#define HIST_HEADER_REGISTER \
+	X (nome_arquivo, 3, 15); \
+	X (codigo_origem, 16, 23); \
+	N (data_geracao, 24, 31)
+
+#define BDIN_HEADER_REGISTER \
+	X (nome_arquivo, 3, 10); \
+	X (codigo_origem, 11, 18); \
+	N (codigo_destino, 19, 22); \
+	N (data_geracao, 23, 30); \
+	N (ano_pregao, 31, 34); \
+	N (mes_pregao, 35, 36); \
+	N (dia_pregao, 37, 38); \
+	N (hora_geracao, 39, 42)
+
+#define HIST_QUOTE_REGISTER \
+	N (ano_pregao, 3, 6); \
+	N (mes_pregao, 7, 8); \
+	N (dia_pregao, 9, 10); \
+	X (cod_bdi, 11, 12); \
+	X (cod_neg, 13, 24); \
+	N (tp_merc, 25, 27); \
+	X (nom_res, 28, 39); \
+	X (especi, 40, 49); \
+	X (mod_ref, 53, 56); \
+	V99 (pre_abe, 57, 69); \
+	V99 (pre_max, 70, 82); \
+	V99 (pre_min, 83, 95); \
+	V99 (pre_med, 96, 108); \
+	V99 (pre_ult, 109, 121); \
+	N (tot_neg, 148, 152); \
+	N (qua_tot, 153, 170); \
+	V99 (vol_tot, 171, 188); \
+	N (fat_cot, 211, 217); \
+	X (cod_isi, 231, 242)
+
+#define BDIN_QUOTE_REGISTER \
+	X (cod_bdi, 3, 4); \
+	X (cod_neg, 58, 69); \
+	N (tp_merc, 70, 72); \
+	X (nom_res, 35, 46); \
+	X (especi, 47, 56); \
+	V99 (pre_abe, 91, 101); \
+	V99 (pre_max, 102, 112); \
+	V99 (pre_min, 113, 123); \
+	V99 (pre_med, 124, 134); \
+	V99 (pre_ult, 135, 145); \
+	N (tot_neg, 174, 178); \
+	N (qua_tot, 179, 193); \
+	V99 (vol_tot, 194, 210); \
+	N (fat_cot, 246, 252); \
+	X (cod_isi, 266, 277)
+
+#define HIST_TRAILER_REGISTER \
+	X (nome_arquivo, 3, 15); \
+	X (codigo_origem, 16, 23); \
+	N (data_geracao, 24, 31); \
+	N (total_registros, 32, 42)
+
+#define BDIN_TRAILER_REGISTER \
+	X (nome_arquivo, 3, 10); \
+	X (codigo_origem, 11, 18); \
+	N (codigo_destino, 19, 22); \
+	N (data_geracao, 23, 30); \
+	N (total_registros, 31, 39)
+
+
+/*
+ * Information containers of important registers (lines) of Bovespa files.
+ */
+
+#define BOVESPA_FIELD(FIELD_NAME,FROM,TO) char FIELD_NAME[TO - FROM + 2]
+
+struct hist_header_register {
+
+	HIST_HEADER_REGISTER;
+
+};
+
+struct hist_quote_register {
+
+	HIST_QUOTE_REGISTER;
+
+};
+
+struct hist_trailer_register {
+
+	HIST_TRAILER_REGISTER;
+
+};
+
+struct bdin_header_register {
+
+	BDIN_HEADER_REGISTER;
+
+};
+
+struct bdin_quote_register {
+
+	BDIN_QUOTE_REGISTER;
+
+};
+
+struct bdin_trailer_register {
+
+	BDIN_TRAILER_REGISTER;
+
+};
+
+union bovespa_header_register {
+
+	struct hist_header_register hist;
+	struct bdin_header_register bdin;
+
+};
+
+union bovespa_quote_register {
+
+	struct hist_quote_register hist;
+	struct bdin_quote_register bdin;
+
+};
+
+union bovespa_trailer_register {
+
+	struct hist_trailer_register hist;
+	struct bdin_trailer_register bdin;
+
+};
+
+#undef BOVESPA_FIELD
+
+
+/*
+ * Discover the type of a Bovespa file.
+ *
+ * @param[in] header_register first line of a Bovespa file.
+ * @param[out] answer one of BOVESPA_FILE_TYPE_* values.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_discover_file_type (const char *header_register, unsigned int *answer);
+
+
+/*
+ * Discover the type of a Bovespa register.
+ *
+ * @param[in] file_type one of BOVESPA_FILE_TYPE_* values.
+ * @param[in] bovespa_register a line of a Bovespa file.
+ * @param[out] answer one of BOVESPA_FILE_SECTION_* values.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_discover_register_type (unsigned int file_type, const char *bovespa_register, unsigned int *answer);
+
+
+/*
+ * Sanitize a field of a Bovespa register.
+ *
+ * @param[in,out] field field to be sanitized, will contain the result of sanitization..
+ * @param[in] field_size size of the field.
+ */
+
+void pfish_bovespa_sanitize_field (char *field, size_t field_size);
+
+
+/*
+ * Mapper structure for fields of a Bovespa register.
+ */
+
+struct bovespa_mapper {
+
+	char *ano_pregao;
+	char *mes_pregao;
+	char *dia_pregao;
+	char *cod_bdi;
+	char *cod_neg;
+	char *tp_merc;
+	char *nom_res;
+	char *especi;
+	char *mod_ref;
+	char *pre_abe;
+	char *pre_max;
+	char *pre_min;
+	char *pre_med;
+	char *pre_ult;
+	char *tot_neg;
+	char *qua_tot;
+	char *vol_tot;
+	char *fat_cot;
+	char *cod_isi;
+
+};
+
+typedef struct bovespa_mapper bovespa_mapper_t;
+
+
+/*
+ * Point the fields of a mapper structure to the fields of register structures of a file type.
+ * Fields of BDIN quotes not in quote registers (trading date, reference currency) are taken from the header register or assumed.
+ *
+ * @param[in] file_type one of BOVESPA_FILE_TYPE_* values.
+ * @param[in] header_register header register structures.
+ * @param[in] quote_register quote register structures, filled for each quote register.
+ * @param[out] answer mapper structure.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_mapper_bind (unsigned int file_type, union bovespa_header_register *header_register, union bovespa_quote_register *quote_register, bovespa_mapper_t *answer);
+
+
+/*
+ * Wrapping structure to make possible for a daily quote of a specific stock to be part of a linked list.
+ */
+
+typedef struct quote_node quote_node_t;
+
+struct quote_node {
+
+	pfish_bovespa_ticker_t ticker;
+	pfish_bovespa_daily_quote_t quote;
+	char isin[PFISH_BOVESPA_CODISI_SIZE];
+	char name[PFISH_BOVESPA_NOMRES_SIZE];
+	quote_node_t *next;
+
+};
+
+
+/*
+ * Decide if a Bovespa mapping is useful. If so, transform it to a quote node, and then add it to the quotes linked list.
+ *
+ * @param[in] mapper mapper structure of Bovespa textual fields containing quote information.
+ * @param[in,out] tickers ticker table; the stock of the quote is interned in it.
+ * @param[in,out] last last node of the quotes linked list, will contain the new last node on successfull append.
+ *
+ * @return 0 on successful append, other positive on ignored node, negative on failure.
+ */
+
+int pfish_bovespa_quotes_list_append (const bovespa_mapper_t *mapper, ticker_table_t *tickers, quote_node_t **last);
+
+
+/*
+ * Rank by stock id of each ticker, for pfish_bovespa_compare_quote_nodes().
+ */
+
+extern uint32_t *pfish_bovespa_quote_ticker_ranks;
+
+
+/*
+ * Compare two quote nodes, by stock id (see pfish_bovespa_quote_ticker_ranks) and trading date.
+ * Arguments type hint: (const void *) == (quote_node_t **)
+ *
+ * @param a first quote node.
+ * @param b second quote node.
+ *
+ * @return negative if a < b, positive if a > b, zero if a == b.
+ */
+
+int pfish_bovespa_compare_quote_nodes (const void *a, const void *b);
+
+
+/*
+ * Merge two arrays of (pointers to) daily quotes.
+ *
+ * @param[in] a first array of pointers to daily quotes.
+ * @param[in] a_size how many elements in 'a'.
+ * @param[in] b second array of pointers to daily quotes.
+ * @param[in] b_size how many elements in 'b'.
+ * @param[out] answer merged array.
+ * @param[out] answer_size how many elements in 'answer'.
+ *
+ * Input arrays are suposed to be sorted by trading date.
+ * Output array is sorted by trading date.
+ * If there are elements with same trading date on both input arrays, the elements of the second array will prevail.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_merge_daily_quotes (pfish_bovespa_daily_quote_t **a, size_t a_size, pfish_bovespa_daily_quote_t **b, size_t b_size, pfish_bovespa_daily_quote_t ***answer, size_t *answer_size);
+
+
+#endif	// FILE_PFISH_BOVESPA_IMPORT_KERNEL_SEEN
@@ -0,0 +1,440 @@
+/*
+ * indicator.c
+ *
+ * Technical indicators of a stock of the pilot_fish bovespa database.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <syslog.h>
+#include <argp.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+#include <pilot_fish/bovespa.h>
+
+#include "async_log.h"
+
+
+/*
+ * Command line argument parsing.
+ */
+
+const char *argp_program_version = PACKAGE_VERSION;
+const char *argp_program_bug_address = PACKAGE_BUGREPORT;
+
+static char doc[] = "pfish_bovespa_indicator -- technical indicators of a stock of the pilot_fish bovespa database.\vThis routine exports an INDICATOR of the trade history of STOCK through the standard output in CSV format.\n\nINDICATOR is one of: sma, ema, rsi, atr, bollinger, vwap, logret.\n\nExported fields are: trading date, indicator value (bollinger: middle, lower and upper band). Values are empty until the window of the indicator is full.\n\nFormat of date fields is YYYY-MM-DD.\nPrice fields are unit prices in units of 1/100 of the stock currency.\n\nWith --state, the indicator state is read from and saved to STATE_FILE, and only trades newer than the saved state are exported.\n";
+
+static char args_doc[] = "INDICATOR STOCK";
+
+static struct argp_option options[] = {
+
+	{"window", 'w', "WINDOW",  0, "window length, in trades or periods (default: 14).", 0 },
+	{"width", 'k', "WIDTH",  0, "width of Bollinger bands, in standard deviations (default: 2).", 0 },
+	{"adjusted", 'x', 0,  0, "use prices adjusted by inplits / splits.", 0 },
+	{"period", 'p', "PERIOD",  0, "use rollups of trades by PERIOD: 'daily' (default), 'weekly' or 'monthly'.", 0 },
+	{"image", 'm', 0,  0, "read from the shared memory database image (see pfish_bovespa_image_load).", 0 },
+	{"state", 's', "STATE_FILE",  0, "compute incrementally from the indicator state kept in STATE_FILE.", 0 },
+	{"stats", 'S', 0,  0, "print runtime metrics of the library to the standard error on exit.", 0 },
+	{ 0 }
+
+};
+
+struct arguments {
+
+	unsigned int indicator;
+	size_t window;
+	double width;
+	unsigned int adjusted;
+	unsigned int period;
+	unsigned int image;
+	char *state;
+	char *stock;
+	unsigned int stats;
+
+};
+
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+	char *tail;
+
+	switch (key) {
+
+		case 'w':
+
+			arguments->window = strtoul (arg, &tail, 10);
+			if ((*arg == 0) || (*tail != 0) || (arguments->window == 0)) {
+
+				argp_error (state, "invalid window '%s'.", arg);
+
+			}
+			break;
+
+		case 'k':
+
+			arguments->width = strtod (arg, &tail);
+			if ((*arg == 0) || (*tail != 0) || !(arguments->width >= 0)) {
+
+				argp_error (state, "invalid width '%s'.", arg);
+
+			}
+			break;
+
+		case 'x':
+
+			arguments->adjusted = 1;
+			break;
+
+		case 'p':
+
+			if ((strcmp (arg, "daily")) == 0) {
+
+				arguments->period = PFISH_BOVESPA_VIEW_RAW;
+
+			}
+			else if ((strcmp (arg, "weekly")) == 0) {
+
+				arguments->period = PFISH_BOVESPA_VIEW_WEEKLY;
+
+			}
+			else if ((strcmp (arg, "monthly")) == 0) {
+
+				arguments->period = PFISH_BOVESPA_VIEW_MONTHLY;
+
+			}
+			else {
+
+				argp_error (state, "unknown period '%s'.", arg);
+
+			}
+			break;
+
+		case 'm':
+
+			arguments->image = 1;
+			break;
+
+		case 's':
+
+			arguments->state = arg;
+			break;
+
+		case 'S':
+
+			arguments->stats = 1;
+			break;
+
+		case ARGP_KEY_ARG:
+
+			switch (state->arg_num) {
+
+				case 0:
+
+					if ((strcmp (arg, "sma")) == 0) {
+
+						arguments->indicator = PFISH_BOVESPA_INDICATOR_SMA;
+
+					}
+					else if ((strcmp (arg, "ema")) == 0) {
+
+						arguments->indicator = PFISH_BOVESPA_INDICATOR_EMA;
+
+					}
+					else if ((strcmp (arg, "rsi")) == 0) {
+
+						arguments->indicator = PFISH_BOVESPA_INDICATOR_RSI;
+
+					}
+					else if ((strcmp (arg, "atr")) == 0) {
+
+						arguments->indicator = PFISH_BOVESPA_INDICATOR_ATR;
+
+					}
+					else if ((strcmp (arg, "bollinger")) == 0) {
+
+						arguments->indicator = PFISH_BOVESPA_INDICATOR_BOLLINGER;
+
+					}
+					else if ((strcmp (arg, "vwap")) == 0) {
+
+						arguments->indicator = PFISH_BOVESPA_INDICATOR_VWAP;
+
+					}
+					else if ((strcmp (arg, "logret")) == 0) {
+
+						arguments->indicator = PFISH_BOVESPA_INDICATOR_LOG_RETURN;
+
+					}
+					else {
+
+						argp_error (state, "unknown indicator '%s'.", arg);
+
+					}
+					break;
+
+				case 1:
+					arguments->stock = arg;
+					break;
+
+				default:
+
+					argp_usage (state);
+
+			}
+			break;
+
+		case ARGP_KEY_END:
+
+			if (state->arg_num < 2) {
+
+				argp_usage (state);
+
+			}
+			break;
+
+		default:
+
+			return ARGP_ERR_UNKNOWN;
+
+	};
+
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+
+/*
+ * The portal.
+ */
+
+#define SUCCESS return (EXIT_SUCCESS)
+#define FAILURE return (EXIT_FAILURE)
+
+#define DATE_BUF_SIZE 16
+
+int main (int argc, char **argv) {
+
+	struct arguments arguments;	// Arguments given in the command line.
+
+	pfish_bovespa_stock_id_t stock_id;	// Stock identification.
+	pfish_bovespa_stock_history_t *stock_history;	// Stock trade history.
+	pfish_bovespa_indicator_state_t *state;	// Indicator state.
+	size_t first;	// Index of stock_history->daily_quotes[] of the first computed value.
+	double *values;	// Computed values.
+	size_t values_size;	// How many daily quotes in values[].
+	int rcode;	// Return code of functions.
+
+	struct tm *trading_date;	// Time components of each trading date.
+	char date_buf[DATE_BUF_SIZE];	// Trading date string formatting buffer.
+
+	size_t i, j;	// General, short ranged indexers / counters.
+
+	/*
+	 * Begin.
+	 */
+
+	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	pfish_bovespa_log_level_from_env ();
+	DEBUG ("start.");
+
+	/*
+	 * Parse command line arguments.
+	 */
+
+	arguments.indicator = PFISH_BOVESPA_INDICATOR_SMA;
+	arguments.window = 14;
+	arguments.width = 2;
+	arguments.adjusted = 0;
+	arguments.period = PFISH_BOVESPA_VIEW_RAW;
+	arguments.image = 0;
+	arguments.state = NULL;
+	arguments.stock = NULL;
+	arguments.stats = 0;
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+	/*
+	 * From now on, log messages are written by a background thread.
+	 */
+
+	pfish_bovespa_log_start ();
+	if (arguments.stock == NULL) {
+
+		CRIT ("missing stock identification.");
+		FAILURE;
+
+	}
+
+	/*
+	 * Retrieve stock history from the database.
+	 */
+
+	if ((strlen (arguments.stock)) > PFISH_BOVESPA_CODNEG_SIZE - 1) {
+
+		CRIT ("stock name is too big.");
+		FAILURE;
+
+	}
+	strcpy (stock_id.id, arguments.stock);
+	if ((arguments.image != 0) && ((pfish_bovespa_image_attach ()) < 0)) {
+
+		CRIT ("cannot attach to the database image.");
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_stock_history_alloc_view (&stock_id, ((arguments.adjusted != 0) ? PFISH_BOVESPA_VIEW_ADJUSTED : PFISH_BOVESPA_VIEW_RAW) | arguments.period, &stock_history)) < 0) {
+
+		CRIT ("cannot retrieve history of stock '%s' from database.", stock_id.id);
+		FAILURE;
+
+	}
+	if (stock_history == NULL) {
+
+		ERR ("stock '%s' does not exist in database.", stock_id.id);
+		FAILURE;
+
+	}
+
+	/*
+	 * Retrieve the indicator state.
+	 */
+
+	state = NULL;
+	if ((arguments.state != NULL) && ((pfish_bovespa_indicator_state_load (arguments.state, &state)) < 0)) {
+
+		CRIT ("cannot load indicator state from '%s'.", arguments.state);
+		FAILURE;
+
+	}
+	if ((state != NULL) && ((state->indicator != arguments.indicator) || (state->window != arguments.window) || (state->width != arguments.width))) {
+
+		ERR ("indicator state '%s' was saved with other indicator parameters.", arguments.state);
+		FAILURE;
+
+	}
+	if ((state == NULL) && ((pfish_bovespa_indicator_state_alloc (arguments.indicator, arguments.window, arguments.width, &state)) < 0)) {
+
+		CRIT ("cannot allocate indicator state.");
+		FAILURE;
+
+	}
+
+	/*
+	 * Compute the indicator.
+	 */
+
+	first = state->daily_quotes_size;
+	if ((rcode = pfish_bovespa_indicator_compute (state, stock_history, &values, &values_size)) < 0) {
+
+		CRIT ("cannot compute indicator of stock '%s'.", stock_id.id);
+		FAILURE;
+
+	}
+	if (rcode > 0) {
+
+		NOTICE ("history of stock '%s' changed since indicator state was saved; computing from scratch.", stock_id.id);
+		free (state);
+		if ((pfish_bovespa_indicator_state_alloc (arguments.indicator, arguments.window, arguments.width, &state)) < 0) {
+
+			CRIT ("cannot allocate indicator state.");
+			FAILURE;
+
+		}
+		first = 0;
+		if ((pfish_bovespa_indicator_compute (state, stock_history, &values, &values_size)) != 0) {
+
+			CRIT ("cannot compute indicator of stock '%s'.", stock_id.id);
+			FAILURE;
+
+		}
+
+	}
+
+	/*
+	 * Export indicator values.
+	 */
+
+	for ( i = 0; i < values_size; i++ ) {
+
+		if ((trading_date = gmtime (&(stock_history->daily_quotes[first + i].trading_date))) == NULL) {
+
+			CRIT ("cannot understand trading date '%u' as a timestamp value.", stock_history->daily_quotes[first + i].trading_date);
+			FAILURE;
+
+		}
+		if ((strftime (date_buf, DATE_BUF_SIZE, "%F", trading_date)) == 0) {
+
+			CRIT ("cannot build the string representation of the trading date.");
+			FAILURE;
+
+		}
+		printf ("%s", date_buf);
+		for ( j = 0; j < state->columns; j++ ) {
+
+			if (isnan (values[(i * state->columns) + j])) {
+
+				printf (",");
+
+			}
+			else {
+
+				printf (",%.6f", values[(i * state->columns) + j]);
+
+			}
+
+		}
+		printf ("\n");
+
+	}
+
+	/*
+	 * Save the indicator state.
+	 */
+
+	if ((arguments.state != NULL) && ((pfish_bovespa_indicator_state_save (state, arguments.state)) < 0)) {
+
+		CRIT ("cannot save indicator state to '%s'.", arguments.state);
+		FAILURE;
+
+	}
+
+	/*
+	 * Resource releasing.
+	 */
+
+	free (values);
+	free (state);
+	if (pfish_bovespa_stock_history_free (stock_history)) {
+
+		CRIT ("cannot release stock history.");
+		FAILURE;
+
+	}
+
+	/*
+	 * End.
+	 */
+
+	if (arguments.stats != 0) {
+
+		pfish_bovespa_metrics_print (stderr);
+
+	}
+	DEBUG ("end.");
+	SUCCESS;
+
+}
+
+#undef DATE_BUF_SIZE
+
+#undef FAILURE
+#undef SUCCESS
@@ -0,0 +1,716 @@
+/*
+ * indicator_engine.c
+ * Technical indicators over stock histories.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <syslog.h>
+
+#if defined (__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+#include <pilot_fish/bovespa.h>
+
+#include "crc32c.h"
+#include "async_log.h"
+
+
+/*
+ * Upper bound of indicator windows.
+ */
+
+#define INDICATOR_MAX_WINDOW 0x10000
+
+
+/*
+ * Size of an indicator state, carried inputs included.
+ */
+
+#define STATE_SIZE(WINDOW) (sizeof (pfish_bovespa_indicator_state_t) + (2 * (WINDOW) * sizeof (double)))
+
+
+/*
+ * Portable kernels.
+ *
+ * Rolling window sums are differences of prefix sums:
+ * the sum of a window of inputs ending at index (i + window - 1) is prefix[i + window] - prefix[i].
+ */
+
+static void window_means_software (const double *prefix, size_t window, size_t size, double *answer) {
+
+	size_t i;
+
+	for ( i = 0; i < size; i++ ) {
+
+		answer[i] = (prefix[i + window] - prefix[i]) / window;
+
+	}
+
+}
+
+static void window_deviations_software (const double *prefix2, size_t window, size_t size, const double *means, double *answer) {
+
+	double variance;
+	size_t i;
+
+	for ( i = 0; i < size; i++ ) {
+
+		variance = ((prefix2[i + window] - prefix2[i]) / window) - (means[i] * means[i]);
+		answer[i] = sqrt ((variance > 0) ? variance : 0);
+
+	}
+
+}
+
+static void window_ratios_software (const double *prefix_a, const double *prefix_b, size_t window, size_t size, double *answer) {
+
+	size_t i;
+
+	for ( i = 0; i < size; i++ ) {
+
+		answer[i] = (prefix_a[i + window] - prefix_a[i]) / (prefix_b[i + window] - prefix_b[i]);
+
+	}
+
+}
+
+static void true_ranges_software (const double *high, const double *low, const double *previous, size_t size, double *answer) {
+
+	double range;
+	size_t i;
+
+	for ( i = 0; i < size; i++ ) {
+
+		answer[i] = high[i] - low[i];
+		if ((range = fabs (high[i] - previous[i])) > answer[i]) {
+
+			answer[i] = range;
+
+		}
+		if ((range = fabs (low[i] - previous[i])) > answer[i]) {
+
+			answer[i] = range;
+
+		}
+
+	}
+
+}
+
+static void changes_software (const double *close, const double *previous, size_t size, double *gains, double *losses) {
+
+	size_t i;
+
+	for ( i = 0; i < size; i++ ) {
+
+		gains[i] = (close[i] > previous[i]) ? (close[i] - previous[i]) : 0;
+		losses[i] = (previous[i] > close[i]) ? (previous[i] - close[i]) : 0;
+
+	}
+
+}
+
+
+#if defined (__x86_64__)
+
+/*
+ * AVX kernels: four inputs per instruction.
+ * Tails are left to the portable kernels.
+ */
+
+__attribute__ ((target ("avx")))
+static void window_means_avx (const double *prefix, size_t window, size_t size, double *answer) {
+
+	__m256d divisor;
+	size_t i;
+
+	divisor = _mm256_set1_pd ((double) window);
+	for ( i = 0; i + 4 <= size; i += 4 ) {
+
+		_mm256_storeu_pd (answer + i, _mm256_div_pd (_mm256_sub_pd (_mm256_loadu_pd (prefix + i + window), _mm256_loadu_pd (prefix + i)), divisor));
+
+	}
+	window_means_software (prefix + i, window, size - i, answer + i);
+
+}
+
+__attribute__ ((target ("avx")))
+static void window_deviations_avx (const double *prefix2, size_t window, size_t size, const double *means, double *answer) {
+
+	__m256d divisor;
+	__m256d zero;
+	__m256d mean;
+	__m256d variance;
+	size_t i;
+
+	divisor = _mm256_set1_pd ((double) window);
+	zero = _mm256_setzero_pd ();
+	for ( i = 0; i + 4 <= size; i += 4 ) {
+
+		mean = _mm256_loadu_pd (means + i);
+		variance = _mm256_sub_pd (_mm256_div_pd (_mm256_sub_pd (_mm256_loadu_pd (prefix2 + i + window), _mm256_loadu_pd (prefix2 + i)), divisor), _mm256_mul_pd (mean, mean));
+		_mm256_storeu_pd (answer + i, _mm256_sqrt_pd (_mm256_max_pd (variance, zero)));
+
+	}
+	window_deviations_software (prefix2 + i, window, size - i, means + i, answer + i);
+
+}
+
+__attribute__ ((target ("avx")))
+static void window_ratios_avx (const double *prefix_a, const double *prefix_b, size_t window, size_t size, double *answer) {
+
+	size_t i;
+
+	for ( i = 0; i + 4 <= size; i += 4 ) {
+
+		_mm256_storeu_pd (answer + i, _mm256_div_pd (
+			_mm256_sub_pd (_mm256_loadu_pd (prefix_a + i + window), _mm256_loadu_pd (prefix_a + i)),
+			_mm256_sub_pd (_mm256_loadu_pd (prefix_b + i + window), _mm256_loadu_pd (prefix_b + i))));
+
+	}
+	window_ratios_software (prefix_a + i, prefix_b + i, window, size - i, answer + i);
+
+}
+
+__attribute__ ((target ("avx")))
+static void true_ranges_avx (const double *high, const double *low, const double *previous, size_t size, double *answer) {
+
+	__m256d sign;
+	__m256d h;
+	__m256d l;
+	__m256d p;
+	size_t i;
+
+	sign = _mm256_set1_pd (-0.0);
+	for ( i = 0; i + 4 <= size; i += 4 ) {
+
+		h = _mm256_loadu_pd (high + i);
+		l = _mm256_loadu_pd (low + i);
+		p = _mm256_loadu_pd (previous + i);
+		_mm256_storeu_pd (answer + i, _mm256_max_pd (_mm256_max_pd (
+			_mm256_sub_pd (h, l),
+			_mm256_andnot_pd (sign, _mm256_sub_pd (h, p))),
+			_mm256_andnot_pd (sign, _mm256_sub_pd (l, p))));
+
+	}
+	true_ranges_software (high + i, low + i, previous + i, size - i, answer + i);
+
+}
+
+__attribute__ ((target ("avx")))
+static void changes_avx (const double *close, const double *previous, size_t size, double *gains, double *losses) {
+
+	__m256d zero;
+	__m256d c;
+	__m256d p;
+	size_t i;
+
+	zero = _mm256_setzero_pd ();
+	for ( i = 0; i + 4 <= size; i += 4 ) {
+
+		c = _mm256_loadu_pd (close + i);
+		p = _mm256_loadu_pd (previous + i);
+		_mm256_storeu_pd (gains + i, _mm256_max_pd (_mm256_sub_pd (c, p), zero));
+		_mm256_storeu_pd (losses + i, _mm256_max_pd (_mm256_sub_pd (p, c), zero));
+
+	}
+	changes_software (close + i, previous + i, size - i, gains + i, losses + i);
+
+}
+
+#define KERNEL(NAME) (__builtin_cpu_supports ("avx") ? NAME ## _avx : NAME ## _software)
+
+#else	// __x86_64__
+
+#define KERNEL(NAME) NAME ## _software
+
+#endif	// __x86_64__
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int pfish_bovespa_indicator_state_alloc (unsigned int indicator, size_t window, double width, pfish_bovespa_indicator_state_t **answer) {
+
+	pfish_bovespa_indicator_state_t *state;
+
+	if (indicator > PFISH_BOVESPA_INDICATOR_LOG_RETURN) {
+
+		ERR ("unknown indicator '%u'.", indicator);
+		FAILURE;
+
+	}
+	if ((window == 0) || (window > INDICATOR_MAX_WINDOW)) {
+
+		ERR ("indicator window must be between 1 and %u.", INDICATOR_MAX_WINDOW);
+		FAILURE;
+
+	}
+	if (!(width >= 0)) {
+
+		ERR ("Bollinger bands width must not be negative.");
+		FAILURE;
+
+	}
+	if ((state = (pfish_bovespa_indicator_state_t *) malloc (STATE_SIZE (window))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", STATE_SIZE (window));
+		FAILURE;
+
+	}
+	memset (state, 0, STATE_SIZE (window));
+	state->indicator = indicator;
+	state->window = window;
+	state->width = width;
+	state->columns = (indicator == PFISH_BOVESPA_INDICATOR_BOLLINGER) ? 3 : 1;
+	state->previous_close = NAN;
+	*answer = state;
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_indicator_compute (pfish_bovespa_indicator_state_t *state, const pfish_bovespa_stock_history_t *history, double **answer, size_t *answer_size) {
+
+	size_t n;	// How many daily quotes to be computed.
+	size_t m;	// How many daily quotes carried from state.
+	size_t e;	// How many inputs in the extended range (carried, then new ones).
+	size_t j0;	// First new daily quote whose window is full.
+	double *work;	// Working memory.
+	double *x;	// First input of window indicators, over the extended range.
+	double *y;	// Second input of window indicators, over the extended range.
+	double *prefix_x;	// Prefix sums of x.
+	double *prefix_y;	// Prefix sums of y (or of squares of x).
+	double *closes;	// Unit closing prices; closes[0] is the previous one.
+	double *highs;	// Unit maximum prices.
+	double *lows;	// Unit minimum prices.
+	double *t1;	// Kernel output.
+	double *t2;	// Kernel output.
+	double *values;	// The answer.
+	size_t count;	// How many inputs of a recursive indicator so far, this one included.
+	const pfish_bovespa_daily_quote_t *quote;
+	size_t j, k;
+
+#define UNIT(FIELD) ((double) quote->FIELD / ((quote->price_factor != 0) ? quote->price_factor : 1))
+
+	/*
+	 * Find out what is new.
+	 */
+
+	if (state->daily_quotes_size > history->daily_quotes_size) {
+
+		return (1);
+
+	}
+	if (state->daily_quotes_size > 0) {
+
+		// Adjusted views are rewritten by later inplits and splits; catch them by the last consumed closing price.
+
+		quote = &(history->daily_quotes[state->daily_quotes_size - 1]);
+		if ((quote->trading_date != state->trading_date) || (UNIT (closing_price) != state->previous_close)) {
+
+			return (1);
+
+		}
+
+	}
+	n = history->daily_quotes_size - state->daily_quotes_size;
+	*answer = NULL;
+	*answer_size = 0;
+	if (n == 0) {
+
+		SUCCESS;
+
+	}
+	m = state->carried_size;
+	e = m + n;
+	if ((work = (double *) malloc (((4 * e) + (6 * n) + 3) * sizeof (double))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", ((4 * e) + (6 * n) + 3) * sizeof (double));
+		FAILURE;
+
+	}
+	if ((values = (double *) malloc (n * state->columns * sizeof (double))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", n * state->columns * sizeof (double));
+		free (work);
+		FAILURE;
+
+	}
+	x = work;
+	y = x + e;
+	prefix_x = y + e;
+	prefix_y = prefix_x + e + 1;
+	closes = prefix_y + e + 1;
+	highs = closes + n + 1;
+	lows = highs + n;
+	t1 = lows + n;
+	t2 = t1 + n;
+
+	/*
+	 * Gather unit prices from the daily quotes.
+	 */
+
+	closes[0] = state->previous_close;
+	for ( j = 0; j < m; j++ ) {
+
+		x[j] = state->carried[2 * j];
+		y[j] = state->carried[(2 * j) + 1];
+
+	}
+	for ( j = 0; j < n; j++ ) {
+
+		quote = &(history->daily_quotes[state->daily_quotes_size + j]);
+		closes[j + 1] = UNIT (closing_price);
+		highs[j] = UNIT (maximum_price);
+		lows[j] = UNIT (minimum_price);
+		if (state->indicator == PFISH_BOVESPA_INDICATOR_VWAP) {
+
+			x[m + j] = UNIT (average_price) * quote->total_stocks;
+			y[m + j] = quote->total_stocks;
+
+		}
+		else {
+
+			x[m + j] = closes[j + 1];
+			y[m + j] = 0;
+
+		}
+
+	}
+
+#undef UNIT
+
+	/*
+	 * Compute.
+	 */
+
+#define VALUE(J,COLUMN) values[((J) * state->columns) + (COLUMN)]
+#define CONSUMED state->daily_quotes_size
+#define WINDOW state->window
+
+	switch (state->indicator) {
+
+		case PFISH_BOVESPA_INDICATOR_SMA:
+		case PFISH_BOVESPA_INDICATOR_BOLLINGER:
+		case PFISH_BOVESPA_INDICATOR_VWAP:
+
+			prefix_x[0] = 0;
+			prefix_y[0] = 0;
+			for ( j = 0; j < e; j++ ) {
+
+				prefix_x[j + 1] = prefix_x[j] + x[j];
+				prefix_y[j + 1] = prefix_y[j] + ((state->indicator == PFISH_BOVESPA_INDICATOR_BOLLINGER) ? (x[j] * x[j]) : y[j]);
+
+			}
+			j0 = WINDOW - 1 - m;	// Carried inputs are never more than (window - 1).
+			for ( j = 0; (j < j0) && (j < n); j++ ) {
+
+				for ( k = 0; k < state->columns; k++ ) {
+
+					VALUE (j, k) = NAN;
+
+				}
+
+			}
+			if (j0 >= n) {
+
+				break;
+
+			}
+			if (state->indicator == PFISH_BOVESPA_INDICATOR_VWAP) {
+
+				KERNEL (window_ratios) (prefix_x, prefix_y, WINDOW, n - j0, t1);
+
+			}
+			else {
+
+				KERNEL (window_means) (prefix_x, WINDOW, n - j0, t1);
+
+			}
+			if (state->indicator == PFISH_BOVESPA_INDICATOR_BOLLINGER) {
+
+				KERNEL (window_deviations) (prefix_y, WINDOW, n - j0, t1, t2);
+				for ( j = j0; j < n; j++ ) {
+
+					VALUE (j, 0) = t1[j - j0];
+					VALUE (j, 1) = t1[j - j0] - (state->width * t2[j - j0]);
+					VALUE (j, 2) = t1[j - j0] + (state->width * t2[j - j0]);
+
+				}
+
+			}
+			else {
+
+				for ( j = j0; j < n; j++ ) {
+
+					VALUE (j, 0) = t1[j - j0];
+
+				}
+
+			}
+			break;
+
+		case PFISH_BOVESPA_INDICATOR_EMA:
+
+			for ( j = 0; j < n; j++ ) {
+
+				count = CONSUMED + j + 1;
+				if (count < WINDOW) {
+
+					state->smoothed[0] += closes[j + 1];
+					VALUE (j, 0) = NAN;
+					continue;
+
+				}
+				if (count == WINDOW) {
+
+					state->smoothed[0] = (state->smoothed[0] + closes[j + 1]) / WINDOW;
+
+				}
+				else {
+
+					state->smoothed[0] += (2.0 / (WINDOW + 1)) * (closes[j + 1] - state->smoothed[0]);
+
+				}
+				VALUE (j, 0) = state->smoothed[0];
+
+			}
+			break;
+
+		case PFISH_BOVESPA_INDICATOR_RSI:
+
+			KERNEL (changes) (closes + 1, closes, n, t1, t2);
+			for ( j = 0; j < n; j++ ) {
+
+				count = CONSUMED + j;
+				if ((count == 0) || (count < WINDOW)) {
+
+					state->smoothed[0] += (count == 0) ? 0 : t1[j];
+					state->smoothed[1] += (count == 0) ? 0 : t2[j];
+					VALUE (j, 0) = NAN;
+					continue;
+
+				}
+				if (count == WINDOW) {
+
+					state->smoothed[0] = (state->smoothed[0] + t1[j]) / WINDOW;
+					state->smoothed[1] = (state->smoothed[1] + t2[j]) / WINDOW;
+
+				}
+				else {
+
+					state->smoothed[0] = ((state->smoothed[0] * (WINDOW - 1)) + t1[j]) / WINDOW;
+					state->smoothed[1] = ((state->smoothed[1] * (WINDOW - 1)) + t2[j]) / WINDOW;
+
+				}
+				if (state->smoothed[1] == 0) {
+
+					VALUE (j, 0) = (state->smoothed[0] == 0) ? 50 : 100;
+
+				}
+				else {
+
+					VALUE (j, 0) = 100 - (100 / (1 + (state->smoothed[0] / state->smoothed[1])));
+
+				}
+
+			}
+			break;
+
+		case PFISH_BOVESPA_INDICATOR_ATR:
+
+			KERNEL (true_ranges) (highs, lows, closes, n, t1);
+			if (CONSUMED == 0) {
+
+				t1[0] = highs[0] - lows[0];
+
+			}
+			for ( j = 0; j < n; j++ ) {
+
+				count = CONSUMED + j + 1;
+				if (count < WINDOW) {
+
+					state->smoothed[0] += t1[j];
+					VALUE (j, 0) = NAN;
+					continue;
+
+				}
+				if (count == WINDOW) {
+
+					state->smoothed[0] = (state->smoothed[0] + t1[j]) / WINDOW;
+
+				}
+				else {
+
+					state->smoothed[0] = ((state->smoothed[0] * (WINDOW - 1)) + t1[j]) / WINDOW;
+
+				}
+				VALUE (j, 0) = state->smoothed[0];
+
+			}
+			break;
+
+		case PFISH_BOVESPA_INDICATOR_LOG_RETURN:
+
+			for ( j = 0; j < n; j++ ) {
+
+				VALUE (j, 0) = ((closes[j] > 0) && (closes[j + 1] > 0)) ? log (closes[j + 1] / closes[j]) : NAN;
+
+			}
+			break;
+
+	}
+
+#undef WINDOW
+#undef CONSUMED
+#undef VALUE
+
+	/*
+	 * Advance the state.
+	 */
+
+	if ((state->indicator == PFISH_BOVESPA_INDICATOR_SMA) || (state->indicator == PFISH_BOVESPA_INDICATOR_BOLLINGER) || (state->indicator == PFISH_BOVESPA_INDICATOR_VWAP)) {
+
+		state->carried_size = (e < state->window - 1) ? e : state->window - 1;
+		for ( j = 0; j < state->carried_size; j++ ) {
+
+			state->carried[2 * j] = x[e - state->carried_size + j];
+			state->carried[(2 * j) + 1] = y[e - state->carried_size + j];
+
+		}
+
+	}
+	state->daily_quotes_size = history->daily_quotes_size;
+	state->trading_date = history->daily_quotes[history->daily_quotes_size - 1].trading_date;
+	state->previous_close = closes[n];
+	free (work);
+	*answer = values;
+	*answer_size = n;
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_indicator_state_save (const pfish_bovespa_indicator_state_t *state, const char *pathname) {
+
+	uint32_t checksum;	// Checksum of the state dump.
+	FILE *state_file;	// Stream to the file.
+
+	checksum = pfish_bovespa_crc32c (0, state, STATE_SIZE (state->window));
+	if ((state_file = fopen (pathname, "w")) == NULL) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s' in write mode.", pathname);
+		FAILURE;
+
+	}
+	if (((fwrite (state, STATE_SIZE (state->window), 1, state_file)) != 1) || ((fwrite (&checksum, sizeof (uint32_t), 1, state_file)) != 1)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot write to file '%s'.", pathname);
+		fclose (state_file);
+		FAILURE;
+
+	}
+	if ((fclose (state_file)) != 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot close file '%s'.", pathname);
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_indicator_state_load (const char *pathname, pfish_bovespa_indicator_state_t **answer) {
+
+	FILE *state_file;	// Stream to the file.
+	pfish_bovespa_indicator_state_t header;	// Fixed part of the state.
+	uint32_t checksum;	// Checksum of the state dump.
+
+	if ((state_file = fopen (pathname, "r")) == NULL) {
+
+		switch (errno) {
+
+			case ENOENT:
+
+				*answer = NULL;
+				SUCCESS;
+
+			default:
+
+				ERRNO_ERR;
+				CRIT ("cannot open file '%s' in read mode.", pathname);
+				FAILURE;
+
+		}
+
+	}
+
+#define FREE \
+	fclose (state_file)
+
+	if ((fread (&header, sizeof (pfish_bovespa_indicator_state_t), 1, state_file)) != 1) {
+
+		ERR ("indicator state file '%s' is truncated.", pathname);
+		FREE;
+		FAILURE;
+
+	}
+	if ((header.indicator > PFISH_BOVESPA_INDICATOR_LOG_RETURN) || (header.columns != ((header.indicator == PFISH_BOVESPA_INDICATOR_BOLLINGER) ? 3 : 1)) || (header.window == 0) || (header.window > INDICATOR_MAX_WINDOW) || (header.carried_size >= header.window)) {
+
+		ERR ("indicator state file '%s' is corrupt.", pathname);
+		FREE;
+		FAILURE;
+
+	}
+	if ((*answer = (pfish_bovespa_indicator_state_t *) malloc (STATE_SIZE (header.window))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", STATE_SIZE (header.window));
+		FREE;
+		FAILURE;
+
+	}
+
+#undef FREE
+#define FREE \
+	free (*answer); \
+	*answer = NULL; \
+	fclose (state_file)
+
+	memcpy (*answer, &header, sizeof (pfish_bovespa_indicator_state_t));
+	if (((fread ((*answer)->carried, STATE_SIZE (header.window) - sizeof (pfish_bovespa_indicator_state_t), 1, state_file)) != 1) || ((fread (&checksum, sizeof (uint32_t), 1, state_file)) != 1)) {
+
+		ERR ("indicator state file '%s' is truncated.", pathname);
+		FREE;
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_crc32c (0, *answer, STATE_SIZE (header.window))) != checksum) {
+
+		ERR ("indicator state file '%s' checksum mismatch.", pathname);
+		FREE;
+		FAILURE;
+
+	}
+	fclose (state_file);
+	SUCCESS;
+
+#undef FREE
+
+}
+
+#undef FAILURE
+#undef SUCCESS
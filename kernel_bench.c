@@ -0,0 +1,869 @@
+/*
+ * kernel_bench.c
+ *
+ * Microbenchmark of the kernels of imports of Bovespa files.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <argp.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+#include <pilot_fish/bovespa.h>
+
+#include "ticker_dictionary.h"
+#include "import_kernel.h"
+
+
+/*
+ * Command line argument parsing.
+ */
+
+const char *argp_program_version = PACKAGE_VERSION;
+const char *argp_program_bug_address = PACKAGE_BUGREPORT;
+
+static char doc[] = "pfish_bovespa_kernel_bench -- microbenchmark of the kernels of imports of Bovespa files.\vThis routine reads a Bovespa file from the standard input (see pfish_bovespa_generate), and times each kernel of pfish_bovespa_file_import over its registers, as the import runs them:\n\n  discover_register_type: finding the type of each register;\n  sanitize_field: copying and sanitizing the fields of each quote register;\n  quotes_list_append: converting each quote register to a quote node;\n  compare_quote_nodes: sorting quote nodes by stock and trading date;\n  merge_daily_quotes: merging, stock by stock, the last half of the quotes of the file onto its first three quarters (as imports merge overlapping files onto the database).\n\nEach kernel runs the warm-up rounds, then the timed repetitions; measures go to the standard output as JSON: nanoseconds and cycles per register or element, minimum and median across repetitions. Cycles are CPU cycles if performance counters are available, otherwise time stamp counter ticks (x86), otherwise not measured.\n\nTickers are loaded from the database, as the import does; the database is not modified.\n";
+
+static struct argp_option options[] = {
+
+	{"repetitions", 'n', "REPETITIONS",  0, "time REPETITIONS rounds of each kernel (default: 10).", 0 },
+	{"warmup", 'w', "ROUNDS",  0, "run ROUNDS untimed rounds of each kernel first (default: 2).", 0 },
+	{"kernel", 'k', "KERNEL",  0, "time only KERNEL.", 0 },
+	{"label", 'l', "LABEL",  0, "tag the measures with LABEL (the build being measured, for instance).", 0 },
+	{ 0 }
+
+};
+
+struct arguments {
+
+	long repetitions;
+	long warmup;
+	char *kernel;
+	char *label;
+
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+	char *aux_charp;
+
+	switch (key) {
+
+		case 'n':
+
+			arguments->repetitions = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->repetitions < 1)) {
+
+				argp_error (state, "invalid number of repetitions '%s'.", arg);
+
+			}
+			break;
+
+		case 'w':
+
+			arguments->warmup = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->warmup < 0)) {
+
+				argp_error (state, "invalid number of warm-up rounds '%s'.", arg);
+
+			}
+			break;
+
+		case 'k':
+
+			arguments->kernel = arg;
+			break;
+
+		case 'l':
+
+			for ( aux_charp = arg; *aux_charp != 0; aux_charp++ ) {
+
+				if ((*aux_charp < ' ') || (*aux_charp == '"') || (*aux_charp == '\\')) {
+
+					argp_error (state, "invalid label '%s': control characters, quotes and backslashes are not allowed.", arg);
+
+				}
+
+			}
+			arguments->label = arg;
+			break;
+
+		case ARGP_KEY_ARG:
+
+			argp_usage (state);
+			break;
+
+		default:
+
+			return (ARGP_ERR_UNKNOWN);
+
+	};
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, 0, doc };
+
+
+/*
+ * Kernels.
+ */
+
+#define KERNEL_DISCOVER_REGISTER_TYPE 0
+#define KERNEL_SANITIZE_FIELD 1
+#define KERNEL_QUOTES_LIST_APPEND 2
+#define KERNEL_COMPARE_QUOTE_NODES 3
+#define KERNEL_MERGE_DAILY_QUOTES 4
+#define KERNELS_SIZE 5
+
+static const char *kernel_names[KERNELS_SIZE] = {
+
+	"discover_register_type",
+	"sanitize_field",
+	"quotes_list_append",
+	"compare_quote_nodes",
+	"merge_daily_quotes"
+
+};
+
+
+/*
+ * Counter of cycles.
+ */
+
+#define CYCLE_COUNTER_NONE 0
+#define CYCLE_COUNTER_CPU 1
+#define CYCLE_COUNTER_TSC 2
+
+static const char *cycle_counter_names[] = { "none", "cpu", "tsc" };
+
+static unsigned int cycle_counter;	// One of CYCLE_COUNTER_*.
+static int cycle_counter_des;	// Performance counter, for CYCLE_COUNTER_CPU.
+
+
+/*
+ * Open the best counter of cycles available.
+ */
+
+void cycle_counter_open (void);
+
+
+/*
+ * Read the counter of cycles.
+ *
+ * @return cycles so far; 0 if not measured.
+ */
+
+uint64_t cycle_counter_read (void);
+
+
+/*
+ * Input of the kernels.
+ */
+
+struct workload {
+
+	unsigned int file_type;	// One of BOVESPA_FILE_TYPE_* values.
+	char *registers;	// Registers of the file, BOVESPA_REGISTER_LENGTH + 2 octets each.
+	size_t registers_size;	// How many registers.
+	unsigned int *register_types;	// Type of each register.
+	union bovespa_header_register header_register;	// Fields of the header register.
+	union bovespa_quote_register *quote_registers;	// Fields of each quote register.
+	bovespa_mapper_t *mappers;	// Mapper of each quote register.
+	size_t quote_registers_size;	// How many quote registers.
+	ticker_table_t *tickers;	// Tickers of the database.
+	quote_node_t **nodes;	// Quote nodes, in file order.
+	quote_node_t **sorted_nodes;	// Quote nodes, sorted (and room for sorting).
+	size_t nodes_size;	// How many quote nodes.
+	pfish_bovespa_daily_quote_t **a, **b;	// Daily quotes of all stocks: three quarters, then the last half of each.
+	size_t *stocks_offset;	// First daily quote of each stock in 'a' and 'b'.
+	size_t *stocks_a_size, *stocks_b_size;	// How many daily quotes of each stock in 'a' and 'b'.
+	size_t stocks_size;	// How many stocks.
+	pfish_bovespa_daily_quote_t ***merged;	// Merged daily quotes of each stock.
+
+};
+
+
+/*
+ * Prepare the input of the kernels from a Bovespa file.
+ *
+ * @param[in] stream Bovespa file.
+ * @param[out] workload input of the kernels.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int workload_load (FILE *stream, struct workload *workload);
+
+
+/*
+ * Run one round of a kernel.
+ *
+ * @param[in] kernel one of KERNEL_* values.
+ * @param[in,out] workload input of the kernels.
+ * @param[out] elements how many registers or elements the round went through.
+ * @param[out] nanoseconds elapsed time of the round.
+ * @param[out] cycles cycles of the round.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int kernel_run (unsigned int kernel, struct workload *workload, size_t *elements, uint64_t *nanoseconds, uint64_t *cycles);
+
+
+/*
+ * Compare two doubles, for qsort().
+ */
+
+int compare_doubles (const void *a, const void *b);
+
+
+/*
+ * Sink of kernel results, so that kernels are not optimized away.
+ */
+
+volatile uint64_t sink;
+
+
+/*
+ * The portal.
+ */
+
+#define SUCCESS return (EXIT_SUCCESS)
+#define FAILURE return (EXIT_FAILURE)
+
+int main (int argc, char **argv) {
+
+	struct arguments arguments;	// Arguments given in the command line.
+	struct workload workload;	// Input of the kernels.
+	double *per_element_ns;	// Nanoseconds per element of each repetition.
+	double *per_element_cycles;	// Cycles per element of each repetition.
+	size_t elements;	// Elements of a round.
+	uint64_t nanoseconds, cycles;	// Measures of a round.
+	unsigned int kernel;
+	unsigned int first;	// Not zero until the first kernel is reported.
+	long i;
+
+	/*
+	 * Begin.
+	 */
+
+	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	DEBUG ("start.");
+
+	/*
+	 * Parse command line arguments.
+	 */
+
+	arguments.repetitions = 10;
+	arguments.warmup = 2;
+	arguments.kernel = NULL;
+	arguments.label = "";
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+	if (arguments.kernel != NULL) {
+
+		for ( kernel = 0; (kernel < KERNELS_SIZE) && ((strcmp (arguments.kernel, kernel_names[kernel])) != 0); kernel++ );
+		if (kernel == KERNELS_SIZE) {
+
+			CRIT ("unknown kernel '%s'.", arguments.kernel);
+			FAILURE;
+
+		}
+
+	}
+
+	/*
+	 * Prepare.
+	 */
+
+	if ((workload_load (stdin, &workload)) < 0) {
+
+		CRIT ("cannot load Bovespa file.");
+		FAILURE;
+
+	}
+	if (((per_element_ns = (double *) malloc (arguments.repetitions * sizeof (double))) == NULL) || ((per_element_cycles = (double *) malloc (arguments.repetitions * sizeof (double))) == NULL)) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", arguments.repetitions * sizeof (double));
+		FAILURE;
+
+	}
+	cycle_counter_open ();
+
+	/*
+	 * Time the kernels, and report.
+	 */
+
+	printf ("{\n");
+	printf ("\t\"label\": \"%s\",\n", arguments.label);
+	printf ("\t\"version\": \"%s\",\n", PACKAGE_VERSION);
+	printf ("\t\"registers\": %zu,\n", workload.registers_size);
+	printf ("\t\"quote_registers\": %zu,\n", workload.quote_registers_size);
+	printf ("\t\"cycle_counter\": \"%s\",\n", cycle_counter_names[cycle_counter]);
+	printf ("\t\"kernels\": [\n");
+	first = 1;
+	for ( kernel = 0; kernel < KERNELS_SIZE; kernel++ ) {
+
+		if ((arguments.kernel != NULL) && ((strcmp (arguments.kernel, kernel_names[kernel])) != 0)) {
+
+			continue;
+
+		}
+		for ( i = 0; i < arguments.warmup; i++ ) {
+
+			if ((kernel_run (kernel, &workload, &elements, &nanoseconds, &cycles)) < 0) {
+
+				CRIT ("cannot run kernel '%s'.", kernel_names[kernel]);
+				FAILURE;
+
+			}
+
+		}
+		for ( i = 0; i < arguments.repetitions; i++ ) {
+
+			if ((kernel_run (kernel, &workload, &elements, &nanoseconds, &cycles)) < 0) {
+
+				CRIT ("cannot run kernel '%s'.", kernel_names[kernel]);
+				FAILURE;
+
+			}
+			per_element_ns[i] = (elements != 0) ? ((double) nanoseconds / elements) : 0;
+			per_element_cycles[i] = (elements != 0) ? ((double) cycles / elements) : 0;
+
+		}
+		qsort (per_element_ns, arguments.repetitions, sizeof (double), compare_doubles);
+		qsort (per_element_cycles, arguments.repetitions, sizeof (double), compare_doubles);
+		printf ("%s\t\t{\n", (first != 0) ? "" : ",\n");
+		printf ("\t\t\t\"name\": \"%s\",\n", kernel_names[kernel]);
+		printf ("\t\t\t\"elements\": %zu,\n", elements);
+		printf ("\t\t\t\"repetitions\": %ld,\n", arguments.repetitions);
+		printf ("\t\t\t\"ns_per_element_min\": %.3f,\n", per_element_ns[0]);
+		printf ("\t\t\t\"ns_per_element_median\": %.3f,\n", per_element_ns[arguments.repetitions / 2]);
+		if (cycle_counter != CYCLE_COUNTER_NONE) {
+
+			printf ("\t\t\t\"cycles_per_element_min\": %.2f,\n", per_element_cycles[0]);
+			printf ("\t\t\t\"cycles_per_element_median\": %.2f\n", per_element_cycles[arguments.repetitions / 2]);
+
+		}
+		else {
+
+			printf ("\t\t\t\"cycles_per_element_min\": null,\n");
+			printf ("\t\t\t\"cycles_per_element_median\": null\n");
+
+		}
+		printf ("\t\t}");
+		first = 0;
+
+	}
+	printf ("\n\t]\n");
+	printf ("}\n");
+	if ((fflush (stdout)) != 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot write to the standard output.");
+		FAILURE;
+
+	}
+
+	/*
+	 * End.
+	 * The workload is left to the end of the process.
+	 */
+
+	DEBUG ("end.");
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void cycle_counter_open (void) {
+
+	struct perf_event_attr attr;	// Performance counter of CPU cycles of this thread, user space only.
+
+	memset (&attr, 0, sizeof (struct perf_event_attr));
+	attr.size = sizeof (struct perf_event_attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	if ((cycle_counter_des = syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0)) >= 0) {
+
+		cycle_counter = CYCLE_COUNTER_CPU;
+		return;
+
+	}
+	DEBUG ("performance counters not available (%s).", strerror (errno));
+#if defined (__x86_64__) || defined (__i386__)
+	cycle_counter = CYCLE_COUNTER_TSC;
+#else
+	cycle_counter = CYCLE_COUNTER_NONE;
+#endif
+
+}
+
+
+uint64_t cycle_counter_read (void) {
+
+	uint64_t answer;
+
+	switch (cycle_counter) {
+
+		case CYCLE_COUNTER_CPU:
+
+			if ((read (cycle_counter_des, &answer, sizeof (uint64_t))) != sizeof (uint64_t)) {
+
+				answer = 0;
+
+			}
+			return (answer);
+
+#if defined (__x86_64__) || defined (__i386__)
+		case CYCLE_COUNTER_TSC:
+
+			return (__rdtsc ());
+#endif
+
+		default:
+
+			return (0);
+
+	}
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int workload_load (FILE *stream, struct workload *workload) {
+
+	char bovespa_register[BOVESPA_REGISTER_LENGTH + 2];	// A line of the Bovespa file.
+	size_t registers_room;	// How many registers fit in 'workload->registers'.
+	quote_node_t *last;	// Last quote node appended.
+	uint32_t *ranks;	// Rank by stock id of each ticker.
+	size_t stock_first;	// First sorted node of the current stock.
+	size_t quote_count;	// Daily quotes of the current stock.
+	size_t i, j;
+	void *aux_voidp;
+	int rcode;
+
+	/*
+	 * Registers.
+	 */
+
+	memset (workload, 0, sizeof (struct workload));
+	registers_room = 0;
+	while ((fgets (bovespa_register, BOVESPA_REGISTER_LENGTH, stream)) != NULL) {
+
+		if (workload->registers_size == registers_room) {
+
+			registers_room = (registers_room != 0) ? (registers_room * 2) : 0x10000;
+			if ((aux_voidp = realloc (workload->registers, registers_room * (BOVESPA_REGISTER_LENGTH + 2))) == NULL) {
+
+				ALERT ("cannot allocate %u bytes of heap space.", registers_room * (BOVESPA_REGISTER_LENGTH + 2));
+				FAILURE;
+
+			}
+			workload->registers = (char *) aux_voidp;
+
+		}
+		memcpy (workload->registers + (workload->registers_size++ * (BOVESPA_REGISTER_LENGTH + 2)), bovespa_register, BOVESPA_REGISTER_LENGTH + 2);
+
+	}
+	if (workload->registers_size == 0) {
+
+		CRIT ("empty Bovespa file.");
+		FAILURE;
+
+	}
+
+#define REGISTER(I) (workload->registers + ((I) * (BOVESPA_REGISTER_LENGTH + 2)))
+
+	if ((pfish_bovespa_discover_file_type (REGISTER (0), &(workload->file_type))) < 0) {
+
+		FAILURE;
+
+	}
+
+	/*
+	 * Types and fields of registers.
+	 */
+
+	if (((workload->register_types = (unsigned int *) malloc (workload->registers_size * sizeof (unsigned int))) == NULL) || ((workload->quote_registers = (union bovespa_quote_register *) malloc (workload->registers_size * sizeof (union bovespa_quote_register))) == NULL) || ((workload->mappers = (bovespa_mapper_t *) malloc (workload->registers_size * sizeof (bovespa_mapper_t))) == NULL)) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", workload->registers_size * sizeof (union bovespa_quote_register));
+		FAILURE;
+
+	}
+
+#define BOVESPA_FIELD(FIELD_NAME,FROM,TO) \
+	memcpy (UNION_NAME.STRUCT_NAME.FIELD_NAME, &bovespa_register[FROM - 1], TO - FROM + 1); \
+	UNION_NAME.STRUCT_NAME.FIELD_NAME[TO - FROM + 1] = 0; \
+	pfish_bovespa_sanitize_field (UNION_NAME.STRUCT_NAME.FIELD_NAME, TO - FROM + 1)
+
+	for ( i = 0; i < workload->registers_size; i++ ) {
+
+		if ((pfish_bovespa_discover_register_type (workload->file_type, REGISTER (i), &(workload->register_types[i]))) < 0) {
+
+			FAILURE;
+
+		}
+		memcpy (bovespa_register, REGISTER (i), BOVESPA_REGISTER_LENGTH + 2);
+		if (workload->register_types[i] == BOVESPA_FILE_SECTION_HEADER) {
+
+#define UNION_NAME workload->header_register
+
+			if (workload->file_type == BOVESPA_FILE_TYPE_HIST) {
+
+#define STRUCT_NAME hist
+				HIST_HEADER_REGISTER;
+#undef STRUCT_NAME
+
+			}
+			else {
+
+#define STRUCT_NAME bdin
+				BDIN_HEADER_REGISTER;
+#undef STRUCT_NAME
+
+			}
+
+#undef UNION_NAME
+
+		}
+		else if (workload->register_types[i] == BOVESPA_FILE_SECTION_QUOTES) {
+
+#define UNION_NAME workload->quote_registers[workload->quote_registers_size]
+
+			if (workload->file_type == BOVESPA_FILE_TYPE_HIST) {
+
+#define STRUCT_NAME hist
+				HIST_QUOTE_REGISTER;
+#undef STRUCT_NAME
+
+			}
+			else {
+
+#define STRUCT_NAME bdin
+				BDIN_QUOTE_REGISTER;
+#undef STRUCT_NAME
+
+			}
+
+#undef UNION_NAME
+
+			workload->quote_registers_size++;
+
+		}
+
+	}
+
+#undef BOVESPA_FIELD
+#undef REGISTER
+
+	for ( i = 0; i < workload->quote_registers_size; i++ ) {
+
+		if ((pfish_bovespa_mapper_bind (workload->file_type, &(workload->header_register), &(workload->quote_registers[i]), &(workload->mappers[i]))) < 0) {
+
+			FAILURE;
+
+		}
+
+	}
+
+	/*
+	 * Quote nodes.
+	 */
+
+	if ((pfish_bovespa_ticker_table_alloc (&(workload->tickers))) < 0) {
+
+		CRIT ("cannot load ticker dictionary.");
+		FAILURE;
+
+	}
+	if (((workload->nodes = (quote_node_t **) malloc ((workload->quote_registers_size + 1) * sizeof (quote_node_t *))) == NULL) || ((workload->sorted_nodes = (quote_node_t **) malloc ((workload->quote_registers_size + 1) * sizeof (quote_node_t *))) == NULL)) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (workload->quote_registers_size + 1) * sizeof (quote_node_t *));
+		FAILURE;
+
+	}
+	for ( i = 0; i < workload->quote_registers_size; i++ ) {
+
+		last = NULL;
+		if ((rcode = pfish_bovespa_quotes_list_append (&(workload->mappers[i]), workload->tickers, &last)) < 0) {
+
+			FAILURE;
+
+		}
+		if (rcode == 0) {
+
+			workload->nodes[workload->nodes_size++] = last;
+
+		}
+
+	}
+	if ((pfish_bovespa_ticker_table_ranks (workload->tickers, &ranks)) < 0) {
+
+		CRIT ("cannot rank tickers.");
+		FAILURE;
+
+	}
+	pfish_bovespa_quote_ticker_ranks = ranks;
+	memcpy (workload->sorted_nodes, workload->nodes, workload->nodes_size * sizeof (quote_node_t *));
+	qsort (workload->sorted_nodes, workload->nodes_size, sizeof (quote_node_t *), pfish_bovespa_compare_quote_nodes);
+
+	/*
+	 * Daily quotes to be merged, stock by stock: the first three quarters, and the last half.
+	 */
+
+	if (((workload->a = (pfish_bovespa_daily_quote_t **) malloc ((workload->nodes_size + 1) * sizeof (pfish_bovespa_daily_quote_t *))) == NULL) || ((workload->b = (pfish_bovespa_daily_quote_t **) malloc ((workload->nodes_size + 1) * sizeof (pfish_bovespa_daily_quote_t *))) == NULL) || ((workload->stocks_offset = (size_t *) malloc ((workload->nodes_size + 1) * sizeof (size_t))) == NULL) || ((workload->stocks_a_size = (size_t *) malloc ((workload->nodes_size + 1) * sizeof (size_t))) == NULL) || ((workload->stocks_b_size = (size_t *) malloc ((workload->nodes_size + 1) * sizeof (size_t))) == NULL) || ((workload->merged = (pfish_bovespa_daily_quote_t ***) malloc ((workload->nodes_size + 1) * sizeof (pfish_bovespa_daily_quote_t **))) == NULL)) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (workload->nodes_size + 1) * sizeof (pfish_bovespa_daily_quote_t *));
+		FAILURE;
+
+	}
+	for ( i = 0, j = 0, stock_first = 0; i <= workload->nodes_size; i++ ) {
+
+		if ((i < workload->nodes_size) && (ranks[workload->sorted_nodes[i]->ticker] == ranks[workload->sorted_nodes[stock_first]->ticker])) {
+
+			continue;
+
+		}
+		quote_count = i - stock_first;
+		workload->stocks_offset[workload->stocks_size] = stock_first;
+		workload->stocks_a_size[workload->stocks_size] = (quote_count * 3) / 4;
+		workload->stocks_b_size[workload->stocks_size] = quote_count / 2;
+		for ( j = 0; j < workload->stocks_a_size[workload->stocks_size]; j++ ) {
+
+			workload->a[stock_first + j] = &(workload->sorted_nodes[stock_first + j]->quote);
+
+		}
+		for ( j = 0; j < workload->stocks_b_size[workload->stocks_size]; j++ ) {
+
+			workload->b[stock_first + j] = &(workload->sorted_nodes[i - workload->stocks_b_size[workload->stocks_size] + j]->quote);
+
+		}
+		workload->stocks_size++;
+		stock_first = i;
+
+	}
+	DEBUG ("%u registers, %u quote registers, %u quote nodes, %u stocks.", workload->registers_size, workload->quote_registers_size, workload->nodes_size, workload->stocks_size);
+	SUCCESS;
+
+}
+
+
+int kernel_run (unsigned int kernel, struct workload *workload, size_t *elements, uint64_t *nanoseconds, uint64_t *cycles) {
+
+	char bovespa_register[BOVESPA_REGISTER_LENGTH + 2];	// A line of the Bovespa file.
+	union bovespa_quote_register quote_register;	// Fields of a quote register.
+	struct timespec start, stop;	// Elapsed time measurement.
+	uint64_t start_cycles, stop_cycles;	// Cycles measurement.
+	quote_node_t *last;	// Last quote node appended.
+	quote_node_t **nodes;	// Quote nodes appended in a round.
+	size_t nodes_size;	// How many elements in 'nodes'.
+	size_t merged_size;	// Merged daily quotes of a stock.
+	unsigned int register_type;
+	uint64_t accumulator;	// Results of the kernel, for the sink.
+	size_t i;
+	int rcode;
+
+	/*
+	 * Inputs not timed.
+	 */
+
+	nodes = NULL;
+	switch (kernel) {
+
+		case KERNEL_QUOTES_LIST_APPEND:
+
+			if ((nodes = (quote_node_t **) malloc ((workload->quote_registers_size + 1) * sizeof (quote_node_t *))) == NULL) {
+
+				ALERT ("cannot allocate %u bytes of heap space.", (workload->quote_registers_size + 1) * sizeof (quote_node_t *));
+				FAILURE;
+
+			}
+			break;
+
+		case KERNEL_COMPARE_QUOTE_NODES:
+
+			memcpy (workload->sorted_nodes, workload->nodes, workload->nodes_size * sizeof (quote_node_t *));
+			break;
+
+	}
+
+	/*
+	 * The kernel.
+	 */
+
+	accumulator = 0;
+	nodes_size = 0;
+	*elements = 0;
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	start_cycles = cycle_counter_read ();
+	switch (kernel) {
+
+		case KERNEL_DISCOVER_REGISTER_TYPE:
+
+			for ( i = 0; i < workload->registers_size; i++ ) {
+
+				if ((pfish_bovespa_discover_register_type (workload->file_type, workload->registers + (i * (BOVESPA_REGISTER_LENGTH + 2)), &register_type)) < 0) {
+
+					FAILURE;
+
+				}
+				accumulator += register_type;
+
+			}
+			*elements = workload->registers_size;
+			break;
+
+		case KERNEL_SANITIZE_FIELD:
+
+#define BOVESPA_FIELD(FIELD_NAME,FROM,TO) \
+	memcpy (quote_register.STRUCT_NAME.FIELD_NAME, &bovespa_register[FROM - 1], TO - FROM + 1); \
+	quote_register.STRUCT_NAME.FIELD_NAME[TO - FROM + 1] = 0; \
+	pfish_bovespa_sanitize_field (quote_register.STRUCT_NAME.FIELD_NAME, TO - FROM + 1)
+
+			for ( i = 0; i < workload->registers_size; i++ ) {
+
+				if (workload->register_types[i] != BOVESPA_FILE_SECTION_QUOTES) {
+
+					continue;
+
+				}
+				memcpy (bovespa_register, workload->registers + (i * (BOVESPA_REGISTER_LENGTH + 2)), BOVESPA_REGISTER_LENGTH + 2);
+				if (workload->file_type == BOVESPA_FILE_TYPE_HIST) {
+
+#define STRUCT_NAME hist
+					HIST_QUOTE_REGISTER;
+					accumulator += quote_register.hist.cod_neg[0];
+#undef STRUCT_NAME
+
+				}
+				else {
+
+#define STRUCT_NAME bdin
+					BDIN_QUOTE_REGISTER;
+					accumulator += quote_register.bdin.cod_neg[0];
+#undef STRUCT_NAME
+
+				}
+				(*elements)++;
+
+			}
+
+#undef BOVESPA_FIELD
+
+			break;
+
+		case KERNEL_QUOTES_LIST_APPEND:
+
+			for ( i = 0; i < workload->quote_registers_size; i++ ) {
+
+				last = NULL;
+				if ((rcode = pfish_bovespa_quotes_list_append (&(workload->mappers[i]), workload->tickers, &last)) < 0) {
+
+					FAILURE;
+
+				}
+				if (rcode == 0) {
+
+					nodes[nodes_size++] = last;
+
+				}
+
+			}
+			*elements = workload->quote_registers_size;
+			break;
+
+		case KERNEL_COMPARE_QUOTE_NODES:
+
+			qsort (workload->sorted_nodes, workload->nodes_size, sizeof (quote_node_t *), pfish_bovespa_compare_quote_nodes);
+			*elements = workload->nodes_size;
+			break;
+
+		case KERNEL_MERGE_DAILY_QUOTES:
+
+			for ( i = 0; i < workload->stocks_size; i++ ) {
+
+				if ((pfish_bovespa_merge_daily_quotes (workload->a + workload->stocks_offset[i], workload->stocks_a_size[i], workload->b + workload->stocks_offset[i], workload->stocks_b_size[i], &(workload->merged[i]), &merged_size)) < 0) {
+
+					FAILURE;
+
+				}
+				*elements += merged_size;
+				accumulator += merged_size;
+
+			}
+			break;
+
+	}
+	stop_cycles = cycle_counter_read ();
+	clock_gettime (CLOCK_MONOTONIC, &stop);
+	*nanoseconds = ((stop.tv_sec - start.tv_sec) * 1000000000ULL) + stop.tv_nsec - start.tv_nsec;
+	*cycles = stop_cycles - start_cycles;
+	sink += accumulator;
+
+	/*
+	 * Release outputs, not timed.
+	 */
+
+	switch (kernel) {
+
+		case KERNEL_QUOTES_LIST_APPEND:
+
+			for ( i = 0; i < nodes_size; i++ ) {
+
+				free (nodes[i]);
+
+			}
+			free (nodes);
+			break;
+
+		case KERNEL_MERGE_DAILY_QUOTES:
+
+			for ( i = 0; i < workload->stocks_size; i++ ) {
+
+				free (workload->merged[i]);
+
+			}
+			break;
+
+	}
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+int compare_doubles (const void *a, const void *b) {
+
+	double x = *((const double *) a);
+	double y = *((const double *) b);
+
+	return ((x > y) - (x < y));
+
+}
@@ -0,0 +1,182 @@
+/*
+ * metrics.c
+ *
+ * Runtime metrics of the library.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pilot_fish/bovespa.h>
+
+#include "metrics.h"
+
+
+/*
+ * Shards of the metrics, each one in its own cache lines.
+ */
+
+#define SHARDS_SIZE 64
+#define CACHE_LINE_SIZE 64
+
+struct shard {
+
+	pfish_bovespa_metrics_t metrics;
+
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+static struct shard shards[SHARDS_SIZE];
+static unsigned int next_shard;	// Next shard to be taken by a thread; taken atomically.
+static __thread pfish_bovespa_metrics_t *own_shard;	// Shard of this thread, once taken.
+static struct rusage loaded_usage;	// Resource usage of the process when the library was loaded.
+
+
+/*
+ * Sample the resource usage of the process when the library is loaded,
+ * so that page faults are answered from then on.
+ */
+
+static void __attribute__ ((constructor)) metrics_load () {
+
+	if ((getrusage (RUSAGE_SELF, &loaded_usage)) < 0) {
+
+		memset (&loaded_usage, 0, sizeof (struct rusage));
+
+	}
+
+}
+
+
+pfish_bovespa_metrics_t *pfish_bovespa_metrics_shard () {
+
+	if (own_shard == NULL) {
+
+		own_shard = &(shards[__sync_fetch_and_add (&next_shard, 1) % SHARDS_SIZE].metrics);
+
+	}
+	return (own_shard);
+
+}
+
+
+uint64_t pfish_bovespa_metrics_clock () {
+
+	struct timespec now;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return ((now.tv_sec * 1000000000ULL) + now.tv_nsec);
+
+}
+
+
+uint64_t pfish_bovespa_metrics_latency (uint64_t *histogram, uint64_t start) {
+
+	uint64_t latency;
+	unsigned int bucket;
+
+	latency = pfish_bovespa_metrics_clock () - start;
+	for ( bucket = 0; ((latency >> (bucket + 1)) != 0) && (bucket < (PFISH_BOVESPA_METRICS_HISTOGRAM_SIZE - 1)); bucket++ );
+	__sync_fetch_and_add (&(histogram[bucket]), 1);
+	return (latency);
+
+}
+
+
+void pfish_bovespa_metrics_get (pfish_bovespa_metrics_t *answer) {
+
+#define COUNTERS_SIZE (sizeof (pfish_bovespa_metrics_t) / sizeof (uint64_t))
+
+	const uint64_t *counters;	// Counters of a shard.
+	uint64_t *sums;	// Counters of the answer.
+	size_t i, j;
+	struct rusage usage;
+
+	memset (answer, 0, sizeof (pfish_bovespa_metrics_t));
+	sums = (uint64_t *) answer;
+	for ( i = 0; i < SHARDS_SIZE; i++ ) {
+
+		counters = (const uint64_t *) &(shards[i].metrics);
+		for ( j = 0; j < COUNTERS_SIZE; j++ ) {
+
+			sums[j] += counters[j];
+
+		}
+
+	}
+	if ((getrusage (RUSAGE_SELF, &usage)) == 0) {
+
+		answer->minor_page_faults = usage.ru_minflt - loaded_usage.ru_minflt;
+		answer->major_page_faults = usage.ru_majflt - loaded_usage.ru_majflt;
+
+	}
+
+#undef COUNTERS_SIZE
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int pfish_bovespa_metrics_print (FILE *stream) {
+
+	static const char *failure_names[PFISH_BOVESPA_FAILURES_SIZE] = { "revision", "io", "map", "corrupt", "cache", "memory" };
+	pfish_bovespa_metrics_t metrics;
+	size_t i;
+
+	pfish_bovespa_metrics_get (&metrics);
+
+#define COUNTER(NAME) fprintf (stream, #NAME " %llu\n", (unsigned long long) metrics.NAME)
+#define HISTOGRAM(NAME) \
+	fprintf (stream, #NAME); \
+	for ( i = 0; i < PFISH_BOVESPA_METRICS_HISTOGRAM_SIZE; i++ ) { \
+		if (metrics.NAME[i] != 0) { \
+			fprintf (stream, " %u:%llu", (unsigned int) i, (unsigned long long) metrics.NAME[i]); \
+		} \
+	} \
+	fprintf (stream, "\n")
+
+	COUNTER (history_allocs);
+	COUNTER (histories_not_found);
+	COUNTER (history_frees);
+	COUNTER (image_hits);
+	COUNTER (cache_hits);
+	COUNTER (cache_misses);
+	COUNTER (files_mapped);
+	COUNTER (bytes_mapped);
+	COUNTER (minor_page_faults);
+	COUNTER (major_page_faults);
+	COUNTER (revision_checks);
+	COUNTER (revision_check_nanoseconds);
+	COUNTER (stock_list_scans);
+	COUNTER (stock_list_entries);
+	for ( i = 0; i < PFISH_BOVESPA_FAILURES_SIZE; i++ ) {
+
+		fprintf (stream, "failures_%s %llu\n", failure_names[i], (unsigned long long) metrics.failures[i]);
+
+	}
+	HISTOGRAM (history_alloc_latency);
+	HISTOGRAM (revision_check_latency);
+	HISTOGRAM (stock_list_latency);
+
+#undef HISTOGRAM
+#undef COUNTER
+
+	if ((fflush (stream)) != 0) {
+
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
@@ -0,0 +1,57 @@
+/*
+ * metrics.h
+ * Runtime metrics of the library, counted in per-thread shards.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_METRICS_SEEN
+#define FILE_PFISH_BOVESPA_METRICS_SEEN
+
+#include <stdint.h>
+
+#include <pilot_fish/bovespa.h>
+
+
+/*
+ * Shard of the calling thread.
+ * Threads take shards round robin on their first update; threads beyond the number of shards share them,
+ * which is why shard updates are still atomic (but uncontended in the common case).
+ *
+ * @return metrics shard of the calling thread.
+ */
+
+pfish_bovespa_metrics_t *pfish_bovespa_metrics_shard ();
+
+
+/*
+ * Add to a counter (a member of pfish_bovespa_metrics_t) of the calling thread's shard.
+ */
+
+#define METRICS_ADD(COUNTER,VALUE) __sync_fetch_and_add (&(pfish_bovespa_metrics_shard ()->COUNTER), (VALUE))
+
+#define METRICS_FAILURE(CAUSE) METRICS_ADD (failures[CAUSE], 1)
+
+
+/*
+ * Monotonic clock, for latencies.
+ *
+ * @return nanoseconds since an arbitrary point.
+ */
+
+uint64_t pfish_bovespa_metrics_clock ();
+
+
+/*
+ * Count a latency in a histogram (a member of pfish_bovespa_metrics_t) of the calling thread's shard.
+ *
+ * @param[in,out] histogram histogram of the calling thread's shard.
+ * @param[in] start pfish_bovespa_metrics_clock() at the start of the operation.
+ *
+ * @return the latency, in nanoseconds.
+ */
+
+uint64_t pfish_bovespa_metrics_latency (uint64_t *histogram, uint64_t start);
+
+#define METRICS_LATENCY(HISTOGRAM,START) pfish_bovespa_metrics_latency (pfish_bovespa_metrics_shard ()->HISTOGRAM, (START))
+
+
+#endif	// FILE_PFISH_BOVESPA_METRICS_SEEN
@@ -0,0 +1,628 @@
+/*
+ * name_index.c
+ * Search index over stock ids and company short names.
+ *
+ * The index holds two sorted arrays of positions in a small text: one of the start of
+ * each field (prefix search) and one of every character (substring search, a suffix array).
+ * Either search is a pair of binary searches for the range of positions whose text starts
+ * with the searched text, followed by a walk through the range.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <syslog.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+#include <pilot_fish/bovespa.h>
+
+#include "crc32c.h"
+#include "revision_marker.h"
+#include "name_index.h"
+#include "snapshot.h"
+#include "async_log.h"
+
+
+/*
+ * Parts of a name index, given its header.
+ */
+
+#define NAMES(HEADER) ((pfish_bovespa_name_t *) ((HEADER) + 1))
+#define RECORDS(HEADER) ((uint32_t *) (NAMES (HEADER) + (HEADER)->names_size))
+#define PREFIXES(HEADER) (RECORDS (HEADER) + (HEADER)->names_size)
+#define SUFFIXES(HEADER) (PREFIXES (HEADER) + (HEADER)->prefixes_size)
+#define TEXT(HEADER) ((char *) (SUFFIXES (HEADER) + (HEADER)->suffixes_size))
+
+
+/*
+ * Mapped name index, kept between searches.
+ */
+
+static struct {
+
+	name_index_header_t *header;	// Mapped name index, NULL if not mapped.
+	struct stat index_stat;	// Status of the name index file at mapping time; mapping length is index_stat.st_size.
+	pthread_mutex_t mutex;	// Protects all of the above.
+
+} mapping = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+
+/*
+ * Text of the index being sorted; qsort() takes no context.
+ */
+
+static const char *sort_text;
+
+
+static int compare_positions (const void *a, const void *b) {
+
+	int rcode;
+
+	if ((rcode = strcmp (sort_text + *((const uint32_t *) a), sort_text + *((const uint32_t *) b))) != 0) {
+
+		return (rcode);
+
+	}
+	return ((*((const uint32_t *) a) > *((const uint32_t *) b)) - (*((const uint32_t *) a) < *((const uint32_t *) b)));
+
+}
+
+
+/*
+ * Append a field to the text of an index, folded to lower case.
+ *
+ * @return how many characters (not counting the terminating null character).
+ */
+
+static size_t fold_field (char *target, const char *field, size_t field_size) {
+
+	size_t i;
+
+	for ( i = 0; (i < field_size - 1) && (field[i] != 0); i++ ) {
+
+		target[i] = tolower ((unsigned char) field[i]);
+
+	}
+	target[i] = 0;
+	return (i);
+
+}
+
+
+/*
+ * Verify the sizes of a name index.
+ *
+ * @param[in] name name of the file, for logging.
+ * @param[in] header name index.
+ * @param[in] file_size octets of the name index.
+ *
+ * @return 0 if sizes agree, negative otherwise.
+ */
+
+static int name_index_check (const char *name, const name_index_header_t *header, size_t file_size) {
+
+	if ((file_size < sizeof (name_index_header_t)) || (header->magic != NAME_INDEX_MAGIC)) {
+
+		ERR ("name index '%s' has no valid header.", name);
+		return (-1);
+
+	}
+	if ((header->names_size > file_size) || (header->prefixes_size > file_size) || (header->suffixes_size > file_size) || (header->text_size > file_size) || (NAME_INDEX_SIZE (header) != file_size)) {
+
+		ERR ("name index '%s' size (%lu octets) disagrees with its header.", name, (unsigned long) file_size);
+		return (-1);
+
+	}
+	return (0);
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int pfish_bovespa_name_index_write (const char *pathname, const pfish_bovespa_name_t *names, size_t names_size) {
+
+	name_index_header_t header;	// Sizes of the index.
+	name_index_header_t *buffer;	// Whole file contents.
+	size_t file_size;	// Octets of the whole file.
+	char *text;	// Text of buffer.
+	uint32_t *prefix;	// Next prefix position of buffer.
+	uint32_t *suffix;	// Next suffix position of buffer.
+	size_t field_size;	// Characters of a field.
+	size_t position;	// Offset in text.
+	size_t i, j, k;	// Short term generic counters.
+	FILE *index_file;	// Stream to the file.
+
+	/*
+	 * Find out the sizes.
+	 */
+
+	memset (&header, 0, sizeof (name_index_header_t));
+	header.magic = NAME_INDEX_MAGIC;
+	header.names_size = names_size;
+	for ( i = 0; i < names_size; i++ ) {
+
+		field_size = strnlen (names[i].stock_id.id, PFISH_BOVESPA_CODNEG_SIZE - 1);
+		header.prefixes_size += (field_size != 0);
+		header.suffixes_size += field_size;
+		header.text_size += field_size + 1;
+		field_size = strnlen (names[i].name, PFISH_BOVESPA_NOMRES_SIZE - 1);
+		header.prefixes_size += (field_size != 0);
+		header.suffixes_size += field_size;
+		header.text_size += field_size + 1;
+
+	}
+	if (header.text_size > UINT32_MAX) {
+
+		ERR ("too many names to be indexed (%lu).", (unsigned long) names_size);
+		FAILURE;
+
+	}
+	file_size = NAME_INDEX_SIZE (&header);
+	if ((buffer = (name_index_header_t *) malloc (file_size)) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", file_size);
+		FAILURE;
+
+	}
+	memcpy (buffer, &header, sizeof (name_index_header_t));
+
+#undef FAILURE
+#define FAILURE \
+	free (buffer); \
+	return (-1)
+
+	/*
+	 * Fill names, records and text, collecting positions on the way.
+	 */
+
+	memcpy (NAMES (buffer), names, names_size * sizeof (pfish_bovespa_name_t));
+	text = TEXT (buffer);
+	prefix = PREFIXES (buffer);
+	suffix = SUFFIXES (buffer);
+	position = 0;
+	for ( i = 0; i < names_size; i++ ) {
+
+		RECORDS (buffer)[i] = position;
+		for ( k = 0; k < 2; k++ ) {
+
+			if (k == 0) {
+
+				field_size = fold_field (text + position, names[i].stock_id.id, PFISH_BOVESPA_CODNEG_SIZE);
+
+			}
+			else {
+
+				field_size = fold_field (text + position, names[i].name, PFISH_BOVESPA_NOMRES_SIZE);
+
+			}
+			if (field_size != 0) {
+
+				*(prefix++) = position;
+
+			}
+			for ( j = 0; j < field_size; j++ ) {
+
+				*(suffix++) = position + j;
+
+			}
+			position += field_size + 1;
+
+		}
+
+	}
+
+	/*
+	 * Sort positions by the text they start.
+	 */
+
+	sort_text = text;
+	qsort (PREFIXES (buffer), buffer->prefixes_size, sizeof (uint32_t), compare_positions);
+	qsort (SUFFIXES (buffer), buffer->suffixes_size, sizeof (uint32_t), compare_positions);
+	sort_text = NULL;
+	buffer->checksum = pfish_bovespa_crc32c (0, buffer + 1, file_size - sizeof (name_index_header_t));
+
+	/*
+	 * Write it.
+	 */
+
+	if ((index_file = fopen (pathname, "w")) == NULL) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s' in write mode.", pathname);
+		FAILURE;
+
+	}
+	if ((fwrite (buffer, file_size, 1, index_file)) != 1) {
+
+		ERRNO_ERR;
+		CRIT ("cannot write to file '%s'.", pathname);
+		fclose (index_file);
+		FAILURE;
+
+	}
+	if ((fclose (index_file)) != 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot close file '%s'.", pathname);
+		FAILURE;
+
+	}
+	free (buffer);
+
+#undef FAILURE
+#define FAILURE return (-1)
+
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_name_index_read (const char *pathname, pfish_bovespa_name_list_t **answer) {
+
+	FILE *index_file;	// Stream to the file.
+	struct stat index_stat;	// Status of the file.
+	name_index_header_t *buffer;	// Whole file contents.
+
+	if ((index_file = fopen (pathname, "r")) == NULL) {
+
+		switch (errno) {
+
+			case ENOENT:
+
+				*answer = NULL;
+				SUCCESS;
+
+			default:
+
+				ERRNO_ERR;
+				CRIT ("cannot open file '%s' in read mode.", pathname);
+				FAILURE;
+
+		}
+
+	}
+	if ((fstat (fileno (index_file), &index_stat)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot stat file '%s'.", pathname);
+		fclose (index_file);
+		FAILURE;
+
+	}
+	if ((buffer = (name_index_header_t *) malloc (index_stat.st_size + 1)) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", index_stat.st_size + 1);
+		fclose (index_file);
+		FAILURE;
+
+	}
+
+#define FREE \
+	free (buffer); \
+	fclose (index_file)
+
+	if ((index_stat.st_size != 0) && ((fread (buffer, index_stat.st_size, 1, index_file)) != 1)) {
+
+		ERR ("name index '%s' is truncated.", pathname);
+		FREE;
+		FAILURE;
+
+	}
+	if ((name_index_check (pathname, buffer, index_stat.st_size)) < 0) {
+
+		FREE;
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_crc32c (0, buffer + 1, index_stat.st_size - sizeof (name_index_header_t))) != buffer->checksum) {
+
+		ERR ("name index '%s' checksum mismatch.", pathname);
+		FREE;
+		FAILURE;
+
+	}
+	if ((*answer = (pfish_bovespa_name_list_t *) malloc (sizeof (pfish_bovespa_name_list_t) + (buffer->names_size * sizeof (pfish_bovespa_name_t)))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", sizeof (pfish_bovespa_name_list_t) + (buffer->names_size * sizeof (pfish_bovespa_name_t)));
+		FREE;
+		FAILURE;
+
+	}
+	(*answer)->name_list_size = buffer->names_size;
+	memcpy ((*answer)->name_list, NAMES (buffer), buffer->names_size * sizeof (pfish_bovespa_name_t));
+	FREE;
+	SUCCESS;
+
+#undef FREE
+
+}
+
+
+/*
+ * Make sure the current name index is mapped; mapping mutex must be held.
+ *
+ * @return 0 on success (mapping.header is NULL if there is no name index), negative on failure.
+ */
+
+static int name_index_map () {
+
+	struct stat index_stat;	// Status of the name index file.
+	int index_des;	// Name index file descriptor.
+	name_index_header_t *header;	// Fresh mapping.
+	char pathname[PATH_MAX];	// Pathname of the file, possibly in the pinned generation.
+
+	if ((pfish_bovespa_snapshot_pathname (NAME_INDEX_FILE, pathname)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((stat (pathname, &index_stat)) < 0) {
+
+		if (errno != ENOENT) {
+
+			ERRNO_ERR;
+			CRIT ("cannot stat file '%s'.", pathname);
+			FAILURE;
+
+		}
+		memset (&index_stat, 0, sizeof (struct stat));
+
+	}
+	if ((mapping.header != NULL) && (mapping.index_stat.st_dev == index_stat.st_dev) && (mapping.index_stat.st_ino == index_stat.st_ino) && (mapping.index_stat.st_size == index_stat.st_size) && (mapping.index_stat.st_mtim.tv_sec == index_stat.st_mtim.tv_sec) && (mapping.index_stat.st_mtim.tv_nsec == index_stat.st_mtim.tv_nsec)) {
+
+		SUCCESS;
+
+	}
+
+	/*
+	 * Name index replaced (or gone) since last mapping.
+	 */
+
+	if (mapping.header != NULL) {
+
+		munmap (mapping.header, mapping.index_stat.st_size);
+		mapping.header = NULL;
+
+	}
+	if (index_stat.st_ino == 0) {
+
+		SUCCESS;
+
+	}
+	if ((pfish_bovespa_revision_marker_check ()) < 0) {
+
+		ALERT ("database revision mismatch; please reinitialize it.");
+		FAILURE;
+
+	}
+	if ((index_des = open (pathname, O_RDONLY)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s'.", pathname);
+		FAILURE;
+
+	}
+	if ((fstat (index_des, &index_stat)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot stat file descriptor '%d'.", index_des);
+		close (index_des);
+		FAILURE;
+
+	}
+	if ((index_stat.st_size < sizeof (name_index_header_t)) || ((header = (name_index_header_t *) mmap (NULL, index_stat.st_size, PROT_READ, MAP_PRIVATE, index_des, 0)) == (name_index_header_t *) (-1))) {
+
+		CRIT ("cannot memory-map file '%s'.", pathname);
+		close (index_des);
+		FAILURE;
+
+	}
+	close (index_des);
+	if ((name_index_check (pathname, header, index_stat.st_size)) < 0) {
+
+		CRIT ("name index '%s' is corrupt; please run pfish_bovespa_fsck.", pathname);
+		munmap (header, index_stat.st_size);
+		FAILURE;
+
+	}
+	mapping.header = header;
+	memcpy (&(mapping.index_stat), &index_stat, sizeof (struct stat));
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_name_search (const char *text, unsigned int mode, pfish_bovespa_name_list_t **answer) {
+
+	char key[PFISH_BOVESPA_NOMRES_SIZE];	// Searched text, folded to lower case.
+	size_t key_size;	// Characters of key.
+	const uint32_t *positions;	// Prefix or suffix positions of the index.
+	size_t positions_size;	// How many elements in positions[].
+	size_t first, last;	// Range of positions[] that start with key.
+	size_t low, high, middle;	// Binary search.
+	unsigned char *found;	// One bit per name of the index.
+	size_t found_size;	// How many names found.
+	size_t i, j;	// Short term generic counters.
+
+	if ((mode != PFISH_BOVESPA_SEARCH_PREFIX) && (mode != PFISH_BOVESPA_SEARCH_SUBSTRING)) {
+
+		ERR ("unknown search mode '%u'.", mode);
+		FAILURE;
+
+	}
+	if ((pthread_mutex_lock (&(mapping.mutex))) != 0) {
+
+		CRIT ("cannot lock name index mutex.");
+		FAILURE;
+
+	}
+
+#undef FAILURE
+#define FAILURE \
+	pthread_mutex_unlock (&(mapping.mutex)); \
+	return (-1)
+
+	if ((name_index_map ()) < 0) {
+
+		FAILURE;
+
+	}
+
+#define HEADER mapping.header
+#define INDEX_TEXT (TEXT (HEADER))
+
+	/*
+	 * Find the range of positions that start with the searched text.
+	 * Texts longer than any field match nothing.
+	 */
+
+	first = last = 0;
+	key_size = strlen (text);
+	if ((HEADER != NULL) && (key_size < PFISH_BOVESPA_NOMRES_SIZE)) {
+
+		fold_field (key, text, PFISH_BOVESPA_NOMRES_SIZE);
+		if (mode == PFISH_BOVESPA_SEARCH_PREFIX) {
+
+			positions = PREFIXES (HEADER);
+			positions_size = HEADER->prefixes_size;
+
+		}
+		else {
+
+			positions = SUFFIXES (HEADER);
+			positions_size = HEADER->suffixes_size;
+
+		}
+		low = 0;
+		high = positions_size;
+		while (low < high) {
+
+			middle = low + ((high - low) / 2);
+			if ((strncmp (INDEX_TEXT + positions[middle], key, key_size)) < 0) {
+
+				low = middle + 1;
+
+			}
+			else {
+
+				high = middle;
+
+			}
+
+		}
+		first = low;
+		high = positions_size;
+		while (low < high) {
+
+			middle = low + ((high - low) / 2);
+			if ((strncmp (INDEX_TEXT + positions[middle], key, key_size)) <= 0) {
+
+				low = middle + 1;
+
+			}
+			else {
+
+				high = middle;
+
+			}
+
+		}
+		last = low;
+
+	}
+
+	/*
+	 * Mark the names owning each position of the range.
+	 */
+
+	found_size = 0;
+	found = NULL;
+	if (first < last) {
+
+		if ((found = (unsigned char *) calloc ((HEADER->names_size + 7) / 8, 1)) == NULL) {
+
+			ALERT ("cannot allocate %u bytes of heap space.", (HEADER->names_size + 7) / 8);
+			FAILURE;
+
+		}
+		for ( i = first; i < last; i++ ) {
+
+			low = 0;
+			high = HEADER->names_size;
+			while (low < high) {
+
+				middle = low + ((high - low) / 2);
+				if (RECORDS (HEADER)[middle] <= positions[i]) {
+
+					low = middle + 1;
+
+				}
+				else {
+
+					high = middle;
+
+				}
+
+			}
+			j = low - 1;
+			if ((found[j / 8] & (1 << (j % 8))) == 0) {
+
+				found[j / 8] |= 1 << (j % 8);
+				found_size++;
+
+			}
+
+		}
+
+	}
+
+	/*
+	 * Copy marked names out, in stock id order.
+	 */
+
+	if ((*answer = (pfish_bovespa_name_list_t *) malloc (sizeof (pfish_bovespa_name_list_t) + (found_size * sizeof (pfish_bovespa_name_t)))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", sizeof (pfish_bovespa_name_list_t) + (found_size * sizeof (pfish_bovespa_name_t)));
+		free (found);
+		FAILURE;
+
+	}
+	(*answer)->name_list_size = 0;
+	for ( j = 0; (*answer)->name_list_size < found_size; j++ ) {
+
+		if ((found[j / 8] & (1 << (j % 8))) != 0) {
+
+			memcpy (&((*answer)->name_list[(*answer)->name_list_size++]), &(NAMES (HEADER)[j]), sizeof (pfish_bovespa_name_t));
+
+		}
+
+	}
+	free (found);
+
+#undef INDEX_TEXT
+#undef HEADER
+
+	pthread_mutex_unlock (&(mapping.mutex));
+
+#undef FAILURE
+#define FAILURE return (-1)
+
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
@@ -0,0 +1,75 @@
+/*
+ * name_index.h
+ * Search index over stock ids and company short names.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_NAME_INDEX_SEEN
+#define FILE_PFISH_BOVESPA_NAME_INDEX_SEEN
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pilot_fish/bovespa.h>
+
+
+/*
+ * Name index file layout:
+ *
+ * 	- a header;
+ * 	- names_size names (pfish_bovespa_name_t), ordered by stock id;
+ * 	- names_size record offsets (uint32_t): offset in text of the record of each name;
+ * 	- prefixes_size prefix positions (uint32_t): offsets in text of each nonempty field, ordered by the field they start;
+ * 	- suffixes_size suffix positions (uint32_t): offsets in text of each character, ordered by the suffix they start;
+ * 	- text_size octets of text: one record per name, made of the stock id and the company short name,
+ * 	  both folded to lower case and terminated by a null character.
+ *
+ * Suffixes end at the null character of their field, so matches never cross fields.
+ */
+
+#define NAME_INDEX_FILE DBPATH "/.name_index"
+#define NAME_INDEX_MAGIC 0x584E4250
+
+struct name_index_header {
+
+	uint32_t magic;	// NAME_INDEX_MAGIC.
+	uint32_t checksum;	// CRC-32C checksum of everything after the header.
+	uint64_t names_size;	// How many names.
+	uint64_t prefixes_size;	// How many prefix positions.
+	uint64_t suffixes_size;	// How many suffix positions.
+	uint64_t text_size;	// Octets of text.
+
+};
+
+typedef struct name_index_header name_index_header_t;
+
+#define NAME_INDEX_SIZE(HEADER) (sizeof (name_index_header_t) + ((HEADER)->names_size * (sizeof (pfish_bovespa_name_t) + sizeof (uint32_t))) + (((HEADER)->prefixes_size + (HEADER)->suffixes_size) * sizeof (uint32_t)) + (HEADER)->text_size)
+
+
+/*
+ * Write a name index file.
+ * Not reentrant.
+ *
+ * @param[in] pathname full pathname of the file.
+ * @param[in] names names to be indexed, ordered by stock id.
+ * @param[in] names_size how many elements in 'names'.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_name_index_write (const char *pathname, const pfish_bovespa_name_t *names, size_t names_size);
+
+
+/*
+ * Read the names of a name index file.
+ * The whole file is verified against its checksum.
+ *
+ * @param[in] pathname full pathname of the file.
+ * @param[out] answer dynamically allocated list of names if file exists, NULL otherwise; release it with free().
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_name_index_read (const char *pathname, pfish_bovespa_name_list_t **answer);
+
+
+#endif	// FILE_PFISH_BOVESPA_NAME_INDEX_SEEN
@@ -15,6 +15,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <limits.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 
@@ -24,6 +25,14 @@
 #include <pilot_fish/bovespa.h>
 
 #include "revision_marker.h"
+#include "image.h"
+#include "stock_file.h"
+#include "view_kernel.h"
+#include "history_cache.h"
+#include "snapshot.h"
+#include "metrics.h"
+#include "tracepoints.h"
+#include "async_log.h"
 
 
 void pfish_bovespa_library_info_get (pfish_bovespa_library_info_t *target) {
@@ -52,16 +61,57 @@ int pfish_bovespa_stock_list_alloc_selector (const struct dirent *dirent) {
 }
 
 
-pfish_bovespa_stock_list_t *pfish_bovespa_stock_list_alloc () {
+/*
+ * Build the stock list, from the database image or the database directory.
+ *
+ * @return dynamically allocated stock list, NULL on failure.
+ */
+
+static pfish_bovespa_stock_list_t *stock_list_build () {
 
 	pfish_bovespa_stock_list_t *answer;	// The answer.
 	size_t answer_size;	// Number of octets of the answer.
 
+	char directory[PATH_MAX];	// Database directory, possibly of the pinned generation.
 	struct dirent **namelist;	// List of stock files.
 	int namelist_size;	// Size of stock file list.
 
 	size_t i;	// Short term generic counter.
 
+	/*
+	 * Serve the list from the database image, if attached.
+	 * Raw view entries come first in the image directory.
+	 */
+
+	if (pfish_bovespa_image != NULL) {
+
+		for ( namelist_size = 0; namelist_size < pfish_bovespa_image->directory_size; namelist_size++ ) {
+
+			if (pfish_bovespa_image->directory[namelist_size].view != PFISH_BOVESPA_VIEW_RAW) {
+
+				break;
+
+			}
+
+		}
+		answer_size = sizeof (size_t) + (sizeof (pfish_bovespa_stock_id_t) * namelist_size);
+		if ((answer = (pfish_bovespa_stock_list_t *) malloc (answer_size)) == NULL) {
+
+			EMERG ("cannot allocate %u octets from heap.", answer_size);
+			METRICS_FAILURE (PFISH_BOVESPA_FAILURE_MEMORY);
+			return (NULL);
+
+		}
+		answer->stock_list_size = namelist_size;
+		for ( i = 0; i < namelist_size; i++ ) {
+
+			memcpy (&(answer->stock_list[i]), &(pfish_bovespa_image->directory[i].stock_id), sizeof (pfish_bovespa_stock_id_t));
+
+		}
+		return (answer);
+
+	}
+
 	/*
 	 * Check database revision.
 	 */
@@ -78,13 +128,21 @@ pfish_bovespa_stock_list_t *pfish_bovespa_stock_list_alloc () {
 	 * Have the file list sorted.
 	 */
 
-	if ((namelist_size = scandir (DBPATH, &namelist, pfish_bovespa_stock_list_alloc_selector, alphasort)) < 0) {
+	if ((pfish_bovespa_snapshot_pathname (DBPATH, directory)) < 0) {
+
+		return (NULL);
+
+	}
+	if ((namelist_size = scandir (directory, &namelist, pfish_bovespa_stock_list_alloc_selector, alphasort)) < 0) {
 
 		ERRNO_ERR;
-		CRIT ("cannot scan directory '%s'.", DBPATH);
+		CRIT ("cannot scan directory '%s'.", directory);
+		METRICS_FAILURE (PFISH_BOVESPA_FAILURE_IO);
 		return (NULL);
 
 	}
+	METRICS_ADD (stock_list_scans, 1);
+	METRICS_ADD (stock_list_entries, namelist_size);
 
 	/*
 	 * Compose the answer with the filenames of the scanned directory.
@@ -94,6 +152,7 @@ pfish_bovespa_stock_list_t *pfish_bovespa_stock_list_alloc () {
 	if ((answer = (pfish_bovespa_stock_list_t *) malloc (answer_size)) == NULL) {
 
 		EMERG ("cannot allocate %u octets from heap.", answer_size);
+		METRICS_FAILURE (PFISH_BOVESPA_FAILURE_MEMORY);
 		return (NULL);
 
 	}
@@ -125,21 +184,89 @@ pfish_bovespa_stock_list_t *pfish_bovespa_stock_list_alloc () {
 }
 
 
+pfish_bovespa_stock_list_t *pfish_bovespa_stock_list_alloc () {
+
+	pfish_bovespa_stock_list_t *answer;
+	uint64_t start;	// Start of the allocation, for metrics.
+
+	start = pfish_bovespa_metrics_clock ();
+	answer = stock_list_build ();
+	METRICS_LATENCY (stock_list_latency, start);
+	return (answer);
+
+}
+
+
 #define SUCCESS return (0)
 #define FAILURE return (-1)
 
-int pfish_bovespa_stock_history_alloc (const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_stock_history_t **answer) {
+/*
+ * Retrieve a stock history from the database image, the cache or the stock file.
+ *
+ * @param[in] stock_id stock identification.
+ * @param[in] view one of PFISH_BOVESPA_VIEW_* values.
+ * @param[out] answer stock history if stock exists in database, NULL otherwise.
+ * @param[in] revision_checked nonzero if the caller already checked the database revision.
+ * @param[out] mapped if not NULL, nonzero if the stock file had to be mapped (neither image nor cache served it).
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+static int stock_history_find (const pfish_bovespa_stock_id_t *stock_id, unsigned int view, pfish_bovespa_stock_history_t **answer, unsigned int revision_checked, unsigned int *mapped) {
 
-	size_t dbpath_len;
 	char stock_file_name[PATH_MAX];
-	int stock_file_des;
 	struct stat stock_file_stat;
+	const image_entry_t *image_entry;
+	int rcode;
+
+	/*
+	 * Serve the history from the database image, if attached.
+	 * Revision was already checked at attachment.
+	 */
+
+	if (pfish_bovespa_image != NULL) {
+
+		if ((image_entry = pfish_bovespa_image_lookup (stock_id, view)) == NULL) {
+
+			DEBUG("stock '%s' does not exist in database image.", stock_id->id);
+			*answer = NULL;
+			SUCCESS;
+
+		}
+		*answer = (pfish_bovespa_stock_history_t *) ((const char *) pfish_bovespa_image + image_entry->offset);
+		METRICS_ADD (image_hits, 1);
+		SUCCESS;
+
+	}
+
+	/*
+	 * Serve the history from the cache, if enabled and still valid.
+	 */
+
+	if ((pfish_bovespa_cache_enabled ()) != 0) {
+
+		if ((rcode = pfish_bovespa_cache_lookup (stock_id, view, answer)) < 0) {
+
+			CRIT ("cannot look up stock '%s' in cache.", stock_id->id);
+			METRICS_FAILURE (PFISH_BOVESPA_FAILURE_CACHE);
+			FAILURE;
+
+		}
+		if (rcode == 0) {
+
+			METRICS_ADD (cache_hits, 1);
+			SUCCESS;
+
+		}
+		METRICS_ADD (cache_misses, 1);
+
+	}
 
 	/*
 	 * Check database revision.
 	 */
 
-	if ((pfish_bovespa_revision_marker_check ()) < 0) {
+	if ((revision_checked == 0) && ((pfish_bovespa_revision_marker_check ()) < 0)) {
 
 		ALERT ("database revision mismatch; please reinitialize it.");
 		FAILURE;
@@ -147,70 +274,352 @@ int pfish_bovespa_stock_history_alloc (const pfish_bovespa_stock_id_t *stock_id,
 	}
 
 	/*
-	 * Build the full pathname of the stock file.
+	 * Map the stock file.
 	 */
 
-	if ((snprintf (stock_file_name, PATH_MAX, "%s/%s", DBPATH, stock_id->id)) >= PATH_MAX) {
+	if ((pfish_bovespa_stock_file_pathname (stock_id, view, stock_file_name)) < 0) {
+
+		FAILURE;
+
+	}
+	if (mapped != NULL) {
+
+		*mapped = 1;
 
-		ALERT ("pathname buffer overflow.");
+	}
+	if ((pfish_bovespa_stock_file_map (stock_file_name, answer, &stock_file_stat)) < 0) {
+
+		CRIT ("cannot map file of stock '%s'.", stock_id->id);
 		FAILURE;
 
 	}
-	DEBUG ("stock_file_name = '%s'", stock_file_name);
+	if ((*answer != NULL) && ((pfish_bovespa_cache_enabled ()) != 0)) {
+
+		if ((pfish_bovespa_cache_insert (stock_id, view, answer, &stock_file_stat)) < 0) {
+
+			CRIT ("cannot insert stock '%s' in cache.", stock_id->id);
+			METRICS_FAILURE (PFISH_BOVESPA_FAILURE_CACHE);
+			FAILURE;
+
+		}
+
+	}
 
 	/*
-	 * "Just" mmap.
+	 * All set.
 	 */
 
-	if ((stock_file_des = open (stock_file_name, O_RDONLY | O_EXCL)) < 0) {
+	SUCCESS;
+
+}
+
+
+/*
+ * Retrieve a stock history (see stock_history_find()), and count it in metrics.
+ */
+
+TRACE_SEMAPHORE (history__alloc);
+
+static int stock_history_load (const pfish_bovespa_stock_id_t *stock_id, unsigned int view, pfish_bovespa_stock_history_t **answer, unsigned int revision_checked, unsigned int *mapped) {
+
+	uint64_t start;	// Start of the allocation, for metrics.
+	uint64_t latency;	// Latency of the allocation.
+	int rcode;
+
+	start = pfish_bovespa_metrics_clock ();
+	rcode = stock_history_find (stock_id, view, answer, revision_checked, mapped);
+	latency = METRICS_LATENCY (history_alloc_latency, start);
+	METRICS_ADD (history_allocs, 1);
+	if ((rcode == 0) && (*answer == NULL)) {
+
+		METRICS_ADD (histories_not_found, 1);
+
+	}
+	if (TRACE_ENABLED (history__alloc)) {
+
+		TRACE5 (history__alloc, stock_id->id, view, ((rcode == 0) && (*answer != NULL)) ? (long) (*answer)->daily_quotes_size : -1L, rcode, latency);
+
+	}
+	return (rcode);
+
+}
+
+
+int pfish_bovespa_stock_history_alloc (const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_stock_history_t **answer) {
+
+	return (stock_history_load (stock_id, PFISH_BOVESPA_VIEW_RAW, answer, 0, NULL));
+
+}
+
+
+int pfish_bovespa_stock_history_alloc_view (const pfish_bovespa_stock_id_t *stock_id, unsigned int view, pfish_bovespa_stock_history_t **answer) {
+
+	return (stock_history_load (stock_id, view, answer, 0, NULL));
+
+}
 
-		switch (errno) {
 
-			case ENOENT:
+int pfish_bovespa_stock_history_alloc_ticker (pfish_bovespa_ticker_t ticker, unsigned int view, pfish_bovespa_stock_history_t **answer) {
+
+	pfish_bovespa_stock_id_t stock_id;
+
+	if ((pfish_bovespa_ticker_stock (ticker, &stock_id)) < 0) {
+
+		return (-1);
+
+	}
+	if (stock_id.id[0] == 0) {
+
+		*answer = NULL;
+		return (0);
+
+	}
+	return (stock_history_load (&stock_id, view, answer, 0, NULL));
+
+}
+
+
+/*
+ * Shared state of a batch load.
+ */
 
-				/*
-				 * Stock file does not exist in database directory.
-				 * By definition this is not a failure.
-				 */
+struct batch_load {
 
-				DEBUG("stock '%s' does not exist in database.", stock_id->id);
-				*answer = NULL;
-				SUCCESS;
+	const pfish_bovespa_stock_id_t *stock_ids;
+	size_t stock_ids_size;
+	pfish_bovespa_stock_history_t **answers;
+	int *statuses;
+	size_t next;	// Next stock to be loaded; taken atomically by workers.
 
-			default:
+};
 
-				ERRNO_ERR;
-				CRIT ("cannot open file '%s'.", stock_file_name);
-				FAILURE;
+
+/*
+ * Pool of helper threads of batch loads.
+ * Helpers are started on demand and live as long as the process; they serve one batch at a time.
+ */
+
+#define BATCH_LOAD_MAX_THREADS 0x20
+
+static struct {
+
+	pthread_mutex_t submit;	// Held by the thread whose batch owns the pool.
+	pthread_mutex_t mutex;	// Protects all of the below.
+	pthread_cond_t wake;	// Signaled when a batch is offered to helpers.
+	pthread_cond_t idle;	// Signaled when the last busy helper leaves a batch.
+	struct batch_load *batch;	// Batch offered to helpers, NULL if none.
+	unsigned long serial;	// Serial number of the last offered batch.
+	size_t threads_size;	// How many helpers were started.
+	size_t busy;	// How many helpers work on the offered batch.
+
+} batch_pool = { .submit = PTHREAD_MUTEX_INITIALIZER, .mutex = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER, .idle = PTHREAD_COND_INITIALIZER };
+
+
+/*
+ * Load stocks of a batch until none is left.
+ *
+ * @param[in,out] batch shared state of the batch.
+ * @param[out] mapped if not NULL, set nonzero once a stock file had to be mapped.
+ */
+
+static void batch_load_work (struct batch_load *batch, unsigned int *mapped) {
+
+	size_t i;
+
+	while ((i = __sync_fetch_and_add (&(batch->next), 1)) < batch->stock_ids_size) {
+
+		if ((batch->statuses[i] = stock_history_load (&(batch->stock_ids[i]), PFISH_BOVESPA_VIEW_RAW, &(batch->answers[i]), 1, mapped)) < 0) {
+
+			batch->answers[i] = NULL;
+
+		}
+		if ((mapped != NULL) && (*mapped != 0)) {
+
+			return;
 
 		}
 
 	}
-	if ((fstat (stock_file_des, &stock_file_stat)) < 0) {
 
-		ERRNO_ERR;
-		CRIT ("cannot stat file descriptor '%d'.", stock_file_des);
-		FAILURE;
+}
+
+
+static void *batch_load_helper (void *arg) {
+
+	struct batch_load *batch;	// Batch being served.
+	unsigned long serial;	// Serial number of the last batch served.
+
+	serial = 0;	// Helpers start within an offer, so they join the offered batch.
+	pthread_mutex_lock (&batch_pool.mutex);
+	while (1) {
+
+		while ((batch_pool.batch == NULL) || (batch_pool.serial == serial)) {
+
+			pthread_cond_wait (&batch_pool.wake, &batch_pool.mutex);
+
+		}
+		batch = batch_pool.batch;
+		serial = batch_pool.serial;
+		batch_pool.busy++;
+		pthread_mutex_unlock (&batch_pool.mutex);
+		batch_load_work (batch, NULL);
+		pthread_mutex_lock (&batch_pool.mutex);
+		if (--batch_pool.busy == 0) {
+
+			pthread_cond_signal (&batch_pool.idle);
+
+		}
 
 	}
-	if ((*answer = (pfish_bovespa_stock_history_t *) mmap (NULL, stock_file_stat.st_size, PROT_READ, MAP_PRIVATE, stock_file_des, 0)) == (pfish_bovespa_stock_history_t *) (-1)) {
+	return (NULL);
 
-		ERRNO_ERR;
-		CRIT ("cannot memory-map file descriptor '%d'.", stock_file_des);
+}
+
+
+/*
+ * Offer a batch to the pool, starting helpers up to the wanted count; pool must be owned.
+ *
+ * @param[in] batch shared state of the batch.
+ * @param[in] threads_size how many helpers are wanted.
+ */
+
+static void batch_pool_offer (struct batch_load *batch, size_t threads_size) {
+
+	pthread_attr_t attributes;	// Helpers are detached.
+	pthread_t thread;	// Started helper.
+
+	pthread_mutex_lock (&batch_pool.mutex);
+	if (batch_pool.threads_size < threads_size) {
+
+		pthread_attr_init (&attributes);
+		pthread_attr_setdetachstate (&attributes, PTHREAD_CREATE_DETACHED);
+		while (batch_pool.threads_size < threads_size) {
+
+			if ((pthread_create (&thread, &attributes, batch_load_helper, NULL)) != 0) {
+
+				WARNING ("cannot start batch load thread; going on with %u helpers.", batch_pool.threads_size);
+				break;
+
+			}
+			batch_pool.threads_size++;
+
+		}
+		pthread_attr_destroy (&attributes);
+
+	}
+	batch_pool.batch = batch;
+	batch_pool.serial++;
+	pthread_cond_broadcast (&batch_pool.wake);
+	pthread_mutex_unlock (&batch_pool.mutex);
+
+}
+
+
+/*
+ * Withdraw the offered batch and wait for helpers working on it; pool must be owned.
+ */
+
+static void batch_pool_withdraw () {
+
+	pthread_mutex_lock (&batch_pool.mutex);
+	batch_pool.batch = NULL;
+	while (batch_pool.busy != 0) {
+
+		pthread_cond_wait (&batch_pool.idle, &batch_pool.mutex);
+
+	}
+	pthread_mutex_unlock (&batch_pool.mutex);
+
+}
+
+
+int pfish_bovespa_stock_history_alloc_many (const pfish_bovespa_stock_id_t *stock_ids, size_t stock_ids_size, pfish_bovespa_stock_history_t **answers, int *statuses) {
+
+	struct batch_load batch;	// Work shared among threads.
+	unsigned int mapped;	// Nonzero once the calling thread had to map a stock file.
+	unsigned int pooled;	// Nonzero if the pool is owned by this batch.
+	size_t threads_size;	// How many helpers are wanted.
+	size_t failures_size;	// How many stocks failed.
+	long cpus;	// Online processors.
+	size_t i;	// Short term generic counter.
+
+	/*
+	 * Check database revision once for the whole batch.
+	 */
+
+	if ((pfish_bovespa_image == NULL) && ((pfish_bovespa_revision_marker_check ()) < 0)) {
+
+		ALERT ("database revision mismatch; please reinitialize it.");
+		for ( i = 0; i < stock_ids_size; i++ ) {
+
+			answers[i] = NULL;
+			statuses[i] = -1;
+
+		}
 		FAILURE;
 
 	}
-	if ((close (stock_file_des)) < 0) {
 
-		ERRNO_ERR;
-		WARNING ("cannot close file descriptor '%d'.", stock_file_des);
+	/*
+	 * The calling thread loads stocks until one needs its stock file mapped.
+	 * Histories served from an image or a warm cache never block, so such batches need no helpers.
+	 * Opens and maps block on I/O, so then helpers of the pool join, some more than processors.
+	 * If another batch owns the pool, the calling thread loads its batch alone.
+	 */
+
+	batch.stock_ids = stock_ids;
+	batch.stock_ids_size = stock_ids_size;
+	batch.answers = answers;
+	batch.statuses = statuses;
+	batch.next = 0;
+	mapped = 0;
+	batch_load_work (&batch, &mapped);
+	pooled = 0;
+	if ((batch.next < stock_ids_size) && ((pthread_mutex_trylock (&batch_pool.submit)) == 0)) {
+
+		if ((cpus = sysconf (_SC_NPROCESSORS_ONLN)) < 1) {
+
+			cpus = 1;
+
+		}
+		threads_size = 2 * cpus;
+		if (threads_size > BATCH_LOAD_MAX_THREADS) {
+
+			threads_size = BATCH_LOAD_MAX_THREADS;
+
+		}
+		batch_pool_offer (&batch, threads_size);
+		pooled = 1;
+
+	}
+	batch_load_work (&batch, NULL);
+	if (pooled != 0) {
+
+		batch_pool_withdraw ();
+		pthread_mutex_unlock (&batch_pool.submit);
 
 	}
 
 	/*
-	 * All set.
+	 * Report failure if any stock failed.
 	 */
 
+	failures_size = 0;
+	for ( i = 0; i < stock_ids_size; i++ ) {
+
+		if (statuses[i] < 0) {
+
+			failures_size++;
+
+		}
+
+	}
+	if (failures_size != 0) {
+
+		ERR ("cannot load %u of %u stock histories.", failures_size, stock_ids_size);
+		FAILURE;
+
+	}
 	SUCCESS;
 
 }
@@ -218,11 +627,40 @@ int pfish_bovespa_stock_history_alloc (const pfish_bovespa_stock_id_t *stock_id,
 
 int pfish_bovespa_stock_history_free (pfish_bovespa_stock_history_t *target) {
 
-#define LENGTH ((2 * sizeof (size_t)) + (target->daily_quotes_size * sizeof (pfish_bovespa_daily_quote_t)))
+#define LENGTH (STOCK_FILE_SIZE (target->daily_quotes_size))
+
+	int rcode;
+
+	METRICS_ADD (history_frees, 1);
+	if ((pfish_bovespa_image_contains (target)) != 0) {
+
+		/*
+		 * Histories of the database image live as long as the attachment.
+		 */
+
+		SUCCESS;
+
+	}
+	if ((pfish_bovespa_cache_enabled ()) != 0) {
+
+		if ((rcode = pfish_bovespa_cache_release (target)) < 0) {
+
+			CRIT ("cannot release stock history from cache.");
+			METRICS_FAILURE (PFISH_BOVESPA_FAILURE_CACHE);
+			FAILURE;
+
+		}
+		if (rcode == 0) {
+
+			SUCCESS;
+
+		}
 
+	}
 	if ((munmap (target, LENGTH)) < 0) {
 
 		CRIT ("cannot memory-unmap stock file.");
+		METRICS_FAILURE (PFISH_BOVESPA_FAILURE_MAP);
 		FAILURE;
 
 	}
@@ -233,6 +671,477 @@ int pfish_bovespa_stock_history_free (pfish_bovespa_stock_history_t *target) {
 }
 
 
+int pfish_bovespa_xplit_list_alloc (const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_xplit_list_t **answer) {
+
+	char xplit_file_name[PATH_MAX];
+
+	if ((pfish_bovespa_image == NULL) && ((pfish_bovespa_revision_marker_check ()) < 0)) {
+
+		ALERT ("database revision mismatch; please reinitialize it.");
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_xplit_file_pathname (stock_id, xplit_file_name)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_xplit_file_read (xplit_file_name, answer)) < 0) {
+
+		CRIT ("cannot read inplit / split list of stock '%s'.", stock_id->id);
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_isin_segment_list_alloc (const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_isin_segment_list_t **answer) {
+
+	char isin_file_name[PATH_MAX];
+
+	if ((pfish_bovespa_image == NULL) && ((pfish_bovespa_revision_marker_check ()) < 0)) {
+
+		ALERT ("database revision mismatch; please reinitialize it.");
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_isin_file_pathname (stock_id, isin_file_name)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_isin_file_read (isin_file_name, answer)) < 0) {
+
+		CRIT ("cannot read ISIN segment list of stock '%s'.", stock_id->id);
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+/*
+ * ISIN index, mapped once and mapped again only when replaced.
+ */
+
+static struct {
+
+	pthread_mutex_t mutex;	// Protects all of the below.
+	unsigned int valid;	// Nonzero once the index was mapped (or found absent).
+	pfish_bovespa_isin_segment_list_t *index;	// Mapped ISIN index, NULL if there is none.
+	size_t index_size;	// Octets of the mapping.
+	struct stat index_stat;	// Status of the index file at mapping time; zeroed if there is none.
+	unsigned int pinned;	// Nonzero if mapped from a pinned generation.
+	uint64_t generation;	// Pinned generation of the mapping.
+
+} isin_mapping = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+
+/*
+ * Map the ISIN index again if it was replaced since last mapping; ISIN mapping mutex must be held.
+ * Files of a pinned generation are never replaced, so a mapping of the pinned generation is kept as it is.
+ *
+ * @return 0 on success (isin_mapping.index is NULL if there is no ISIN index), negative on failure.
+ */
+
+static int isin_index_remap () {
+
+	struct stat index_stat;	// Status of the ISIN index file.
+	char pathname[PATH_MAX];	// Pathname of the file, possibly in the pinned generation.
+	uint64_t generation;	// Pinned generation, if any.
+	unsigned int pinned;	// Nonzero if a generation is pinned.
+
+	pinned = ((pfish_bovespa_snapshot_generation (&generation)) == 0);
+	if ((isin_mapping.valid != 0) && (pinned != 0) && (isin_mapping.pinned != 0) && (isin_mapping.generation == generation)) {
+
+		SUCCESS;
+
+	}
+	if ((pfish_bovespa_snapshot_pathname (ISIN_INDEX_FILE, pathname)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((stat (pathname, &index_stat)) < 0) {
+
+		if (errno != ENOENT) {
+
+			ERRNO_ERR;
+			CRIT ("cannot stat file '%s'.", pathname);
+			FAILURE;
+
+		}
+		memset (&index_stat, 0, sizeof (struct stat));
+
+	}
+	if ((isin_mapping.valid != 0) && (isin_mapping.index_stat.st_dev == index_stat.st_dev) && (isin_mapping.index_stat.st_ino == index_stat.st_ino) && (isin_mapping.index_stat.st_size == index_stat.st_size) && (isin_mapping.index_stat.st_mtim.tv_sec == index_stat.st_mtim.tv_sec) && (isin_mapping.index_stat.st_mtim.tv_nsec == index_stat.st_mtim.tv_nsec)) {
+
+		isin_mapping.pinned = pinned;
+		isin_mapping.generation = generation;
+		SUCCESS;
+
+	}
+	if ((isin_mapping.index != NULL) && ((munmap (isin_mapping.index, isin_mapping.index_size)) < 0)) {
+
+		ERRNO_ERR;
+		WARNING ("cannot unmap ISIN index.");
+
+	}
+	isin_mapping.valid = 0;
+	isin_mapping.index = NULL;
+	if ((pfish_bovespa_isin_index_map (&(isin_mapping.index), &(isin_mapping.index_size))) < 0) {
+
+		CRIT ("cannot map ISIN index.");
+		isin_mapping.index = NULL;
+		FAILURE;
+
+	}
+	memcpy (&(isin_mapping.index_stat), &index_stat, sizeof (struct stat));
+	isin_mapping.pinned = pinned;
+	isin_mapping.generation = generation;
+	isin_mapping.valid = 1;
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_isin_lookup (const char *isin, pfish_bovespa_isin_segment_list_t **answer) {
+
+	const pfish_bovespa_isin_segment_list_t *index;	// Mapped ISIN index.
+	size_t first, last;	// Bounds of the segments of the ISIN code in the index.
+	size_t low, high, middle;	// Binary search.
+	size_t answer_size;	// Octets of the answer.
+
+	if ((pfish_bovespa_image == NULL) && ((pfish_bovespa_revision_marker_check ()) < 0)) {
+
+		ALERT ("database revision mismatch; please reinitialize it.");
+		FAILURE;
+
+	}
+	pthread_mutex_lock (&(isin_mapping.mutex));
+	if ((isin_index_remap ()) < 0) {
+
+		pthread_mutex_unlock (&(isin_mapping.mutex));
+		FAILURE;
+
+	}
+	index = isin_mapping.index;
+
+	/*
+	 * Find the range of segments of the ISIN code.
+	 */
+
+	first = last = 0;
+	if (index != NULL) {
+
+		low = 0;
+		high = index->isin_segment_list_size;
+		while (low < high) {
+
+			middle = low + ((high - low) / 2);
+			if ((strncmp (index->isin_segment_list[middle].isin, isin, PFISH_BOVESPA_CODISI_SIZE)) < 0) {
+
+				low = middle + 1;
+
+			} else {
+
+				high = middle;
+
+			}
+
+		}
+		first = last = low;
+		while ((last < index->isin_segment_list_size) && ((strncmp (index->isin_segment_list[last].isin, isin, PFISH_BOVESPA_CODISI_SIZE)) == 0)) {
+
+			last++;
+
+		}
+
+	}
+
+	/*
+	 * Copy them out.
+	 */
+
+	answer_size = sizeof (pfish_bovespa_isin_segment_list_t) + ((last - first) * sizeof (pfish_bovespa_isin_segment_t));
+	if ((*answer = (pfish_bovespa_isin_segment_list_t *) malloc (answer_size)) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", answer_size);
+		pthread_mutex_unlock (&(isin_mapping.mutex));
+		FAILURE;
+
+	}
+	(*answer)->isin_segment_list_size = last - first;
+	if (last != first) {
+
+		memcpy ((*answer)->isin_segment_list, &(index->isin_segment_list[first]), (last - first) * sizeof (pfish_bovespa_isin_segment_t));
+
+	}
+	pthread_mutex_unlock (&(isin_mapping.mutex));
+	SUCCESS;
+
+}
+
+
+/*
+ * Stitch the raw daily quotes of the segments of an ISIN code, along with their inplits and splits.
+ * Where segments overlap in time, the earlier segment prevails.
+ * An inplit or split of a stock is kept if its daily quote is stitched, unless it is the first one stitched;
+ * a change of stock is never taken as an inplit or split.
+ *
+ * @param[in] segments segments of the ISIN code, ordered by first trading date.
+ * @param[out] answer dynamically allocated stitched raw history; release it with free().
+ * @param[out] answer_xplits dynamically allocated inplit / split list of 'answer'; release it with free().
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+static int stitch_daily_quotes (const pfish_bovespa_isin_segment_list_t *segments, pfish_bovespa_stock_history_t **answer, pfish_bovespa_xplit_list_t **answer_xplits) {
+
+	const pfish_bovespa_isin_segment_t *segment;	// Segment being stitched.
+	pfish_bovespa_stock_history_t *history;	// Raw history of the stock of a segment.
+	pfish_bovespa_xplit_list_t *xplits;	// Inplits and splits of the stock of a segment, NULL if none.
+	size_t daily_quotes_size;	// Upper bound of daily quotes of the answer.
+	time_t last_date;	// Trading date of the last daily quote stitched so far.
+	size_t low, high, middle;	// Binary search.
+	size_t i, j;	// Short term generic counters.
+
+	daily_quotes_size = 0;
+	for ( i = 0; i < segments->isin_segment_list_size; i++ ) {
+
+		daily_quotes_size += segments->isin_segment_list[i].daily_quotes_size;
+
+	}
+	if ((*answer = (pfish_bovespa_stock_history_t *) malloc (sizeof (pfish_bovespa_stock_history_t) + (daily_quotes_size * sizeof (pfish_bovespa_daily_quote_t)))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", sizeof (pfish_bovespa_stock_history_t) + (daily_quotes_size * sizeof (pfish_bovespa_daily_quote_t)));
+		FAILURE;
+
+	}
+	if ((*answer_xplits = (pfish_bovespa_xplit_list_t *) malloc (sizeof (pfish_bovespa_xplit_list_t) + (daily_quotes_size * sizeof (pfish_bovespa_xplit_t)))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", sizeof (pfish_bovespa_xplit_list_t) + (daily_quotes_size * sizeof (pfish_bovespa_xplit_t)));
+		free (*answer);
+		FAILURE;
+
+	}
+	(*answer)->daily_quotes_size = 0;
+	(*answer)->last_xplit = 0;
+	(*answer_xplits)->xplit_list_size = 0;
+
 #undef FAILURE
-#undef SUCCESS
+#define FAILURE \
+	free (*answer); \
+	free (*answer_xplits); \
+	return (-1)
+
+	/*
+	 * Append the daily quotes of each segment that fall after the ones already stitched.
+	 */
+
+	last_date = 0;
+	for ( i = 0; i < segments->isin_segment_list_size; i++ ) {
+
+		segment = &(segments->isin_segment_list[i]);
+		if ((pfish_bovespa_stock_history_alloc (&(segment->stock_id), &history)) < 0) {
+
+			CRIT ("cannot retrieve history of stock '%s'.", segment->stock_id.id);
+			FAILURE;
+
+		}
+		if (history == NULL) {
+
+			WARNING ("stock '%s' is in ISIN index but not in database; please run pfish_bovespa_fsck.", segment->stock_id.id);
+			continue;
+
+		}
+		if ((pfish_bovespa_xplit_list_alloc (&(segment->stock_id), &xplits)) < 0) {
+
+			CRIT ("cannot retrieve inplit / split list of stock '%s'.", segment->stock_id.id);
+			pfish_bovespa_stock_history_free (history);
+			FAILURE;
+
+		}
+		low = 0;
+		high = history->daily_quotes_size;
+		while (low < high) {
+
+			middle = low + ((high - low) / 2);
+			if ((history->daily_quotes[middle].trading_date < segment->first_trading_date) || (((*answer)->daily_quotes_size != 0) && (history->daily_quotes[middle].trading_date <= last_date))) {
+
+				low = middle + 1;
+
+			} else {
+
+				high = middle;
+
+			}
+
+		}
+		j = 0;
+		for ( ; (low < history->daily_quotes_size) && (history->daily_quotes[low].trading_date <= segment->last_trading_date) && ((*answer)->daily_quotes_size < daily_quotes_size); low++ ) {
+
+			while ((xplits != NULL) && (j < xplits->xplit_list_size) && (xplits->xplit_list[j].daily_quote_index < low)) {
+
+				j++;
+
+			}
+			if ((xplits != NULL) && (j < xplits->xplit_list_size) && (xplits->xplit_list[j].daily_quote_index == low) && ((*answer)->daily_quotes_size != 0)) {
+
+				memcpy (&((*answer_xplits)->xplit_list[(*answer_xplits)->xplit_list_size]), &(xplits->xplit_list[j]), sizeof (pfish_bovespa_xplit_t));
+				(*answer_xplits)->xplit_list[(*answer_xplits)->xplit_list_size++].daily_quote_index = (*answer)->daily_quotes_size;
+				(*answer)->last_xplit = (*answer)->daily_quotes_size;
+
+			}
+			memcpy (&((*answer)->daily_quotes[(*answer)->daily_quotes_size++]), &(history->daily_quotes[low]), sizeof (pfish_bovespa_daily_quote_t));
+			last_date = history->daily_quotes[low].trading_date;
+
+		}
+		free (xplits);
+		if ((pfish_bovespa_stock_history_free (history)) < 0) {
+
+			CRIT ("cannot release history of stock '%s'.", segment->stock_id.id);
+			FAILURE;
+
+		}
+
+	}
+
+#undef FAILURE
+#define FAILURE return (-1)
+
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_stitched_history_alloc (const char *isin, unsigned int view, pfish_bovespa_stock_history_t **answer) {
+
+	pfish_bovespa_isin_segment_list_t *segments;	// Segments of the ISIN code.
+	pfish_bovespa_stock_history_t *history;	// Stitched raw daily quotes.
+	pfish_bovespa_xplit_list_t *xplits;	// Inplits and splits of the stitched raw daily quotes.
+	pfish_bovespa_daily_quote_t **daily_quotes;	// Pointers to the stitched raw daily quotes.
+	pfish_bovespa_daily_quote_t **adjusted;	// Adjusted daily quotes, NULL if not in the view.
+	pfish_bovespa_daily_quote_t **rollups;	// Rollups, NULL if not in the view.
+	pfish_bovespa_daily_quote_t **quotes;	// Daily quotes of the view.
+	size_t quotes_size;	// How many elements in 'quotes'.
+	size_t last_xplit;	// Index of 'quotes' of the most recent inplit or split.
+	size_t i;	// Short term generic counter.
+
+	if ((pfish_bovespa_stock_file_directory (view)) == NULL) {
 
+		ERR ("unknown stock history view '%u'.", view);
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_isin_lookup (isin, &segments)) < 0) {
+
+		FAILURE;
+
+	}
+	if (segments->isin_segment_list_size == 0) {
+
+		free (segments);
+		*answer = NULL;
+		SUCCESS;
+
+	}
+	if ((stitch_daily_quotes (segments, &history, &xplits)) < 0) {
+
+		free (segments);
+		FAILURE;
+
+	}
+	free (segments);
+	if (view == PFISH_BOVESPA_VIEW_RAW) {
+
+		free (xplits);
+		*answer = history;
+		SUCCESS;
+
+	}
+
+	/*
+	 * Derive the view from the stitched daily quotes, as the importer derives views of a stock:
+	 * adjust by all stitched inplits and splits, then roll up.
+	 */
+
+	daily_quotes = adjusted = rollups = NULL;
+
+#undef FAILURE
+#define FAILURE \
+	free (rollups); \
+	free (adjusted); \
+	free (daily_quotes); \
+	free (xplits); \
+	free (history); \
+	return (-1)
+
+	if ((daily_quotes = (pfish_bovespa_daily_quote_t **) malloc ((history->daily_quotes_size + 1) * sizeof (pfish_bovespa_daily_quote_t *))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (history->daily_quotes_size + 1) * sizeof (pfish_bovespa_daily_quote_t *));
+		FAILURE;
+
+	}
+	for ( i = 0; i < history->daily_quotes_size; i++ ) {
+
+		daily_quotes[i] = &(history->daily_quotes[i]);
+
+	}
+	quotes = daily_quotes;
+	quotes_size = history->daily_quotes_size;
+	last_xplit = history->last_xplit;
+	if ((view & PFISH_BOVESPA_VIEW_ADJUSTED) != 0) {
+
+		if ((pfish_bovespa_adjust_daily_quotes (daily_quotes, history->daily_quotes_size, xplits, NULL, NULL, 0, &adjusted)) < 0) {
+
+			CRIT ("cannot adjust stitched history of ISIN '%.*s'.", PFISH_BOVESPA_CODISI_SIZE, isin);
+			FAILURE;
+
+		}
+		quotes = adjusted;
+
+	}
+	if ((view & (PFISH_BOVESPA_VIEW_WEEKLY | PFISH_BOVESPA_VIEW_MONTHLY)) != 0) {
+
+		if ((pfish_bovespa_rollup_daily_quotes (quotes, history->daily_quotes_size, history->last_xplit, view & (PFISH_BOVESPA_VIEW_WEEKLY | PFISH_BOVESPA_VIEW_MONTHLY), NULL, 0, &rollups, &quotes_size, &last_xplit)) < 0) {
+
+			CRIT ("cannot roll up stitched history of ISIN '%.*s'.", PFISH_BOVESPA_CODISI_SIZE, isin);
+			FAILURE;
+
+		}
+		quotes = rollups;
+
+	}
+	if ((*answer = (pfish_bovespa_stock_history_t *) malloc (sizeof (pfish_bovespa_stock_history_t) + (quotes_size * sizeof (pfish_bovespa_daily_quote_t)))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", sizeof (pfish_bovespa_stock_history_t) + (quotes_size * sizeof (pfish_bovespa_daily_quote_t)));
+		FAILURE;
+
+	}
+	(*answer)->daily_quotes_size = quotes_size;
+	(*answer)->last_xplit = last_xplit;
+	for ( i = 0; i < quotes_size; i++ ) {
+
+		memcpy (&((*answer)->daily_quotes[i]), quotes[i], sizeof (pfish_bovespa_daily_quote_t));
+
+	}
+	free (rollups);
+	free (adjusted);
+	free (daily_quotes);
+	free (xplits);
+	free (history);
+
+#undef FAILURE
+#define FAILURE return (-1)
+
+	SUCCESS;
+
+}
+
+
+#undef FAILURE
+#undef SUCCESS
@@ -7,6 +7,7 @@
 #define FILE_PFISH_BOVESPA_SEEN
 
 #include <stddef.h>
+#include <stdio.h>
 #include <time.h>
 
 #include <pilot_fish/bovespa_stdint.h>
@@ -44,6 +45,8 @@ void pfish_bovespa_library_info_get (pfish_bovespa_library_info_t *target);
 
 #define PFISH_BOVESPA_CODNEG_SIZE 13
 #define PFISH_BOVESPA_ESPECI_SIZE 11
+#define PFISH_BOVESPA_CODISI_SIZE 13
+#define PFISH_BOVESPA_NOMRES_SIZE 13
 
 
 /*
@@ -60,6 +63,17 @@ struct pfish_bovespa_stock_id {
 typedef struct pfish_bovespa_stock_id pfish_bovespa_stock_id_t;
 
 
+/*
+ * Bovespa stock ticker type.
+ * A dense integer identifying a stock, assigned by the importer in order of first appearance
+ * and kept until the database is reinitialized; suitable for keying joins and caches.
+ */
+
+typedef uint32_t pfish_bovespa_ticker_t;
+
+#define PFISH_BOVESPA_TICKER_NONE UINT32_MAX	// No ticker.
+
+
 /*
  * Bovespa stock list structure.
  */
@@ -136,6 +150,80 @@ typedef struct pfish_bovespa_stock_history pfish_bovespa_stock_history_t;
 int pfish_bovespa_stock_history_alloc (const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_stock_history_t **answer);
 
 
+/*
+ * Views of a stock history.
+ *
+ * PFISH_BOVESPA_VIEW_RAW: daily quotes as traded.
+ * PFISH_BOVESPA_VIEW_ADJUSTED: daily quotes with prices adjusted by all inplits and splits that
+ * happened after them, so that the whole history is comparable to the most recent trading day;
+ * all adjusted quotes share price factor PFISH_BOVESPA_ADJUSTED_PRICE_FACTOR.
+ * Quantity and volume fields are never adjusted.
+ *
+ * PFISH_BOVESPA_VIEW_WEEKLY, PFISH_BOVESPA_VIEW_MONTHLY: rollups of the daily quotes of each
+ * calendar week (Monday to Sunday) or month, optionally combined with PFISH_BOVESPA_VIEW_ADJUSTED.
+ * Each rollup is a daily quote structure with:
+ * 	- trading date and opening price of the first trading day of the period;
+ * 	- stock spec and closing price of the last trading day of the period;
+ * 	- price factor of the last trading day of the period; prices of other days are rescaled to it;
+ * 	- maximum of maximum prices and minimum of minimum prices;
+ * 	- average of average prices weighted by total stocks;
+ * 	- sum of total trades, total stocks and total volume.
+ * The 'last_xplit' field of a rollup history indexes the period of the most recent inplit or split.
+ */
+
+#define PFISH_BOVESPA_VIEW_RAW 0x0
+#define PFISH_BOVESPA_VIEW_ADJUSTED 0x1
+#define PFISH_BOVESPA_VIEW_WEEKLY 0x2
+#define PFISH_BOVESPA_VIEW_MONTHLY 0x4
+
+#define PFISH_BOVESPA_ADJUSTED_PRICE_FACTOR 10000
+
+
+/*
+ * Bovespa stock history structure allocator, for a given view.
+ * Views are maintained by the importer, so rollups are served as stored.
+ *
+ * @param[in] stock_id stock identification.
+ * @param[in] view PFISH_BOVESPA_VIEW_RAW or PFISH_BOVESPA_VIEW_ADJUSTED,
+ * optionally or'ed with one of PFISH_BOVESPA_VIEW_WEEKLY or PFISH_BOVESPA_VIEW_MONTHLY.
+ * @param[out] answer dynamically allocated stock history structure if stock exists in database, NULL otherwise.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_stock_history_alloc_view (const pfish_bovespa_stock_id_t *stock_id, unsigned int view, pfish_bovespa_stock_history_t **answer);
+
+
+/*
+ * Bovespa stock history structure allocator, for a given ticker and view.
+ *
+ * @param[in] ticker stock ticker.
+ * @param[in] view as in pfish_bovespa_stock_history_alloc_view().
+ * @param[out] answer dynamically allocated stock history structure if ticker exists in database, NULL otherwise.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_stock_history_alloc_ticker (pfish_bovespa_ticker_t ticker, unsigned int view, pfish_bovespa_stock_history_t **answer);
+
+
+/*
+ * Bovespa stock history structure batch allocator.
+ * Stock histories are retrieved concurrently by an internal pool of threads,
+ * so that the batch takes about as long as its slowest stock. Batches served from
+ * a database image or a warm cache are retrieved by the calling thread alone.
+ *
+ * @param[in] stock_ids array of stock identifications.
+ * @param[in] stock_ids_size how many elements in stock_ids[].
+ * @param[out] answers array of stock_ids_size elements; each one as the answer of pfish_bovespa_stock_history_alloc() for the corresponding stock, or NULL on failure.
+ * @param[out] statuses array of stock_ids_size elements; each one 0 on success, negative on failure for the corresponding stock.
+ *
+ * @return 0 if all stocks succeeded, negative otherwise.
+ */
+
+int pfish_bovespa_stock_history_alloc_many (const pfish_bovespa_stock_id_t *stock_ids, size_t stock_ids_size, pfish_bovespa_stock_history_t **answers, int *statuses);
+
+
 /*
  * Bovespa stock history structure releaser.
  *
@@ -147,5 +235,462 @@ int pfish_bovespa_stock_history_alloc (const pfish_bovespa_stock_id_t *stock_id,
 int pfish_bovespa_stock_history_free (pfish_bovespa_stock_history_t *target);
 
 
+/*
+ * Inplit or split of a stock.
+ */
+
+struct pfish_bovespa_xplit {
+
+	size_t daily_quote_index;	// Index of daily_quotes[] (raw view) of the first trading day after the event.
+	time_t trading_date;	// Trading date of that day.
+	double price_ratio;	// Implied factor: unit opening price of that day / unit closing price of the previous trading day.
+
+};
+
+typedef struct pfish_bovespa_xplit pfish_bovespa_xplit_t;
+
+
+/*
+ * Inplits and splits of a stock.
+ */
+
+struct pfish_bovespa_xplit_list {
+
+	size_t xplit_list_size;	// How many elements in xplit_list[].
+	pfish_bovespa_xplit_t xplit_list[];	// Elements are ordered by daily quote index (ascending, unique).
+
+};
+
+typedef struct pfish_bovespa_xplit_list pfish_bovespa_xplit_list_t;
+
+
+/*
+ * Bovespa inplit and split list allocator.
+ *
+ * @param[in] stock_id stock identification.
+ * @param[out] answer dynamically allocated list of inplits and splits if stock exists in database, NULL otherwise;
+ * release it with free().
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_xplit_list_alloc (const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_xplit_list_t **answer);
+
+
+/*
+ * ISIN segment: a run of consecutive trading days of a stock under the same ISIN code.
+ * A stock changes ISIN codes seldom, and an ISIN code may be traded under different stocks over time.
+ */
+
+struct pfish_bovespa_isin_segment {
+
+	char isin[PFISH_BOVESPA_CODISI_SIZE];	// ISIN code; empty if unknown.
+	pfish_bovespa_stock_id_t stock_id;	// Stock traded under the ISIN code.
+	size_t daily_quote_index;	// Index of daily_quotes[] (raw view) of the stock of the first trading day of the segment.
+	size_t daily_quotes_size;	// How many trading days in the segment.
+	time_t first_trading_date;	// Trading date of the first trading day of the segment.
+	time_t last_trading_date;	// Trading date of the last trading day of the segment.
+
+};
+
+typedef struct pfish_bovespa_isin_segment pfish_bovespa_isin_segment_t;
+
+
+/*
+ * ISIN segments, of a stock or of an ISIN code.
+ */
+
+struct pfish_bovespa_isin_segment_list {
+
+	size_t isin_segment_list_size;	// How many elements in isin_segment_list[].
+	pfish_bovespa_isin_segment_t isin_segment_list[];	// Elements of a stock are ordered by daily quote index; elements of an ISIN code, by first trading date.
+
+};
+
+typedef struct pfish_bovespa_isin_segment_list pfish_bovespa_isin_segment_list_t;
+
+
+/*
+ * Bovespa ISIN segment list allocator, by stock.
+ *
+ * @param[in] stock_id stock identification.
+ * @param[out] answer dynamically allocated list of ISIN segments of the stock if stock exists in database, NULL otherwise;
+ * release it with free().
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_isin_segment_list_alloc (const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_isin_segment_list_t **answer);
+
+
+/*
+ * Bovespa ISIN segment list allocator, by ISIN code.
+ * The ISIN index is searched, so the cost grows with the logarithm of the index size plus the number of segments found.
+ *
+ * @param[in] isin ISIN code.
+ * @param[out] answer dynamically allocated list of ISIN segments of all stocks traded under the ISIN code (possibly empty);
+ * release it with free().
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_isin_lookup (const char *isin, pfish_bovespa_isin_segment_list_t **answer);
+
+
+/*
+ * Bovespa stitched stock history allocator.
+ * Builds one history of an ISIN code across the stocks it was traded under, segment by segment.
+ * Where segments overlap in time, the earlier segment prevails.
+ * Raw daily quotes are stitched first, along with the inplits and splits of each stock;
+ * adjusted and rollup views are then derived from the stitched daily quotes as the importer derives them,
+ * so that inplits and splits of later stocks adjust earlier ones, and a period across a change of stock is rolled up once.
+ *
+ * @param[in] isin ISIN code.
+ * @param[in] view as in pfish_bovespa_stock_history_alloc_view().
+ * @param[out] answer dynamically allocated stitched stock history if ISIN code exists in database, NULL otherwise;
+ * release it with free() (not with pfish_bovespa_stock_history_free()).
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_stitched_history_alloc (const char *isin, unsigned int view, pfish_bovespa_stock_history_t **answer);
+
+
+/*
+ * Company short name of a stock.
+ */
+
+struct pfish_bovespa_name {
+
+	pfish_bovespa_stock_id_t stock_id;	// Stock identification.
+	char name[PFISH_BOVESPA_NOMRES_SIZE];	// Company short name, as in the most recent trading day of the stock.
+	time_t trading_date;	// Trading date of the most recent trading day of the stock.
+
+};
+
+typedef struct pfish_bovespa_name pfish_bovespa_name_t;
+
+
+/*
+ * Company short names of stocks.
+ */
+
+struct pfish_bovespa_name_list {
+
+	size_t name_list_size;	// How many elements in name_list[].
+	pfish_bovespa_name_t name_list[];	// Elements are ordered (stock id, ascending).
+
+};
+
+typedef struct pfish_bovespa_name_list pfish_bovespa_name_list_t;
+
+
+/*
+ * Kinds of name search.
+ *
+ * PFISH_BOVESPA_SEARCH_PREFIX: stock id or company short name starts with the text.
+ * PFISH_BOVESPA_SEARCH_SUBSTRING: stock id or company short name contains the text.
+ */
+
+#define PFISH_BOVESPA_SEARCH_PREFIX 0x0
+#define PFISH_BOVESPA_SEARCH_SUBSTRING 0x1
+
+
+/*
+ * Bovespa stock search by stock id and company short name, ignoring case.
+ * The name index built by the importer is searched; it stays mapped between calls
+ * and is mapped again only after an import replaces it.
+ * Each search costs a few binary searches plus the number of matching positions.
+ *
+ * @param[in] text text to be searched.
+ * @param[in] mode one of PFISH_BOVESPA_SEARCH_* values.
+ * @param[out] answer dynamically allocated list of matching stocks (possibly empty); release it with free().
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_name_search (const char *text, unsigned int mode, pfish_bovespa_name_list_t **answer);
+
+
+/*
+ * Bovespa stock ticker lookup.
+ * The ticker dictionary built by the importer is searched in constant time by a minimal perfect
+ * hash function; it stays mapped between calls and is mapped again only on a miss.
+ *
+ * @param[in] stock_id stock identification.
+ * @param[out] answer ticker of the stock, PFISH_BOVESPA_TICKER_NONE if stock is unknown.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_ticker_lookup (const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_ticker_t *answer);
+
+
+/*
+ * Bovespa stock identification of a ticker.
+ *
+ * @param[in] ticker stock ticker.
+ * @param[out] answer stock identification, empty if ticker is unknown.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_ticker_stock (pfish_bovespa_ticker_t ticker, pfish_bovespa_stock_id_t *answer);
+
+
+/*
+ * Shared memory database image attacher.
+ * The image must have been previously built with pfish_bovespa_image_load.
+ *
+ * While attached, stock lists and stock histories are served from the image
+ * instead of the database files, and no revision check happens per call.
+ * Stock histories taken from the image stay valid until detachment.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_image_attach ();
+
+
+/*
+ * Shared memory database image detacher.
+ * Histories taken from the image must not be used after detachment.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_image_detach ();
+
+
+/*
+ * Database snapshot pinner.
+ *
+ * Each import publishes a new database generation. While pinned, stock lists, stock histories,
+ * inplit / split lists, ISIN segments and index lookups are all served from the most recent
+ * generation at pinning time, so that a session loading many stocks never mixes files of
+ * different imports. Pinning again moves to the most recent generation.
+ * A pinned generation is kept by the importer until it is unpinned (or the process exits);
+ * readers never block imports and imports never block readers.
+ * Pinning and unpinning must not race with other calls of this library.
+ *
+ * @return 0 on success, positive if no generation was published yet (reads stay on the live database), negative on failure.
+ */
+
+int pfish_bovespa_snapshot_pin ();
+
+
+/*
+ * Database snapshot unpinner.
+ * Stock histories taken while pinned stay valid.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_snapshot_unpin ();
+
+
+/*
+ * Stock history cache enabler.
+ *
+ * While enabled, stock histories stay mapped after release and are shared among
+ * allocations of the same stock, so that repeated allocations cost a hash probe
+ * plus one stat of the stock file (to detect its replacement by an import).
+ * Released histories are unmapped in least recently used order whenever the
+ * mapped octets exceed max_mapped_size; allocated histories are never unmapped.
+ * Cache functions are thread safe, but enabling and disabling must not race
+ * with allocations.
+ *
+ * @param[in] max_mapped_size upper bound of mapped octets.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_cache_enable (size_t max_mapped_size);
+
+
+/*
+ * Stock history cache disabler.
+ * All cached histories are unmapped; fails if any of them is still allocated.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_cache_disable ();
+
+
+/*
+ * Runtime metrics.
+ *
+ * Counters and latency histograms of this library in the calling process, since it was loaded.
+ * Updates are lock-free (each thread counts in its own shard); pfish_bovespa_metrics_get() sums the shards
+ * without stopping updates, so that concurrent updates may or may not be seen.
+ * All members are uint64_t.
+ *
+ * Failures are counted by cause:
+ * PFISH_BOVESPA_FAILURE_REVISION: database revision mismatch (or revision marker unreadable);
+ * PFISH_BOVESPA_FAILURE_IO: cannot open, stat or scan database files;
+ * PFISH_BOVESPA_FAILURE_MAP: cannot memory-map or unmap a stock file;
+ * PFISH_BOVESPA_FAILURE_CORRUPT: stock file failed verification;
+ * PFISH_BOVESPA_FAILURE_CACHE: stock history cache failure;
+ * PFISH_BOVESPA_FAILURE_MEMORY: cannot allocate heap space.
+ *
+ * Page faults are not counted in shards: pfish_bovespa_metrics_get() samples them from the kernel, for the whole process
+ * (faults of readers touching mapped stock histories included), and answers the difference from when the library was loaded.
+ *
+ * Latency histograms count operations by floor (log2 (nanoseconds)): bucket i holds latencies from 2^i to 2^(i+1) - 1 nanoseconds
+ * (the last bucket holds everything slower).
+ */
+
+#define PFISH_BOVESPA_FAILURE_REVISION 0
+#define PFISH_BOVESPA_FAILURE_IO 1
+#define PFISH_BOVESPA_FAILURE_MAP 2
+#define PFISH_BOVESPA_FAILURE_CORRUPT 3
+#define PFISH_BOVESPA_FAILURE_CACHE 4
+#define PFISH_BOVESPA_FAILURE_MEMORY 5
+#define PFISH_BOVESPA_FAILURES_SIZE 6
+
+#define PFISH_BOVESPA_METRICS_HISTOGRAM_SIZE 40
+
+typedef struct pfish_bovespa_metrics pfish_bovespa_metrics_t;
+
+struct pfish_bovespa_metrics {
+
+	uint64_t history_allocs;	// Stock history allocations (of any kind), found or not.
+	uint64_t histories_not_found;	// Allocations of stocks not in the database.
+	uint64_t history_frees;	// Stock history releases.
+	uint64_t image_hits;	// Histories served from the database image.
+	uint64_t cache_hits;	// Histories served from the stock history cache.
+	uint64_t cache_misses;	// Histories looked up in the cache but mapped from stock files.
+	uint64_t files_mapped;	// Stock files memory-mapped.
+	uint64_t bytes_mapped;	// Octets of stock files memory-mapped.
+	uint64_t minor_page_faults;	// Page faults of this process since the library was loaded, served from memory.
+	uint64_t major_page_faults;	// Page faults of this process since the library was loaded, served from disk.
+	uint64_t revision_checks;	// Database revision checks.
+	uint64_t revision_check_nanoseconds;	// Time spent checking the database revision.
+	uint64_t stock_list_scans;	// Stock lists built by scanning the database directory.
+	uint64_t stock_list_entries;	// Stocks found by those scans.
+	uint64_t failures[PFISH_BOVESPA_FAILURES_SIZE];	// Failures by cause (PFISH_BOVESPA_FAILURE_*).
+	uint64_t history_alloc_latency[PFISH_BOVESPA_METRICS_HISTOGRAM_SIZE];	// Latency of stock history allocations.
+	uint64_t revision_check_latency[PFISH_BOVESPA_METRICS_HISTOGRAM_SIZE];	// Latency of database revision checks.
+	uint64_t stock_list_latency[PFISH_BOVESPA_METRICS_HISTOGRAM_SIZE];	// Latency of stock list allocations.
+
+};
+
+
+/*
+ * Runtime metrics retriever.
+ *
+ * @param[out] answer metrics of this process.
+ */
+
+void pfish_bovespa_metrics_get (pfish_bovespa_metrics_t *answer);
+
+
+/*
+ * Runtime metrics printer, one 'name value' line per counter
+ * (histograms: name followed by 'bucket:count' pairs of buckets not empty).
+ *
+ * @param[in] stream destination of the metrics.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_metrics_print (FILE *stream);
+
+
+/*
+ * Technical indicators.
+ *
+ * Indicators are computed over unit prices (price field value / price factor) of a stock history of any view.
+ * Values are NAN until the window of an indicator is full.
+ *
+ * PFISH_BOVESPA_INDICATOR_SMA: simple moving average of closing prices.
+ * PFISH_BOVESPA_INDICATOR_EMA: exponential moving average of closing prices (smoothing 2 / (window + 1)), seeded with the first simple average.
+ * PFISH_BOVESPA_INDICATOR_RSI: relative strength index of closing prices, with Wilder smoothing.
+ * PFISH_BOVESPA_INDICATOR_ATR: average true range, with Wilder smoothing.
+ * PFISH_BOVESPA_INDICATOR_BOLLINGER: Bollinger bands of closing prices; three values: middle, lower and upper band.
+ * PFISH_BOVESPA_INDICATOR_VWAP: moving average of average prices weighted by total stocks.
+ * PFISH_BOVESPA_INDICATOR_LOG_RETURN: natural logarithm of closing price / previous closing price; window is ignored.
+ */
+
+#define PFISH_BOVESPA_INDICATOR_SMA 0x0
+#define PFISH_BOVESPA_INDICATOR_EMA 0x1
+#define PFISH_BOVESPA_INDICATOR_RSI 0x2
+#define PFISH_BOVESPA_INDICATOR_ATR 0x3
+#define PFISH_BOVESPA_INDICATOR_BOLLINGER 0x4
+#define PFISH_BOVESPA_INDICATOR_VWAP 0x5
+#define PFISH_BOVESPA_INDICATOR_LOG_RETURN 0x6
+
+
+/*
+ * Incremental state of an indicator over a stock history.
+ * The state remembers how many daily quotes were consumed, so that only newer daily quotes are computed next time.
+ */
+
+struct pfish_bovespa_indicator_state {
+
+	unsigned int indicator;	// One of PFISH_BOVESPA_INDICATOR_* values.
+	size_t window;	// Window length, in daily quotes.
+	double width;	// Width of Bollinger bands, in standard deviations.
+	size_t columns;	// How many values per daily quote.
+	size_t daily_quotes_size;	// How many daily quotes were consumed so far.
+	time_t trading_date;	// Trading date of the last consumed daily quote.
+	double previous_close;	// Unit closing price of the last consumed daily quote.
+	double smoothed[2];	// Running averages of recursive indicators, or their sums while seeding.
+	size_t carried_size;	// How many daily quotes are carried in carried[].
+	double carried[];	// Inputs of the last (window - 1) consumed daily quotes; two per daily quote.
+
+};
+
+typedef struct pfish_bovespa_indicator_state pfish_bovespa_indicator_state_t;
+
+
+/*
+ * Indicator state allocator.
+ *
+ * @param[in] indicator one of PFISH_BOVESPA_INDICATOR_* values.
+ * @param[in] window window length, in daily quotes.
+ * @param[in] width width of Bollinger bands, in standard deviations.
+ * @param[out] answer dynamically allocated indicator state, with no daily quotes consumed; release it with free().
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_indicator_state_alloc (unsigned int indicator, size_t window, double width, pfish_bovespa_indicator_state_t **answer);
+
+
+/*
+ * Compute an indicator over the daily quotes of a stock history not yet consumed by its state.
+ * Kernels use SIMD instructions when available.
+ *
+ * @param[in,out] state indicator state; will be advanced to the end of history.
+ * @param[in] history stock history; must extend the history previously consumed by state
+ * (checked by trading date and closing price of the last consumed daily quote).
+ * @param[out] answer dynamically allocated array of (answer_size * state->columns) values,
+ * for daily quotes from the previous state->daily_quotes_size on; NULL if there are none; release it with free().
+ * @param[out] answer_size how many daily quotes were computed.
+ *
+ * @return 0 on success, positive if history does not extend the consumed history (state is untouched), negative on failure.
+ */
+
+int pfish_bovespa_indicator_compute (pfish_bovespa_indicator_state_t *state, const pfish_bovespa_stock_history_t *history, double **answer, size_t *answer_size);
+
+
+/*
+ * Indicator state persistence.
+ * The state file is checksummed.
+ *
+ * @param[in] state indicator state.
+ * @param[in] pathname state file.
+ * @param[out] answer dynamically allocated indicator state if state file exists, NULL otherwise; release it with free().
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_indicator_state_save (const pfish_bovespa_indicator_state_t *state, const char *pathname);
+
+int pfish_bovespa_indicator_state_load (const char *pathname, pfish_bovespa_indicator_state_t **answer);
+
+
 #endif	// FILE_PFISH_BOVESPA_SEEN
 
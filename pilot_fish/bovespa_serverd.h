@@ -0,0 +1,79 @@
+/*
+ * pilot_fish/bovespa_serverd.h
+ * Protocol of pfish_bovespa_serverd, the local query daemon of the pilot_fish bovespa database.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_SERVERD_SEEN
+#define FILE_PFISH_BOVESPA_SERVERD_SEEN
+
+#include <stdint.h>
+
+#include <pilot_fish/bovespa.h>
+
+
+/*
+ * The daemon listens on a Unix domain stream socket (by default '.serverd' in the database directory).
+ * Clients send requests and read responses over the connection; requests may be pipelined,
+ * and responses come back in the order of requests.
+ * All integers are in the native byte order: client and daemon share the machine.
+ *
+ * Each request is one struct pfish_bovespa_serverd_request.
+ * Each response is one struct pfish_bovespa_serverd_response followed by 'count' records:
+ *
+ * PFISH_BOVESPA_SERVERD_REQUEST_LIST: all stocks of the database;
+ * records are pfish_bovespa_stock_id_t.
+ *
+ * PFISH_BOVESPA_SERVERD_REQUEST_HISTORY: the whole history of 'stock_id' in 'view';
+ * records are pfish_bovespa_daily_quote_t, and 'last_xplit' is as in pfish_bovespa_stock_history_t.
+ *
+ * PFISH_BOVESPA_SERVERD_REQUEST_RANGE: daily quotes of 'stock_id' in 'view' traded from the day (UTC) of 'from' to the day of 'to' (inclusive);
+ * records are pfish_bovespa_daily_quote_t.
+ *
+ * PFISH_BOVESPA_SERVERD_REQUEST_CROSS_SECTION: daily quotes in 'view' of all stocks traded in the day (UTC) of 'from';
+ * records are struct pfish_bovespa_serverd_quote, ordered by stock.
+ *
+ * A malformed request (bad size or type) is answered with PFISH_BOVESPA_SERVERD_STATUS_BAD_REQUEST
+ * and the connection is closed.
+ */
+
+#define PFISH_BOVESPA_SERVERD_REQUEST_LIST 1
+#define PFISH_BOVESPA_SERVERD_REQUEST_HISTORY 2
+#define PFISH_BOVESPA_SERVERD_REQUEST_RANGE 3
+#define PFISH_BOVESPA_SERVERD_REQUEST_CROSS_SECTION 4
+
+#define PFISH_BOVESPA_SERVERD_STATUS_OK 0
+#define PFISH_BOVESPA_SERVERD_STATUS_NOT_FOUND 1	// Stock does not exist.
+#define PFISH_BOVESPA_SERVERD_STATUS_BAD_REQUEST -1
+#define PFISH_BOVESPA_SERVERD_STATUS_FAILURE -2	// Database failure; see daemon logs.
+
+struct pfish_bovespa_serverd_request {
+
+	uint32_t size;	// sizeof (struct pfish_bovespa_serverd_request).
+	uint32_t tag;	// Any value; echoed in the response.
+	uint16_t type;	// PFISH_BOVESPA_SERVERD_REQUEST_*.
+	uint16_t view;	// PFISH_BOVESPA_VIEW_* (see pfish_bovespa_stock_history_alloc_view()).
+	char stock_id[16];	// Stock identification, null terminated.
+	int64_t from;	// Trading date (seconds since the epoch).
+	int64_t to;	// Trading date (seconds since the epoch).
+
+};
+
+struct pfish_bovespa_serverd_response {
+
+	uint32_t size;	// Octets of the response, this header and records included.
+	uint32_t tag;	// Tag of the request.
+	int32_t status;	// PFISH_BOVESPA_SERVERD_STATUS_*.
+	uint32_t count;	// How many records follow.
+	uint64_t last_xplit;	// PFISH_BOVESPA_SERVERD_REQUEST_HISTORY only; zero otherwise.
+
+};
+
+struct pfish_bovespa_serverd_quote {
+
+	pfish_bovespa_stock_id_t stock_id;
+	pfish_bovespa_daily_quote_t daily_quote;
+
+};
+
+
+#endif	// FILE_PFISH_BOVESPA_SERVERD_SEEN
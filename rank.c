@@ -0,0 +1,929 @@
+/*
+ * rank.c
+ *
+ * Cross-sectional ranking of the stocks of the pilot_fish bovespa database.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <syslog.h>
+#include <argp.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+#include <pilot_fish/bovespa.h>
+
+#include "async_log.h"
+
+
+/*
+ * Metrics.
+ */
+
+#define RANK_METRIC_VOLUME 0
+#define RANK_METRIC_TRADES 1
+#define RANK_METRIC_STOCKS 2
+#define RANK_METRIC_CLOSE 3
+#define RANK_METRIC_RETURN 4
+
+
+/*
+ * Upper bound of the date range, in days.
+ */
+
+#define RANK_MAX_DAYS 0x10000
+
+
+/*
+ * Command line argument parsing.
+ */
+
+const char *argp_program_version = PACKAGE_VERSION;
+const char *argp_program_bug_address = PACKAGE_BUGREPORT;
+
+static char doc[] = "pfish_bovespa_rank -- cross-sectional ranking of the stocks of the pilot_fish bovespa database.\vThis routine ranks all stocks by METRIC on each trading day from FROM to TO (default: FROM), and exports the ranking through the standard output in CSV format.\n\nMETRIC is one of: volume, trades, stocks, close (unit closing price), return (unit closing price / previous unit closing price - 1).\n\nExported fields are: trading date, stock, metric value, rank, how many stocks were ranked, percentile.\nRank 1 is the highest value; ties share the best rank. Percentile is 100 * (count - rank) / (count - 1).\n\nFormat of date fields is YYYY-MM-DD.\n\nWith --binary, each exported line is a native record of 48 octets instead: int64 trading date (seconds since the epoch, midnight UTC), double value, double percentile, uint32 rank, uint32 count, char stock[16] (null padded).\n\nStocks are scanned in parallel, and each thread keeps its own per-day rankings (heaps of the best ones with --top), which are merged per day in parallel.\n";
+
+static char args_doc[] = "METRIC FROM [TO]";
+
+static struct argp_option options[] = {
+
+	{"top", 'k', "K", 0, "export only the K best ranked stocks of each day.", 0 },
+	{"adjusted", 'x', 0, 0, "use prices adjusted by inplits / splits.", 0 },
+	{"image", 'm', 0, 0, "read from the shared memory database image (see pfish_bovespa_image_load).", 0 },
+	{"binary", 'b', 0, 0, "export binary records instead of CSV.", 0 },
+	{"jobs", 'j', "JOBS", 0, "use JOBS threads (default: number of online processors).", 0 },
+	{"stats", 'S', 0, 0, "print runtime metrics of the library to the standard error on exit.", 0 },
+	{ 0 }
+
+};
+
+struct arguments {
+
+	unsigned int metric;
+	long from;	// Days since the epoch.
+	long to;	// Days since the epoch.
+	size_t top;
+	unsigned int adjusted;
+	unsigned int image;
+	unsigned int binary;
+	long jobs;
+	unsigned int stats;
+
+};
+
+
+/*
+ * Parse a date.
+ *
+ * @param[in] text date in format YYYY-MM-DD.
+ * @param[out] answer days since the epoch.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int parse_date (const char *text, long *answer);
+
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+	char *aux_charp;
+
+	switch (key) {
+
+		case 'k':
+
+			arguments->top = strtoul (arg, &aux_charp, 10);
+			if ((*arg == 0) || (*aux_charp != 0) || (arguments->top == 0)) {
+
+				argp_error (state, "invalid number of stocks '%s'.", arg);
+
+			}
+			break;
+
+		case 'x':
+
+			arguments->adjusted = 1;
+			break;
+
+		case 'm':
+
+			arguments->image = 1;
+			break;
+
+		case 'b':
+
+			arguments->binary = 1;
+			break;
+
+		case 'j':
+
+			arguments->jobs = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->jobs < 1)) {
+
+				argp_error (state, "invalid number of jobs '%s'.", arg);
+
+			}
+			break;
+
+		case 'S':
+
+			arguments->stats = 1;
+			break;
+
+		case ARGP_KEY_ARG:
+
+			switch (state->arg_num) {
+
+				case 0:
+
+					if ((strcmp (arg, "volume")) == 0) {
+
+						arguments->metric = RANK_METRIC_VOLUME;
+
+					}
+					else if ((strcmp (arg, "trades")) == 0) {
+
+						arguments->metric = RANK_METRIC_TRADES;
+
+					}
+					else if ((strcmp (arg, "stocks")) == 0) {
+
+						arguments->metric = RANK_METRIC_STOCKS;
+
+					}
+					else if ((strcmp (arg, "close")) == 0) {
+
+						arguments->metric = RANK_METRIC_CLOSE;
+
+					}
+					else if ((strcmp (arg, "return")) == 0) {
+
+						arguments->metric = RANK_METRIC_RETURN;
+
+					}
+					else {
+
+						argp_error (state, "unknown metric '%s'.", arg);
+
+					}
+					break;
+
+				case 1:
+
+					if ((parse_date (arg, &(arguments->from))) < 0) {
+
+						argp_error (state, "invalid date '%s'.", arg);
+
+					}
+					arguments->to = arguments->from;
+					break;
+
+				case 2:
+
+					if ((parse_date (arg, &(arguments->to))) < 0) {
+
+						argp_error (state, "invalid date '%s'.", arg);
+
+					}
+					break;
+
+				default:
+
+					argp_usage (state);
+
+			}
+			break;
+
+		case ARGP_KEY_END:
+
+			if (state->arg_num < 2) {
+
+				argp_usage (state);
+
+			}
+			if ((arguments->to < arguments->from) || (arguments->to - arguments->from >= RANK_MAX_DAYS)) {
+
+				argp_error (state, "invalid date range.");
+
+			}
+			break;
+
+		default:
+
+			return (ARGP_ERR_UNKNOWN);
+
+	};
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+
+/*
+ * A ranked stock.
+ */
+
+struct rank_entry {
+
+	double value;	// Metric value.
+	size_t stock;	// Index of the stock list.
+
+};
+
+
+/*
+ * Ranked stocks of one day.
+ * With a top limit, entries are a heap whose root is the worst ranked entry.
+ */
+
+struct rank_bucket {
+
+	struct rank_entry *entries;
+	size_t size;	// How many elements in entries[].
+	size_t capacity;	// How many elements fit in entries[].
+	size_t count;	// How many stocks were seen, ranked or not.
+
+};
+
+
+/*
+ * Binary export record.
+ */
+
+struct rank_record {
+
+	int64_t trading_date;	// Midnight UTC of the trading day, in seconds since the epoch.
+	double value;	// Metric value.
+	double percentile;	// Percentile of value among all ranked stocks of the day.
+	uint32_t rank;	// Rank of the stock; 1 is the highest value.
+	uint32_t count;	// How many stocks were ranked in the day.
+	char stock[16];	// Stock identification, null padded.
+
+};
+
+
+/*
+ * Work shared among threads.
+ */
+
+struct rank_work {
+
+	const pfish_bovespa_stock_list_t *stocks;	// Stocks to be ranked.
+	unsigned int metric;	// One of RANK_METRIC_* values.
+	unsigned int view;	// Stock history view.
+	long first_day;	// First day of the range, in days since the epoch.
+	size_t days_size;	// How many days in the range.
+	size_t top;	// How many best ranked stocks to keep per day; 0 for all.
+	size_t workers_size;	// How many threads work.
+	struct rank_bucket *buckets;	// Per thread rankings; day d of thread w is at [(w * days_size) + d].
+	struct rank_bucket *results;	// Merged rankings, per day.
+	size_t next;	// Next stock (scan phase) or day (merge phase); taken atomically.
+	size_t failures;	// How many stocks could not be scanned; updated atomically.
+
+};
+
+struct rank_worker {
+
+	struct rank_work *work;	// Work shared among threads.
+	size_t index;	// Index of this thread.
+
+};
+
+
+/*
+ * Scanning thread: rank each stock in the per day rankings of this thread.
+ *
+ * @param arg (struct rank_worker *).
+ */
+
+void *rank_scan_worker (void *arg);
+
+
+/*
+ * Merging thread: merge per thread rankings of each day.
+ *
+ * @param arg (struct rank_worker *).
+ */
+
+void *rank_merge_worker (void *arg);
+
+
+/*
+ * Run a worker function on all threads; this thread works too.
+ *
+ * @param[in] work work shared among threads.
+ * @param[in] workers one element per thread.
+ * @param[in] worker worker function.
+ */
+
+void rank_run (struct rank_work *work, struct rank_worker *workers, void *(*worker) (void *));
+
+
+/*
+ * Rank a stock in a ranking of a day.
+ *
+ * @param[in,out] bucket ranking of the day.
+ * @param[in] entry ranked stock.
+ * @param[in] top how many best ranked stocks to keep; 0 for all.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int rank_bucket_push (struct rank_bucket *bucket, const struct rank_entry *entry, size_t top);
+
+
+/*
+ * Compare two ranked stocks, best first.
+ * Arguments type hint: (const void *) == (const struct rank_entry *)
+ *
+ * @return negative if a is better ranked than b, positive if worse, zero if same.
+ */
+
+int compare_rank_entries (const void *a, const void *b);
+
+
+/*
+ * The portal.
+ */
+
+#define SUCCESS return (EXIT_SUCCESS)
+#define FAILURE return (EXIT_FAILURE)
+
+#define DATE_BUF_SIZE 16
+
+int main (int argc, char **argv) {
+
+	struct arguments arguments;	// Arguments given in the command line.
+	struct rank_work work;	// Work shared among threads.
+	struct rank_worker *workers;	// One element per thread.
+	struct rank_record record;	// Binary export record.
+	struct rank_bucket *result;	// Merged ranking of a day.
+	time_t trading_date;	// Trading date of a day.
+	struct tm calendar;	// Time components of a trading date.
+	char date_buf[DATE_BUF_SIZE];	// Trading date string formatting buffer.
+	size_t rank;	// Rank of a stock.
+	double percentile;	// Percentile of a stock.
+	size_t d, i;	// General, short ranged indexers.
+
+	/*
+	 * Begin.
+	 */
+
+	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	pfish_bovespa_log_level_from_env ();
+	DEBUG ("start.");
+
+	/*
+	 * Parse command line arguments.
+	 */
+
+	arguments.metric = RANK_METRIC_VOLUME;
+	arguments.from = 0;
+	arguments.to = 0;
+	arguments.top = 0;
+	arguments.adjusted = 0;
+	arguments.image = 0;
+	arguments.binary = 0;
+	if ((arguments.jobs = sysconf (_SC_NPROCESSORS_ONLN)) < 1) {
+
+		arguments.jobs = 1;
+
+	}
+	arguments.stats = 0;
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+	/*
+	 * From now on, log messages are written by a background thread.
+	 */
+
+	pfish_bovespa_log_start ();
+
+	/*
+	 * Prepare the work.
+	 */
+
+	if ((arguments.image != 0) && ((pfish_bovespa_image_attach ()) < 0)) {
+
+		CRIT ("cannot attach to the database image.");
+		FAILURE;
+
+	}
+	if ((arguments.image == 0) && ((pfish_bovespa_snapshot_pin ()) < 0)) {
+
+		CRIT ("cannot pin a database snapshot.");
+		FAILURE;
+
+	}
+	if ((work.stocks = pfish_bovespa_stock_list_alloc ()) == NULL) {
+
+		CRIT ("cannot retrieve stock list from database.");
+		FAILURE;
+
+	}
+	work.metric = arguments.metric;
+	work.view = (arguments.adjusted != 0) ? PFISH_BOVESPA_VIEW_ADJUSTED : PFISH_BOVESPA_VIEW_RAW;
+	work.first_day = arguments.from;
+	work.days_size = arguments.to - arguments.from + 1;
+	work.top = arguments.top;
+	work.workers_size = arguments.jobs;
+	work.failures = 0;
+	if ((work.buckets = (struct rank_bucket *) calloc (work.workers_size * work.days_size, sizeof (struct rank_bucket))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", work.workers_size * work.days_size * sizeof (struct rank_bucket));
+		FAILURE;
+
+	}
+	if ((work.results = (struct rank_bucket *) calloc (work.days_size, sizeof (struct rank_bucket))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", work.days_size * sizeof (struct rank_bucket));
+		FAILURE;
+
+	}
+	if ((workers = (struct rank_worker *) malloc (work.workers_size * sizeof (struct rank_worker))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", work.workers_size * sizeof (struct rank_worker));
+		FAILURE;
+
+	}
+	for ( i = 0; i < work.workers_size; i++ ) {
+
+		workers[i].work = &work;
+		workers[i].index = i;
+
+	}
+
+	/*
+	 * Scan all stocks, then merge all days.
+	 */
+
+	work.next = 0;
+	rank_run (&work, workers, rank_scan_worker);
+	if (work.failures != 0) {
+
+		CRIT ("cannot scan %u stocks.", work.failures);
+		FAILURE;
+
+	}
+	work.next = 0;
+	rank_run (&work, workers, rank_merge_worker);
+	if (work.failures != 0) {
+
+		CRIT ("cannot merge rankings of %u days.", work.failures);
+		FAILURE;
+
+	}
+
+	/*
+	 * Export rankings.
+	 */
+
+	for ( d = 0; d < work.days_size; d++ ) {
+
+		result = &(work.results[d]);
+		trading_date = (time_t) (work.first_day + d) * 86400;
+		if (arguments.binary == 0) {
+
+			if ((gmtime_r (&trading_date, &calendar)) == NULL) {
+
+				CRIT ("cannot understand trading date '%ld' as a timestamp value.", (long) trading_date);
+				FAILURE;
+
+			}
+			if ((strftime (date_buf, DATE_BUF_SIZE, "%F", &calendar)) == 0) {
+
+				CRIT ("cannot build the string representation of the trading date.");
+				FAILURE;
+
+			}
+
+		}
+		for ( i = 0, rank = 1; i < result->size; i++ ) {
+
+			if ((i > 0) && (result->entries[i].value != result->entries[i - 1].value)) {
+
+				rank = i + 1;
+
+			}
+			percentile = (result->count > 1) ? ((100.0 * (result->count - rank)) / (result->count - 1)) : 100.0;
+			if (arguments.binary != 0) {
+
+				memset (&record, 0, sizeof (struct rank_record));
+				record.trading_date = trading_date;
+				record.value = result->entries[i].value;
+				record.percentile = percentile;
+				record.rank = rank;
+				record.count = result->count;
+				strncpy (record.stock, work.stocks->stock_list[result->entries[i].stock].id, sizeof (record.stock) - 1);
+				if ((fwrite (&record, sizeof (struct rank_record), 1, stdout)) != 1) {
+
+					CRIT ("cannot write to standard output.");
+					FAILURE;
+
+				}
+
+			}
+			else {
+
+				printf ("%s,%s,%.6f,%lu,%lu,%.6f\n", date_buf, work.stocks->stock_list[result->entries[i].stock].id, result->entries[i].value, (unsigned long) rank, (unsigned long) result->count, percentile);
+
+			}
+
+		}
+		free (result->entries);
+
+	}
+
+	/*
+	 * Resource releasing.
+	 */
+
+	free (workers);
+	free (work.results);
+	free (work.buckets);
+	free ((void *) work.stocks);
+
+	/*
+	 * End.
+	 */
+
+	if (arguments.stats != 0) {
+
+		pfish_bovespa_metrics_print (stderr);
+
+	}
+	DEBUG ("end.");
+	SUCCESS;
+
+}
+
+#undef DATE_BUF_SIZE
+
+#undef FAILURE
+#undef SUCCESS
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int parse_date (const char *text, long *answer) {
+
+	unsigned int year, month, day;
+	char tail;
+	struct tm calendar;
+	time_t t;
+
+	if ((sscanf (text, "%4u-%2u-%2u%c", &year, &month, &day, &tail)) != 3) {
+
+		FAILURE;
+
+	}
+	if ((year < 1970) || (month < 1) || (month > 12) || (day < 1) || (day > 31)) {
+
+		FAILURE;
+
+	}
+	memset (&calendar, 0, sizeof (struct tm));
+	calendar.tm_year = year - 1900;
+	calendar.tm_mon = month - 1;
+	calendar.tm_mday = day;
+	if ((t = timegm (&calendar)) == (time_t) (-1)) {
+
+		FAILURE;
+
+	}
+	*answer = t / 86400;
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void rank_run (struct rank_work *work, struct rank_worker *workers, void *(*worker) (void *)) {
+
+	pthread_t *threads;	// Helper threads.
+	size_t threads_size;	// How many helper threads were started.
+	size_t i;
+
+	threads_size = work->workers_size - 1;
+	if ((threads = (pthread_t *) malloc ((threads_size + 1) * sizeof (pthread_t))) == NULL) {
+
+		WARNING ("cannot allocate %u bytes of heap space; going on with 1 thread.", (threads_size + 1) * sizeof (pthread_t));
+		threads_size = 0;
+
+	}
+	for ( i = 0; i < threads_size; i++ ) {
+
+		if ((pthread_create (&(threads[i]), NULL, worker, &(workers[i]))) != 0) {
+
+			WARNING ("cannot start thread; going on with %u threads.", i + 1);
+			threads_size = i;
+			break;
+
+		}
+
+	}
+
+	// Threads that could not start leave their share to this one.
+
+	for ( i = threads_size; i < work->workers_size; i++ ) {
+
+		worker (&(workers[i]));
+
+	}
+	for ( i = 0; i < threads_size; i++ ) {
+
+		pthread_join (threads[i], NULL);
+
+	}
+	free (threads);
+
+}
+
+
+void *rank_scan_worker (void *arg) {
+
+	struct rank_worker *worker = (struct rank_worker *) arg;
+	struct rank_work *work = worker->work;
+	struct rank_bucket *buckets;	// Per day rankings of this thread.
+	pfish_bovespa_stock_history_t *history;	// History of the stock being scanned.
+	const pfish_bovespa_daily_quote_t *quote;	// Daily quote being scanned.
+	struct rank_entry entry;	// Ranked stock.
+	double previous_close;	// Unit closing price of the previous daily quote.
+	long day;	// Day of the daily quote, relative to the first day of the range.
+	size_t low, high, middle;	// Binary search delimiters.
+	size_t i;
+
+	buckets = &(work->buckets[worker->index * work->days_size]);
+	while ((entry.stock = __sync_fetch_and_add (&(work->next), 1)) < work->stocks->stock_list_size) {
+
+		if ((pfish_bovespa_stock_history_alloc_view (&(work->stocks->stock_list[entry.stock]), work->view, &history)) < 0) {
+
+			CRIT ("cannot retrieve history of stock '%s' from database.", work->stocks->stock_list[entry.stock].id);
+			__sync_fetch_and_add (&(work->failures), 1);
+			continue;
+
+		}
+		if (history == NULL) {
+
+			continue;
+
+		}
+
+		// Find the first daily quote of the range.
+
+		for ( low = 0, high = history->daily_quotes_size; low < high; ) {
+
+			middle = low + ((high - low) / 2);
+			if ((history->daily_quotes[middle].trading_date / 86400) < work->first_day) {
+
+				low = middle + 1;
+
+			}
+			else {
+
+				high = middle;
+
+			}
+
+		}
+
+#define UNIT_CLOSE(QUOTE) ((double) (QUOTE)->closing_price / (((QUOTE)->price_factor != 0) ? (QUOTE)->price_factor : 1))
+
+		for ( i = low; i < history->daily_quotes_size; i++ ) {
+
+			quote = &(history->daily_quotes[i]);
+			if ((day = (quote->trading_date / 86400) - work->first_day) >= (long) work->days_size) {
+
+				break;
+
+			}
+			switch (work->metric) {
+
+				case RANK_METRIC_VOLUME:
+
+					entry.value = quote->total_volume;
+					break;
+
+				case RANK_METRIC_TRADES:
+
+					entry.value = quote->total_trades;
+					break;
+
+				case RANK_METRIC_STOCKS:
+
+					entry.value = quote->total_stocks;
+					break;
+
+				case RANK_METRIC_CLOSE:
+
+					entry.value = UNIT_CLOSE (quote);
+					break;
+
+				default:
+
+					previous_close = (i > 0) ? UNIT_CLOSE (quote - 1) : 0;
+					entry.value = (previous_close > 0) ? ((UNIT_CLOSE (quote) / previous_close) - 1) : NAN;
+
+			}
+			if (isnan (entry.value)) {
+
+				continue;
+
+			}
+			if ((rank_bucket_push (&(buckets[day]), &entry, work->top)) < 0) {
+
+				__sync_fetch_and_add (&(work->failures), 1);
+				break;
+
+			}
+
+		}
+
+#undef UNIT_CLOSE
+
+		if ((pfish_bovespa_stock_history_free (history)) < 0) {
+
+			CRIT ("cannot release history of stock '%s'.", work->stocks->stock_list[entry.stock].id);
+			__sync_fetch_and_add (&(work->failures), 1);
+
+		}
+
+	}
+	return (NULL);
+
+}
+
+
+void *rank_merge_worker (void *arg) {
+
+	struct rank_worker *worker = (struct rank_worker *) arg;
+	struct rank_work *work = worker->work;
+	struct rank_bucket *result;	// Merged ranking of the day.
+	struct rank_bucket *bucket;	// Ranking of the day of a thread.
+	size_t size;	// How many ranked stocks in all threads.
+	size_t d, w;
+
+	while ((d = __sync_fetch_and_add (&(work->next), 1)) < work->days_size) {
+
+		result = &(work->results[d]);
+		for ( w = 0, size = 0; w < work->workers_size; w++ ) {
+
+			size += work->buckets[(w * work->days_size) + d].size;
+
+		}
+		if (size == 0) {
+
+			continue;
+
+		}
+		if ((result->entries = (struct rank_entry *) malloc (size * sizeof (struct rank_entry))) == NULL) {
+
+			ALERT ("cannot allocate %u bytes of heap space.", size * sizeof (struct rank_entry));
+			__sync_fetch_and_add (&(work->failures), 1);
+			continue;
+
+		}
+		for ( w = 0; w < work->workers_size; w++ ) {
+
+			bucket = &(work->buckets[(w * work->days_size) + d]);
+			memcpy (&(result->entries[result->size]), bucket->entries, bucket->size * sizeof (struct rank_entry));
+			result->size += bucket->size;
+			result->count += bucket->count;
+			free (bucket->entries);
+
+		}
+		qsort (result->entries, result->size, sizeof (struct rank_entry), compare_rank_entries);
+		if ((work->top != 0) && (result->size > work->top)) {
+
+			result->size = work->top;
+
+		}
+
+	}
+	return (NULL);
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int rank_bucket_push (struct rank_bucket *bucket, const struct rank_entry *entry, size_t top) {
+
+	struct rank_entry *entries;	// Resized entries.
+	struct rank_entry aux;
+	size_t capacity;	// New capacity.
+	size_t i, child;
+
+#define BETTER(A,B) ((compare_rank_entries (&(A), &(B))) < 0)
+#define SWAP(A,B) aux = (A); (A) = (B); (B) = aux
+
+	bucket->count++;
+	if ((top != 0) && (bucket->size == top)) {
+
+		// Full heap: replace the worst ranked entry if the new one is better, then sift it down.
+
+		if (!BETTER (*entry, bucket->entries[0])) {
+
+			SUCCESS;
+
+		}
+		bucket->entries[0] = *entry;
+		for ( i = 0; (child = (2 * i) + 1) < bucket->size; i = child ) {
+
+			if ((child + 1 < bucket->size) && BETTER (bucket->entries[child], bucket->entries[child + 1])) {
+
+				child++;
+
+			}
+			if (!BETTER (bucket->entries[i], bucket->entries[child])) {
+
+				break;
+
+			}
+			SWAP (bucket->entries[i], bucket->entries[child]);
+
+		}
+		SUCCESS;
+
+	}
+	if (bucket->size == bucket->capacity) {
+
+		capacity = (bucket->capacity == 0) ? 0x10 : (2 * bucket->capacity);
+		if ((top != 0) && (capacity > top)) {
+
+			capacity = top;
+
+		}
+		if ((entries = (struct rank_entry *) realloc (bucket->entries, capacity * sizeof (struct rank_entry))) == NULL) {
+
+			ALERT ("cannot allocate %u bytes of heap space.", capacity * sizeof (struct rank_entry));
+			FAILURE;
+
+		}
+		bucket->entries = entries;
+		bucket->capacity = capacity;
+
+	}
+	bucket->entries[bucket->size++] = *entry;
+	if (top != 0) {
+
+		// Sift the new entry up, so that the worst ranked entry stays at the root.
+
+		for ( i = bucket->size - 1; i > 0; i = (i - 1) / 2 ) {
+
+			if (!BETTER (bucket->entries[(i - 1) / 2], bucket->entries[i])) {
+
+				break;
+
+			}
+			SWAP (bucket->entries[(i - 1) / 2], bucket->entries[i]);
+
+		}
+
+	}
+	SUCCESS;
+
+#undef SWAP
+#undef BETTER
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+int compare_rank_entries (const void *a, const void *b) {
+
+#define A ((const struct rank_entry *) a)
+#define B ((const struct rank_entry *) b)
+
+	if (A->value != B->value) {
+
+		return ((A->value > B->value) ? -1 : 1);
+
+	}
+	if (A->stock != B->stock) {
+
+		return ((A->stock < B->stock) ? -1 : 1);
+
+	}
+	return (0);
+
+#undef B
+#undef A
+
+}
@@ -0,0 +1,1083 @@
+/*
+ * read_bench.c
+ *
+ * Latency benchmark of reads of the pilot_fish bovespa database.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <argp.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+#include <pilot_fish/bovespa.h>
+
+#include "history_writer.h"
+
+
+#define MAX_THREADS 256	// Readers of concurrent scenarios, at most.
+#define HISTOGRAM_SIZE 64	// Buckets of latencies, by power of two nanoseconds.
+
+
+/*
+ * Command line argument parsing.
+ */
+
+const char *argp_program_version = PACKAGE_VERSION;
+const char *argp_program_bug_address = PACKAGE_BUGREPORT;
+
+static char doc[] = "pfish_bovespa_read_bench -- latency benchmark of reads of the pilot_fish bovespa database.\vThis routine builds a synthetic database with pfish_bovespa_generate and pfish_bovespa_file_import, then times read operations and writes the measures to the standard output as JSON, for comparison between builds. Operations are: 'stock_list', pfish_bovespa_stock_list_alloc() and free(); 'stock_history', pfish_bovespa_stock_history_alloc() and pfish_bovespa_stock_history_free() of a random stock; and 'history_format', the CSV export of the history of a random stock (as pfish_bovespa_stock_history does, to /dev/null).\n\nScenarios are: 'cold', one reader, with the page cache of the database dropped before each operation; 'warm', one reader, after a warm-up; 'concurrent', THREADS readers at once; and 'concurrent_import', THREADS readers at once while pfish_bovespa_file_import rewrites stock files over and over.\n\nEach operation of each scenario reports latency percentiles (p50, p99, p999, maximum), a histogram of latencies (counts by power of two nanoseconds), failed operations and throughput.\n\nThe page cache is dropped through /proc/sys/vm/drop_caches where permitted (root), otherwise by advising the kernel that the files of the database are not needed (the 'cold_method' of the measures).\n\nThe database is reinitialized (all its contents are lost). This routine refuses to run on a database holding stocks unless forced; benchmark with a build configured with its own --localstatedir.\n";
+
+static struct argp_option options[] = {
+
+	{"stocks", 's', "STOCKS",  0, "quote STOCKS stocks (default: 400).", 0 },
+	{"days", 'd', "DAYS",  0, "cover DAYS trading days (default: 1000).", 0 },
+	{"seed", 'r', "SEED",  0, "generate files with SEED (default: 1).", 0 },
+	{"operations", 'n', "OPERATIONS",  0, "time OPERATIONS operations per reader of each scenario (default: 2000).", 0 },
+	{"cold-operations", 'c', "OPERATIONS",  0, "time OPERATIONS operations of the cold scenario (default: 100).", 0 },
+	{"threads", 'j', "THREADS",  0, "run THREADS readers in concurrent scenarios (default: 4).", 0 },
+	{"bindir", 'B', "DIR",  0, "run programs found in DIR (default: current directory).", 0 },
+	{"work-dir", 'w', "DIR",  0, "keep generated files in DIR while running (default: '" P_tmpdir "').", 0 },
+	{"label", 'l', "LABEL",  0, "tag the measures with LABEL (the build being measured, for instance).", 0 },
+	{"force", 'f', 0,  0, "run even if the database holds stocks.", 0 },
+	{ 0 }
+
+};
+
+struct arguments {
+
+	long stocks;
+	long days;
+	unsigned long seed;
+	long operations;
+	long cold_operations;
+	long threads;
+	char *bindir;
+	char *work_dir;
+	char *label;
+	unsigned int force;
+
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+	char *aux_charp;
+
+	switch (key) {
+
+		case 's':
+
+			arguments->stocks = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->stocks < 1)) {
+
+				argp_error (state, "invalid number of stocks '%s'.", arg);
+
+			}
+			break;
+
+		case 'd':
+
+			arguments->days = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->days < 1)) {
+
+				argp_error (state, "invalid number of days '%s'.", arg);
+
+			}
+			break;
+
+		case 'r':
+
+			arguments->seed = strtoul (arg, &aux_charp, 10);
+			if (*aux_charp != 0) {
+
+				argp_error (state, "invalid seed '%s'.", arg);
+
+			}
+			break;
+
+		case 'n':
+
+			arguments->operations = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->operations < 1)) {
+
+				argp_error (state, "invalid number of operations '%s'.", arg);
+
+			}
+			break;
+
+		case 'c':
+
+			arguments->cold_operations = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->cold_operations < 1)) {
+
+				argp_error (state, "invalid number of operations '%s'.", arg);
+
+			}
+			break;
+
+		case 'j':
+
+			arguments->threads = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->threads < 1) || (arguments->threads > MAX_THREADS)) {
+
+				argp_error (state, "invalid number of threads '%s' (1 to %d).", arg, MAX_THREADS);
+
+			}
+			break;
+
+		case 'B':
+
+			arguments->bindir = arg;
+			break;
+
+		case 'w':
+
+			arguments->work_dir = arg;
+			break;
+
+		case 'l':
+
+			for ( aux_charp = arg; *aux_charp != 0; aux_charp++ ) {
+
+				if ((*aux_charp < ' ') || (*aux_charp == '"') || (*aux_charp == '\\')) {
+
+					argp_error (state, "invalid label '%s': control characters, quotes and backslashes are not allowed.", arg);
+
+				}
+
+			}
+			arguments->label = arg;
+			break;
+
+		case 'f':
+
+			arguments->force = 1;
+			break;
+
+		case ARGP_KEY_ARG:
+
+			argp_usage (state);
+			break;
+
+		default:
+
+			return (ARGP_ERR_UNKNOWN);
+
+	};
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, 0, doc };
+
+
+#define GENERATE_NAME "pfish_bovespa_generate"
+#define DATABASE_INIT_NAME "pfish_bovespa_database_init"
+#define FILE_IMPORT_NAME "pfish_bovespa_file_import"
+#define FIRST_DATE "20100104"	// A Monday.
+
+
+/*
+ * Operations and scenarios.
+ */
+
+#define OPERATION_STOCK_LIST 0
+#define OPERATION_STOCK_HISTORY 1
+#define OPERATION_HISTORY_FORMAT 2
+#define OPERATIONS_SIZE 3
+
+static const char *operation_names[OPERATIONS_SIZE] = { "stock_list", "stock_history", "history_format" };
+
+#define SCENARIO_COLD 0
+#define SCENARIO_WARM 1
+#define SCENARIO_CONCURRENT 2
+#define SCENARIO_CONCURRENT_IMPORT 3
+#define SCENARIOS_SIZE 4
+
+static const char *scenario_names[SCENARIOS_SIZE] = { "cold", "warm", "concurrent", "concurrent_import" };
+
+
+/*
+ * How the page cache is dropped.
+ */
+
+#define COLD_METHOD_DROP_CACHES 0
+#define COLD_METHOD_FADVISE 1
+
+static const char *cold_method_names[] = { "drop_caches", "fadvise" };
+
+static unsigned int cold_method;	// One of COLD_METHOD_*.
+
+
+/*
+ * A reader: runs an operation a number of times, and keeps latencies.
+ */
+
+struct reader {
+
+	unsigned int operation;	// One of OPERATION_* values.
+	unsigned int cold;	// Not zero to drop the page cache before each operation.
+	const pfish_bovespa_stock_list_t *stock_list;	// Stocks of the database.
+	unsigned int seed;	// Random choice of stocks.
+	long operations;	// How many operations.
+	uint64_t *latencies;	// Latency of each operation, in nanoseconds.
+	long failures;	// Failed operations.
+
+};
+
+
+/*
+ * Measures of an operation in a scenario.
+ */
+
+struct measure {
+
+	unsigned int scenario;	// One of SCENARIO_* values.
+	unsigned int operation;	// One of OPERATION_* values.
+	long threads;	// How many readers.
+	long operations;	// Operations of all readers.
+	long failures;	// Failed operations of all readers.
+	double seconds;	// Elapsed time of the scenario.
+	uint64_t p50, p99, p999, max;	// Latency percentiles, in nanoseconds.
+	unsigned long histogram[HISTOGRAM_SIZE];	// Operations by floor (log2 (latency in nanoseconds)).
+
+};
+
+
+/*
+ * Control of the import running along concurrent readers.
+ */
+
+struct importer {
+
+	const char *program;	// Pathname of the import program.
+	const char *pathname;	// Pathname of the imported file.
+	volatile int stop;	// Set to stop importing.
+	long imports;	// Completed imports.
+	long failures;	// Failed imports.
+
+};
+
+
+/*
+ * Run a program and wait for it.
+ *
+ * @param[in] argv program (argv[0]) and its arguments, NULL terminated.
+ * @param[in] input pathname of the standard input of the program, NULL to inherit.
+ * @param[in] output pathname of the standard output of the program (truncated), NULL to inherit.
+ *
+ * @return 0 if the program exited successfully, negative otherwise.
+ */
+
+int program_run (char *const argv[], const char *input, const char *output);
+
+
+/*
+ * Format a date some trading weeks after FIRST_DATE, as YYYYMMDD.
+ *
+ * @param[in] days trading days to skip; whole weeks are skipped, so that the date is past the skipped days.
+ * @param[out] buffer formatted date (at least 9 octets).
+ */
+
+void date_after (long days, char *buffer);
+
+
+/*
+ * Choose how to drop the page cache: /proc/sys/vm/drop_caches if writable, file advice otherwise.
+ */
+
+void cold_method_choose (void);
+
+
+/*
+ * Drop the page cache of the database.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int cache_drop (void);
+
+
+/*
+ * Run a reader (thread start routine).
+ *
+ * @param[in,out] arg the reader (struct reader *).
+ *
+ * @return NULL.
+ */
+
+void *reader_run (void *arg);
+
+
+/*
+ * Import a file over and over until stopped (thread start routine).
+ *
+ * @param[in,out] arg the importer (struct importer *).
+ *
+ * @return NULL.
+ */
+
+void *importer_run (void *arg);
+
+
+/*
+ * Run a scenario of an operation, and measure it.
+ *
+ * @param[in] stock_list stocks of the database.
+ * @param[in] threads how many readers.
+ * @param[in] operations operations per reader.
+ * @param[in] cold not zero to drop the page cache before each operation.
+ * @param[in,out] measure measures (scenario and operation are given, everything else is filled).
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int scenario_measure (const pfish_bovespa_stock_list_t *stock_list, long threads, long operations, unsigned int cold, struct measure *measure);
+
+
+/*
+ * Compare two latencies, for qsort().
+ */
+
+int compare_latencies (const void *a, const void *b);
+
+
+/*
+ * The portal.
+ */
+
+#define SUCCESS return (EXIT_SUCCESS)
+#define FAILURE return (EXIT_FAILURE)
+
+int main (int argc, char **argv) {
+
+	struct arguments arguments;	// Arguments given in the command line.
+	pfish_bovespa_stock_list_t *stock_list;	// Stocks of the database.
+	struct measure measures[SCENARIOS_SIZE * OPERATIONS_SIZE];	// Measures of each operation of each scenario.
+	size_t measures_size;	// How many elements in 'measures'.
+	struct importer importer;	// Import along concurrent readers.
+	pthread_t importer_thread;	// Thread of the import.
+	char hist_pathname[PATH_MAX], bdin_pathname[PATH_MAX];	// Pathnames of the generated files.
+	char program[PATH_MAX];	// Pathname of a program.
+	char import_program[PATH_MAX];	// Pathname of the import program.
+	char stocks[32], days[32], seed[32], begin[16];	// Arguments of the generator.
+	char *program_argv[16];	// Arguments of a program.
+	size_t histogram_size;	// Buckets of a histogram up to the last one not empty.
+	unsigned int scenario, operation;
+	int des;
+	size_t i, j;
+
+	/*
+	 * Begin.
+	 */
+
+	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	DEBUG ("start.");
+
+	/*
+	 * Parse command line arguments.
+	 */
+
+	arguments.stocks = 400;
+	arguments.days = 1000;
+	arguments.seed = 1;
+	arguments.operations = 2000;
+	arguments.cold_operations = 100;
+	arguments.threads = 4;
+	arguments.bindir = ".";
+	arguments.work_dir = P_tmpdir;
+	arguments.label = "";
+	arguments.force = 0;
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+	/*
+	 * Refuse to destroy a database holding stocks.
+	 */
+
+	if ((stock_list = pfish_bovespa_stock_list_alloc ()) != NULL) {
+
+		if ((stock_list->stock_list_size != 0) && (arguments.force == 0)) {
+
+			CRIT ("database '%s' holds %u stocks; benchmarks reinitialize it (use --force to run anyway).", DBPATH, stock_list->stock_list_size);
+			free (stock_list);
+			FAILURE;
+
+		}
+		free (stock_list);
+
+	}
+
+	/*
+	 * Build the database: a COTAHIST file of DAYS trading days,
+	 * and keep a BDIN file of the next trading session for the concurrent import.
+	 */
+
+#define PROGRAM(NAME) \
+	if ((snprintf (program, PATH_MAX, "%s/%s", arguments.bindir, NAME)) >= PATH_MAX) { \
+		CRIT ("pathname of program '%s' is too big.", NAME); \
+		FAILURE; \
+	}
+
+	PROGRAM (DATABASE_INIT_NAME);
+	program_argv[0] = program;
+	program_argv[1] = "-f";
+	program_argv[2] = NULL;
+	if ((program_run (program_argv, NULL, NULL)) < 0) {
+
+		CRIT ("cannot initialize the database.");
+		FAILURE;
+
+	}
+	if (((snprintf (hist_pathname, PATH_MAX, "%s/pfish_bovespa_bench.XXXXXX", arguments.work_dir)) >= PATH_MAX) || ((snprintf (bdin_pathname, PATH_MAX, "%s/pfish_bovespa_bench.XXXXXX", arguments.work_dir)) >= PATH_MAX)) {
+
+		CRIT ("pathname of work directory '%s' is too big.", arguments.work_dir);
+		FAILURE;
+
+	}
+	if ((des = mkstemp (hist_pathname)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot create file in '%s'.", arguments.work_dir);
+		FAILURE;
+
+	}
+	close (des);
+	if ((des = mkstemp (bdin_pathname)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot create file in '%s'.", arguments.work_dir);
+		unlink (hist_pathname);
+		FAILURE;
+
+	}
+	close (des);
+	snprintf (stocks, sizeof (stocks), "%ld", arguments.stocks);
+	snprintf (days, sizeof (days), "%ld", arguments.days);
+	snprintf (seed, sizeof (seed), "%lu", arguments.seed);
+	for ( i = 0; i < 2; i++ ) {
+
+		if (i == 0) {
+
+			strcpy (begin, FIRST_DATE);
+
+		}
+		else {
+
+			date_after (arguments.days, begin);
+
+		}
+		PROGRAM (GENERATE_NAME);
+		program_argv[0] = program;
+		program_argv[1] = "--type";
+		program_argv[2] = (i == 0) ? "hist" : "bdin";
+		program_argv[3] = "--stocks";
+		program_argv[4] = stocks;
+		program_argv[5] = "--days";
+		program_argv[6] = days;
+		program_argv[7] = "--begin";
+		program_argv[8] = begin;
+		program_argv[9] = "--seed";
+		program_argv[10] = seed;
+		program_argv[11] = NULL;
+		if ((program_run (program_argv, NULL, (i == 0) ? hist_pathname : bdin_pathname)) < 0) {
+
+			CRIT ("cannot generate files.");
+			unlink (hist_pathname);
+			unlink (bdin_pathname);
+			FAILURE;
+
+		}
+
+	}
+	PROGRAM (FILE_IMPORT_NAME);
+	strcpy (import_program, program);
+	program_argv[0] = import_program;
+	program_argv[1] = NULL;
+	if ((program_run (program_argv, hist_pathname, NULL)) < 0) {
+
+		CRIT ("cannot import file '%s'.", hist_pathname);
+		unlink (hist_pathname);
+		unlink (bdin_pathname);
+		FAILURE;
+
+	}
+	unlink (hist_pathname);
+
+#undef PROGRAM
+
+	if ((stock_list = pfish_bovespa_stock_list_alloc ()) == NULL) {
+
+		CRIT ("cannot retrieve stock list from database.");
+		unlink (bdin_pathname);
+		FAILURE;
+
+	}
+	if (stock_list->stock_list_size == 0) {
+
+		CRIT ("no stocks imported.");
+		unlink (bdin_pathname);
+		FAILURE;
+
+	}
+	cold_method_choose ();
+
+	/*
+	 * Scenarios.
+	 */
+
+	measures_size = 0;
+	for ( scenario = 0; scenario < SCENARIOS_SIZE; scenario++ ) {
+
+		if (scenario == SCENARIO_CONCURRENT_IMPORT) {
+
+			importer.program = import_program;
+			importer.pathname = bdin_pathname;
+			importer.stop = 0;
+			importer.imports = 0;
+			importer.failures = 0;
+			if ((pthread_create (&importer_thread, NULL, importer_run, &importer)) != 0) {
+
+				CRIT ("cannot create import thread.");
+				unlink (bdin_pathname);
+				FAILURE;
+
+			}
+
+		}
+		for ( operation = 0; operation < OPERATIONS_SIZE; operation++ ) {
+
+			measures[measures_size].scenario = scenario;
+			measures[measures_size].operation = operation;
+			if ((scenario_measure (stock_list, (scenario < SCENARIO_CONCURRENT) ? 1 : arguments.threads, (scenario == SCENARIO_COLD) ? arguments.cold_operations : arguments.operations, (scenario == SCENARIO_COLD), &(measures[measures_size]))) < 0) {
+
+				CRIT ("cannot measure operation '%s' of scenario '%s'.", operation_names[operation], scenario_names[scenario]);
+				unlink (bdin_pathname);
+				FAILURE;
+
+			}
+			INFO ("%s %s: p50 %lu ns, p99 %lu ns.", scenario_names[scenario], operation_names[operation], (unsigned long) measures[measures_size].p50, (unsigned long) measures[measures_size].p99);
+			measures_size++;
+
+		}
+		if (scenario == SCENARIO_CONCURRENT_IMPORT) {
+
+			importer.stop = 1;
+			pthread_join (importer_thread, NULL);
+			INFO ("%ld imports along concurrent readers.", importer.imports);
+			if (importer.failures != 0) {
+
+				WARNING ("%ld imports failed along concurrent readers.", importer.failures);
+
+			}
+
+		}
+
+	}
+	unlink (bdin_pathname);
+	free (stock_list);
+
+	/*
+	 * Report.
+	 */
+
+	printf ("{\n");
+	printf ("\t\"label\": \"%s\",\n", arguments.label);
+	printf ("\t\"version\": \"%s\",\n", PACKAGE_VERSION);
+	printf ("\t\"stocks\": %ld,\n", arguments.stocks);
+	printf ("\t\"days\": %ld,\n", arguments.days);
+	printf ("\t\"seed\": %lu,\n", arguments.seed);
+	printf ("\t\"cold_method\": \"%s\",\n", cold_method_names[cold_method]);
+	printf ("\t\"concurrent_imports\": %ld,\n", importer.imports);
+	printf ("\t\"measures\": [\n");
+	for ( i = 0; i < measures_size; i++ ) {
+
+		printf ("\t\t{\n");
+		printf ("\t\t\t\"scenario\": \"%s\",\n", scenario_names[measures[i].scenario]);
+		printf ("\t\t\t\"operation\": \"%s\",\n", operation_names[measures[i].operation]);
+		printf ("\t\t\t\"threads\": %ld,\n", measures[i].threads);
+		printf ("\t\t\t\"operations\": %ld,\n", measures[i].operations);
+		printf ("\t\t\t\"failures\": %ld,\n", measures[i].failures);
+		printf ("\t\t\t\"seconds\": %.6f,\n", measures[i].seconds);
+		printf ("\t\t\t\"operations_per_second\": %.1f,\n", (measures[i].seconds > 0) ? (measures[i].operations / measures[i].seconds) : 0);
+		printf ("\t\t\t\"p50_ns\": %lu,\n", (unsigned long) measures[i].p50);
+		printf ("\t\t\t\"p99_ns\": %lu,\n", (unsigned long) measures[i].p99);
+		printf ("\t\t\t\"p999_ns\": %lu,\n", (unsigned long) measures[i].p999);
+		printf ("\t\t\t\"max_ns\": %lu,\n", (unsigned long) measures[i].max);
+		printf ("\t\t\t\"histogram_log2_ns\": [");
+		for ( histogram_size = HISTOGRAM_SIZE; (histogram_size > 0) && (measures[i].histogram[histogram_size - 1] == 0); histogram_size-- );
+		for ( j = 0; j < histogram_size; j++ ) {
+
+			printf ("%s%lu", (j == 0) ? "" : ", ", measures[i].histogram[j]);
+
+		}
+		printf ("]\n");
+		printf ("\t\t}%s\n", (i < (measures_size - 1)) ? "," : "");
+
+	}
+	printf ("\t]\n");
+	printf ("}\n");
+	if ((fflush (stdout)) != 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot write to the standard output.");
+		FAILURE;
+
+	}
+
+	/*
+	 * End.
+	 */
+
+	DEBUG ("end.");
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int program_run (char *const argv[], const char *input, const char *output) {
+
+	pid_t pid;	// Process of the program.
+	int status;	// Exit status of the program.
+	int des;
+
+	if ((pid = fork ()) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot fork.");
+		FAILURE;
+
+	}
+	if (pid == 0) {
+
+		if (input != NULL) {
+
+			if (((des = open (input, O_RDONLY)) < 0) || ((dup2 (des, STDIN_FILENO)) < 0)) {
+
+				_exit (127);
+
+			}
+			close (des);
+
+		}
+		if (output != NULL) {
+
+			if (((des = open (output, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) || ((dup2 (des, STDOUT_FILENO)) < 0)) {
+
+				_exit (127);
+
+			}
+			close (des);
+
+		}
+		execv (argv[0], argv);
+		_exit (127);
+
+	}
+	while ((waitpid (pid, &status, 0)) < 0) {
+
+		if (errno != EINTR) {
+
+			ERRNO_ERR;
+			CRIT ("cannot wait for program '%s'.", argv[0]);
+			FAILURE;
+
+		}
+
+	}
+	if ((!WIFEXITED (status)) || (WEXITSTATUS (status) != EXIT_SUCCESS)) {
+
+		ERR ("program '%s' failed (status %d).", argv[0], status);
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void date_after (long days, char *buffer) {
+
+	struct tm date;	// Calendar date.
+	time_t day;	// Date as time.
+
+	memset (&date, 0, sizeof (struct tm));
+	date.tm_year = 110;
+	date.tm_mon = 0;
+	date.tm_mday = 4;
+	date.tm_hour = 12;
+	day = timegm (&date) + (((days + 4) / 5) * 7 * 86400);
+	gmtime_r (&day, &date);
+	strftime (buffer, 9, "%Y%m%d", &date);
+
+}
+
+
+void cold_method_choose (void) {
+
+	cold_method = ((access ("/proc/sys/vm/drop_caches", W_OK)) == 0) ? COLD_METHOD_DROP_CACHES : COLD_METHOD_FADVISE;
+	DEBUG ("page cache dropped by %s.", cold_method_names[cold_method]);
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int cache_drop (void) {
+
+	char pathname[PATH_MAX];	// Pathname of a file of the database.
+	struct dirent *entry;	// An entry of the database directory.
+	DIR *dir;	// The database directory.
+	int des;
+
+	/*
+	 * Drop everything, if permitted.
+	 */
+
+	if (cold_method == COLD_METHOD_DROP_CACHES) {
+
+		sync ();
+		if (((des = open ("/proc/sys/vm/drop_caches", O_WRONLY)) < 0) || ((write (des, "1", 1)) != 1)) {
+
+			ERRNO_ERR;
+			CRIT ("cannot drop page cache.");
+			if (des >= 0) {
+
+				close (des);
+
+			}
+			FAILURE;
+
+		}
+		close (des);
+		SUCCESS;
+
+	}
+
+	/*
+	 * Otherwise, advise the kernel to drop the files of the database (clean pages only: imports are not running).
+	 */
+
+	if ((dir = opendir (DBPATH)) == NULL) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open directory '%s'.", DBPATH);
+		FAILURE;
+
+	}
+	while ((entry = readdir (dir)) != NULL) {
+
+		if ((snprintf (pathname, PATH_MAX, "%s/%s", DBPATH, entry->d_name)) >= PATH_MAX) {
+
+			continue;
+
+		}
+		if ((des = open (pathname, O_RDONLY)) < 0) {
+
+			continue;
+
+		}
+		posix_fadvise (des, 0, 0, POSIX_FADV_DONTNEED);
+		close (des);
+
+	}
+	closedir (dir);
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void *reader_run (void *arg) {
+
+	struct reader *reader = (struct reader *) arg;
+	pfish_bovespa_stock_list_t *stock_list;	// Result of OPERATION_STOCK_LIST.
+	pfish_bovespa_stock_history_t *history;	// Result of OPERATION_STOCK_HISTORY, input of OPERATION_HISTORY_FORMAT.
+	pfish_bovespa_history_writer_t *writer;	// Writer of OPERATION_HISTORY_FORMAT.
+	const pfish_bovespa_stock_id_t *stock_id;	// Stock of an operation.
+	struct timespec start, stop;	// Elapsed time measurement.
+	FILE *stream;	// Destination of OPERATION_HISTORY_FORMAT.
+	unsigned int failed;
+	long i;
+
+	writer = NULL;
+	stream = NULL;
+	if (reader->operation == OPERATION_HISTORY_FORMAT) {
+
+		if (((stream = fopen ("/dev/null", "w")) == NULL) || ((pfish_bovespa_history_writer_alloc (stream, PFISH_BOVESPA_HISTORY_FORMAT_CSV, PFISH_BOVESPA_HISTORY_FIELDS_ALL, &writer)) < 0)) {
+
+			CRIT ("cannot prepare history export.");
+			reader->failures = reader->operations;
+			if (stream != NULL) {
+
+				fclose (stream);
+
+			}
+			return (NULL);
+
+		}
+
+	}
+	for ( i = 0; i < reader->operations; i++ ) {
+
+		stock_id = &(reader->stock_list->stock_list[rand_r (&(reader->seed)) % reader->stock_list->stock_list_size]);
+		history = NULL;
+		if (reader->operation == OPERATION_HISTORY_FORMAT) {
+
+			if ((pfish_bovespa_stock_history_alloc (stock_id, &history)) < 0) {
+
+				reader->failures++;
+				reader->latencies[i] = 0;
+				continue;
+
+			}
+
+		}
+		if (reader->cold != 0) {
+
+			cache_drop ();
+
+		}
+		failed = 0;
+		clock_gettime (CLOCK_MONOTONIC, &start);
+		switch (reader->operation) {
+
+			case OPERATION_STOCK_LIST:
+
+				if ((stock_list = pfish_bovespa_stock_list_alloc ()) == NULL) {
+
+					failed = 1;
+
+				}
+				else {
+
+					free (stock_list);
+
+				}
+				break;
+
+			case OPERATION_STOCK_HISTORY:
+
+				if ((pfish_bovespa_stock_history_alloc (stock_id, &history)) < 0) {
+
+					failed = 1;
+
+				}
+				else {
+
+					pfish_bovespa_stock_history_free (history);
+
+				}
+				break;
+
+			default:
+
+				if (((pfish_bovespa_history_writer_begin (writer)) < 0) || ((pfish_bovespa_history_writer_write (writer, stock_id, history, 0)) < 0) || ((pfish_bovespa_history_writer_end (writer)) < 0)) {
+
+					failed = 1;
+
+				}
+
+		}
+		clock_gettime (CLOCK_MONOTONIC, &stop);
+		reader->latencies[i] = ((stop.tv_sec - start.tv_sec) * 1000000000ULL) + stop.tv_nsec - start.tv_nsec;
+		reader->failures += failed;
+		if ((reader->operation == OPERATION_HISTORY_FORMAT) && (history != NULL)) {
+
+			pfish_bovespa_stock_history_free (history);
+
+		}
+
+	}
+	if (writer != NULL) {
+
+		pfish_bovespa_history_writer_free (writer);
+
+	}
+	if (stream != NULL) {
+
+		fclose (stream);
+
+	}
+	return (NULL);
+
+}
+
+
+void *importer_run (void *arg) {
+
+	struct importer *importer = (struct importer *) arg;
+	char *program_argv[2];	// Arguments of the import program.
+
+	program_argv[0] = (char *) importer->program;
+	program_argv[1] = NULL;
+	while (importer->stop == 0) {
+
+		if ((program_run (program_argv, importer->pathname, NULL)) < 0) {
+
+			importer->failures++;
+			usleep (100000);
+
+		}
+		else {
+
+			importer->imports++;
+
+		}
+
+	}
+	return (NULL);
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int scenario_measure (const pfish_bovespa_stock_list_t *stock_list, long threads, long operations, unsigned int cold, struct measure *measure) {
+
+	struct reader readers[MAX_THREADS];	// The readers.
+	pthread_t reader_threads[MAX_THREADS];	// Threads of the readers.
+	uint64_t *latencies;	// Latencies of all readers.
+	struct timespec start, stop;	// Elapsed time measurement.
+	size_t latencies_size;	// How many elements in 'latencies'.
+	unsigned int bucket;
+	long i;
+
+	latencies_size = threads * operations;
+	if ((latencies = (uint64_t *) malloc (latencies_size * sizeof (uint64_t))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", latencies_size * sizeof (uint64_t));
+		FAILURE;
+
+	}
+	for ( i = 0; i < threads; i++ ) {
+
+		readers[i].operation = measure->operation;
+		readers[i].cold = cold;
+		readers[i].stock_list = stock_list;
+		readers[i].seed = (measure->scenario * 1000003) + (measure->operation * 1009) + i + 1;
+		readers[i].operations = operations;
+		readers[i].latencies = latencies + (i * operations);
+		readers[i].failures = 0;
+
+	}
+
+	/*
+	 * Warm up (the page cache and the library), unless cold.
+	 */
+
+	if (cold == 0) {
+
+		reader_run (&(readers[0]));
+		readers[0].failures = 0;
+
+	}
+
+	/*
+	 * Run the readers.
+	 */
+
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	if (threads == 1) {
+
+		reader_run (&(readers[0]));
+
+	}
+	else {
+
+		for ( i = 0; i < threads; i++ ) {
+
+			if ((pthread_create (&(reader_threads[i]), NULL, reader_run, &(readers[i]))) != 0) {
+
+				CRIT ("cannot create reader thread.");
+				while (i > 0) {
+
+					pthread_join (reader_threads[--i], NULL);
+
+				}
+				free (latencies);
+				FAILURE;
+
+			}
+
+		}
+		for ( i = 0; i < threads; i++ ) {
+
+			pthread_join (reader_threads[i], NULL);
+
+		}
+
+	}
+	clock_gettime (CLOCK_MONOTONIC, &stop);
+
+	/*
+	 * Measures.
+	 */
+
+	measure->threads = threads;
+	measure->operations = latencies_size;
+	measure->failures = 0;
+	for ( i = 0; i < threads; i++ ) {
+
+		measure->failures += readers[i].failures;
+
+	}
+	measure->seconds = (stop.tv_sec - start.tv_sec) + ((stop.tv_nsec - start.tv_nsec) / 1e9);
+	qsort (latencies, latencies_size, sizeof (uint64_t), compare_latencies);
+	measure->p50 = latencies[(latencies_size * 500) / 1000];
+	measure->p99 = latencies[(latencies_size * 990) / 1000];
+	measure->p999 = latencies[(latencies_size * 999) / 1000];
+	measure->max = latencies[latencies_size - 1];
+	memset (measure->histogram, 0, sizeof (measure->histogram));
+	for ( i = 0; i < (long) latencies_size; i++ ) {
+
+		for ( bucket = 0; (latencies[i] >> (bucket + 1)) != 0; bucket++ );
+		measure->histogram[bucket]++;
+
+	}
+	free (latencies);
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+int compare_latencies (const void *a, const void *b) {
+
+	uint64_t x = *((const uint64_t *) a);
+	uint64_t y = *((const uint64_t *) b);
+
+	return ((x > y) - (x < y));
+
+}
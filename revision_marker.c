@@ -13,6 +13,8 @@
 #include <pilot_fish/bovespa.h>
 
 #include "revision_marker.h"
+#include "metrics.h"
+#include "async_log.h"
 
 
 #define FAILURE return (-1)
@@ -35,7 +37,13 @@ int pfish_bovespa_revision_marker_content_alloc (char **target) {
 }
 
 
-int pfish_bovespa_revision_marker_check () {
+/*
+ * Compare the revision marker of the database with the one expected by this library.
+ *
+ * @return 0 on match, negative on mismatch or failure.
+ */
+
+static int revision_marker_compare () {
 
 	char *expected_content;
 	char *current_content;
@@ -103,6 +111,25 @@ int pfish_bovespa_revision_marker_check () {
 }
 
 
+int pfish_bovespa_revision_marker_check () {
+
+	uint64_t start;	// Start of the check, for metrics.
+	int rcode;
+
+	start = pfish_bovespa_metrics_clock ();
+	rcode = revision_marker_compare ();
+	METRICS_ADD (revision_checks, 1);
+	METRICS_ADD (revision_check_nanoseconds, METRICS_LATENCY (revision_check_latency, start));
+	if (rcode < 0) {
+
+		METRICS_FAILURE (PFISH_BOVESPA_FAILURE_REVISION);
+
+	}
+	return (rcode);
+
+}
+
+
 #undef SUCCESS
 #undef FAILURE
 
@@ -0,0 +1,650 @@
+/*
+ * screen.c
+ *
+ * Stock screener over the pilot_fish bovespa database.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <syslog.h>
+#include <argp.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+#include <pilot_fish/bovespa.h>
+
+#include "expression.h"
+#include "async_log.h"
+
+
+/*
+ * Command line argument parsing.
+ */
+
+const char *argp_program_version = PACKAGE_VERSION;
+const char *argp_program_bug_address = PACKAGE_BUGREPORT;
+
+static char doc[] = "pfish_bovespa_screen -- stock screener over the pilot_fish bovespa database.\vThis routine evaluates EXPRESSION on the trade history of every stock, and exports the trading days that satisfy it through the standard output in CSV format.\nWithout FROM, only the most recent trading day of each stock is screened; TO defaults to FROM.\n\nExported fields are: trading date, stock.\n\nFormat of date fields is YYYY-MM-DD.\n\nEXPRESSION combines fields with arithmetic (+ - * /), comparisons (< <= > >= == !=) and logic (and, or, not). Example: 'close > sma(close, 200) and total_volume > 1e8 and total_trades > 500'.\nFields: open, close, minimum, maximum, average (unit prices, in units of 1/100 of the stock currency), total_trades, total_stocks, total_volume (in units of 1/100 of the stock currency).\nFunctions: sma(X, N), ema(X, N), highest(X, N), lowest(X, N) over the last N trading days; lag(X, N) is X of N trading days ago; abs(X). Window functions are undefined until their window is full, and comparisons with undefined values are false.\n\nEXPRESSION is compiled once into a plan that runs over blocks of trading days, skipping the second operand of 'and' / 'or' on blocks already decided by the first one. Stocks are screened in parallel.\n";
+
+static char args_doc[] = "EXPRESSION [FROM [TO]]";
+
+static struct argp_option options[] = {
+
+	{"adjusted", 'x', 0, 0, "use prices adjusted by inplits / splits.", 0 },
+	{"period", 'p', "PERIOD", 0, "screen rollups of trades by PERIOD: 'daily' (default), 'weekly' or 'monthly'.", 0 },
+	{"image", 'm', 0, 0, "read from the shared memory database image (see pfish_bovespa_image_load).", 0 },
+	{"jobs", 'j', "JOBS", 0, "use JOBS threads (default: number of online processors).", 0 },
+	{"stats", 'S', 0, 0, "print runtime metrics of the library to the standard error on exit.", 0 },
+	{ 0 }
+
+};
+
+struct arguments {
+
+	char *expression;
+	long from;	// Days since the epoch; negative for the most recent trading day.
+	long to;	// Days since the epoch.
+	unsigned int adjusted;
+	unsigned int period;
+	unsigned int image;
+	long jobs;
+	unsigned int stats;
+
+};
+
+
+/*
+ * Parse a date.
+ *
+ * @param[in] text date in format YYYY-MM-DD.
+ * @param[out] answer days since the epoch.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int parse_date (const char *text, long *answer);
+
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+	char *aux_charp;
+
+	switch (key) {
+
+		case 'x':
+
+			arguments->adjusted = 1;
+			break;
+
+		case 'p':
+
+			if ((strcmp (arg, "daily")) == 0) {
+
+				arguments->period = PFISH_BOVESPA_VIEW_RAW;
+
+			}
+			else if ((strcmp (arg, "weekly")) == 0) {
+
+				arguments->period = PFISH_BOVESPA_VIEW_WEEKLY;
+
+			}
+			else if ((strcmp (arg, "monthly")) == 0) {
+
+				arguments->period = PFISH_BOVESPA_VIEW_MONTHLY;
+
+			}
+			else {
+
+				argp_error (state, "unknown period '%s'.", arg);
+
+			}
+			break;
+
+		case 'm':
+
+			arguments->image = 1;
+			break;
+
+		case 'j':
+
+			arguments->jobs = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->jobs < 1)) {
+
+				argp_error (state, "invalid number of jobs '%s'.", arg);
+
+			}
+			break;
+
+		case 'S':
+
+			arguments->stats = 1;
+			break;
+
+		case ARGP_KEY_ARG:
+
+			switch (state->arg_num) {
+
+				case 0:
+
+					arguments->expression = arg;
+					break;
+
+				case 1:
+
+					if ((parse_date (arg, &(arguments->from))) < 0) {
+
+						argp_error (state, "invalid date '%s'.", arg);
+
+					}
+					arguments->to = arguments->from;
+					break;
+
+				case 2:
+
+					if ((parse_date (arg, &(arguments->to))) < 0) {
+
+						argp_error (state, "invalid date '%s'.", arg);
+
+					}
+					break;
+
+				default:
+
+					argp_usage (state);
+
+			}
+			break;
+
+		case ARGP_KEY_END:
+
+			if (state->arg_num < 1) {
+
+				argp_usage (state);
+
+			}
+			if (arguments->to < arguments->from) {
+
+				argp_error (state, "invalid date range.");
+
+			}
+			break;
+
+		default:
+
+			return (ARGP_ERR_UNKNOWN);
+
+	};
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+
+/*
+ * A trading day that satisfies the expression.
+ */
+
+struct screen_match {
+
+	time_t trading_date;
+	size_t stock;	// Index of the stock list.
+
+};
+
+
+/*
+ * Work shared among threads.
+ */
+
+struct screen_work {
+
+	const pfish_bovespa_stock_list_t *stocks;	// Stocks to be screened.
+	const pfish_bovespa_expression_t *expression;	// Compiled expression.
+	unsigned int view;	// Stock history view.
+	long from;	// Days since the epoch; negative for the most recent trading day.
+	long to;	// Days since the epoch.
+	size_t next;	// Next stock; taken atomically.
+	size_t failures;	// How many stocks could not be screened; updated atomically.
+
+};
+
+struct screen_worker {
+
+	struct screen_work *work;	// Work shared among threads.
+	struct screen_match *matches;	// Trading days that satisfy the expression, found by this thread.
+	size_t matches_size;	// How many elements in matches[].
+	size_t matches_capacity;	// How many elements fit in matches[].
+
+};
+
+
+/*
+ * Screening thread.
+ *
+ * @param arg (struct screen_worker *).
+ */
+
+void *screen_worker (void *arg);
+
+
+/*
+ * Compare two matches by trading date, then stock.
+ * Arguments type hint: (const void *) == (const struct screen_match *)
+ *
+ * @return negative if a comes first, positive if b comes first, zero if same.
+ */
+
+int compare_screen_matches (const void *a, const void *b);
+
+
+/*
+ * The portal.
+ */
+
+#define SUCCESS return (EXIT_SUCCESS)
+#define FAILURE return (EXIT_FAILURE)
+
+#define DATE_BUF_SIZE 16
+
+int main (int argc, char **argv) {
+
+	struct arguments arguments;	// Arguments given in the command line.
+	struct screen_work work;	// Work shared among threads.
+	struct screen_worker *workers;	// One element per thread.
+	pthread_t *threads;	// Helper threads.
+	size_t threads_size;	// How many helper threads were started.
+	pfish_bovespa_expression_t *expression;	// Compiled expression.
+	struct screen_match *matches;	// Trading days that satisfy the expression, of all threads.
+	size_t matches_size;	// How many elements in matches[].
+	struct tm calendar;	// Time components of a trading date.
+	char date_buf[DATE_BUF_SIZE];	// Trading date string formatting buffer.
+	size_t i;	// General, short ranged indexer.
+
+	/*
+	 * Begin.
+	 */
+
+	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	pfish_bovespa_log_level_from_env ();
+	DEBUG ("start.");
+
+	/*
+	 * Parse command line arguments.
+	 */
+
+	arguments.expression = NULL;
+	arguments.from = -1;
+	arguments.to = -1;
+	arguments.adjusted = 0;
+	arguments.period = PFISH_BOVESPA_VIEW_RAW;
+	arguments.image = 0;
+	if ((arguments.jobs = sysconf (_SC_NPROCESSORS_ONLN)) < 1) {
+
+		arguments.jobs = 1;
+
+	}
+	arguments.stats = 0;
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+	/*
+	 * From now on, log messages are written by a background thread.
+	 */
+
+	pfish_bovespa_log_start ();
+
+	/*
+	 * Compile the expression.
+	 */
+
+	if ((pfish_bovespa_expression_compile (arguments.expression, &expression)) < 0) {
+
+		CRIT ("cannot compile expression '%s'.", arguments.expression);
+		FAILURE;
+
+	}
+
+	/*
+	 * Prepare the work.
+	 */
+
+	if ((arguments.image != 0) && ((pfish_bovespa_image_attach ()) < 0)) {
+
+		CRIT ("cannot attach to the database image.");
+		FAILURE;
+
+	}
+	if ((arguments.image == 0) && ((pfish_bovespa_snapshot_pin ()) < 0)) {
+
+		CRIT ("cannot pin a database snapshot.");
+		FAILURE;
+
+	}
+	if ((work.stocks = pfish_bovespa_stock_list_alloc ()) == NULL) {
+
+		CRIT ("cannot retrieve stock list from database.");
+		FAILURE;
+
+	}
+	work.expression = expression;
+	work.view = ((arguments.adjusted != 0) ? PFISH_BOVESPA_VIEW_ADJUSTED : PFISH_BOVESPA_VIEW_RAW) | arguments.period;
+	work.from = arguments.from;
+	work.to = arguments.to;
+	work.next = 0;
+	work.failures = 0;
+	if ((workers = (struct screen_worker *) calloc (arguments.jobs, sizeof (struct screen_worker))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", arguments.jobs * sizeof (struct screen_worker));
+		FAILURE;
+
+	}
+	for ( i = 0; i < arguments.jobs; i++ ) {
+
+		workers[i].work = &work;
+
+	}
+
+	/*
+	 * Screen stocks in parallel; this thread works too.
+	 */
+
+	threads_size = arguments.jobs - 1;
+	if ((threads = (pthread_t *) malloc ((threads_size + 1) * sizeof (pthread_t))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (threads_size + 1) * sizeof (pthread_t));
+		FAILURE;
+
+	}
+	for ( i = 0; i < threads_size; i++ ) {
+
+		if ((pthread_create (&(threads[i]), NULL, screen_worker, &(workers[i + 1]))) != 0) {
+
+			WARNING ("cannot start thread; going on with %u threads.", i + 1);
+			threads_size = i;
+			break;
+
+		}
+
+	}
+	screen_worker (&(workers[0]));
+	for ( i = 0; i < threads_size; i++ ) {
+
+		pthread_join (threads[i], NULL);
+
+	}
+	if (work.failures != 0) {
+
+		CRIT ("cannot screen %u stocks.", work.failures);
+		FAILURE;
+
+	}
+
+	/*
+	 * Gather matches of all threads.
+	 */
+
+	for ( i = 0, matches_size = 0; i <= threads_size; i++ ) {
+
+		matches_size += workers[i].matches_size;
+
+	}
+	if ((matches = (struct screen_match *) malloc ((matches_size + 1) * sizeof (struct screen_match))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (matches_size + 1) * sizeof (struct screen_match));
+		FAILURE;
+
+	}
+	for ( i = 0, matches_size = 0; i <= threads_size; i++ ) {
+
+		memcpy (&(matches[matches_size]), workers[i].matches, workers[i].matches_size * sizeof (struct screen_match));
+		matches_size += workers[i].matches_size;
+		free (workers[i].matches);
+
+	}
+	qsort (matches, matches_size, sizeof (struct screen_match), compare_screen_matches);
+
+	/*
+	 * Export matches.
+	 */
+
+	for ( i = 0; i < matches_size; i++ ) {
+
+		if ((gmtime_r (&(matches[i].trading_date), &calendar)) == NULL) {
+
+			CRIT ("cannot understand trading date '%ld' as a timestamp value.", (long) matches[i].trading_date);
+			FAILURE;
+
+		}
+		if ((strftime (date_buf, DATE_BUF_SIZE, "%F", &calendar)) == 0) {
+
+			CRIT ("cannot build the string representation of the trading date.");
+			FAILURE;
+
+		}
+		printf ("%s,%s\n", date_buf, work.stocks->stock_list[matches[i].stock].id);
+
+	}
+
+	/*
+	 * Resource releasing.
+	 */
+
+	free (matches);
+	free (threads);
+	free (workers);
+	free (expression);
+	free ((void *) work.stocks);
+
+	/*
+	 * End.
+	 */
+
+	if (arguments.stats != 0) {
+
+		pfish_bovespa_metrics_print (stderr);
+
+	}
+	DEBUG ("end.");
+	SUCCESS;
+
+}
+
+#undef DATE_BUF_SIZE
+
+#undef FAILURE
+#undef SUCCESS
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int parse_date (const char *text, long *answer) {
+
+	unsigned int year, month, day;
+	char tail;
+	struct tm calendar;
+	time_t t;
+
+	if ((sscanf (text, "%4u-%2u-%2u%c", &year, &month, &day, &tail)) != 3) {
+
+		FAILURE;
+
+	}
+	if ((year < 1970) || (month < 1) || (month > 12) || (day < 1) || (day > 31)) {
+
+		FAILURE;
+
+	}
+	memset (&calendar, 0, sizeof (struct tm));
+	calendar.tm_year = year - 1900;
+	calendar.tm_mon = month - 1;
+	calendar.tm_mday = day;
+	if ((t = timegm (&calendar)) == (time_t) (-1)) {
+
+		FAILURE;
+
+	}
+	*answer = t / 86400;
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void *screen_worker (void *arg) {
+
+	struct screen_worker *worker = (struct screen_worker *) arg;
+	struct screen_work *work = worker->work;
+	pfish_bovespa_expression_machine_t *machine;	// Evaluation resources of this thread.
+	pfish_bovespa_stock_history_t *history;	// History of the stock being screened.
+	unsigned char *satisfied;	// Screened daily quotes that satisfy the expression.
+	size_t satisfied_capacity;	// How many elements fit in satisfied[].
+	struct screen_match *matches;	// Resized matches.
+	size_t first, last;	// Range of history->daily_quotes[] to be screened.
+	size_t low, high, middle;	// Binary search delimiters.
+	size_t capacity;	// New capacity.
+	size_t stock;	// Index of the stock list.
+	size_t i;
+
+	if ((pfish_bovespa_expression_machine_alloc (work->expression, &machine)) < 0) {
+
+		__sync_fetch_and_add (&(work->failures), 1);
+		return (NULL);
+
+	}
+	satisfied = NULL;
+	satisfied_capacity = 0;
+	while ((stock = __sync_fetch_and_add (&(work->next), 1)) < work->stocks->stock_list_size) {
+
+		if ((pfish_bovespa_stock_history_alloc_view (&(work->stocks->stock_list[stock]), work->view, &history)) < 0) {
+
+			CRIT ("cannot retrieve history of stock '%s' from database.", work->stocks->stock_list[stock].id);
+			__sync_fetch_and_add (&(work->failures), 1);
+			continue;
+
+		}
+		if (history == NULL) {
+
+			continue;
+
+		}
+
+		// Find out the range of daily quotes to be screened.
+
+		if (work->from < 0) {
+
+			first = (history->daily_quotes_size > 0) ? (history->daily_quotes_size - 1) : 0;
+			last = history->daily_quotes_size;
+
+		}
+		else {
+
+#define LOWER_BOUND(DAY,ANSWER) \
+			for ( low = 0, high = history->daily_quotes_size; low < high; ) { \
+				middle = low + ((high - low) / 2); \
+				if ((history->daily_quotes[middle].trading_date / 86400) < (DAY)) { low = middle + 1; } else { high = middle; } \
+			} \
+			ANSWER = low
+
+			LOWER_BOUND (work->from, first);
+			LOWER_BOUND (work->to + 1, last);
+
+#undef LOWER_BOUND
+
+		}
+		if (last > first) {
+
+			if (last - first > satisfied_capacity) {
+
+				capacity = last - first;
+				free (satisfied);
+				if ((satisfied = (unsigned char *) malloc (capacity)) == NULL) {
+
+					ALERT ("cannot allocate %u bytes of heap space.", capacity);
+					__sync_fetch_and_add (&(work->failures), 1);
+					satisfied_capacity = 0;
+					pfish_bovespa_stock_history_free (history);
+					continue;
+
+				}
+				satisfied_capacity = capacity;
+
+			}
+			if ((pfish_bovespa_expression_screen (machine, history, first, last, satisfied)) > 0) {
+
+				for ( i = first; i < last; i++ ) {
+
+					if (satisfied[i - first] == 0) {
+
+						continue;
+
+					}
+					if (worker->matches_size == worker->matches_capacity) {
+
+						capacity = (worker->matches_capacity == 0) ? 0x100 : (2 * worker->matches_capacity);
+						if ((matches = (struct screen_match *) realloc (worker->matches, capacity * sizeof (struct screen_match))) == NULL) {
+
+							ALERT ("cannot allocate %u bytes of heap space.", capacity * sizeof (struct screen_match));
+							__sync_fetch_and_add (&(work->failures), 1);
+							break;
+
+						}
+						worker->matches = matches;
+						worker->matches_capacity = capacity;
+
+					}
+					worker->matches[worker->matches_size].trading_date = history->daily_quotes[i].trading_date;
+					worker->matches[worker->matches_size].stock = stock;
+					worker->matches_size++;
+
+				}
+
+			}
+
+		}
+		if ((pfish_bovespa_stock_history_free (history)) < 0) {
+
+			CRIT ("cannot release history of stock '%s'.", work->stocks->stock_list[stock].id);
+			__sync_fetch_and_add (&(work->failures), 1);
+
+		}
+
+	}
+	free (satisfied);
+	pfish_bovespa_expression_machine_free (machine);
+	return (NULL);
+
+}
+
+
+int compare_screen_matches (const void *a, const void *b) {
+
+#define A ((const struct screen_match *) a)
+#define B ((const struct screen_match *) b)
+
+	if (A->trading_date != B->trading_date) {
+
+		return ((A->trading_date < B->trading_date) ? -1 : 1);
+
+	}
+	if (A->stock != B->stock) {
+
+		return ((A->stock < B->stock) ? -1 : 1);
+
+	}
+	return (0);
+
+#undef B
+#undef A
+
+}
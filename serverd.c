@@ -0,0 +1,924 @@
+/*
+ * serverd.c
+ *
+ * Local query daemon of the pilot_fish bovespa database.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <argp.h>
+#include <signal.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+
+#include <pilot_fish/bovespa.h>
+#include <pilot_fish/bovespa_serverd.h>
+
+#include "async_log.h"
+
+
+/*
+ * Command line argument parsing.
+ */
+
+const char *argp_program_version = PACKAGE_VERSION;
+const char *argp_program_bug_address = PACKAGE_BUGREPORT;
+
+static char doc[] = "pfish_bovespa_serverd -- local query daemon of the pilot_fish bovespa database.\vThis routine answers list, history, range and cross section requests over a Unix domain socket, with the binary protocol of pilot_fish/bovespa_serverd.h. It runs in the foreground until interrupted (SIGINT or SIGTERM).\n\nStock histories stay mapped between requests, up to the cache size; histories replaced by an import are mapped again on their next request, and the stock list is reloaded whenever the database directory changes.\n\nLog messages are written by a background thread; the log level is taken from the environment variable PFISH_BOVESPA_LOG_LEVEL (a syslog priority name or number; default: info).\n";
+
+static struct argp_option options[] = {
+
+	{"socket", 's', "PATH",  0, "listen on PATH (default: '.serverd' in the database directory).", 0 },
+	{"jobs", 'j', "JOBS",  0, "serve with JOBS threads (default: number of online processors).", 0 },
+	{"cache", 'c', "MEGABYTES",  0, "keep up to MEGABYTES of stock histories mapped (default: 1024).", 0 },
+	{ 0 }
+
+};
+
+struct arguments {
+
+	char *socket;
+	long jobs;
+	long cache;
+
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+	char *aux_charp;
+
+	switch (key) {
+
+		case 's':
+
+			arguments->socket = arg;
+			break;
+
+		case 'j':
+
+			arguments->jobs = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->jobs < 1)) {
+
+				argp_error (state, "invalid number of jobs '%s'.", arg);
+
+			}
+			break;
+
+		case 'c':
+
+			arguments->cache = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->cache < 1)) {
+
+				argp_error (state, "invalid cache size '%s'.", arg);
+
+			}
+			break;
+
+		case ARGP_KEY_ARG:
+
+			argp_usage (state);
+			break;
+
+		default:
+
+			return (ARGP_ERR_UNKNOWN);
+
+	};
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, 0, doc };
+
+
+#define SERVERD_SOCKET_PATHNAME DBPATH "/.serverd"
+
+#define LISTEN_BACKLOG 0x100
+#define INPUT_SIZE 0x1000	// Room for pipelined requests of a connection.
+#define OUTPUT_HIGH_SIZE 0x100000	// Pending responses of a connection above which its requests wait.
+#define SECONDS_PER_DAY 86400
+
+
+/*
+ * State shared among threads.
+ */
+
+struct server {
+
+	int epoll_des;	// Ready connections.
+	int listen_des;	// Listening socket.
+	pthread_rwlock_t stocks_lock;	// Protects the stock list.
+	pfish_bovespa_stock_list_t *stocks;	// Stocks of the database; NULL until first needed.
+	struct timespec stocks_mtime;	// Modification time of the database directory when 'stocks' was loaded.
+
+};
+
+
+/*
+ * A client connection.
+ * Connections are armed one shot in epoll, so only one thread at a time serves each of them.
+ */
+
+struct connection {
+
+	int des;	// Connected socket.
+	char input[INPUT_SIZE];	// Received octets not yet served.
+	size_t input_size;	// Octets in 'input'.
+	char *output;	// Responses not yet sent.
+	size_t output_size;	// Octets in 'output'.
+	size_t output_done;	// Octets of 'output' already sent.
+	size_t output_capacity;	// Size of 'output'.
+	unsigned int closing;	// Not zero to close once all responses are sent.
+
+};
+
+
+/*
+ * Serving thread.
+ *
+ * @param arg (struct server *).
+ */
+
+void *serverd_worker (void *arg);
+
+
+/*
+ * Accept pending connections.
+ *
+ * @param[in] server state shared among threads.
+ */
+
+void serverd_accept (struct server *server);
+
+
+/*
+ * Serve a ready connection: send pending responses, answer received requests, receive more requests;
+ * then wait for the connection again, or close it.
+ *
+ * @param[in] server state shared among threads.
+ * @param[in] connection client connection.
+ */
+
+void serverd_serve (struct server *server, struct connection *connection);
+
+
+/*
+ * Answer a request, appending its response to the connection output.
+ *
+ * @param[in] server state shared among threads.
+ * @param[in] connection client connection.
+ * @param[in] request request.
+ *
+ * @return 0 on success, negative if the connection must be closed.
+ */
+
+int serverd_answer (struct server *server, struct connection *connection, const struct pfish_bovespa_serverd_request *request);
+
+
+/*
+ * Take the stock list for reading, reloading it if the database changed.
+ * Release it with pthread_rwlock_unlock (&(server->stocks_lock)) after use.
+ *
+ * @param[in] server state shared among threads.
+ *
+ * @return stock list, or NULL on failure (with nothing to be released).
+ */
+
+const pfish_bovespa_stock_list_t *serverd_stocks (struct server *server);
+
+
+/*
+ * Day number (since the epoch, UTC) of a time.
+ */
+
+long day_floor (int64_t time);
+
+
+/*
+ * Reserve room at the end of the connection output.
+ *
+ * @return reserved room, or NULL on failure.
+ */
+
+void *output_reserve (struct connection *connection, size_t size);
+
+
+/*
+ * The portal.
+ */
+
+#define SUCCESS return (EXIT_SUCCESS)
+#define FAILURE return (EXIT_FAILURE)
+
+int main (int argc, char **argv) {
+
+	struct arguments arguments;	// Arguments given in the command line.
+	struct server server;	// State shared among threads.
+	struct sockaddr_un address;	// Address of the listening socket.
+	struct epoll_event event;	// Registration of the listening socket.
+	sigset_t signals;	// Signals that stop the daemon.
+	pthread_t thread;	// Serving thread.
+	int signal_number;	// Signal received.
+	long i;	// General, short ranged indexer.
+
+	/*
+	 * Begin.
+	 */
+
+	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	pfish_bovespa_log_level_from_env ();
+	DEBUG ("start.");
+
+	/*
+	 * Parse command line arguments.
+	 */
+
+	arguments.socket = SERVERD_SOCKET_PATHNAME;
+	if ((arguments.jobs = sysconf (_SC_NPROCESSORS_ONLN)) < 1) {
+
+		arguments.jobs = 1;
+
+	}
+	arguments.cache = 1024;
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+	/*
+	 * Serving threads get no signals; this thread waits for them.
+	 */
+
+	signal (SIGPIPE, SIG_IGN);
+	sigemptyset (&signals);
+	sigaddset (&signals, SIGINT);
+	sigaddset (&signals, SIGTERM);
+	if ((pthread_sigmask (SIG_BLOCK, &signals, NULL)) != 0) {
+
+		CRIT ("cannot block signals.");
+		FAILURE;
+
+	}
+
+	/*
+	 * From now on, log messages are written by a background thread (which gets no signals either).
+	 */
+
+	pfish_bovespa_log_start ();
+
+	/*
+	 * Prepare the state.
+	 */
+
+	if ((pfish_bovespa_cache_enable (((size_t) arguments.cache) << 20)) < 0) {
+
+		CRIT ("cannot enable stock history cache.");
+		FAILURE;
+
+	}
+	server.stocks = NULL;
+	memset (&(server.stocks_mtime), 0, sizeof (struct timespec));
+	pthread_rwlock_init (&(server.stocks_lock), NULL);
+	if ((server.epoll_des = epoll_create1 (EPOLL_CLOEXEC)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot create epoll instance.");
+		FAILURE;
+
+	}
+
+	/*
+	 * Listen.
+	 */
+
+	if ((strlen (arguments.socket)) >= sizeof (address.sun_path)) {
+
+		CRIT ("socket pathname '%s' is too big.", arguments.socket);
+		FAILURE;
+
+	}
+	memset (&address, 0, sizeof (struct sockaddr_un));
+	address.sun_family = AF_UNIX;
+	strcpy (address.sun_path, arguments.socket);
+	if ((server.listen_des = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot create socket.");
+		FAILURE;
+
+	}
+	if (((unlink (arguments.socket)) < 0) && (errno != ENOENT)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot remove stale socket '%s'.", arguments.socket);
+		FAILURE;
+
+	}
+	if ((bind (server.listen_des, (struct sockaddr *) &address, sizeof (struct sockaddr_un))) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot bind socket to '%s'.", arguments.socket);
+		FAILURE;
+
+	}
+	if ((listen (server.listen_des, LISTEN_BACKLOG)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot listen on socket '%s'.", arguments.socket);
+		unlink (arguments.socket);
+		FAILURE;
+
+	}
+	event.events = EPOLLIN | EPOLLEXCLUSIVE;
+	event.data.ptr = NULL;	// Tells the listening socket apart from connections.
+	if ((epoll_ctl (server.epoll_des, EPOLL_CTL_ADD, server.listen_des, &event)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot register listening socket.");
+		unlink (arguments.socket);
+		FAILURE;
+
+	}
+
+	/*
+	 * Serve until told to stop.
+	 */
+
+	for ( i = 0; i < arguments.jobs; i++ ) {
+
+		if ((pthread_create (&thread, NULL, serverd_worker, &server)) != 0) {
+
+			if (i == 0) {
+
+				CRIT ("cannot start serving thread.");
+				unlink (arguments.socket);
+				FAILURE;
+
+			}
+			WARNING ("cannot start serving thread; going on with %u threads.", i);
+			break;
+
+		}
+		pthread_detach (thread);
+
+	}
+	INFO ("serving on '%s'.", arguments.socket);
+	while ((sigwait (&signals, &signal_number)) != 0);
+	INFO ("stopping on signal %d.", signal_number);
+
+	/*
+	 * End.
+	 * Serving threads end with the process.
+	 */
+
+	unlink (arguments.socket);
+	DEBUG ("end.");
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
+
+
+void *serverd_worker (void *arg) {
+
+	struct server *server = (struct server *) arg;
+	struct epoll_event event;	// Ready socket.
+
+	while (1) {
+
+		if ((epoll_wait (server->epoll_des, &event, 1, -1)) < 1) {
+
+			if (errno != EINTR) {
+
+				ERRNO_ERR;
+				CRIT ("cannot wait for connections.");
+				return (NULL);
+
+			}
+			continue;
+
+		}
+		if (event.data.ptr == NULL) {
+
+			serverd_accept (server);
+
+		}
+		else {
+
+			serverd_serve (server, (struct connection *) event.data.ptr);
+
+		}
+
+	}
+
+}
+
+
+void serverd_accept (struct server *server) {
+
+	struct connection *connection;	// Accepted connection.
+	struct epoll_event event;	// Registration of the connection.
+	int des;	// Accepted socket.
+
+	while ((des = accept (server->listen_des, NULL, NULL)) >= 0) {
+
+		if (((fcntl (des, F_SETFL, O_NONBLOCK)) < 0) || ((fcntl (des, F_SETFD, FD_CLOEXEC)) < 0)) {
+
+			ERRNO_ERR;
+			CRIT ("cannot set up connection.");
+			close (des);
+			continue;
+
+		}
+		if ((connection = (struct connection *) calloc (1, sizeof (struct connection))) == NULL) {
+
+			ALERT ("cannot allocate %u bytes of heap space.", sizeof (struct connection));
+			close (des);
+			continue;
+
+		}
+		connection->des = des;
+		event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+		event.data.ptr = connection;
+		if ((epoll_ctl (server->epoll_des, EPOLL_CTL_ADD, des, &event)) < 0) {
+
+			ERRNO_ERR;
+			CRIT ("cannot register connection.");
+			close (des);
+			free (connection);
+
+		}
+
+	}
+	if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR) && (errno != ECONNABORTED)) {
+
+		ERRNO_ERR;
+		WARNING ("cannot accept connection.");
+
+	}
+
+}
+
+
+void serverd_serve (struct server *server, struct connection *connection) {
+
+	struct pfish_bovespa_serverd_request request;	// Request being answered.
+	struct epoll_event event;	// Registration of the connection.
+	size_t served;	// Octets of input served.
+	ssize_t count;	// Octets sent or received.
+
+	while (1) {
+
+		/*
+		 * Send pending responses.
+		 */
+
+		while (connection->output_done < connection->output_size) {
+
+			if ((count = send (connection->des, connection->output + connection->output_done, connection->output_size - connection->output_done, MSG_NOSIGNAL)) < 0) {
+
+				if (errno == EINTR) {
+
+					continue;
+
+				}
+				if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+
+					// Wait until the peer reads.
+
+					event.events = EPOLLOUT | EPOLLONESHOT;
+					event.data.ptr = connection;
+					if ((epoll_ctl (server->epoll_des, EPOLL_CTL_MOD, connection->des, &event)) == 0) {
+
+						return;
+
+					}
+					ERRNO_ERR;
+					CRIT ("cannot register connection.");
+
+				}
+				connection->closing = 1;
+				connection->output_size = 0;
+				break;
+
+			}
+			connection->output_done += count;
+
+		}
+		connection->output_size = 0;
+		connection->output_done = 0;
+
+		/*
+		 * Answer complete requests received, while responses do not pile up.
+		 */
+
+		for ( served = 0; (connection->closing == 0) && ((connection->input_size - served) >= sizeof (struct pfish_bovespa_serverd_request)) && (connection->output_size < OUTPUT_HIGH_SIZE); served += sizeof (struct pfish_bovespa_serverd_request) ) {
+
+			memcpy (&request, connection->input + served, sizeof (struct pfish_bovespa_serverd_request));
+			if ((serverd_answer (server, connection, &request)) < 0) {
+
+				connection->closing = 1;
+
+			}
+
+		}
+		memmove (connection->input, connection->input + served, connection->input_size - served);
+		connection->input_size -= served;
+		if (connection->output_size != 0) {
+
+			continue;
+
+		}
+		if (connection->closing != 0) {
+
+			break;
+
+		}
+
+		/*
+		 * Receive more requests.
+		 */
+
+		if ((count = recv (connection->des, connection->input + connection->input_size, INPUT_SIZE - connection->input_size, 0)) > 0) {
+
+			connection->input_size += count;
+			continue;
+
+		}
+		if (count == 0) {
+
+			// Peer is done; requests already received were answered.
+
+			break;
+
+		}
+		if (errno == EINTR) {
+
+			continue;
+
+		}
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+
+			event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+			event.data.ptr = connection;
+			if ((epoll_ctl (server->epoll_des, EPOLL_CTL_MOD, connection->des, &event)) == 0) {
+
+				return;
+
+			}
+			ERRNO_ERR;
+			CRIT ("cannot register connection.");
+
+		}
+		break;
+
+	}
+
+	/*
+	 * Close the connection.
+	 */
+
+	epoll_ctl (server->epoll_des, EPOLL_CTL_DEL, connection->des, NULL);
+	close (connection->des);
+	free (connection->output);
+	free (connection);
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int serverd_answer (struct server *server, struct connection *connection, const struct pfish_bovespa_serverd_request *request) {
+
+	struct pfish_bovespa_serverd_response *response;	// Response being built.
+	size_t response_offset;	// Offset of the response in the connection output.
+	const pfish_bovespa_stock_list_t *stocks;	// Stocks of the database.
+	pfish_bovespa_stock_id_t stock_id;	// Requested stock.
+	pfish_bovespa_stock_history_t *history;	// History of a stock.
+	struct pfish_bovespa_serverd_quote *quote;	// Cross section record.
+	size_t first, last;	// Range of daily quotes [first, last).
+	size_t low, high, middle;	// Binary search.
+	long day;	// Requested day of a cross section.
+	long since, until;	// Requested days of a history (inclusive).
+	unsigned int bad;	// Not zero for a malformed request.
+	void *records;
+	size_t i;
+
+	/*
+	 * Validate the request.
+	 */
+
+	bad = 0;
+	if ((request->size != sizeof (struct pfish_bovespa_serverd_request)) || (request->type < PFISH_BOVESPA_SERVERD_REQUEST_LIST) || (request->type > PFISH_BOVESPA_SERVERD_REQUEST_CROSS_SECTION)) {
+
+		bad = 1;
+
+	}
+	if (((request->view & ~(PFISH_BOVESPA_VIEW_ADJUSTED | PFISH_BOVESPA_VIEW_WEEKLY | PFISH_BOVESPA_VIEW_MONTHLY)) != 0) || ((request->view & (PFISH_BOVESPA_VIEW_WEEKLY | PFISH_BOVESPA_VIEW_MONTHLY)) == (PFISH_BOVESPA_VIEW_WEEKLY | PFISH_BOVESPA_VIEW_MONTHLY))) {
+
+		bad = 1;
+
+	}
+	if ((memchr (request->stock_id, 0, sizeof (request->stock_id))) == NULL) {
+
+		bad = 1;
+
+	}
+	else if ((strlen (request->stock_id)) > (PFISH_BOVESPA_CODNEG_SIZE - 1)) {
+
+		bad = 1;
+
+	}
+	if ((response = (struct pfish_bovespa_serverd_response *) output_reserve (connection, sizeof (struct pfish_bovespa_serverd_response))) == NULL) {
+
+		FAILURE;
+
+	}
+	response_offset = (char *) response - connection->output;
+	memset (response, 0, sizeof (struct pfish_bovespa_serverd_response));
+	response->size = sizeof (struct pfish_bovespa_serverd_response);
+	response->tag = request->tag;
+	if (bad != 0) {
+
+		response->status = PFISH_BOVESPA_SERVERD_STATUS_BAD_REQUEST;
+		FAILURE;
+
+	}
+
+#define RESPONSE ((struct pfish_bovespa_serverd_response *) (connection->output + response_offset))
+
+	/*
+	 * Stock list, or cross section.
+	 */
+
+	if ((request->type == PFISH_BOVESPA_SERVERD_REQUEST_LIST) || (request->type == PFISH_BOVESPA_SERVERD_REQUEST_CROSS_SECTION)) {
+
+		if ((stocks = serverd_stocks (server)) == NULL) {
+
+			RESPONSE->status = PFISH_BOVESPA_SERVERD_STATUS_FAILURE;
+			SUCCESS;
+
+		}
+		if (request->type == PFISH_BOVESPA_SERVERD_REQUEST_LIST) {
+
+			if ((records = output_reserve (connection, stocks->stock_list_size * sizeof (pfish_bovespa_stock_id_t))) == NULL) {
+
+				pthread_rwlock_unlock (&(server->stocks_lock));
+				FAILURE;
+
+			}
+			memcpy (records, stocks->stock_list, stocks->stock_list_size * sizeof (pfish_bovespa_stock_id_t));
+			RESPONSE->count = stocks->stock_list_size;
+
+		}
+		else {
+
+			day = day_floor (request->from);
+			for ( i = 0; i < stocks->stock_list_size; i++ ) {
+
+				if ((pfish_bovespa_stock_history_alloc_view (&(stocks->stock_list[i]), request->view, &history)) < 0) {
+
+					RESPONSE->status = PFISH_BOVESPA_SERVERD_STATUS_FAILURE;
+					break;
+
+				}
+				if (history == NULL) {
+
+					continue;
+
+				}
+
+				// Earliest daily quote at or after the start of the day.
+
+				for ( low = 0, high = history->daily_quotes_size; low < high; ) {
+
+					middle = low + ((high - low) / 2);
+					if (history->daily_quotes[middle].trading_date < (time_t) (day * SECONDS_PER_DAY)) {
+
+						low = middle + 1;
+
+					}
+					else {
+
+						high = middle;
+
+					}
+
+				}
+				if ((low < history->daily_quotes_size) && (history->daily_quotes[low].trading_date < (time_t) ((day + 1) * SECONDS_PER_DAY))) {
+
+					if ((quote = (struct pfish_bovespa_serverd_quote *) output_reserve (connection, sizeof (struct pfish_bovespa_serverd_quote))) == NULL) {
+
+						pfish_bovespa_stock_history_free (history);
+						pthread_rwlock_unlock (&(server->stocks_lock));
+						FAILURE;
+
+					}
+					quote->stock_id = stocks->stock_list[i];
+					quote->daily_quote = history->daily_quotes[low];
+					RESPONSE->count++;
+
+				}
+				pfish_bovespa_stock_history_free (history);
+
+			}
+			if (RESPONSE->status != PFISH_BOVESPA_SERVERD_STATUS_OK) {
+
+				// Answer no partial cross section.
+
+				connection->output_size = response_offset + sizeof (struct pfish_bovespa_serverd_response);
+				RESPONSE->count = 0;
+
+			}
+
+		}
+		pthread_rwlock_unlock (&(server->stocks_lock));
+		RESPONSE->size = connection->output_size - response_offset;
+		SUCCESS;
+
+	}
+
+	/*
+	 * History of a stock, or part of it.
+	 */
+
+	memset (stock_id.id, 0, PFISH_BOVESPA_CODNEG_SIZE);
+	memcpy (stock_id.id, request->stock_id, strlen (request->stock_id));
+	if ((pfish_bovespa_stock_history_alloc_view (&stock_id, request->view, &history)) < 0) {
+
+		RESPONSE->status = PFISH_BOVESPA_SERVERD_STATUS_FAILURE;
+		SUCCESS;
+
+	}
+	if (history == NULL) {
+
+		RESPONSE->status = PFISH_BOVESPA_SERVERD_STATUS_NOT_FOUND;
+		SUCCESS;
+
+	}
+	first = 0;
+	last = history->daily_quotes_size;
+	if (request->type == PFISH_BOVESPA_SERVERD_REQUEST_HISTORY) {
+
+		RESPONSE->last_xplit = history->last_xplit;
+
+	}
+	else {
+
+		since = day_floor (request->from);
+		until = day_floor (request->to);
+		for ( low = 0, high = history->daily_quotes_size; low < high; ) {
+
+			middle = low + ((high - low) / 2);
+			if ((day_floor (history->daily_quotes[middle].trading_date)) < since) {
+
+				low = middle + 1;
+
+			}
+			else {
+
+				high = middle;
+
+			}
+
+		}
+		first = low;
+		for ( high = history->daily_quotes_size; low < high; ) {
+
+			middle = low + ((high - low) / 2);
+			if ((day_floor (history->daily_quotes[middle].trading_date)) <= until) {
+
+				low = middle + 1;
+
+			}
+			else {
+
+				high = middle;
+
+			}
+
+		}
+		last = low;
+
+	}
+	if ((records = output_reserve (connection, (last - first) * sizeof (pfish_bovespa_daily_quote_t))) == NULL) {
+
+		pfish_bovespa_stock_history_free (history);
+		FAILURE;
+
+	}
+	memcpy (records, &(history->daily_quotes[first]), (last - first) * sizeof (pfish_bovespa_daily_quote_t));
+	RESPONSE->count = last - first;
+	RESPONSE->size = connection->output_size - response_offset;
+	if ((pfish_bovespa_stock_history_free (history)) < 0) {
+
+		CRIT ("cannot release history of stock '%s'.", stock_id.id);
+
+	}
+	SUCCESS;
+
+#undef RESPONSE
+
+}
+
+
+const pfish_bovespa_stock_list_t *serverd_stocks (struct server *server) {
+
+	struct stat directory_stat;	// Status of the database directory.
+	pfish_bovespa_stock_list_t *stocks;	// Reloaded stock list.
+
+	if ((stat (DBPATH, &directory_stat)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot stat directory '%s'.", DBPATH);
+		return (NULL);
+
+	}
+
+#define FRESH ((server->stocks != NULL) && (server->stocks_mtime.tv_sec == directory_stat.st_mtim.tv_sec) && (server->stocks_mtime.tv_nsec == directory_stat.st_mtim.tv_nsec))
+
+	pthread_rwlock_rdlock (&(server->stocks_lock));
+	if (FRESH) {
+
+		return (server->stocks);
+
+	}
+	pthread_rwlock_unlock (&(server->stocks_lock));
+	pthread_rwlock_wrlock (&(server->stocks_lock));
+	if (!FRESH) {
+
+		if ((stocks = pfish_bovespa_stock_list_alloc ()) == NULL) {
+
+			CRIT ("cannot retrieve stock list from database.");
+			pthread_rwlock_unlock (&(server->stocks_lock));
+			return (NULL);
+
+		}
+		free (server->stocks);
+		server->stocks = stocks;
+		server->stocks_mtime = directory_stat.st_mtim;
+		DEBUG ("stock list reloaded: %u stocks.", stocks->stock_list_size);
+
+	}
+	pthread_rwlock_unlock (&(server->stocks_lock));
+
+#undef FRESH
+
+	// The list may be replaced in between; any fresh enough list will do.
+
+	pthread_rwlock_rdlock (&(server->stocks_lock));
+	return (server->stocks);
+
+}
+
+
+long day_floor (int64_t time) {
+
+	return ((time >= 0) ? (time / SECONDS_PER_DAY) : -((-time + SECONDS_PER_DAY - 1) / SECONDS_PER_DAY));
+
+}
+
+
+void *output_reserve (struct connection *connection, size_t size) {
+
+	char *output;	// Grown output.
+	size_t capacity;	// Size of the grown output.
+	void *answer;
+
+	if ((connection->output_size + size) > connection->output_capacity) {
+
+		for ( capacity = (connection->output_capacity != 0) ? connection->output_capacity : 0x1000; capacity < (connection->output_size + size); capacity *= 2 );
+		if ((output = (char *) realloc (connection->output, capacity)) == NULL) {
+
+			ALERT ("cannot allocate %u bytes of heap space.", capacity);
+			return (NULL);
+
+		}
+		connection->output = output;
+		connection->output_capacity = capacity;
+
+	}
+	answer = connection->output + connection->output_size;
+	connection->output_size += size;
+	return (answer);
+
+}
+
+#undef FAILURE
+#undef SUCCESS
@@ -0,0 +1,914 @@
+/*
+ * snapshot.c
+ * Database generations and reader snapshots.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+#include <pilot_fish/bovespa.h>
+
+#include "stock_file.h"
+#include "name_index.h"
+#include "ticker_dictionary.h"
+#include "snapshot.h"
+#include "async_log.h"
+
+
+/*
+ * Directory of a generation while it is being published.
+ */
+
+#define SNAPSHOT_TEMP_DIR SNAPSHOT_DIR "/.tmp"
+
+
+/*
+ * How many times a reader tries to pin the most recent generation
+ * before giving up; each failure means an import published meanwhile.
+ */
+
+#define PIN_ATTEMPTS 16
+
+
+/*
+ * Pinned generation.
+ * Pinning and unpinning must not race with reads.
+ */
+
+static struct {
+
+	int directory_des;	// Locked generation directory, negative if no generation is pinned.
+	uint64_t generation;	// Pinned generation.
+	char directory[PATH_MAX];	// Full pathname of the generation directory.
+
+} snapshot = { .directory_des = -1 };
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+/*
+ * Build the full pathname of the directory of a generation.
+ *
+ * @param[in] generation generation.
+ * @param[out] target buffer of PATH_MAX octets to receive the pathname.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+static int generation_directory (uint64_t generation, char *target) {
+
+	if ((snprintf (target, PATH_MAX, "%s/%016" PRIx64, SNAPSHOT_DIR, generation)) >= PATH_MAX) {
+
+		ALERT ("pathname buffer overflow.");
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+/*
+ * Translate a database pathname to a generation directory.
+ *
+ * @param[in] directory generation directory.
+ * @param[in] pathname full pathname of a database file, starting with DBPATH.
+ * @param[out] target buffer of PATH_MAX octets to receive the pathname.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+static int generation_pathname (const char *directory, const char *pathname, char *target) {
+
+	char buffer[PATH_MAX];
+
+	if ((snprintf (buffer, PATH_MAX, "%s%s", directory, pathname + sizeof (DBPATH) - 1)) >= PATH_MAX) {
+
+		ALERT ("pathname buffer overflow.");
+		FAILURE;
+
+	}
+	strcpy (target, buffer);
+	SUCCESS;
+
+}
+
+
+/*
+ * Read the most recent generation from the manifest.
+ *
+ * @param[out] answer most recent generation.
+ *
+ * @return 0 on success, positive if no generation was published, negative on failure.
+ */
+
+static int manifest_read (uint64_t *answer) {
+
+	FILE *manifest_file;
+	snapshot_manifest_t manifest;
+
+	if ((manifest_file = fopen (SNAPSHOT_MANIFEST_FILE, "r")) == NULL) {
+
+		if (errno == ENOENT) {
+
+			return (1);
+
+		}
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s' in read mode.", SNAPSHOT_MANIFEST_FILE);
+		FAILURE;
+
+	}
+	if (((fread (&manifest, sizeof (snapshot_manifest_t), 1, manifest_file)) != 1) || (manifest.magic != SNAPSHOT_MANIFEST_MAGIC)) {
+
+		CRIT ("generation manifest '%s' is corrupt; please run pfish_bovespa_file_import again.", SNAPSHOT_MANIFEST_FILE);
+		fclose (manifest_file);
+		FAILURE;
+
+	}
+	fclose (manifest_file);
+	*answer = manifest.generation;
+	SUCCESS;
+
+}
+
+
+/*
+ * Select visible regular files of a directory, for scandir().
+ */
+
+static int entry_selector (const struct dirent *dirent) {
+
+	if (dirent->d_type != DT_REG) {
+
+		return (0);
+
+	}
+	if (dirent->d_name[0] == '.') {
+
+		return (0);
+
+	}
+	return (1);
+
+}
+
+
+/*
+ * Order directory entries by name, for scandir(); unlike alphasort(), independent of the locale.
+ */
+
+static int entry_compare (const struct dirent **a, const struct dirent **b) {
+
+	return (strcmp ((*a)->d_name, (*b)->d_name));
+
+}
+
+
+/*
+ * Release a list of directory entries built by scandir().
+ *
+ * @param[in] entries list of directory entries.
+ * @param[in] entries_size how many elements in 'entries'.
+ */
+
+static void entries_free (struct dirent **entries, int entries_size) {
+
+	int i;
+
+	for ( i = 0; i < entries_size; i++ ) {
+
+		free (entries[i]);
+
+	}
+	free (entries);
+
+}
+
+
+/*
+ * Make a directory hold hard links to exactly the visible regular files of another directory.
+ * Links to the same file (same inode) are kept, so that links and unlinks are made only for files
+ * replaced, added or removed since the directories last matched.
+ *
+ * @param[in] source directory with the files; a missing directory counts as empty.
+ * @param[in] target directory to be synchronized; created if missing.
+ * @param[in,out] changes incremented by the number of links and unlinks made.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+static int directory_sync (const char *source, const char *target, size_t *changes) {
+
+	struct dirent **source_entries;	// Files of the source, ordered by name.
+	int source_entries_size;	// How many elements in 'source_entries'.
+	struct dirent **target_entries;	// Files of the target, ordered by name.
+	int target_entries_size;	// How many elements in 'target_entries'.
+	char source_pathname[PATH_MAX];
+	char target_pathname[PATH_MAX];
+	int order;	// Order of the current source file name relative to the current target file name.
+	int i, j;
+
+	if (((mkdir (target, 0755)) < 0) && (errno != EEXIST)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot create directory '%s'.", target);
+		FAILURE;
+
+	}
+	if ((source_entries_size = scandir (source, &source_entries, entry_selector, entry_compare)) < 0) {
+
+		if (errno != ENOENT) {
+
+			ERRNO_ERR;
+			CRIT ("cannot scan directory '%s'.", source);
+			FAILURE;
+
+		}
+		source_entries = NULL;
+		source_entries_size = 0;
+
+	}
+	if ((target_entries_size = scandir (target, &target_entries, entry_selector, entry_compare)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot scan directory '%s'.", target);
+		entries_free (source_entries, source_entries_size);
+		FAILURE;
+
+	}
+
+#undef FAILURE
+#define FAILURE \
+	entries_free (target_entries, target_entries_size); \
+	entries_free (source_entries, source_entries_size); \
+	return (-1)
+
+	/*
+	 * Walk both lists in name order.
+	 */
+
+	i = 0;
+	j = 0;
+	while ((i < source_entries_size) || (j < target_entries_size)) {
+
+		if (i == source_entries_size) {
+
+			order = 1;
+
+		}
+		else if (j == target_entries_size) {
+
+			order = -1;
+
+		}
+		else {
+
+			order = strcmp (source_entries[i]->d_name, target_entries[j]->d_name);
+
+		}
+
+		/*
+		 * Files removed from the source, or replaced since, are unlinked from the target.
+		 */
+
+		if ((order > 0) || ((order == 0) && (source_entries[i]->d_ino != target_entries[j]->d_ino))) {
+
+			if ((snprintf (target_pathname, PATH_MAX, "%s/%s", target, target_entries[j]->d_name)) >= PATH_MAX) {
+
+				ALERT ("pathname buffer overflow.");
+				FAILURE;
+
+			}
+			if ((unlink (target_pathname)) < 0) {
+
+				ERRNO_ERR;
+				CRIT ("cannot erase file '%s'.", target_pathname);
+				FAILURE;
+
+			}
+			(*changes)++;
+
+		}
+
+		/*
+		 * Files added to the source, or replaced since, are linked into the target.
+		 */
+
+		if ((order < 0) || ((order == 0) && (source_entries[i]->d_ino != target_entries[j]->d_ino))) {
+
+			if (((snprintf (source_pathname, PATH_MAX, "%s/%s", source, source_entries[i]->d_name)) >= PATH_MAX) || ((snprintf (target_pathname, PATH_MAX, "%s/%s", target, source_entries[i]->d_name)) >= PATH_MAX)) {
+
+				ALERT ("pathname buffer overflow.");
+				FAILURE;
+
+			}
+			if ((link (source_pathname, target_pathname)) < 0) {
+
+				ERRNO_ERR;
+				CRIT ("cannot link file '%s' to '%s'.", source_pathname, target_pathname);
+				FAILURE;
+
+			}
+			(*changes)++;
+
+		}
+		if (order <= 0) {
+
+			i++;
+
+		}
+		if (order >= 0) {
+
+			j++;
+
+		}
+
+	}
+	entries_free (target_entries, target_entries_size);
+	entries_free (source_entries, source_entries_size);
+
+#undef FAILURE
+#define FAILURE return (-1)
+
+	SUCCESS;
+
+}
+
+
+/*
+ * Make a pathname a hard link to the same file as another pathname, or inexistent if the other is.
+ *
+ * @param[in] source full pathname of the file.
+ * @param[in] target full pathname to be synchronized.
+ * @param[in,out] changes incremented by the number of links and unlinks made.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+static int file_sync (const char *source, const char *target, size_t *changes) {
+
+	struct stat source_stat;
+	struct stat target_stat;
+	int source_exists;
+	int target_exists;
+
+	if (((source_exists = ((lstat (source, &source_stat)) == 0)) == 0) && (errno != ENOENT)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot get status of file '%s'.", source);
+		FAILURE;
+
+	}
+	if (((target_exists = ((lstat (target, &target_stat)) == 0)) == 0) && (errno != ENOENT)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot get status of file '%s'.", target);
+		FAILURE;
+
+	}
+	if (source_exists && target_exists && (source_stat.st_dev == target_stat.st_dev) && (source_stat.st_ino == target_stat.st_ino)) {
+
+		SUCCESS;
+
+	}
+	if (target_exists) {
+
+		if ((unlink (target)) < 0) {
+
+			ERRNO_ERR;
+			CRIT ("cannot erase file '%s'.", target);
+			FAILURE;
+
+		}
+		(*changes)++;
+
+	}
+	if (source_exists) {
+
+		if ((link (source, target)) < 0) {
+
+			ERRNO_ERR;
+			CRIT ("cannot link file '%s' to '%s'.", source, target);
+			FAILURE;
+
+		}
+		(*changes)++;
+
+	}
+	SUCCESS;
+
+}
+
+
+/*
+ * Remove a directory and everything in it.
+ *
+ * @param[in] pathname full pathname of the directory.
+ *
+ * @return 0 on success (or if directory does not exist), negative on failure.
+ */
+
+static int directory_remove (const char *pathname) {
+
+	DIR *directory;
+	struct dirent *dirent;
+	char entry_pathname[PATH_MAX];
+
+	if ((directory = opendir (pathname)) == NULL) {
+
+		if (errno == ENOENT) {
+
+			SUCCESS;
+
+		}
+		ERRNO_ERR;
+		CRIT ("cannot open directory '%s'.", pathname);
+		FAILURE;
+
+	}
+
+#undef FAILURE
+#define FAILURE \
+	closedir (directory); \
+	return (-1)
+
+	while ((dirent = readdir (directory)) != NULL) {
+
+		if (((strcmp (dirent->d_name, ".")) == 0) || ((strcmp (dirent->d_name, "..")) == 0)) {
+
+			continue;
+
+		}
+		if ((snprintf (entry_pathname, PATH_MAX, "%s/%s", pathname, dirent->d_name)) >= PATH_MAX) {
+
+			ALERT ("pathname buffer overflow.");
+			FAILURE;
+
+		}
+		if (dirent->d_type == DT_DIR) {
+
+			if ((directory_remove (entry_pathname)) < 0) {
+
+				FAILURE;
+
+			}
+
+		}
+		else if ((unlink (entry_pathname)) < 0) {
+
+			ERRNO_ERR;
+			CRIT ("cannot erase file '%s'.", entry_pathname);
+			FAILURE;
+
+		}
+
+	}
+	closedir (directory);
+
+#undef FAILURE
+#define FAILURE return (-1)
+
+	if ((rmdir (pathname)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot remove directory '%s'.", pathname);
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+/*
+ * Remove all generations but the given one that no reader has pinned.
+ * The most recent of them is not removed but moved to the temporary directory,
+ * as the spare generation the next publication is built from.
+ *
+ * @param[in] keep generation to be kept.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+static int generations_collect (uint64_t keep) {
+
+	DIR *directory;
+	struct dirent *dirent;
+	char pathname[PATH_MAX];
+	char *tail;
+	uint64_t generation;
+	uint64_t spare;	// Spare generation so far, 0 if none.
+	int generation_des;
+
+	spare = 0;
+	if ((directory = opendir (SNAPSHOT_DIR)) == NULL) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open directory '%s'.", SNAPSHOT_DIR);
+		FAILURE;
+
+	}
+
+#undef FAILURE
+#define FAILURE \
+	closedir (directory); \
+	return (-1)
+
+	while ((dirent = readdir (directory)) != NULL) {
+
+		if (dirent->d_name[0] == '.') {
+
+			continue;
+
+		}
+		generation = strtoull (dirent->d_name, &tail, 16);
+		if ((*tail != 0) || (generation == keep)) {
+
+			continue;
+
+		}
+		if ((generation_directory (generation, pathname)) < 0) {
+
+			FAILURE;
+
+		}
+		if ((generation_des = open (pathname, O_RDONLY | O_DIRECTORY)) < 0) {
+
+			ERRNO_ERR;
+			CRIT ("cannot open directory '%s'.", pathname);
+			FAILURE;
+
+		}
+
+		/*
+		 * A reader holding a shared lock keeps the generation alive;
+		 * readers trying to pin it meanwhile will find it locked or gone.
+		 */
+
+		if ((flock (generation_des, LOCK_EX | LOCK_NB)) < 0) {
+
+			if (errno != EWOULDBLOCK) {
+
+				ERRNO_ERR;
+				CRIT ("cannot lock directory '%s'.", pathname);
+				close (generation_des);
+				FAILURE;
+
+			}
+			DEBUG ("generation %" PRIu64 " is pinned.", generation);
+			close (generation_des);
+			continue;
+
+		}
+		if (generation > spare) {
+
+			if ((directory_remove (SNAPSHOT_TEMP_DIR)) < 0) {
+
+				close (generation_des);
+				FAILURE;
+
+			}
+			if ((rename (pathname, SNAPSHOT_TEMP_DIR)) == -1) {
+
+				ERRNO_ERR;
+				CRIT ("cannot move generation directory '%s' to '%s'.", pathname, SNAPSHOT_TEMP_DIR);
+				close (generation_des);
+				FAILURE;
+
+			}
+			close (generation_des);
+			spare = generation;
+			DEBUG ("generation %" PRIu64 " kept as spare.", generation);
+			continue;
+
+		}
+		if ((directory_remove (pathname)) < 0) {
+
+			close (generation_des);
+			FAILURE;
+
+		}
+		close (generation_des);
+		DEBUG ("generation %" PRIu64 " removed.", generation);
+
+	}
+	closedir (directory);
+
+#undef FAILURE
+#define FAILURE return (-1)
+
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_snapshot_pathname (const char *pathname, char *target) {
+
+	if ((snapshot.directory_des >= 0) && ((strncmp (pathname, DBPATH, sizeof (DBPATH) - 1)) == 0) && ((pathname[sizeof (DBPATH) - 1] == '/') || (pathname[sizeof (DBPATH) - 1] == 0))) {
+
+		return (generation_pathname (snapshot.directory, pathname, target));
+
+	}
+	if (target != pathname) {
+
+		if ((strlen (pathname)) >= PATH_MAX) {
+
+			ALERT ("pathname buffer overflow.");
+			FAILURE;
+
+		}
+		strcpy (target, pathname);
+
+	}
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_snapshot_generation (uint64_t *answer) {
+
+	if (snapshot.directory_des < 0) {
+
+		return (1);
+
+	}
+	*answer = snapshot.generation;
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_snapshot_publish (uint64_t *answer) {
+
+	static const char *const index_files[] = { ISIN_INDEX_FILE, NAME_INDEX_FILE, TICKER_DICTIONARY_FILE };
+
+	uint64_t generation;	// Most recent generation before this one.
+	snapshot_manifest_t manifest;	// Manifest of the new generation.
+	FILE *manifest_file;	// Stream to the manifest file.
+	char directory[PATH_MAX];	// Directory of the new generation.
+	char source[PATH_MAX];	// Directory or file of the database.
+	char target[PATH_MAX];	// Directory or file of the new generation.
+	const char *view_directory;	// Directory of a derived view.
+	size_t changes;	// Links and unlinks made to build the new generation.
+	size_t i;	// Short term generic counter.
+	int rcode;	// Return code of functions.
+
+	if (((mkdir (SNAPSHOT_DIR, 0755)) < 0) && (errno != EEXIST)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot create directory '%s'.", SNAPSHOT_DIR);
+		FAILURE;
+
+	}
+	if ((rcode = manifest_read (&generation)) < 0) {
+
+		FAILURE;
+
+	}
+	*answer = (rcode > 0) ? 1 : (generation + 1);
+
+	/*
+	 * Build the new generation in the temporary directory.
+	 * The last publication left there the spare generation (or the leftovers of an interrupted publication):
+	 * only files changed since then are linked or unlinked, not the whole database.
+	 */
+
+	changes = 0;
+	if ((directory_sync (DBPATH, SNAPSHOT_TEMP_DIR, &changes)) < 0) {
+
+		FAILURE;
+
+	}
+	for ( i = 1; i < STOCK_FILE_VIEWS_SIZE; i++ ) {
+
+		view_directory = pfish_bovespa_stock_file_directory (pfish_bovespa_stock_file_views[i]);
+		if (((generation_pathname (SNAPSHOT_TEMP_DIR, view_directory, target)) < 0) || ((directory_sync (view_directory, target, &changes)) < 0)) {
+
+			FAILURE;
+
+		}
+
+	}
+	strcpy (source, XPLIT_FILE_DIR);
+	if (((generation_pathname (SNAPSHOT_TEMP_DIR, source, target)) < 0) || ((directory_sync (source, target, &changes)) < 0)) {
+
+		FAILURE;
+
+	}
+	strcpy (source, ISIN_FILE_DIR);
+	if (((generation_pathname (SNAPSHOT_TEMP_DIR, source, target)) < 0) || ((directory_sync (source, target, &changes)) < 0)) {
+
+		FAILURE;
+
+	}
+	for ( i = 0; i < (sizeof (index_files) / sizeof (index_files[0])); i++ ) {
+
+		if (((generation_pathname (SNAPSHOT_TEMP_DIR, index_files[i], target)) < 0) || ((file_sync (index_files[i], target, &changes)) < 0)) {
+
+			FAILURE;
+
+		}
+
+	}
+	DEBUG ("generation %" PRIu64 " built with %zu links and unlinks.", *answer, changes);
+
+	/*
+	 * Publish: name the directory, then point the manifest to it.
+	 */
+
+	if ((generation_directory (*answer, directory)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((directory_remove (directory)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((rename (SNAPSHOT_TEMP_DIR, directory)) == -1) {
+
+		ERRNO_ERR;
+		CRIT ("cannot move temporary generation directory '%s' to '%s'.", SNAPSHOT_TEMP_DIR, directory);
+		FAILURE;
+
+	}
+
+#define SNAPSHOT_MANIFEST_TEMP_PATHNAME DBPATH "/.generation.tmp"
+
+	memset (&manifest, 0, sizeof (snapshot_manifest_t));
+	manifest.magic = SNAPSHOT_MANIFEST_MAGIC;
+	manifest.generation = *answer;
+	if ((manifest_file = fopen (SNAPSHOT_MANIFEST_TEMP_PATHNAME, "w")) == NULL) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s' in write mode.", SNAPSHOT_MANIFEST_TEMP_PATHNAME);
+		FAILURE;
+
+	}
+	if ((fwrite (&manifest, sizeof (snapshot_manifest_t), 1, manifest_file)) != 1) {
+
+		ERRNO_ERR;
+		CRIT ("cannot write to file '%s'.", SNAPSHOT_MANIFEST_TEMP_PATHNAME);
+		fclose (manifest_file);
+		FAILURE;
+
+	}
+	if ((fclose (manifest_file)) != 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot close file '%s'.", SNAPSHOT_MANIFEST_TEMP_PATHNAME);
+		FAILURE;
+
+	}
+	if ((rename (SNAPSHOT_MANIFEST_TEMP_PATHNAME, SNAPSHOT_MANIFEST_FILE)) == -1) {
+
+		ERRNO_ERR;
+		CRIT ("cannot move temporary generation manifest '%s' to official file.", SNAPSHOT_MANIFEST_TEMP_PATHNAME);
+		FAILURE;
+
+	}
+
+#undef SNAPSHOT_MANIFEST_TEMP_PATHNAME
+
+	/*
+	 * Older generations are not needed anymore once unpinned;
+	 * the most recent of them is kept as the spare generation of the next publication.
+	 */
+
+	if ((generations_collect (*answer)) < 0) {
+
+		CRIT ("cannot remove old generations.");
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_snapshot_pin () {
+
+	uint64_t generation;	// Most recent generation.
+	char directory[PATH_MAX];	// Directory of the generation.
+	int directory_des;	// Directory of the generation, to be locked.
+	struct stat directory_stat;	// Status of the locked directory.
+	struct stat pathname_stat;	// Status of the directory pathname.
+	unsigned int attempt;	// Pinning attempts so far.
+	int rcode;	// Return code of functions.
+
+	for ( attempt = 0; attempt < PIN_ATTEMPTS; attempt++ ) {
+
+		if ((rcode = manifest_read (&generation)) != 0) {
+
+			if (rcode > 0) {
+
+				DEBUG ("no generation published; reading the live database.");
+
+			}
+			return (rcode);
+
+		}
+		if ((generation_directory (generation, directory)) < 0) {
+
+			FAILURE;
+
+		}
+		if ((directory_des = open (directory, O_RDONLY | O_DIRECTORY)) < 0) {
+
+			if (errno == ENOENT) {
+
+				continue;
+
+			}
+			ERRNO_ERR;
+			CRIT ("cannot open directory '%s'.", directory);
+			FAILURE;
+
+		}
+
+		/*
+		 * The lock is taken only if the importer is not removing the generation,
+		 * and it counts only if the generation was not removed meanwhile.
+		 */
+
+		if ((flock (directory_des, LOCK_SH | LOCK_NB)) < 0) {
+
+			if (errno == EWOULDBLOCK) {
+
+				close (directory_des);
+				continue;
+
+			}
+			ERRNO_ERR;
+			CRIT ("cannot lock directory '%s'.", directory);
+			close (directory_des);
+			FAILURE;
+
+		}
+		if (((fstat (directory_des, &directory_stat)) < 0) || ((stat (directory, &pathname_stat)) < 0) || (directory_stat.st_dev != pathname_stat.st_dev) || (directory_stat.st_ino != pathname_stat.st_ino)) {
+
+			close (directory_des);
+			continue;
+
+		}
+
+		/*
+		 * Pinned; release any previous generation.
+		 */
+
+		if (snapshot.directory_des >= 0) {
+
+			close (snapshot.directory_des);
+
+		}
+		snapshot.directory_des = directory_des;
+		snapshot.generation = generation;
+		strcpy (snapshot.directory, directory);
+		DEBUG ("generation %" PRIu64 " pinned.", generation);
+		SUCCESS;
+
+	}
+	CRIT ("cannot pin a database generation after %u attempts.", PIN_ATTEMPTS);
+	FAILURE;
+
+}
+
+
+int pfish_bovespa_snapshot_unpin () {
+
+	if (snapshot.directory_des < 0) {
+
+		SUCCESS;
+
+	}
+	if ((close (snapshot.directory_des)) < 0) {
+
+		ERRNO_ERR;
+		WARNING ("cannot close file descriptor '%d'.", snapshot.directory_des);
+
+	}
+	snapshot.directory_des = -1;
+	DEBUG ("generation %" PRIu64 " unpinned.", snapshot.generation);
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
@@ -0,0 +1,85 @@
+/*
+ * snapshot.h
+ * Database generations and reader snapshots.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_SNAPSHOT_SEEN
+#define FILE_PFISH_BOVESPA_SNAPSHOT_SEEN
+
+#include <stdint.h>
+
+
+/*
+ * Each import publishes a new database generation:
+ *
+ * 	- SNAPSHOT_DIR/<generation> (16 hexadecimal digits) mirrors the database directory layout
+ * 	  with hard links to the files of the generation: stock files, derived views, inplit / split
+ * 	  lists, ISIN segment lists and indexes;
+ * 	- SNAPSHOT_MANIFEST_FILE names the most recent generation; it is replaced atomically.
+ *
+ * The importer never rewrites a file in place, so a generation keeps the file versions it was
+ * published with. Readers pin a generation by holding a shared lock on its directory; the importer
+ * removes unpinned generations other than the most recent one. No one ever waits for a lock.
+ *
+ * The most recent unpinned generation that would be removed is kept instead as the spare generation
+ * (SNAPSHOT_DIR/.tmp), and the next publication is built from it: only files replaced, added or removed
+ * since the spare generation are linked or unlinked, typically those of the last two imports.
+ * Without a spare generation (first publication, or every older generation pinned) all files are linked.
+ * The spare generation keeps the replaced file versions it links alive until the next publication.
+ */
+
+#define SNAPSHOT_DIR DBPATH "/.generations"
+#define SNAPSHOT_MANIFEST_FILE DBPATH "/.generation"
+#define SNAPSHOT_MANIFEST_MAGIC 0x4E474250
+
+struct snapshot_manifest {
+
+	uint32_t magic;	// SNAPSHOT_MANIFEST_MAGIC.
+	uint32_t reserved;	// Zero.
+	uint64_t generation;	// Most recent generation.
+
+};
+
+typedef struct snapshot_manifest snapshot_manifest_t;
+
+
+/*
+ * Translate a database pathname to the pinned generation, if any.
+ * DBPATH itself is translated to the generation directory.
+ * Pathnames outside DBPATH, or any pathname while no generation is pinned, are kept.
+ *
+ * @param[in] pathname full pathname of a database file.
+ * @param[out] target buffer of PATH_MAX octets to receive the pathname; may be 'pathname' itself.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_snapshot_pathname (const char *pathname, char *target);
+
+
+/*
+ * Find the pinned generation.
+ * Files of a pinned generation are never replaced.
+ *
+ * @param[out] answer pinned generation, if any.
+ *
+ * @return 0 if a generation is pinned, positive otherwise.
+ */
+
+int pfish_bovespa_snapshot_generation (uint64_t *answer);
+
+
+/*
+ * Publish the current database files as a new generation, then remove unpinned older generations
+ * (but the spare generation).
+ * Not reentrant; only the importer publishes.
+ *
+ * @param[out] answer the new generation.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_snapshot_publish (uint64_t *answer);
+
+
+#endif	// FILE_PFISH_BOVESPA_SNAPSHOT_SEEN
@@ -0,0 +1,615 @@
+/*
+ * stock_file.c
+ * Stock file functions.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+#include <pilot_fish/bovespa.h>
+
+#include "crc32c.h"
+#include "stock_file.h"
+#include "snapshot.h"
+#include "metrics.h"
+#include "async_log.h"
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+
+const unsigned int pfish_bovespa_stock_file_views[STOCK_FILE_VIEWS_SIZE] = {
+
+	PFISH_BOVESPA_VIEW_RAW,
+	PFISH_BOVESPA_VIEW_ADJUSTED,
+	PFISH_BOVESPA_VIEW_WEEKLY,
+	PFISH_BOVESPA_VIEW_ADJUSTED | PFISH_BOVESPA_VIEW_WEEKLY,
+	PFISH_BOVESPA_VIEW_MONTHLY,
+	PFISH_BOVESPA_VIEW_ADJUSTED | PFISH_BOVESPA_VIEW_MONTHLY
+
+};
+
+
+const char *pfish_bovespa_stock_file_directory (unsigned int view) {
+
+	switch (view) {
+
+		case PFISH_BOVESPA_VIEW_RAW:
+
+			return (DBPATH);
+
+		case PFISH_BOVESPA_VIEW_ADJUSTED:
+
+			return (STOCK_FILE_ADJUSTED_DIR);
+
+		case PFISH_BOVESPA_VIEW_WEEKLY:
+
+			return (STOCK_FILE_WEEKLY_DIR);
+
+		case PFISH_BOVESPA_VIEW_MONTHLY:
+
+			return (STOCK_FILE_MONTHLY_DIR);
+
+		case PFISH_BOVESPA_VIEW_ADJUSTED | PFISH_BOVESPA_VIEW_WEEKLY:
+
+			return (STOCK_FILE_ADJUSTED_WEEKLY_DIR);
+
+		case PFISH_BOVESPA_VIEW_ADJUSTED | PFISH_BOVESPA_VIEW_MONTHLY:
+
+			return (STOCK_FILE_ADJUSTED_MONTHLY_DIR);
+
+		default:
+
+			return (NULL);
+
+	}
+
+}
+
+
+int pfish_bovespa_stock_file_pathname (const pfish_bovespa_stock_id_t *stock_id, unsigned int view, char *target) {
+
+	const char *directory;
+
+	if ((directory = pfish_bovespa_stock_file_directory (view)) == NULL) {
+
+		ERR ("unknown stock history view '%u'.", view);
+		FAILURE;
+
+	}
+	if ((snprintf (target, PATH_MAX, "%s/%s", directory, stock_id->id)) >= PATH_MAX) {
+
+		ALERT ("pathname buffer overflow.");
+		FAILURE;
+
+	}
+	return (pfish_bovespa_snapshot_pathname (target, target));
+
+}
+
+
+int pfish_bovespa_xplit_file_pathname (const pfish_bovespa_stock_id_t *stock_id, char *target) {
+
+	if ((snprintf (target, PATH_MAX, "%s/%s", XPLIT_FILE_DIR, stock_id->id)) >= PATH_MAX) {
+
+		ALERT ("pathname buffer overflow.");
+		FAILURE;
+
+	}
+	return (pfish_bovespa_snapshot_pathname (target, target));
+
+}
+
+
+int pfish_bovespa_stock_file_map (const char *pathname, pfish_bovespa_stock_history_t **answer, struct stat *answer_stat) {
+
+	int stock_file_des;
+
+	DEBUG ("stock_file_name = '%s'", pathname);
+
+	/*
+	 * "Just" mmap.
+	 */
+
+	if ((stock_file_des = open (pathname, O_RDONLY | O_EXCL)) < 0) {
+
+		switch (errno) {
+
+			case ENOENT:
+
+				/*
+				 * Stock file does not exist in database directory.
+				 * By definition this is not a failure.
+				 */
+
+				DEBUG("file '%s' does not exist in database.", pathname);
+				*answer = NULL;
+				SUCCESS;
+
+			default:
+
+				ERRNO_ERR;
+				CRIT ("cannot open file '%s'.", pathname);
+				METRICS_FAILURE (PFISH_BOVESPA_FAILURE_IO);
+				FAILURE;
+
+		}
+
+	}
+	if ((fstat (stock_file_des, answer_stat)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot stat file descriptor '%d'.", stock_file_des);
+		close (stock_file_des);
+		METRICS_FAILURE (PFISH_BOVESPA_FAILURE_IO);
+		FAILURE;
+
+	}
+	if ((*answer = (pfish_bovespa_stock_history_t *) mmap (NULL, answer_stat->st_size, PROT_READ, MAP_PRIVATE, stock_file_des, 0)) == (pfish_bovespa_stock_history_t *) (-1)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot memory-map file descriptor '%d'.", stock_file_des);
+		close (stock_file_des);
+		METRICS_FAILURE (PFISH_BOVESPA_FAILURE_MAP);
+		FAILURE;
+
+	}
+	if ((close (stock_file_des)) < 0) {
+
+		ERRNO_ERR;
+		WARNING ("cannot close file descriptor '%d'.", stock_file_des);
+
+	}
+	if ((pfish_bovespa_stock_file_verify (pathname, *answer, answer_stat->st_size, 0)) < 0) {
+
+		CRIT ("stock file '%s' is corrupt; please run pfish_bovespa_fsck.", pathname);
+		munmap (*answer, answer_stat->st_size);
+		*answer = NULL;
+		METRICS_FAILURE (PFISH_BOVESPA_FAILURE_CORRUPT);
+		FAILURE;
+
+	}
+	METRICS_ADD (files_mapped, 1);
+	METRICS_ADD (bytes_mapped, answer_stat->st_size);
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_stock_file_write (const char *pathname, size_t daily_quotes_size, size_t last_xplit, pfish_bovespa_daily_quote_t **daily_quotes) {
+
+	char *buffer;	// Whole file contents.
+	size_t file_size;	// Size of the whole file.
+	size_t data_size;	// Size of the data part.
+	pfish_bovespa_stock_history_t *history;	// Data part of buffer.
+	uint32_t *block_checksums;	// Block checksums of buffer.
+	stock_file_trailer_t *trailer;	// Trailer of buffer.
+	int stock_file_des;	// Stock file descriptor.
+	ssize_t count;	// Octets written at each pass.
+	size_t done;	// Octets written so far.
+	size_t i;	// Short term generic counter.
+
+	/*
+	 * Build the file contents in memory.
+	 */
+
+	data_size = STOCK_FILE_DATA_SIZE (daily_quotes_size);
+	file_size = STOCK_FILE_SIZE (daily_quotes_size);
+	if ((buffer = (char *) malloc (file_size)) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", file_size);
+		FAILURE;
+
+	}
+	history = (pfish_bovespa_stock_history_t *) buffer;
+	block_checksums = (uint32_t *) (buffer + data_size);
+	trailer = (stock_file_trailer_t *) (buffer + file_size - sizeof (stock_file_trailer_t));
+	history->daily_quotes_size = daily_quotes_size;
+	history->last_xplit = last_xplit;
+	for ( i = 0; i < daily_quotes_size; i++ ) {
+
+		memcpy (&(history->daily_quotes[i]), daily_quotes[i], sizeof (pfish_bovespa_daily_quote_t));
+
+	}
+	trailer->block_size = STOCK_FILE_BLOCK_SIZE;
+	trailer->blocks_size = STOCK_FILE_BLOCKS_SIZE (data_size);
+	trailer->data_size = data_size;
+	trailer->magic = STOCK_FILE_MAGIC;
+	for ( i = 0; i < trailer->blocks_size; i++ ) {
+
+		block_checksums[i] = pfish_bovespa_crc32c (0, buffer + (i * STOCK_FILE_BLOCK_SIZE), ((i + 1) < trailer->blocks_size) ? STOCK_FILE_BLOCK_SIZE : (data_size - (i * STOCK_FILE_BLOCK_SIZE)));
+
+	}
+	trailer->file_checksum = pfish_bovespa_crc32c (0, buffer, file_size - sizeof (uint32_t));
+
+#undef FAILURE
+#define FAILURE \
+	free (buffer); \
+	return (-1)
+
+	/*
+	 * Write it.
+	 */
+
+	if ((stock_file_des = open (pathname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s' in write mode.", pathname);
+		FAILURE;
+
+	}
+	for ( done = 0; done < file_size; done += count ) {
+
+		if ((count = write (stock_file_des, buffer + done, file_size - done)) < 0) {
+
+			ERRNO_ERR;
+			CRIT ("cannot write to file '%s'.", pathname);
+			close (stock_file_des);
+			FAILURE;
+
+		}
+
+	}
+	if ((close (stock_file_des)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot close file '%s'.", pathname);
+		FAILURE;
+
+	}
+	free (buffer);
+
+#undef FAILURE
+#define FAILURE return (-1)
+
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_stock_file_verify (const char *name, const pfish_bovespa_stock_history_t *history, size_t file_size, unsigned int deep) {
+
+	const stock_file_trailer_t *trailer;
+	const uint32_t *block_checksums;
+	size_t i;
+
+	/*
+	 * Sizes.
+	 */
+
+	if (file_size < (STOCK_FILE_DATA_SIZE (0) + sizeof (stock_file_trailer_t))) {
+
+		ERR ("stock file '%s' is truncated (%lu octets).", name, (unsigned long) file_size);
+		FAILURE;
+
+	}
+	trailer = (const stock_file_trailer_t *) ((const char *) history + file_size - sizeof (stock_file_trailer_t));
+	if (trailer->magic != STOCK_FILE_MAGIC) {
+
+		ERR ("stock file '%s' has no valid trailer.", name);
+		FAILURE;
+
+	}
+	if ((history->daily_quotes_size > (file_size / sizeof (pfish_bovespa_daily_quote_t))) || (file_size != STOCK_FILE_SIZE (history->daily_quotes_size))) {
+
+		ERR ("stock file '%s' size (%lu octets) disagrees with its header (%lu daily quotes).", name, (unsigned long) file_size, (unsigned long) history->daily_quotes_size);
+		FAILURE;
+
+	}
+	if ((trailer->data_size != STOCK_FILE_DATA_SIZE (history->daily_quotes_size)) || (trailer->block_size != STOCK_FILE_BLOCK_SIZE) || (trailer->blocks_size != STOCK_FILE_BLOCKS_SIZE (trailer->data_size))) {
+
+		ERR ("stock file '%s' trailer disagrees with its header.", name);
+		FAILURE;
+
+	}
+	if ((history->last_xplit != 0) && (history->last_xplit >= history->daily_quotes_size)) {
+
+		ERR ("stock file '%s' has an out of range inplit / split index (%lu).", name, (unsigned long) history->last_xplit);
+		FAILURE;
+
+	}
+	if (deep == 0) {
+
+		SUCCESS;
+
+	}
+
+	/*
+	 * Checksums.
+	 */
+
+	if ((pfish_bovespa_crc32c (0, history, file_size - sizeof (uint32_t))) != trailer->file_checksum) {
+
+		ERR ("stock file '%s' checksum mismatch.", name);
+		block_checksums = (const uint32_t *) ((const char *) history + trailer->data_size);
+		for ( i = 0; i < trailer->blocks_size; i++ ) {
+
+			if ((pfish_bovespa_crc32c (0, (const char *) history + (i * STOCK_FILE_BLOCK_SIZE), ((i + 1) < trailer->blocks_size) ? STOCK_FILE_BLOCK_SIZE : (trailer->data_size - (i * STOCK_FILE_BLOCK_SIZE)))) != block_checksums[i]) {
+
+				ERR ("stock file '%s' block %lu (octets %lu to %lu) is corrupt.", name, (unsigned long) i, (unsigned long) (i * STOCK_FILE_BLOCK_SIZE), (unsigned long) (((i + 1) * STOCK_FILE_BLOCK_SIZE) - 1));
+
+			}
+
+		}
+		FAILURE;
+
+	}
+
+	/*
+	 * Ordering.
+	 */
+
+	for ( i = 1; i < history->daily_quotes_size; i++ ) {
+
+		if (history->daily_quotes[i - 1].trading_date >= history->daily_quotes[i].trading_date) {
+
+			ERR ("stock file '%s' daily quotes out of order at position %lu.", name, (unsigned long) i);
+			FAILURE;
+
+		}
+
+	}
+	SUCCESS;
+
+}
+
+
+/*
+ * Write a list file: a dump of a list (a size_t element count followed by the elements)
+ * followed by its CRC-32C checksum (uint32_t).
+ *
+ * @param[in] pathname full pathname of the file.
+ * @param[in] list list.
+ * @param[in] list_size octets of the list dump.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+static int list_file_write (const char *pathname, const void *list, size_t list_size) {
+
+	uint32_t checksum;	// Checksum of the list dump.
+	FILE *list_file;	// Stream to the file.
+
+	checksum = pfish_bovespa_crc32c (0, list, list_size);
+	if ((list_file = fopen (pathname, "w")) == NULL) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s' in write mode.", pathname);
+		FAILURE;
+
+	}
+	if (((fwrite (list, list_size, 1, list_file)) != 1) || ((fwrite (&checksum, sizeof (uint32_t), 1, list_file)) != 1)) {
+
+		ERRNO_ERR;
+		CRIT ("cannot write to file '%s'.", pathname);
+		fclose (list_file);
+		FAILURE;
+
+	}
+	if ((fclose (list_file)) != 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot close file '%s'.", pathname);
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+/*
+ * Read a list file (see list_file_write()).
+ *
+ * @param[in] pathname full pathname of the file.
+ * @param[in] kind kind of list, for logging.
+ * @param[in] header_size octets of the list before its first element.
+ * @param[in] element_size octets of each element.
+ * @param[out] answer dynamically allocated list if file exists, NULL otherwise.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+static int list_file_read (const char *pathname, const char *kind, size_t header_size, size_t element_size, void **answer) {
+
+	FILE *list_file;	// Stream to the file.
+	size_t elements_size;	// How many elements in the file.
+	size_t list_size;	// Octets of the list dump.
+	uint32_t checksum;	// Checksum of the list dump.
+
+	if ((list_file = fopen (pathname, "r")) == NULL) {
+
+		switch (errno) {
+
+			case ENOENT:
+
+				*answer = NULL;
+				SUCCESS;
+
+			default:
+
+				ERRNO_ERR;
+				CRIT ("cannot open file '%s' in read mode.", pathname);
+				FAILURE;
+
+		}
+
+	}
+
+#define FREE \
+	fclose (list_file)
+
+	if ((fread (&elements_size, sizeof (size_t), 1, list_file)) != 1) {
+
+		ERR ("%s file '%s' is truncated.", kind, pathname);
+		FREE;
+		FAILURE;
+
+	}
+	if (elements_size > (SIZE_MAX / element_size) - 1) {
+
+		ERR ("%s file '%s' is corrupt.", kind, pathname);
+		FREE;
+		FAILURE;
+
+	}
+	list_size = header_size + (elements_size * element_size);
+	if ((*answer = malloc (list_size)) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", list_size);
+		FREE;
+		FAILURE;
+
+	}
+
+#undef FREE
+#define FREE \
+	free (*answer); \
+	*answer = NULL; \
+	fclose (list_file)
+
+	*((size_t *) *answer) = elements_size;
+	if (((elements_size != 0) && ((fread ((char *) *answer + header_size, list_size - header_size, 1, list_file)) != 1)) || ((fread (&checksum, sizeof (uint32_t), 1, list_file)) != 1)) {
+
+		ERR ("%s file '%s' is truncated.", kind, pathname);
+		FREE;
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_crc32c (0, *answer, list_size)) != checksum) {
+
+		ERR ("%s file '%s' checksum mismatch.", kind, pathname);
+		FREE;
+		FAILURE;
+
+	}
+	fclose (list_file);
+	SUCCESS;
+
+#undef FREE
+
+}
+
+
+int pfish_bovespa_xplit_file_write (const char *pathname, const pfish_bovespa_xplit_list_t *list) {
+
+	return (list_file_write (pathname, list, sizeof (pfish_bovespa_xplit_list_t) + (list->xplit_list_size * sizeof (pfish_bovespa_xplit_t))));
+
+}
+
+
+int pfish_bovespa_xplit_file_read (const char *pathname, pfish_bovespa_xplit_list_t **answer) {
+
+	return (list_file_read (pathname, "inplit / split list", sizeof (pfish_bovespa_xplit_list_t), sizeof (pfish_bovespa_xplit_t), (void **) answer));
+
+}
+
+
+int pfish_bovespa_isin_file_pathname (const pfish_bovespa_stock_id_t *stock_id, char *target) {
+
+	if ((snprintf (target, PATH_MAX, "%s/%s", ISIN_FILE_DIR, stock_id->id)) >= PATH_MAX) {
+
+		ALERT ("pathname buffer overflow.");
+		FAILURE;
+
+	}
+	return (pfish_bovespa_snapshot_pathname (target, target));
+
+}
+
+
+int pfish_bovespa_isin_file_write (const char *pathname, const pfish_bovespa_isin_segment_list_t *list) {
+
+	return (list_file_write (pathname, list, sizeof (pfish_bovespa_isin_segment_list_t) + (list->isin_segment_list_size * sizeof (pfish_bovespa_isin_segment_t))));
+
+}
+
+
+int pfish_bovespa_isin_file_read (const char *pathname, pfish_bovespa_isin_segment_list_t **answer) {
+
+	return (list_file_read (pathname, "ISIN segment list", sizeof (pfish_bovespa_isin_segment_list_t), sizeof (pfish_bovespa_isin_segment_t), (void **) answer));
+
+}
+
+
+int pfish_bovespa_isin_index_map (pfish_bovespa_isin_segment_list_t **answer, size_t *answer_size) {
+
+	int index_file_des;
+	struct stat index_file_stat;
+	char pathname[PATH_MAX];	// Pathname of the file, possibly in the pinned generation.
+
+	if ((pfish_bovespa_snapshot_pathname (ISIN_INDEX_FILE, pathname)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((index_file_des = open (pathname, O_RDONLY)) < 0) {
+
+		switch (errno) {
+
+			case ENOENT:
+
+				DEBUG("file '%s' does not exist in database.", pathname);
+				*answer = NULL;
+				SUCCESS;
+
+			default:
+
+				ERRNO_ERR;
+				CRIT ("cannot open file '%s'.", pathname);
+				FAILURE;
+
+		}
+
+	}
+	if ((fstat (index_file_des, &index_file_stat)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot stat file descriptor '%d'.", index_file_des);
+		close (index_file_des);
+		FAILURE;
+
+	}
+	*answer_size = index_file_stat.st_size;
+	if ((*answer_size < (sizeof (pfish_bovespa_isin_segment_list_t) + sizeof (uint32_t))) || ((*answer = (pfish_bovespa_isin_segment_list_t *) mmap (NULL, *answer_size, PROT_READ, MAP_PRIVATE, index_file_des, 0)) == (pfish_bovespa_isin_segment_list_t *) (-1))) {
+
+		ERRNO_ERR;
+		CRIT ("cannot memory-map file '%s'.", pathname);
+		close (index_file_des);
+		FAILURE;
+
+	}
+	if ((close (index_file_des)) < 0) {
+
+		ERRNO_ERR;
+		WARNING ("cannot close file descriptor '%d'.", index_file_des);
+
+	}
+	if (((*answer)->isin_segment_list_size > (*answer_size / sizeof (pfish_bovespa_isin_segment_t))) || (*answer_size != (sizeof (pfish_bovespa_isin_segment_list_t) + ((*answer)->isin_segment_list_size * sizeof (pfish_bovespa_isin_segment_t)) + sizeof (uint32_t)))) {
+
+		CRIT ("ISIN index file '%s' is corrupt; please run pfish_bovespa_fsck.", pathname);
+		munmap (*answer, *answer_size);
+		*answer = NULL;
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+#undef FAILURE
+#undef SUCCESS
@@ -0,0 +1,231 @@
+/*
+ * stock_file.h
+ * Stock file functions.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_STOCK_FILE_SEEN
+#define FILE_PFISH_BOVESPA_STOCK_FILE_SEEN
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <pilot_fish/bovespa.h>
+
+
+/*
+ * Stock file layout:
+ *
+ * 	- a dump of a 'pfish_bovespa_stock_history_t' instance (the data part);
+ * 	- one CRC-32C checksum (uint32_t) per STOCK_FILE_BLOCK_SIZE octets of the data part;
+ * 	- a trailer, whose checksum covers everything before it.
+ */
+
+#define STOCK_FILE_MAGIC 0x54564250
+#define STOCK_FILE_BLOCK_SIZE 0x10000
+
+struct stock_file_trailer {
+
+	uint32_t block_size;	// Octets of data part covered by each block checksum.
+	uint32_t blocks_size;	// How many block checksums precede the trailer.
+	uint64_t data_size;	// Octets of the data part.
+	uint32_t magic;		// STOCK_FILE_MAGIC.
+	uint32_t file_checksum;	// Checksum of the whole file up to this field.
+
+};
+
+typedef struct stock_file_trailer stock_file_trailer_t;
+
+#define STOCK_FILE_DATA_SIZE(DAILY_QUOTES_SIZE) ((2 * sizeof (size_t)) + ((DAILY_QUOTES_SIZE) * sizeof (pfish_bovespa_daily_quote_t)))
+#define STOCK_FILE_BLOCKS_SIZE(DATA_SIZE) (((DATA_SIZE) + STOCK_FILE_BLOCK_SIZE - 1) / STOCK_FILE_BLOCK_SIZE)
+#define STOCK_FILE_SIZE(DAILY_QUOTES_SIZE) (STOCK_FILE_DATA_SIZE (DAILY_QUOTES_SIZE) + (STOCK_FILE_BLOCKS_SIZE (STOCK_FILE_DATA_SIZE (DAILY_QUOTES_SIZE)) * sizeof (uint32_t)) + sizeof (stock_file_trailer_t))
+
+
+/*
+ * Database directories.
+ * Raw stock files live directly in DBPATH; other views and inplit / split lists live in hidden subdirectories.
+ */
+
+#define STOCK_FILE_ADJUSTED_DIR DBPATH "/.adjusted"
+#define STOCK_FILE_WEEKLY_DIR DBPATH "/.weekly"
+#define STOCK_FILE_MONTHLY_DIR DBPATH "/.monthly"
+#define STOCK_FILE_ADJUSTED_WEEKLY_DIR DBPATH "/.adjusted_weekly"
+#define STOCK_FILE_ADJUSTED_MONTHLY_DIR DBPATH "/.adjusted_monthly"
+#define XPLIT_FILE_DIR DBPATH "/.xplits"
+#define ISIN_FILE_DIR DBPATH "/.isins"
+#define LOCK_FILE_DIR DBPATH "/.locks"
+
+
+/*
+ * ISIN index: all ISIN segments of all stocks with a known ISIN code,
+ * ordered by ISIN code, first trading date and stock, in the same layout of an ISIN segment list file.
+ */
+
+#define ISIN_INDEX_FILE DBPATH "/.isin_index"
+
+
+/*
+ * All stock history views kept in the database, in ascending order.
+ */
+
+#define STOCK_FILE_VIEWS_SIZE 6
+
+extern const unsigned int pfish_bovespa_stock_file_views[STOCK_FILE_VIEWS_SIZE];
+
+
+/*
+ * Find the directory of the stock files of a view.
+ *
+ * @param[in] view one of PFISH_BOVESPA_VIEW_* values, possibly combined.
+ *
+ * @return full pathname of the directory, NULL if view is unknown.
+ */
+
+const char *pfish_bovespa_stock_file_directory (unsigned int view);
+
+
+/*
+ * Build the full pathname of the file of a stock.
+ *
+ * @param[in] stock_id stock identification.
+ * @param[in] view one of PFISH_BOVESPA_VIEW_* values, possibly combined.
+ * @param[out] target buffer of PATH_MAX octets to receive the pathname.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_stock_file_pathname (const pfish_bovespa_stock_id_t *stock_id, unsigned int view, char *target);
+
+
+/*
+ * Build the full pathname of the inplit / split list file of a stock.
+ *
+ * @param[in] stock_id stock identification.
+ * @param[out] target buffer of PATH_MAX octets to receive the pathname.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_xplit_file_pathname (const pfish_bovespa_stock_id_t *stock_id, char *target);
+
+
+/*
+ * Write an inplit / split list file.
+ * The file is a dump of a 'pfish_bovespa_xplit_list_t' instance followed by its CRC-32C checksum (uint32_t).
+ *
+ * @param[in] pathname full pathname of the file.
+ * @param[in] list inplit / split list.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_xplit_file_write (const char *pathname, const pfish_bovespa_xplit_list_t *list);
+
+
+/*
+ * Read an inplit / split list file.
+ *
+ * @param[in] pathname full pathname of the file.
+ * @param[out] answer dynamically allocated inplit / split list if file exists, NULL otherwise.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_xplit_file_read (const char *pathname, pfish_bovespa_xplit_list_t **answer);
+
+
+/*
+ * Build the full pathname of the ISIN segment list file of a stock.
+ *
+ * @param[in] stock_id stock identification.
+ * @param[out] target buffer of PATH_MAX octets to receive the pathname.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_isin_file_pathname (const pfish_bovespa_stock_id_t *stock_id, char *target);
+
+
+/*
+ * Write an ISIN segment list file.
+ * The file is a dump of a 'pfish_bovespa_isin_segment_list_t' instance followed by its CRC-32C checksum (uint32_t).
+ *
+ * @param[in] pathname full pathname of the file.
+ * @param[in] list ISIN segment list.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_isin_file_write (const char *pathname, const pfish_bovespa_isin_segment_list_t *list);
+
+
+/*
+ * Read an ISIN segment list file.
+ *
+ * @param[in] pathname full pathname of the file.
+ * @param[out] answer dynamically allocated ISIN segment list if file exists, NULL otherwise.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_isin_file_read (const char *pathname, pfish_bovespa_isin_segment_list_t **answer);
+
+
+/*
+ * Memory-map the ISIN index file.
+ * Only sizes are verified; checksum is left to pfish_bovespa_fsck.
+ *
+ * @param[out] answer mapped ISIN segment list if file exists, NULL otherwise.
+ * @param[out] answer_size octets spanned by the mapping.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_isin_index_map (pfish_bovespa_isin_segment_list_t **answer, size_t *answer_size);
+
+
+/*
+ * Write a stock file.
+ *
+ * @param[in] pathname full pathname of the stock file.
+ * @param[in] daily_quotes_size how many elements in daily_quotes.
+ * @param[in] last_xplit index of daily_quotes of the most recent inplit or split.
+ * @param[in] daily_quotes array of pointers to daily quotes, ordered by trading date.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_stock_file_write (const char *pathname, size_t daily_quotes_size, size_t last_xplit, pfish_bovespa_daily_quote_t **daily_quotes);
+
+
+/*
+ * Verify the integrity of a mapped stock file.
+ * Shallow verification checks only that the sizes told by the file agree with the size of the file.
+ * Deep verification also checks all checksums and the ordering of daily quotes.
+ * Failures are logged.
+ *
+ * @param[in] name name of the stock file, for logging.
+ * @param[in] history mapped stock file.
+ * @param[in] file_size size of the stock file.
+ * @param[in] deep nonzero for deep verification.
+ *
+ * @return 0 if stock file is sound, negative otherwise.
+ */
+
+int pfish_bovespa_stock_file_verify (const char *name, const pfish_bovespa_stock_history_t *history, size_t file_size, unsigned int deep);
+
+
+/*
+ * Memory-map a stock file.
+ * The stock file is shallowly verified (see pfish_bovespa_stock_file_verify()).
+ *
+ * @param[in] pathname full pathname of the stock file.
+ * @param[out] answer mapped stock history if file exists, NULL otherwise.
+ * @param[out] answer_stat status of the mapped file; the mapping spans answer_stat->st_size octets.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_stock_file_map (const char *pathname, pfish_bovespa_stock_history_t **answer, struct stat *answer_stat);
+
+
+#endif	// FILE_PFISH_BOVESPA_STOCK_FILE_SEEN
@@ -9,15 +9,23 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
+#include <errno.h>
 #include <syslog.h>
 #include <argp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include <pilot_fish/syslog.h>
 #include <pilot_fish/syslog_macros.h>
 
 #include <pilot_fish/bovespa.h>
 
+#include "history_writer.h"
+#include "async_log.h"
+
 
 /*
  * Command line argument parsing.
@@ -26,13 +34,24 @@
 const char *argp_program_version = PACKAGE_VERSION;
 const char *argp_program_bug_address = PACKAGE_BUGREPORT;
 
-static char doc[] = "pfish_bovespa_stock_history -- trade history of a stock of the pilot_fish bovespa database.\vThis routine exports the trade history of STOCK through the standard output in CSV format.\n\nExported fields are: trading date, stock specification, price factor, opening price, closing price, minimum price, maximum price, average price, total trades, total stocks, total volume.\n\nFormat of date fields is YYYY-MM-DD.\nPrice and volume fields are in units of 1/100 of the stock currency.\n";
+static char doc[] = "pfish_bovespa_stock_history -- trade history of a stock of the pilot_fish bovespa database.\vThis routine exports the trade history of STOCK through the standard output in CSV format.\n\nExported fields are: trading date, stock specification, price factor, opening price, closing price, minimum price, maximum price, average price, total trades, total stocks, total volume.\n\nFormat of date fields is YYYY-MM-DD.\nPrice and volume fields are in units of 1/100 of the stock currency.\n\nWith --adjusted, prices of all trades are adjusted by later inplits / splits and the price factor is always 10000.\n\nWith --period, each line is a weekly or monthly rollup: trading date and opening price of the first trading day of the period, stock specification, price factor and closing price of the last one, extreme prices, average price weighted by total stocks, and summed totals.\n\nWith --isin, STOCK is an ISIN code, and the history is stitched across all stocks traded under it.\n\nWith --format, the export is 'jsonl' (one JSON object per line, keyed by field name), 'raw' (daily quote records as stored in the database, native byte order) or 'arrow' (an Apache Arrow IPC stream of one record batch per stock).\n\nWith --fields, only the listed fields are exported, in the order above. Field names are: stock_id, trading_date, stock_spec, price_factor, opening_price, closing_price, minimum_price, maximum_price, average_price, total_trades, total_stocks, total_volume.\n\nSeveral stocks (given as arguments, listed in a file, or all stocks with --all-stocks) are exported by one process from a pinned database snapshot, formatted in parallel. By default they are exported as one combined stream, in the order given, with the stock identification (field stock_id) as the first field; with --output-dir, each stock is exported to its own file, named after the stock and the format. Stocks that cannot be exported are reported and skipped; exit status is then non zero.\n";
 
-static char args_doc[] = "STOCK";
+static char args_doc[] = "[STOCK...]";
 
 static struct argp_option options[] = {
 
 	{"all", 'a', 0,  0, "show all trades (instead of starting in the most recent inplit / slit).", 0 },
+	{"image", 'm', 0,  0, "read from the shared memory database image (see pfish_bovespa_image_load).", 0 },
+	{"adjusted", 'x', 0,  0, "show all trades with prices adjusted by inplits / splits.", 0 },
+	{"period", 'p', "PERIOD",  0, "show rollups of trades by PERIOD: 'daily' (default), 'weekly' or 'monthly'.", 0 },
+	{"isin", 'i', 0,  0, "take STOCK as an ISIN code and show the history stitched across ticker changes.", 0 },
+	{"format", 'f', "FORMAT",  0, "export in FORMAT: 'csv' (default), 'jsonl', 'raw' or 'arrow'.", 0 },
+	{"fields", 'F', "LIST",  0, "export only fields in the comma separated LIST.", 0 },
+	{"all-stocks", 'A', 0,  0, "export all stocks of the database.", 0 },
+	{"stocks-file", 's', "FILE",  0, "export stocks listed in FILE, one per line ('-' for the standard input).", 0 },
+	{"output-dir", 'o', "DIR",  0, "export each stock to its own file in DIR.", 0 },
+	{"jobs", 'j', "JOBS",  0, "format JOBS stocks at once (default: number of online processors).", 0 },
+	{"stats", 'S', 0,  0, "print runtime metrics of the library to the standard error on exit.", 0 },
 	{ 0 }
 
 };
@@ -40,7 +59,20 @@ static struct argp_option options[] = {
 struct arguments {
 
 	unsigned int all;
-	char *stock;
+	unsigned int image;
+	unsigned int adjusted;
+	unsigned int period;
+	unsigned int isin;
+	unsigned int format;
+	unsigned int fields;
+	unsigned int fields_given;
+	unsigned int all_stocks;
+	char *stocks_file;
+	char *output_dir;
+	long jobs;
+	char **stocks;
+	size_t stocks_size;
+	unsigned int stats;
 
 };
 
@@ -48,6 +80,7 @@ struct arguments {
 static error_t parse_opt (int key, char *arg, struct argp_state *state) {
 
 	struct arguments *arguments = state->input;
+	char *aux_charp;
 
 	switch (key) {
 
@@ -56,27 +89,111 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state) {
 			arguments->all = 1;
 			break;
 
-		case ARGP_KEY_ARG:
+		case 'm':
+
+			arguments->image = 1;
+			break;
+
+		case 'x':
+
+			arguments->adjusted = 1;
+			break;
+
+		case 'i':
+
+			arguments->isin = 1;
+			break;
+
+		case 'p':
+
+			if ((strcmp (arg, "daily")) == 0) {
+
+				arguments->period = PFISH_BOVESPA_VIEW_RAW;
+
+			}
+			else if ((strcmp (arg, "weekly")) == 0) {
+
+				arguments->period = PFISH_BOVESPA_VIEW_WEEKLY;
+
+			}
+			else if ((strcmp (arg, "monthly")) == 0) {
+
+				arguments->period = PFISH_BOVESPA_VIEW_MONTHLY;
+
+			}
+			else {
+
+				argp_error (state, "unknown period '%s'.", arg);
+
+			}
+			break;
+
+		case 'f':
+
+			if ((pfish_bovespa_history_writer_format (arg, &(arguments->format))) < 0) {
+
+				argp_error (state, "unknown format '%s'.", arg);
+
+			}
+			break;
+
+		case 'F':
+
+			if ((pfish_bovespa_history_writer_fields (arg, &(arguments->fields))) < 0) {
+
+				argp_error (state, "bad list of fields '%s'.", arg);
+
+			}
+			arguments->fields_given = 1;
+			break;
+
+		case 'A':
+
+			arguments->all_stocks = 1;
+			break;
+
+		case 's':
+
+			arguments->stocks_file = arg;
+			break;
 
-			switch (state->arg_num) {
+		case 'o':
 
-				case 0:
-					arguments->stock = arg;
-					break;
+			arguments->output_dir = arg;
+			break;
 
-				default:
+		case 'j':
 
-					argp_usage (state);
+			arguments->jobs = strtol (arg, &aux_charp, 10);
+			if ((*aux_charp != 0) || (arguments->jobs < 1)) {
+
+				argp_error (state, "invalid number of jobs '%s'.", arg);
 
 			}
 			break;
 
+		case 'S':
+
+			arguments->stats = 1;
+			break;
+
+		case ARGP_KEY_ARGS:
+
+			arguments->stocks = state->argv + state->next;
+			arguments->stocks_size = state->argc - state->next;
+			break;
+
 		case ARGP_KEY_END:
 
-			if (state->arg_num < 1) {
+			if ((arguments->stocks_size < 1) && (arguments->all_stocks == 0) && (arguments->stocks_file == NULL)) {
 
 				argp_usage (state);
 
+			}
+			if ((arguments->all_stocks != 0) && (arguments->isin != 0)) {
+
+				argp_error (state, "--all-stocks does not apply to ISIN codes.");
+
 			}
 			break;
 
@@ -93,32 +210,150 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state) {
 static struct argp argp = { options, parse_opt, args_doc, doc };
 
 
-/* 
- * The portal. 
+/*
+ * File name extensions of export formats, by PFISH_BOVESPA_HISTORY_FORMAT_*.
+ */
+
+static const char *format_extensions[] = { "csv", "raw", "arrow", "jsonl" };
+
+
+/*
+ * An exported stock of a combined stream.
+ */
+
+struct export_slot {
+
+	char *data;	// Export of the stock, NULL if it could not be exported.
+	size_t data_size;	// Octets in 'data'.
+	unsigned int done;	// Not zero when the stock was processed.
+
+};
+
+
+/*
+ * Work shared among threads.
+ */
+
+struct export_work {
+
+	const struct arguments *arguments;	// Arguments given in the command line.
+	const pfish_bovespa_stock_id_t *stocks;	// Stocks (or ISIN codes) to be exported.
+	size_t stocks_size;	// How many elements in stocks[].
+	size_t workers_size;	// How many threads work.
+	struct export_slot *slots;	// Exports not yet in the combined stream, by stock; NULL when exporting to files.
+	size_t window;	// How many stocks may be processed ahead of the combined stream.
+	size_t next;	// Next stock to be processed.
+	size_t emitted;	// Stocks already in the combined stream.
+	unsigned int emitting;	// Not zero while a thread writes to the combined stream.
+	size_t failures;	// How many stocks could not be exported.
+	pthread_mutex_t mutex;	// Protects all of the above that changes.
+	pthread_cond_t cond;	// Signaled when the combined stream advances.
+
+};
+
+struct export_worker {
+
+	struct export_work *work;	// Work shared among threads.
+	FILE *stream;	// Memory stream receiving exports of this thread.
+	char *stream_data;	// Contents of 'stream'.
+	size_t stream_data_size;	// Octets in 'stream_data'.
+	pfish_bovespa_history_writer_t *writer;	// History writer on 'stream'.
+
+};
+
+
+/*
+ * Retrieve and export the history of a stock.
+ *
+ * @param[in] arguments arguments given in the command line.
+ * @param[in] stock_id stock identification, or ISIN code.
+ * @param[in] writer history writer.
+ *
+ * @return 0 on success, negative on failure (including a stock that does not exist).
+ */
+
+int export_stock (const struct arguments *arguments, const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_history_writer_t *writer);
+
+
+/*
+ * Write an export of a stock to its own file in the output directory.
+ *
+ * @param[in] arguments arguments given in the command line.
+ * @param[in] stock_id stock identification, or ISIN code.
+ * @param[in] data export of the stock.
+ * @param[in] data_size octets in 'data'.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int export_file_write (const struct arguments *arguments, const pfish_bovespa_stock_id_t *stock_id, const char *data, size_t data_size);
+
+
+/*
+ * Exporting thread.
+ *
+ * @param arg (struct export_worker *).
+ */
+
+void *export_worker (void *arg);
+
+
+/*
+ * Run the exporting threads; this thread works too.
+ *
+ * @param[in] work work shared among threads.
+ * @param[in] workers one element per thread.
+ */
+
+void export_run (struct export_work *work, struct export_worker *workers);
+
+
+/*
+ * Append a stock identification to a list.
+ *
+ * @param[in,out] stocks dynamically allocated list of stocks.
+ * @param[in,out] stocks_size how many elements in the list.
+ * @param[in] name stock identification or ISIN code.
+ * @param[in] isin nonzero if name is an ISIN code.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int stocks_append (pfish_bovespa_stock_id_t **stocks, size_t *stocks_size, const char *name, unsigned int isin);
+
+
+/*
+ * The portal.
  */
 
 #define SUCCESS return (EXIT_SUCCESS)
 #define FAILURE return (EXIT_FAILURE)
 
-#define DATE_BUF_SIZE 16
-
 int main (int argc, char **argv) {
 
 	struct arguments arguments;	// Arguments given in the command line.
 
 	pfish_bovespa_stock_id_t stock_id;	// Stock identification.
-	pfish_bovespa_stock_history_t *stock_history;	// Stock trade history.
 
-	struct tm *trading_date;	// Time components of each trading date.
-	char date_buf[DATE_BUF_SIZE];	// Trading date string formatting buffer.
+	pfish_bovespa_history_writer_t *writer;	// Buffered export.
 
-	size_t i;	// General, short ranged indexer / counter.
+	pfish_bovespa_stock_id_t *stocks;	// Stocks to be exported, when more than one.
+	size_t stocks_size;
+	pfish_bovespa_stock_list_t *stock_list;	// All stocks of the database.
+	FILE *stocks_file;	// List of stocks to be exported.
+	char *line;	// Line of the list of stocks.
+	size_t line_size;
+	ssize_t line_length;
+	struct export_work work;	// Work shared among threads.
+	struct export_worker *workers;	// One element per thread.
+	size_t i;	// General, short ranged indexer.
 
 	/*
 	 * Begin.
 	 */
 
 	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	pfish_bovespa_log_level_from_env ();
 	DEBUG ("start.");
 
 	/*
@@ -126,75 +361,247 @@ int main (int argc, char **argv) {
 	 */
 
 	arguments.all = 0;
-	arguments.stock = NULL;
+	arguments.image = 0;
+	arguments.adjusted = 0;
+	arguments.period = PFISH_BOVESPA_VIEW_RAW;
+	arguments.isin = 0;
+	arguments.format = PFISH_BOVESPA_HISTORY_FORMAT_CSV;
+	arguments.fields = PFISH_BOVESPA_HISTORY_FIELDS_ALL;
+	arguments.fields_given = 0;
+	arguments.all_stocks = 0;
+	arguments.stocks_file = NULL;
+	arguments.output_dir = NULL;
+	if ((arguments.jobs = sysconf (_SC_NPROCESSORS_ONLN)) < 1) {
+
+		arguments.jobs = 1;
+
+	}
+	arguments.stocks = NULL;
+	arguments.stocks_size = 0;
+	arguments.stats = 0;
 	argp_parse (&argp, argc, argv, 0, 0, &arguments);
-	if (arguments.stock == NULL) {
 
-		CRIT ("missing stock identification.");
+	/*
+	 * From now on, log messages are written by a background thread.
+	 */
+
+	pfish_bovespa_log_start ();
+	if ((arguments.image != 0) && ((pfish_bovespa_image_attach ()) < 0)) {
+
+		CRIT ("cannot attach to the database image.");
 		FAILURE;
 
 	}
 
+	if ((arguments.stocks_size == 1) && (arguments.all_stocks == 0) && (arguments.stocks_file == NULL) && (arguments.output_dir == NULL)) {
+
+		/*
+		 * One stock, to the standard output.
+		 */
+
+		if ((strlen (arguments.stocks[0])) > ((arguments.isin != 0) ? PFISH_BOVESPA_CODISI_SIZE : PFISH_BOVESPA_CODNEG_SIZE) - 1) {
+
+			CRIT ("stock name is too big.");
+			FAILURE;
+
+		}
+		memset (stock_id.id, 0, PFISH_BOVESPA_CODNEG_SIZE);
+		strncpy (stock_id.id, arguments.stocks[0], PFISH_BOVESPA_CODNEG_SIZE - 1);
+		if ((pfish_bovespa_history_writer_alloc (stdout, arguments.format, arguments.fields, &writer)) < 0) {
+
+			CRIT ("cannot allocate history writer.");
+			FAILURE;
+
+		}
+		if (((pfish_bovespa_history_writer_begin (writer)) < 0) || ((export_stock (&arguments, &stock_id, writer)) < 0) || ((pfish_bovespa_history_writer_end (writer)) < 0)) {
+
+			FAILURE;
+
+		}
+		pfish_bovespa_history_writer_free (writer);
+		if (arguments.stats != 0) {
+
+			pfish_bovespa_metrics_print (stderr);
+
+		}
+		DEBUG ("end.");
+		SUCCESS;
+
+	}
+
 	/*
-	 * Retrieve stock history from the database.
+	 * Several stocks: gather them from a pinned snapshot.
 	 */
 
-	if ((strlen (arguments.stock)) > PFISH_BOVESPA_CODNEG_SIZE - 1) {
+	if ((arguments.image == 0) && ((pfish_bovespa_snapshot_pin ()) < 0)) {
 
-		CRIT ("stock name is too big.");
+		CRIT ("cannot pin a database snapshot.");
 		FAILURE;
 
 	}
-	strcpy (stock_id.id, arguments.stock);
-	if ((pfish_bovespa_stock_history_alloc (&stock_id, &stock_history)) < 0) {
+	stocks = NULL;
+	stocks_size = 0;
+	for ( i = 0; i < arguments.stocks_size; i++ ) {
+
+		if ((stocks_append (&stocks, &stocks_size, arguments.stocks[i], arguments.isin)) < 0) {
+
+			FAILURE;
+
+		}
+
+	}
+	if (arguments.stocks_file != NULL) {
+
+		if ((strcmp (arguments.stocks_file, "-")) == 0) {
+
+			stocks_file = stdin;
+
+		}
+		else if ((stocks_file = fopen (arguments.stocks_file, "r")) == NULL) {
+
+			ERRNO_ERR;
+			CRIT ("cannot open file '%s' in read mode.", arguments.stocks_file);
+			FAILURE;
+
+		}
+		line = NULL;
+		line_size = 0;
+		while ((line_length = getline (&line, &line_size, stocks_file)) >= 0) {
+
+			while ((line_length > 0) && ((line[line_length - 1] == '\n') || (line[line_length - 1] == '\r') || (line[line_length - 1] == ' '))) {
+
+				line[--line_length] = 0;
+
+			}
+			if ((line_length != 0) && ((stocks_append (&stocks, &stocks_size, line, arguments.isin)) < 0)) {
+
+				FAILURE;
+
+			}
+
+		}
+		if (ferror (stocks_file)) {
+
+			ERRNO_ERR;
+			CRIT ("cannot read file '%s'.", arguments.stocks_file);
+			FAILURE;
+
+		}
+		free (line);
+		if (stocks_file != stdin) {
+
+			fclose (stocks_file);
+
+		}
+
+	}
+	if (arguments.all_stocks != 0) {
+
+		if ((stock_list = pfish_bovespa_stock_list_alloc ()) == NULL) {
+
+			CRIT ("cannot retrieve stock list from database.");
+			FAILURE;
+
+		}
+		for ( i = 0; i < stock_list->stock_list_size; i++ ) {
+
+			if ((stocks_append (&stocks, &stocks_size, stock_list->stock_list[i].id, 0)) < 0) {
+
+				FAILURE;
 
-		CRIT ("cannot retrieve history of stock '%s' from database.", stock_id.id);
+			}
+
+		}
+		free (stock_list);
+
+	}
+
+	/*
+	 * Prepare the work.
+	 * The combined stream tells stocks apart by their identification, unless told otherwise.
+	 */
+
+	if ((arguments.output_dir == NULL) && (arguments.fields_given == 0)) {
+
+		arguments.fields |= PFISH_BOVESPA_HISTORY_FIELD_STOCK_ID;
+
+	}
+	work.arguments = &arguments;
+	work.stocks = stocks;
+	work.stocks_size = stocks_size;
+	work.workers_size = ((size_t) arguments.jobs < stocks_size) ? (size_t) arguments.jobs : stocks_size;
+	if (work.workers_size < 1) {
+
+		work.workers_size = 1;
+
+	}
+	work.slots = NULL;
+	work.window = 4 * work.workers_size;
+	work.next = 0;
+	work.emitted = 0;
+	work.emitting = 0;
+	work.failures = 0;
+	pthread_mutex_init (&(work.mutex), NULL);
+	pthread_cond_init (&(work.cond), NULL);
+	if ((arguments.output_dir == NULL) && ((work.slots = (struct export_slot *) calloc (stocks_size + 1, sizeof (struct export_slot))) == NULL)) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (stocks_size + 1) * sizeof (struct export_slot));
 		FAILURE;
 
 	}
-	if (stock_history == NULL) {
+	if ((workers = (struct export_worker *) calloc (work.workers_size, sizeof (struct export_worker))) == NULL) {
 
-		ERR ("stock '%s' does not exist in database.", stock_id.id);
+		ALERT ("cannot allocate %u bytes of heap space.", work.workers_size * sizeof (struct export_worker));
 		FAILURE;
 
+	}
+	for ( i = 0; i < work.workers_size; i++ ) {
+
+		workers[i].work = &work;
+		if ((workers[i].stream = open_memstream (&(workers[i].stream_data), &(workers[i].stream_data_size))) == NULL) {
+
+			ERRNO_ERR;
+			CRIT ("cannot open memory stream.");
+			FAILURE;
+
+		}
+		if ((pfish_bovespa_history_writer_alloc (workers[i].stream, arguments.format, arguments.fields, &(workers[i].writer))) < 0) {
+
+			CRIT ("cannot allocate history writer.");
+			FAILURE;
+
+		}
+
 	}
 
 	/*
-	 * Export stock history.
+	 * Export.
 	 */
 
-	for ( i = ((arguments.all != 0) ? 0 : stock_history->last_xplit); i < stock_history->daily_quotes_size; i++ ) {
-
-#define QUOTE stock_history->daily_quotes[i]
+	if (arguments.output_dir == NULL) {
 
-		if ((trading_date = gmtime (&(QUOTE.trading_date))) == NULL) {
+		if ((pfish_bovespa_history_writer_alloc (stdout, arguments.format, arguments.fields, &writer)) < 0) {
 
-			CRIT ("cannot understand trading date '%u' as a timestamp value.", QUOTE.trading_date);
+			CRIT ("cannot allocate history writer.");
 			FAILURE;
 
 		}
-		if ((strftime (date_buf, DATE_BUF_SIZE, "%F", trading_date)) == 0) {
+		if (((pfish_bovespa_history_writer_begin (writer)) < 0) || ((pfish_bovespa_history_writer_flush (writer)) < 0)) {
 
-			CRIT ("cannot build the string representation of the trading date.");
 			FAILURE;
 
 		}
-		printf (
-			"%s,%s,%u,%Lu,%Lu,%Lu,%Lu,%Lu,%u,%Lu,%Lu\n",
-			date_buf,
-			QUOTE.stock_spec,
-			QUOTE.price_factor,
-			QUOTE.opening_price,
-			QUOTE.closing_price,
-			QUOTE.minimum_price,
-			QUOTE.maximum_price,
-			QUOTE.average_price,
-			QUOTE.total_trades,
-			QUOTE.total_stocks,
-			QUOTE.total_volume
-			);
 
-#undef QUOTE
+	}
+	export_run (&work, workers);
+	if (arguments.output_dir == NULL) {
+
+		if ((pfish_bovespa_history_writer_end (writer)) < 0) {
+
+			FAILURE;
+
+		}
+		pfish_bovespa_history_writer_free (writer);
 
 	}
 
@@ -202,24 +609,362 @@ int main (int argc, char **argv) {
 	 * Resource releasing.
 	 */
 
-	if (pfish_bovespa_stock_history_free (stock_history)) {
+	for ( i = 0; i < work.workers_size; i++ ) {
 
-		CRIT ("cannot release stock history.");
-		FAILURE;
+		pfish_bovespa_history_writer_free (workers[i].writer);
+		fclose (workers[i].stream);
+		free (workers[i].stream_data);
 
 	}
+	free (workers);
+	free (work.slots);
+	free (stocks);
+	pthread_cond_destroy (&(work.cond));
+	pthread_mutex_destroy (&(work.mutex));
 
 	/*
 	 * End.
 	 */
 
+	if (work.failures != 0) {
+
+		ERR ("%u of %u stocks could not be exported.", work.failures, stocks_size);
+		FAILURE;
+
+	}
+	INFO ("%u stocks exported.", stocks_size);
+	if (arguments.stats != 0) {
+
+		pfish_bovespa_metrics_print (stderr);
+
+	}
 	DEBUG ("end.");
 	SUCCESS;
 
 }
 
-#undef DATE_BUF_SIZE
+#undef FAILURE
+#undef SUCCESS
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int export_stock (const struct arguments *arguments, const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_history_writer_t *writer) {
+
+	pfish_bovespa_stock_history_t *stock_history;	// Stock trade history.
+
+	/*
+	 * Retrieve stock history from the database.
+	 */
+
+	if (arguments->isin != 0) {
+
+		if ((pfish_bovespa_stitched_history_alloc (stock_id->id, ((arguments->adjusted != 0) ? PFISH_BOVESPA_VIEW_ADJUSTED : PFISH_BOVESPA_VIEW_RAW) | arguments->period, &stock_history)) < 0) {
+
+			CRIT ("cannot retrieve history of ISIN code '%s' from database.", stock_id->id);
+			FAILURE;
+
+		}
+		if (stock_history == NULL) {
+
+			ERR ("ISIN code '%s' does not exist in database.", stock_id->id);
+			FAILURE;
+
+		}
+
+	}
+	else if ((pfish_bovespa_stock_history_alloc_view (stock_id, ((arguments->adjusted != 0) ? PFISH_BOVESPA_VIEW_ADJUSTED : PFISH_BOVESPA_VIEW_RAW) | arguments->period, &stock_history)) < 0) {
+
+		CRIT ("cannot retrieve history of stock '%s' from database.", stock_id->id);
+		FAILURE;
+
+	}
+	if (stock_history == NULL) {
+
+		ERR ("stock '%s' does not exist in database.", stock_id->id);
+		FAILURE;
+
+	}
+
+	/*
+	 * Export stock history.
+	 */
+
+	if ((pfish_bovespa_history_writer_write (writer, stock_id, stock_history, ((arguments->all != 0) || (arguments->adjusted != 0)) ? 0 : stock_history->last_xplit)) < 0) {
+
+		CRIT ("cannot export history of '%s'.", stock_id->id);
+		if (arguments->isin != 0) {
+
+			free (stock_history);
+
+		}
+		else {
+
+			pfish_bovespa_stock_history_free (stock_history);
+
+		}
+		FAILURE;
+
+	}
+
+	/*
+	 * Resource releasing.
+	 */
+
+	if (arguments->isin != 0) {
+
+		free (stock_history);
+
+	}
+	else if (pfish_bovespa_stock_history_free (stock_history)) {
+
+		CRIT ("cannot release stock history.");
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+int export_file_write (const struct arguments *arguments, const pfish_bovespa_stock_id_t *stock_id, const char *data, size_t data_size) {
+
+	char pathname[PATH_MAX];	// Pathname of the export file.
+	int file_des;	// Export file.
+	size_t done;	// Octets written so far.
+	ssize_t count;	// Octets written by each write().
+
+	if ((snprintf (pathname, PATH_MAX, "%s/%s.%s", arguments->output_dir, stock_id->id, format_extensions[arguments->format])) >= PATH_MAX) {
+
+		CRIT ("pathname of export of '%s' is too big.", stock_id->id);
+		FAILURE;
+
+	}
+	if ((file_des = open (pathname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s' in write mode.", pathname);
+		FAILURE;
+
+	}
+	for ( done = 0; done < data_size; done += count ) {
+
+		if ((count = write (file_des, data + done, data_size - done)) < 0) {
+
+			ERRNO_ERR;
+			CRIT ("cannot write to file '%s'.", pathname);
+			close (file_des);
+			FAILURE;
+
+		}
+
+	}
+	if ((close (file_des)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot close file '%s'.", pathname);
+		FAILURE;
+
+	}
+	SUCCESS;
+
+}
+
+
+int stocks_append (pfish_bovespa_stock_id_t **stocks, size_t *stocks_size, const char *name, unsigned int isin) {
+
+	pfish_bovespa_stock_id_t *aux_stocks;
+
+	if ((strlen (name)) > ((isin != 0) ? PFISH_BOVESPA_CODISI_SIZE : PFISH_BOVESPA_CODNEG_SIZE) - 1) {
+
+		CRIT ("stock name '%s' is too big.", name);
+		FAILURE;
+
+	}
+	if ((*stocks_size & (*stocks_size - 1)) == 0) {
+
+		// Grow to powers of two.
+
+		if ((aux_stocks = (pfish_bovespa_stock_id_t *) realloc (*stocks, ((*stocks_size != 0) ? (2 * *stocks_size) : 1) * sizeof (pfish_bovespa_stock_id_t))) == NULL) {
+
+			ALERT ("cannot allocate %u bytes of heap space.", ((*stocks_size != 0) ? (2 * *stocks_size) : 1) * sizeof (pfish_bovespa_stock_id_t));
+			FAILURE;
+
+		}
+		*stocks = aux_stocks;
+
+	}
+	memset ((*stocks)[*stocks_size].id, 0, PFISH_BOVESPA_CODNEG_SIZE);
+	strncpy ((*stocks)[*stocks_size].id, name, PFISH_BOVESPA_CODNEG_SIZE - 1);
+	(*stocks_size)++;
+	SUCCESS;
+
+}
 
 #undef FAILURE
 #undef SUCCESS
 
+
+void export_run (struct export_work *work, struct export_worker *workers) {
+
+	pthread_t *threads;	// Helper threads.
+	size_t threads_size;	// How many helper threads were started.
+	size_t i;
+
+	threads_size = work->workers_size - 1;
+	if ((threads = (pthread_t *) malloc ((threads_size + 1) * sizeof (pthread_t))) == NULL) {
+
+		WARNING ("cannot allocate %u bytes of heap space; going on with 1 thread.", (threads_size + 1) * sizeof (pthread_t));
+		threads_size = 0;
+
+	}
+	for ( i = 0; i < threads_size; i++ ) {
+
+		if ((pthread_create (&(threads[i]), NULL, export_worker, &(workers[i + 1]))) != 0) {
+
+			WARNING ("cannot start thread; going on with %u threads.", i + 1);
+			threads_size = i;
+			break;
+
+		}
+
+	}
+	export_worker (&(workers[0]));
+	for ( i = 0; i < threads_size; i++ ) {
+
+		pthread_join (threads[i], NULL);
+
+	}
+	free (threads);
+
+}
+
+
+void *export_worker (void *arg) {
+
+	struct export_worker *worker = (struct export_worker *) arg;
+	struct export_work *work = worker->work;
+	const struct arguments *arguments = work->arguments;
+	struct export_slot slot;	// Export of the stock being processed.
+	size_t i;	// Stock being processed.
+
+	while (1) {
+
+		/*
+		 * Take the next stock, without getting too far ahead of the combined stream.
+		 */
+
+		pthread_mutex_lock (&(work->mutex));
+		while ((work->slots != NULL) && (work->next < work->stocks_size) && (work->next >= (work->emitted + work->window))) {
+
+			pthread_cond_wait (&(work->cond), &(work->mutex));
+
+		}
+		if (work->next >= work->stocks_size) {
+
+			pthread_mutex_unlock (&(work->mutex));
+			break;
+
+		}
+		i = work->next++;
+		pthread_mutex_unlock (&(work->mutex));
+
+		/*
+		 * Format it in memory.
+		 */
+
+		slot.data = NULL;
+		slot.data_size = 0;
+		slot.done = 1;
+		if ((fseeko (worker->stream, 0, SEEK_SET)) == 0) {
+
+			if (((arguments->output_dir == NULL) || ((pfish_bovespa_history_writer_begin (worker->writer)) == 0)) && ((export_stock (arguments, &(work->stocks[i]), worker->writer)) == 0) && (((arguments->output_dir == NULL) ? pfish_bovespa_history_writer_flush (worker->writer) : pfish_bovespa_history_writer_end (worker->writer)) == 0)) {
+
+				slot.data = worker->stream_data;
+				slot.data_size = worker->stream_data_size;
+
+			}
+			else {
+
+				// Drop whatever was formatted.
+
+				pfish_bovespa_history_writer_flush (worker->writer);
+
+			}
+
+		}
+		else {
+
+			ERRNO_ERR;
+			CRIT ("cannot rewind memory stream.");
+
+		}
+
+		/*
+		 * Deliver it: to its own file, or to the combined stream in order.
+		 */
+
+		if (arguments->output_dir != NULL) {
+
+			if ((slot.data == NULL) || ((export_file_write (arguments, &(work->stocks[i]), slot.data, slot.data_size)) < 0)) {
+
+				__sync_fetch_and_add (&(work->failures), 1);
+
+			}
+			continue;
+
+		}
+		if (slot.data != NULL) {
+
+			if ((slot.data = (char *) malloc (slot.data_size + 1)) == NULL) {
+
+				ALERT ("cannot allocate %u bytes of heap space.", slot.data_size + 1);
+
+			}
+			else {
+
+				memcpy (slot.data, worker->stream_data, slot.data_size);
+
+			}
+
+		}
+		pthread_mutex_lock (&(work->mutex));
+		work->slots[i] = slot;
+		if (work->emitting == 0) {
+
+			// Write every export that is next in order; others write theirs meanwhile.
+
+			work->emitting = 1;
+			while (work->slots[work->emitted].done != 0) {
+
+				slot = work->slots[work->emitted];
+				pthread_mutex_unlock (&(work->mutex));
+				if (slot.data == NULL) {
+
+					__sync_fetch_and_add (&(work->failures), 1);
+
+				}
+				else if ((fwrite (slot.data, slot.data_size, 1, stdout)) != 1) {
+
+					ERRNO_ERR;
+					CRIT ("cannot write history export.");
+					__sync_fetch_and_add (&(work->failures), 1);
+
+				}
+				free (slot.data);
+				pthread_mutex_lock (&(work->mutex));
+				work->slots[work->emitted].data = NULL;
+				work->emitted++;
+				pthread_cond_broadcast (&(work->cond));
+
+			}
+			work->emitting = 0;
+
+		}
+		pthread_mutex_unlock (&(work->mutex));
+
+	}
+	return (NULL);
+
+}
@@ -16,6 +16,8 @@
 
 #include <pilot_fish/bovespa.h>
 
+#include "async_log.h"
+
 
 /*
  * Command line argument parsing.
@@ -24,9 +26,70 @@
 const char *argp_program_version = PACKAGE_VERSION;
 const char *argp_program_bug_address = PACKAGE_BUGREPORT;
 
-static char doc[] = "pfish_bovespa_stock_list -- list of stocks in the pilot_fish bovespa database.\vThis routine exports a list of stock identifiers through the standard output, one stock per line.\n";
+static char doc[] = "pfish_bovespa_stock_list -- list of stocks in the pilot_fish bovespa database.\vThis routine exports a list of stock identifiers through the standard output, one stock per line.\n\nWith --prefix or --search, only stocks whose identifier or company short name starts with or contains TEXT (ignoring case) are listed, each one followed by its company short name.\n";
+
+static struct argp_option options[] = {
+
+	{"image", 'm', 0,  0, "read from the shared memory database image (see pfish_bovespa_image_load).", 0 },
+	{"prefix", 'p', "TEXT",  0, "list stocks whose identifier or company short name starts with TEXT.", 0 },
+	{"search", 's', "TEXT",  0, "list stocks whose identifier or company short name contains TEXT.", 0 },
+	{"stats", 'S', 0,  0, "print runtime metrics of the library to the standard error on exit.", 0 },
+	{ 0 }
+
+};
+
+struct arguments {
+
+	unsigned int image;
+	unsigned int mode;
+	char *text;
+	unsigned int stats;
+
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state) {
+
+	struct arguments *arguments = state->input;
+
+	switch (key) {
+
+		case 'm':
+
+			arguments->image = 1;
+			break;
+
+		case 'p':
 
-static struct argp argp = { 0, 0, 0, doc };
+			arguments->mode = PFISH_BOVESPA_SEARCH_PREFIX;
+			arguments->text = arg;
+			break;
+
+		case 's':
+
+			arguments->mode = PFISH_BOVESPA_SEARCH_SUBSTRING;
+			arguments->text = arg;
+			break;
+
+		case 'S':
+
+			arguments->stats = 1;
+			break;
+
+		case ARGP_KEY_ARG:
+
+			argp_usage (state);
+			break;
+
+		default:
+
+			return (ARGP_ERR_UNKNOWN);
+
+	};
+	return (0);
+
+};
+
+static struct argp argp = { options, parse_opt, NULL, doc };
 
 
 /*
@@ -38,7 +101,9 @@ static struct argp argp = { 0, 0, 0, doc };
 
 int main (int argc, char **argv) {
 
+	struct arguments arguments;	// Arguments given in the command line.
 	pfish_bovespa_stock_list_t *stocks;	// Stock list.
+	pfish_bovespa_name_list_t *names;	// Stocks found by name.
 	size_t i;	// General, short ranged indexer.
 
 	/*
@@ -46,18 +111,64 @@ int main (int argc, char **argv) {
 	 */
 
 	pfish_syslog_init (SYSLOG_FACILITY, LOG_PERROR | LOG_PID);
+	pfish_bovespa_log_level_from_env ();
 	DEBUG ("start.");
 
 	/*
 	 * Parse command line arguments.
 	 */
 
-	argp_parse (&argp, argc, argv, 0, 0, 0);
+	arguments.image = 0;
+	arguments.mode = PFISH_BOVESPA_SEARCH_PREFIX;
+	arguments.text = NULL;
+	arguments.stats = 0;
+	argp_parse (&argp, argc, argv, 0, 0, &arguments);
+
+	/*
+	 * From now on, log messages are written by a background thread.
+	 */
+
+	pfish_bovespa_log_start ();
+
+	/*
+	 * Search stocks by name, if asked to.
+	 */
+
+	if (arguments.text != NULL) {
+
+		if ((pfish_bovespa_name_search (arguments.text, arguments.mode, &names)) < 0) {
+
+			CRIT ("cannot search stocks by name.");
+			FAILURE;
+
+		}
+		for ( i = 0; i < names->name_list_size; i++ ) {
+
+			printf ("%s,%s\n", names->name_list[i].stock_id.id, names->name_list[i].name);
+
+		}
+		free (names);
+		if (arguments.stats != 0) {
+
+			pfish_bovespa_metrics_print (stderr);
+
+		}
+		DEBUG ("end.");
+		SUCCESS;
+
+	}
 
 	/*
 	 * Retrieve the stock list from database.
 	 */
 
+	if ((arguments.image != 0) && ((pfish_bovespa_image_attach ()) < 0)) {
+
+		CRIT ("cannot attach to the database image.");
+		FAILURE;
+
+	}
+
 	if ((stocks = pfish_bovespa_stock_list_alloc ()) == NULL) {
 
 		CRIT ("canot retrieve stock list from database.");
@@ -85,6 +196,11 @@ int main (int argc, char **argv) {
 	 * That was easy! :-)
 	 */
 
+	if (arguments.stats != 0) {
+
+		pfish_bovespa_metrics_print (stderr);
+
+	}
 	DEBUG ("end.");
 	SUCCESS;
 
@@ -0,0 +1,868 @@
+/*
+ * ticker_dictionary.c
+ * Dictionary of dense stock tickers.
+ *
+ * Tickers are assigned by the importer in order of first appearance, so they never change
+ * until the database is reinitialized. The dictionary file carries a minimal perfect hash
+ * function built by hash and displace: stock ids are spread into buckets, and buckets are
+ * placed from the biggest one, each with the first displacement that sends all of its
+ * stock ids to free slots.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+#include <pilot_fish/bovespa.h>
+
+#include "crc32c.h"
+#include "revision_marker.h"
+#include "ticker_dictionary.h"
+#include "snapshot.h"
+#include "async_log.h"
+
+
+/*
+ * Parts of a ticker dictionary, given its header.
+ */
+
+#define DISPLACEMENTS(HEADER) ((uint32_t *) ((HEADER) + 1))
+#define SLOTS(HEADER) (DISPLACEMENTS (HEADER) + (HEADER)->buckets_size)
+#define TICKERS(HEADER) ((pfish_bovespa_stock_id_t *) (SLOTS (HEADER) + (HEADER)->tickers_size))
+
+
+/*
+ * Bound of displacements tried for a bucket before giving up with the current number of buckets.
+ */
+
+#define MAX_DISPLACEMENT 0x100000
+
+
+struct ticker_table {
+
+	pfish_bovespa_stock_id_t *stocks;	// Stock id of each ticker.
+	size_t stocks_size;	// How many tickers.
+	size_t stocks_room;	// How many elements fit in 'stocks'.
+	size_t loaded_size;	// How many tickers came from the database dictionary.
+	pfish_bovespa_ticker_t *slots;	// Open addressing hash table of tickers; PFISH_BOVESPA_TICKER_NONE if empty.
+	size_t slots_size;	// How many elements in 'slots'; a power of two, more than twice 'stocks_size'.
+
+};
+
+
+/*
+ * Mapped ticker dictionary, kept between lookups.
+ * Tickers are never reassigned, so the mapping is checked against the file only on a miss.
+ */
+
+static struct {
+
+	ticker_dictionary_header_t *header;	// Mapped ticker dictionary, NULL if not mapped.
+	struct stat dictionary_stat;	// Status of the ticker dictionary file at mapping time; mapping length is dictionary_stat.st_size.
+	pthread_mutex_t mutex;	// Protects all of the above.
+
+} mapping = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+
+uint32_t pfish_bovespa_ticker_hash (const char *id, uint32_t seed) {
+
+	uint64_t hash;
+	size_t i;
+
+	hash = 14695981039346656037ULL ^ ((uint64_t) seed * 0x9E3779B97F4A7C15ULL);
+	for ( i = 0; (i < PFISH_BOVESPA_CODNEG_SIZE) && (id[i] != 0); i++ ) {
+
+		hash = (hash ^ (unsigned char) id[i]) * 1099511628211ULL;
+
+	}
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= hash >> 33;
+	return ((uint32_t) hash);
+
+}
+
+
+/*
+ * Look up a stock id in a ticker dictionary.
+ *
+ * @return ticker, PFISH_BOVESPA_TICKER_NONE if not found.
+ */
+
+static pfish_bovespa_ticker_t dictionary_lookup (const ticker_dictionary_header_t *header, const char *id) {
+
+	uint32_t bucket;
+	pfish_bovespa_ticker_t ticker;
+
+	if (header->tickers_size == 0) {
+
+		return (PFISH_BOVESPA_TICKER_NONE);
+
+	}
+	bucket = pfish_bovespa_ticker_hash (id, 0) % header->buckets_size;
+	ticker = SLOTS (header)[pfish_bovespa_ticker_hash (id, DISPLACEMENTS (header)[bucket]) % header->tickers_size];
+	if ((ticker >= header->tickers_size) || ((strncmp (TICKERS (header)[ticker].id, id, PFISH_BOVESPA_CODNEG_SIZE)) != 0)) {
+
+		return (PFISH_BOVESPA_TICKER_NONE);
+
+	}
+	return (ticker);
+
+}
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int pfish_bovespa_ticker_dictionary_verify (const char *name, const ticker_dictionary_header_t *header, size_t file_size, unsigned int deep) {
+
+	uint32_t i;
+
+	if ((file_size < sizeof (ticker_dictionary_header_t)) || (header->magic != TICKER_DICTIONARY_MAGIC)) {
+
+		ERR ("ticker dictionary '%s' has no valid header.", name);
+		FAILURE;
+
+	}
+	if ((header->buckets_size == 0) || (TICKER_DICTIONARY_SIZE (header) != file_size)) {
+
+		ERR ("ticker dictionary '%s' size (%lu octets) disagrees with its header.", name, (unsigned long) file_size);
+		FAILURE;
+
+	}
+	if (deep == 0) {
+
+		SUCCESS;
+
+	}
+	if ((pfish_bovespa_crc32c (0, header + 1, file_size - sizeof (ticker_dictionary_header_t))) != header->checksum) {
+
+		ERR ("ticker dictionary '%s' checksum mismatch.", name);
+		FAILURE;
+
+	}
+	for ( i = 0; i < header->tickers_size; i++ ) {
+
+		if ((dictionary_lookup (header, TICKERS (header)[i].id)) != i) {
+
+			ERR ("ticker dictionary '%s' does not find stock '%s'.", name, TICKERS (header)[i].id);
+			FAILURE;
+
+		}
+
+	}
+	SUCCESS;
+
+}
+
+
+/*
+ * Insert a ticker in the hash table of a ticker table; there must be room.
+ */
+
+static void table_insert (ticker_table_t *table, pfish_bovespa_ticker_t ticker) {
+
+	size_t slot;
+
+	for ( slot = pfish_bovespa_ticker_hash (table->stocks[ticker].id, 0) & (table->slots_size - 1); table->slots[slot] != PFISH_BOVESPA_TICKER_NONE; slot = (slot + 1) & (table->slots_size - 1) );
+	table->slots[slot] = ticker;
+
+}
+
+
+/*
+ * Make room for one more ticker in a ticker table.
+ */
+
+static int table_grow (ticker_table_t *table) {
+
+	void *aux_voidp;
+	size_t i;
+
+	if (table->stocks_size == table->stocks_room) {
+
+		table->stocks_room = (table->stocks_room != 0) ? (2 * table->stocks_room) : 0x400;
+		if ((aux_voidp = realloc (table->stocks, table->stocks_room * sizeof (pfish_bovespa_stock_id_t))) == NULL) {
+
+			ALERT ("cannot allocate %u bytes of heap space.", table->stocks_room * sizeof (pfish_bovespa_stock_id_t));
+			FAILURE;
+
+		}
+		table->stocks = (pfish_bovespa_stock_id_t *) aux_voidp;
+
+	}
+	if ((2 * (table->stocks_size + 1)) >= table->slots_size) {
+
+		table->slots_size = (table->slots_size != 0) ? (2 * table->slots_size) : 0x1000;
+		free (table->slots);
+		if ((table->slots = (pfish_bovespa_ticker_t *) malloc (table->slots_size * sizeof (pfish_bovespa_ticker_t))) == NULL) {
+
+			ALERT ("cannot allocate %u bytes of heap space.", table->slots_size * sizeof (pfish_bovespa_ticker_t));
+			FAILURE;
+
+		}
+		memset (table->slots, 0xFF, table->slots_size * sizeof (pfish_bovespa_ticker_t));
+		for ( i = 0; i < table->stocks_size; i++ ) {
+
+			table_insert (table, i);
+
+		}
+
+	}
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_ticker_table_alloc (ticker_table_t **answer) {
+
+	ticker_table_t *table;	// The answer.
+	FILE *dictionary_file;	// Stream to the dictionary file.
+	struct stat dictionary_stat;	// Status of the dictionary file.
+	ticker_dictionary_header_t *buffer;	// Whole dictionary file contents.
+	pfish_bovespa_stock_list_t *stocks;	// Stocks of the database, if there is no dictionary.
+	pfish_bovespa_ticker_t ticker;	// Assigned ticker.
+	size_t i;	// Short term generic counter.
+
+	if ((table = (ticker_table_t *) calloc (1, sizeof (ticker_table_t))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", sizeof (ticker_table_t));
+		FAILURE;
+
+	}
+
+#undef FAILURE
+#define FAILURE \
+	pfish_bovespa_ticker_table_free (table); \
+	return (-1)
+
+	if ((dictionary_file = fopen (TICKER_DICTIONARY_FILE, "r")) == NULL) {
+
+		if (errno != ENOENT) {
+
+			ERRNO_ERR;
+			CRIT ("cannot open file '%s' in read mode.", TICKER_DICTIONARY_FILE);
+			FAILURE;
+
+		}
+
+		/*
+		 * No dictionary yet; assign tickers to the stocks already in the database.
+		 */
+
+		if ((stocks = pfish_bovespa_stock_list_alloc ()) == NULL) {
+
+			CRIT ("cannot retrieve stock list from database.");
+			FAILURE;
+
+		}
+		for ( i = 0; i < stocks->stock_list_size; i++ ) {
+
+			if ((pfish_bovespa_ticker_table_intern (table, stocks->stock_list[i].id, &ticker)) < 0) {
+
+				free (stocks);
+				FAILURE;
+
+			}
+
+		}
+		free (stocks);
+		*answer = table;
+		SUCCESS;
+
+	}
+
+	/*
+	 * Read and verify the dictionary.
+	 */
+
+	if ((fstat (fileno (dictionary_file), &dictionary_stat)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot stat file '%s'.", TICKER_DICTIONARY_FILE);
+		fclose (dictionary_file);
+		FAILURE;
+
+	}
+	if ((buffer = (ticker_dictionary_header_t *) malloc (dictionary_stat.st_size + 1)) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", dictionary_stat.st_size + 1);
+		fclose (dictionary_file);
+		FAILURE;
+
+	}
+
+#define FREE \
+	free (buffer); \
+	fclose (dictionary_file)
+
+	if ((dictionary_stat.st_size != 0) && ((fread (buffer, dictionary_stat.st_size, 1, dictionary_file)) != 1)) {
+
+		ERR ("ticker dictionary '%s' is truncated.", TICKER_DICTIONARY_FILE);
+		FREE;
+		FAILURE;
+
+	}
+	if ((pfish_bovespa_ticker_dictionary_verify (TICKER_DICTIONARY_FILE, buffer, dictionary_stat.st_size, 1)) < 0) {
+
+		CRIT ("ticker dictionary '%s' is corrupt; please run pfish_bovespa_fsck.", TICKER_DICTIONARY_FILE);
+		FREE;
+		FAILURE;
+
+	}
+	for ( i = 0; i < buffer->tickers_size; i++ ) {
+
+		if ((pfish_bovespa_ticker_table_intern (table, TICKERS (buffer)[i].id, &ticker)) < 0) {
+
+			FREE;
+			FAILURE;
+
+		}
+
+	}
+	table->loaded_size = table->stocks_size;
+	FREE;
+
+#undef FREE
+#undef FAILURE
+#define FAILURE return (-1)
+
+	*answer = table;
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_ticker_table_intern (ticker_table_t *table, const char *id, pfish_bovespa_ticker_t *answer) {
+
+	size_t slot;
+
+	if (table->slots_size != 0) {
+
+		for ( slot = pfish_bovespa_ticker_hash (id, 0) & (table->slots_size - 1); table->slots[slot] != PFISH_BOVESPA_TICKER_NONE; slot = (slot + 1) & (table->slots_size - 1) ) {
+
+			if ((strncmp (table->stocks[table->slots[slot]].id, id, PFISH_BOVESPA_CODNEG_SIZE)) == 0) {
+
+				*answer = table->slots[slot];
+				SUCCESS;
+
+			}
+
+		}
+
+	}
+	if (table->stocks_size == PFISH_BOVESPA_TICKER_NONE) {
+
+		ALERT ("too many tickers.");
+		FAILURE;
+
+	}
+	if ((table_grow (table)) < 0) {
+
+		FAILURE;
+
+	}
+	memset (&(table->stocks[table->stocks_size]), 0, sizeof (pfish_bovespa_stock_id_t));
+	strncpy (table->stocks[table->stocks_size].id, id, PFISH_BOVESPA_CODNEG_SIZE - 1);
+	table_insert (table, table->stocks_size);
+	*answer = table->stocks_size++;
+	SUCCESS;
+
+}
+
+
+const pfish_bovespa_stock_id_t *pfish_bovespa_ticker_table_stock (const ticker_table_t *table, pfish_bovespa_ticker_t ticker) {
+
+	return (&(table->stocks[ticker]));
+
+}
+
+
+size_t pfish_bovespa_ticker_table_size (const ticker_table_t *table) {
+
+	return (table->stocks_size);
+
+}
+
+
+/*
+ * A ticker with its stock id, for ranking.
+ */
+
+struct ranked_ticker {
+
+	pfish_bovespa_stock_id_t stock_id;
+	pfish_bovespa_ticker_t ticker;
+
+};
+
+
+static int compare_ranked_tickers (const void *a, const void *b) {
+
+	return (strncmp (((const struct ranked_ticker *) a)->stock_id.id, ((const struct ranked_ticker *) b)->stock_id.id, PFISH_BOVESPA_CODNEG_SIZE));
+
+}
+
+
+int pfish_bovespa_ticker_table_ranks (const ticker_table_t *table, uint32_t **answer) {
+
+	struct ranked_ticker *ranked;
+	size_t i;
+
+	if ((ranked = (struct ranked_ticker *) malloc ((table->stocks_size + 1) * sizeof (struct ranked_ticker))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (table->stocks_size + 1) * sizeof (struct ranked_ticker));
+		FAILURE;
+
+	}
+	if ((*answer = (uint32_t *) malloc ((table->stocks_size + 1) * sizeof (uint32_t))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (table->stocks_size + 1) * sizeof (uint32_t));
+		free (ranked);
+		FAILURE;
+
+	}
+	for ( i = 0; i < table->stocks_size; i++ ) {
+
+		memcpy (&(ranked[i].stock_id), &(table->stocks[i]), sizeof (pfish_bovespa_stock_id_t));
+		ranked[i].ticker = i;
+
+	}
+	qsort (ranked, table->stocks_size, sizeof (struct ranked_ticker), compare_ranked_tickers);
+	for ( i = 0; i < table->stocks_size; i++ ) {
+
+		(*answer)[ranked[i].ticker] = i;
+
+	}
+	free (ranked);
+	SUCCESS;
+
+}
+
+
+/*
+ * Build a minimal perfect hash function over the stock ids of a ticker dictionary.
+ *
+ * @param[in,out] header ticker dictionary with its tickers filled; displacements and slots are filled.
+ *
+ * @return 0 on success, positive if some bucket could not be placed, negative on failure.
+ */
+
+static int dictionary_hash_build (ticker_dictionary_header_t *header) {
+
+	uint32_t *buckets;	// Bucket of each ticker.
+	uint32_t *bucket_first;	// Index of 'members' of the first ticker of each bucket (one more element).
+	uint32_t *members;	// Tickers, grouped by bucket.
+	uint32_t *order;	// Buckets, biggest first.
+	unsigned char *taken;	// Nonzero for each slot taken.
+	uint32_t *candidates;	// Slots of the members of the bucket being placed.
+	uint32_t bucket, size, largest;	// Bucket being placed, its size and size of the largest bucket.
+	uint32_t displacement;	// Displacement being tried.
+	uint32_t i, j, k;	// Short term generic counters.
+	int rcode;	// Result of placements.
+
+	if (header->tickers_size == 0) {
+
+		DISPLACEMENTS (header)[0] = 0;
+		SUCCESS;
+
+	}
+	buckets = (uint32_t *) malloc (header->tickers_size * sizeof (uint32_t));
+	bucket_first = (uint32_t *) calloc (header->buckets_size + 1, sizeof (uint32_t));
+	members = (uint32_t *) malloc (header->tickers_size * sizeof (uint32_t));
+	order = (uint32_t *) malloc (header->buckets_size * sizeof (uint32_t));
+	taken = (unsigned char *) calloc (header->tickers_size, 1);
+	candidates = (uint32_t *) malloc (header->tickers_size * sizeof (uint32_t));
+
+#define FREE \
+	free (buckets); \
+	free (bucket_first); \
+	free (members); \
+	free (order); \
+	free (taken); \
+	free (candidates)
+
+	if ((buckets == NULL) || (bucket_first == NULL) || (members == NULL) || (order == NULL) || (taken == NULL) || (candidates == NULL)) {
+
+		ALERT ("cannot allocate heap space for %u tickers.", header->tickers_size);
+		FREE;
+		FAILURE;
+
+	}
+
+	/*
+	 * Group tickers by bucket (counting sort), then order buckets by size (counting sort again, descending).
+	 */
+
+	for ( i = 0; i < header->tickers_size; i++ ) {
+
+		buckets[i] = pfish_bovespa_ticker_hash (TICKERS (header)[i].id, 0) % header->buckets_size;
+		bucket_first[buckets[i] + 1]++;
+
+	}
+	largest = 0;
+	for ( i = 0; i < header->buckets_size; i++ ) {
+
+		if (bucket_first[i + 1] > largest) {
+
+			largest = bucket_first[i + 1];
+
+		}
+		bucket_first[i + 1] += bucket_first[i];
+
+	}
+	for ( i = 0; i < header->tickers_size; i++ ) {
+
+		members[bucket_first[buckets[i]]++] = i;
+
+	}
+	for ( i = header->buckets_size; i > 0; i-- ) {
+
+		bucket_first[i] = bucket_first[i - 1];
+
+	}
+	bucket_first[0] = 0;
+	k = 0;
+	for ( size = largest; size > 0; size-- ) {
+
+		for ( i = 0; i < header->buckets_size; i++ ) {
+
+			if ((bucket_first[i + 1] - bucket_first[i]) == size) {
+
+				order[k++] = i;
+
+			}
+
+		}
+
+	}
+
+	/*
+	 * Place buckets; empty buckets keep displacement 0.
+	 */
+
+	memset (DISPLACEMENTS (header), 0, header->buckets_size * sizeof (uint32_t));
+	rcode = 0;
+	for ( i = 0; (i < k) && (rcode == 0); i++ ) {
+
+		bucket = order[i];
+		size = bucket_first[bucket + 1] - bucket_first[bucket];
+		for ( displacement = 1; displacement < MAX_DISPLACEMENT; displacement++ ) {
+
+			for ( j = 0; j < size; j++ ) {
+
+				candidates[j] = pfish_bovespa_ticker_hash (TICKERS (header)[members[bucket_first[bucket] + j]].id, displacement) % header->tickers_size;
+				if (taken[candidates[j]] != 0) {
+
+					break;
+
+				}
+				taken[candidates[j]] = 1;
+
+			}
+			if (j == size) {
+
+				break;
+
+			}
+			while (j > 0) {
+
+				taken[candidates[--j]] = 0;
+
+			}
+
+		}
+		if (displacement == MAX_DISPLACEMENT) {
+
+			rcode = 1;
+			break;
+
+		}
+		DISPLACEMENTS (header)[bucket] = displacement;
+		for ( j = 0; j < size; j++ ) {
+
+			SLOTS (header)[candidates[j]] = members[bucket_first[bucket] + j];
+
+		}
+
+	}
+	FREE;
+	return (rcode);
+
+#undef FREE
+
+}
+
+
+int pfish_bovespa_ticker_table_write (const ticker_table_t *table, const char *pathname) {
+
+	ticker_dictionary_header_t header;	// Sizes of the dictionary.
+	ticker_dictionary_header_t *buffer;	// Whole file contents.
+	size_t file_size;	// Octets of the whole file.
+	FILE *dictionary_file;	// Stream to the file.
+	struct stat dictionary_stat;	// Status of the database dictionary.
+	int rcode;	// Result of building the hash function.
+
+	if ((table->loaded_size == table->stocks_size) && ((stat (TICKER_DICTIONARY_FILE, &dictionary_stat)) == 0)) {
+
+		return (1);
+
+	}
+
+	/*
+	 * Build the hash function, with more buckets if some bucket cannot be placed.
+	 */
+
+	memset (&header, 0, sizeof (ticker_dictionary_header_t));
+	header.magic = TICKER_DICTIONARY_MAGIC;
+	header.tickers_size = table->stocks_size;
+	buffer = NULL;
+	for ( header.buckets_size = (table->stocks_size / 4) + 1; ; header.buckets_size *= 2 ) {
+
+		file_size = TICKER_DICTIONARY_SIZE (&header);
+		free (buffer);
+		if ((buffer = (ticker_dictionary_header_t *) malloc (file_size)) == NULL) {
+
+			ALERT ("cannot allocate %u bytes of heap space.", file_size);
+			FAILURE;
+
+		}
+		memcpy (buffer, &header, sizeof (ticker_dictionary_header_t));
+		memcpy (TICKERS (buffer), table->stocks, table->stocks_size * sizeof (pfish_bovespa_stock_id_t));
+		if ((rcode = dictionary_hash_build (buffer)) <= 0) {
+
+			break;
+
+		}
+		DEBUG ("cannot place all buckets among %u; trying again.", header.buckets_size);
+
+	}
+
+#undef FAILURE
+#define FAILURE \
+	free (buffer); \
+	return (-1)
+
+	if (rcode < 0) {
+
+		FAILURE;
+
+	}
+	buffer->checksum = pfish_bovespa_crc32c (0, buffer + 1, file_size - sizeof (ticker_dictionary_header_t));
+
+	/*
+	 * Write it.
+	 */
+
+	if ((dictionary_file = fopen (pathname, "w")) == NULL) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s' in write mode.", pathname);
+		FAILURE;
+
+	}
+	if ((fwrite (buffer, file_size, 1, dictionary_file)) != 1) {
+
+		ERRNO_ERR;
+		CRIT ("cannot write to file '%s'.", pathname);
+		fclose (dictionary_file);
+		FAILURE;
+
+	}
+	if ((fclose (dictionary_file)) != 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot close file '%s'.", pathname);
+		FAILURE;
+
+	}
+	free (buffer);
+
+#undef FAILURE
+#define FAILURE return (-1)
+
+	SUCCESS;
+
+}
+
+
+void pfish_bovespa_ticker_table_free (ticker_table_t *table) {
+
+	free (table->stocks);
+	free (table->slots);
+	free (table);
+
+}
+
+
+/*
+ * Map the ticker dictionary again if it was replaced since last mapping; mapping mutex must be held.
+ *
+ * @return 0 on success (mapping.header is NULL if there is no ticker dictionary), negative on failure.
+ */
+
+static int dictionary_map () {
+
+	struct stat dictionary_stat;	// Status of the ticker dictionary file.
+	int dictionary_des;	// Ticker dictionary file descriptor.
+	ticker_dictionary_header_t *header;	// Fresh mapping.
+	char pathname[PATH_MAX];	// Pathname of the file, possibly in the pinned generation.
+
+	if ((pfish_bovespa_snapshot_pathname (TICKER_DICTIONARY_FILE, pathname)) < 0) {
+
+		FAILURE;
+
+	}
+	if ((stat (pathname, &dictionary_stat)) < 0) {
+
+		if (errno != ENOENT) {
+
+			ERRNO_ERR;
+			CRIT ("cannot stat file '%s'.", pathname);
+			FAILURE;
+
+		}
+		memset (&dictionary_stat, 0, sizeof (struct stat));
+
+	}
+	if ((mapping.header != NULL) && (mapping.dictionary_stat.st_dev == dictionary_stat.st_dev) && (mapping.dictionary_stat.st_ino == dictionary_stat.st_ino) && (mapping.dictionary_stat.st_size == dictionary_stat.st_size) && (mapping.dictionary_stat.st_mtim.tv_sec == dictionary_stat.st_mtim.tv_sec) && (mapping.dictionary_stat.st_mtim.tv_nsec == dictionary_stat.st_mtim.tv_nsec)) {
+
+		SUCCESS;
+
+	}
+	if (mapping.header != NULL) {
+
+		munmap (mapping.header, mapping.dictionary_stat.st_size);
+		mapping.header = NULL;
+
+	}
+	if (dictionary_stat.st_ino == 0) {
+
+		SUCCESS;
+
+	}
+	if ((pfish_bovespa_revision_marker_check ()) < 0) {
+
+		ALERT ("database revision mismatch; please reinitialize it.");
+		FAILURE;
+
+	}
+	if ((dictionary_des = open (pathname, O_RDONLY)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot open file '%s'.", pathname);
+		FAILURE;
+
+	}
+	if ((fstat (dictionary_des, &dictionary_stat)) < 0) {
+
+		ERRNO_ERR;
+		CRIT ("cannot stat file descriptor '%d'.", dictionary_des);
+		close (dictionary_des);
+		FAILURE;
+
+	}
+	if ((dictionary_stat.st_size < (off_t) sizeof (ticker_dictionary_header_t)) || ((header = (ticker_dictionary_header_t *) mmap (NULL, dictionary_stat.st_size, PROT_READ, MAP_PRIVATE, dictionary_des, 0)) == (ticker_dictionary_header_t *) (-1))) {
+
+		CRIT ("cannot memory-map file '%s'.", pathname);
+		close (dictionary_des);
+		FAILURE;
+
+	}
+	close (dictionary_des);
+	if ((pfish_bovespa_ticker_dictionary_verify (pathname, header, dictionary_stat.st_size, 0)) < 0) {
+
+		CRIT ("ticker dictionary '%s' is corrupt; please run pfish_bovespa_fsck.", pathname);
+		munmap (header, dictionary_stat.st_size);
+		FAILURE;
+
+	}
+	mapping.header = header;
+	memcpy (&(mapping.dictionary_stat), &dictionary_stat, sizeof (struct stat));
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_ticker_lookup (const pfish_bovespa_stock_id_t *stock_id, pfish_bovespa_ticker_t *answer) {
+
+	if ((pthread_mutex_lock (&(mapping.mutex))) != 0) {
+
+		CRIT ("cannot lock ticker dictionary mutex.");
+		FAILURE;
+
+	}
+	*answer = PFISH_BOVESPA_TICKER_NONE;
+	if (mapping.header != NULL) {
+
+		*answer = dictionary_lookup (mapping.header, stock_id->id);
+
+	}
+	if (*answer == PFISH_BOVESPA_TICKER_NONE) {
+
+		if ((dictionary_map ()) < 0) {
+
+			pthread_mutex_unlock (&(mapping.mutex));
+			FAILURE;
+
+		}
+		if (mapping.header != NULL) {
+
+			*answer = dictionary_lookup (mapping.header, stock_id->id);
+
+		}
+
+	}
+	pthread_mutex_unlock (&(mapping.mutex));
+	SUCCESS;
+
+}
+
+
+int pfish_bovespa_ticker_stock (pfish_bovespa_ticker_t ticker, pfish_bovespa_stock_id_t *answer) {
+
+	if ((pthread_mutex_lock (&(mapping.mutex))) != 0) {
+
+		CRIT ("cannot lock ticker dictionary mutex.");
+		FAILURE;
+
+	}
+	if ((mapping.header == NULL) || (ticker >= mapping.header->tickers_size)) {
+
+		if ((dictionary_map ()) < 0) {
+
+			pthread_mutex_unlock (&(mapping.mutex));
+			FAILURE;
+
+		}
+
+	}
+	if ((mapping.header != NULL) && (ticker < mapping.header->tickers_size)) {
+
+		memcpy (answer, &(TICKERS (mapping.header)[ticker]), sizeof (pfish_bovespa_stock_id_t));
+
+	}
+	else {
+
+		memset (answer, 0, sizeof (pfish_bovespa_stock_id_t));
+
+	}
+	pthread_mutex_unlock (&(mapping.mutex));
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
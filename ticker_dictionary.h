@@ -0,0 +1,163 @@
+/*
+ * ticker_dictionary.h
+ * Dictionary of dense stock tickers.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_TICKER_DICTIONARY_SEEN
+#define FILE_PFISH_BOVESPA_TICKER_DICTIONARY_SEEN
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pilot_fish/bovespa.h>
+
+
+/*
+ * Ticker dictionary file layout:
+ *
+ * 	- a header;
+ * 	- buckets_size displacements (uint32_t) of a minimal perfect hash function;
+ * 	- tickers_size slots (uint32_t): the ticker of each value of the minimal perfect hash function;
+ * 	- tickers_size stock identifications (pfish_bovespa_stock_id_t), by ticker.
+ *
+ * The ticker of a stock id is looked up this way (see pfish_bovespa_ticker_hash()):
+ * 	bucket = hash (id, 0) % buckets_size;
+ * 	slot = hash (id, displacements[bucket]) % tickers_size;
+ * 	ticker = slots[slot], if the stock id of the ticker is the looked up one.
+ */
+
+#define TICKER_DICTIONARY_FILE DBPATH "/.tickers"
+#define TICKER_DICTIONARY_MAGIC 0x4B544250
+
+struct ticker_dictionary_header {
+
+	uint32_t magic;	// TICKER_DICTIONARY_MAGIC.
+	uint32_t checksum;	// CRC-32C checksum of everything after the header.
+	uint32_t tickers_size;	// How many tickers.
+	uint32_t buckets_size;	// How many buckets of the minimal perfect hash function.
+
+};
+
+typedef struct ticker_dictionary_header ticker_dictionary_header_t;
+
+#define TICKER_DICTIONARY_SIZE(HEADER) (sizeof (ticker_dictionary_header_t) + (((size_t) (HEADER)->buckets_size + (HEADER)->tickers_size) * sizeof (uint32_t)) + ((size_t) (HEADER)->tickers_size * sizeof (pfish_bovespa_stock_id_t)))
+
+
+/*
+ * Seeded hash of a stock id.
+ *
+ * @param[in] id stock id.
+ * @param[in] seed seed.
+ *
+ * @return hash value.
+ */
+
+uint32_t pfish_bovespa_ticker_hash (const char *id, uint32_t seed);
+
+
+/*
+ * Verify a ticker dictionary.
+ * Shallow verification checks only sizes; deep verification also checks the checksum
+ * and that every stock id is found by the minimal perfect hash function.
+ * Failures are logged.
+ *
+ * @param[in] name name of the file, for logging.
+ * @param[in] header ticker dictionary.
+ * @param[in] file_size octets of the ticker dictionary.
+ * @param[in] deep nonzero for deep verification.
+ *
+ * @return 0 if the ticker dictionary is sound, negative otherwise.
+ */
+
+int pfish_bovespa_ticker_dictionary_verify (const char *name, const ticker_dictionary_header_t *header, size_t file_size, unsigned int deep);
+
+
+/*
+ * Tickers of an import, kept in memory.
+ */
+
+typedef struct ticker_table ticker_table_t;
+
+
+/*
+ * Load the tickers of the database.
+ * If the database has no ticker dictionary, tickers are assigned to the stocks of the database.
+ *
+ * @param[out] answer ticker table. Caller must pfish_bovespa_ticker_table_free() it after use.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_ticker_table_alloc (ticker_table_t **answer);
+
+
+/*
+ * Find the ticker of a stock id, assigning the next ticker if the stock id is new.
+ *
+ * @param[in] table ticker table.
+ * @param[in] id stock id.
+ * @param[out] answer ticker.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_ticker_table_intern (ticker_table_t *table, const char *id, pfish_bovespa_ticker_t *answer);
+
+
+/*
+ * Find the stock identification of a ticker of a ticker table.
+ *
+ * @param[in] table ticker table.
+ * @param[in] ticker ticker, less than pfish_bovespa_ticker_table_size().
+ *
+ * @return stock identification.
+ */
+
+const pfish_bovespa_stock_id_t *pfish_bovespa_ticker_table_stock (const ticker_table_t *table, pfish_bovespa_ticker_t ticker);
+
+
+/*
+ * Count the tickers of a ticker table.
+ *
+ * @param[in] table ticker table.
+ *
+ * @return how many tickers.
+ */
+
+size_t pfish_bovespa_ticker_table_size (const ticker_table_t *table);
+
+
+/*
+ * Rank the tickers of a ticker table by stock id.
+ *
+ * @param[in] table ticker table.
+ * @param[out] answer dynamically allocated array with the rank of each ticker; release it with free().
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_ticker_table_ranks (const ticker_table_t *table, uint32_t **answer);
+
+
+/*
+ * Write the ticker dictionary of a ticker table, building its minimal perfect hash function.
+ *
+ * @param[in] table ticker table.
+ * @param[in] pathname full pathname of the file.
+ *
+ * @return 0 on success, positive if the database dictionary is already up to date (nothing written), negative on failure.
+ */
+
+int pfish_bovespa_ticker_table_write (const ticker_table_t *table, const char *pathname);
+
+
+/*
+ * Release a ticker table.
+ *
+ * @param[in] table ticker table.
+ */
+
+void pfish_bovespa_ticker_table_free (ticker_table_t *table);
+
+
+#endif	// FILE_PFISH_BOVESPA_TICKER_DICTIONARY_SEEN
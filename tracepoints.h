@@ -0,0 +1,61 @@
+/*
+ * tracepoints.h
+ * Static user-level tracepoints (USDT) of the library and the importer.
+ */
+
+#ifndef FILE_PFISH_BOVESPA_TRACEPOINTS_SEEN
+#define FILE_PFISH_BOVESPA_TRACEPOINTS_SEEN
+
+
+/*
+ * Probes belong to provider 'pfish_bovespa' and compile to a single no-op instruction each
+ * (plus an ELF note telling tracers where it is); arguments are left where the compiler
+ * already has them. Probes are:
+ *
+ * history__alloc (stock id, view, daily quotes or -1 if not found, status, nanoseconds):
+ * every stock history allocation of the library.
+ * register__parse (register number, register type): every register of an imported file.
+ * quote__accept (stock id, ticker, trading date): a quote register turned into a quote node.
+ * quote__ignore (stock id, name of the field that excluded it): a quote register left out.
+ * merge__daily_quotes (database quotes, imported quotes, merged quotes, nanoseconds).
+ * xplit__detect (stock id, inplits / splits, daily quote index of the last one): inplit / split lists rebuilt by an import.
+ * stock__commit (stock id, daily quotes, nanoseconds): stock files (all views and lists) written and renamed into place.
+ *
+ * Each probe has a semaphore, defined once by the translation unit firing it with TRACE_SEMAPHORE (NAME);
+ * tracers raise semaphores of attached probes, so that arguments costing something to compute
+ * (durations) are computed only while traced:
+ *
+ * 	if (TRACE_ENABLED (NAME)) { ... }
+ *
+ * Without <sys/sdt.h> at configure time, probes compile to nothing.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define TRACE_SEMAPHORE(NAME) unsigned short pfish_bovespa_##NAME##_semaphore __attribute__ ((unused)) __attribute__ ((section (".probes")))
+#define TRACE_ENABLED(NAME) __builtin_expect (pfish_bovespa_##NAME##_semaphore != 0, 0)
+
+#define TRACE2(NAME,A1,A2) STAP_PROBE2 (pfish_bovespa, NAME, A1, A2)
+#define TRACE3(NAME,A1,A2,A3) STAP_PROBE3 (pfish_bovespa, NAME, A1, A2, A3)
+#define TRACE4(NAME,A1,A2,A3,A4) STAP_PROBE4 (pfish_bovespa, NAME, A1, A2, A3, A4)
+#define TRACE5(NAME,A1,A2,A3,A4,A5) STAP_PROBE5 (pfish_bovespa, NAME, A1, A2, A3, A4, A5)
+
+#else
+
+#define TRACE_SEMAPHORE(NAME) extern unsigned short pfish_bovespa_##NAME##_semaphore
+#define TRACE_ENABLED(NAME) 0
+
+// Arguments are referenced in dead code, so that variables kept only for probes are not reported as unused.
+
+#define TRACE2(NAME,A1,A2) do { if (0) { (void) (A1); (void) (A2); } } while (0)
+#define TRACE3(NAME,A1,A2,A3) do { if (0) { (void) (A1); (void) (A2); (void) (A3); } } while (0)
+#define TRACE4(NAME,A1,A2,A3,A4) do { if (0) { (void) (A1); (void) (A2); (void) (A3); (void) (A4); } } while (0)
+#define TRACE5(NAME,A1,A2,A3,A4,A5) do { if (0) { (void) (A1); (void) (A2); (void) (A3); (void) (A4); (void) (A5); } } while (0)
+
+#endif
+
+
+#endif	// FILE_PFISH_BOVESPA_TRACEPOINTS_SEEN
@@ -0,0 +1,285 @@
+/*
+ * view_kernel.c
+ * Kernels of derived views of stock histories: adjusted daily quotes, and weekly / monthly rollups.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <limits.h>
+#include <assert.h>
+
+#include <pilot_fish/syslog.h>
+#include <pilot_fish/syslog_macros.h>
+#include <pilot_fish/bovespa.h>
+
+#include "view_kernel.h"
+#include "async_log.h"
+
+
+#define SUCCESS return (0)
+#define FAILURE return (-1)
+
+int pfish_bovespa_adjust_daily_quotes (pfish_bovespa_daily_quote_t **daily_quotes, size_t daily_quotes_size, const pfish_bovespa_xplit_list_t *xplits, const pfish_bovespa_stock_history_t *previous, const pfish_bovespa_xplit_list_t *previous_xplits, size_t first_changed, pfish_bovespa_daily_quote_t ***answer) {
+
+	pfish_bovespa_daily_quote_t **c;	// The answer; adjusted daily quotes are stored right after the array of pointers.
+	pfish_bovespa_daily_quote_t *quote;	// Adjusted daily quote being built.
+	size_t reused;	// How many adjusted daily quotes are taken from 'previous'.
+	double previous_ratio;	// Product of price ratios of previous inplits and splits since 'first_changed'.
+	double ratio;	// Product of price ratios of current inplits and splits since 'first_changed'; later, since the current daily quote.
+	double scale;	// Multiplier from raw prices to adjusted prices of the current daily quote.
+	size_t i, j;
+
+	/*
+	 * Find out how many adjusted daily quotes are still valid.
+	 * They are, if the adjusting ratio of every one of them did not change.
+	 */
+
+	reused = 0;
+	if ((previous != NULL) && (previous_xplits != NULL) && (first_changed > 0) && (previous->daily_quotes_size >= first_changed) && (previous->daily_quotes[first_changed - 1].trading_date == daily_quotes[first_changed - 1]->trading_date)) {
+
+		previous_ratio = 1;
+		for ( j = 0; j < previous_xplits->xplit_list_size; j++ ) {
+
+			if (previous_xplits->xplit_list[j].daily_quote_index >= first_changed) {
+
+				previous_ratio *= previous_xplits->xplit_list[j].price_ratio;
+
+			}
+
+		}
+		ratio = 1;
+		for ( j = 0; j < xplits->xplit_list_size; j++ ) {
+
+			if (xplits->xplit_list[j].daily_quote_index >= first_changed) {
+
+				ratio *= xplits->xplit_list[j].price_ratio;
+
+			}
+
+		}
+		if (ratio == previous_ratio) {
+
+			reused = first_changed;
+
+		}
+
+	}
+	DEBUG ("%u of %u adjusted daily quotes reused.", reused, daily_quotes_size);
+
+	/*
+	 * Build the answer.
+	 */
+
+	if ((c = (pfish_bovespa_daily_quote_t **) malloc ((daily_quotes_size * sizeof (pfish_bovespa_daily_quote_t *)) + ((daily_quotes_size - reused) * sizeof (pfish_bovespa_daily_quote_t)))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (daily_quotes_size * sizeof (pfish_bovespa_daily_quote_t *)) + ((daily_quotes_size - reused) * sizeof (pfish_bovespa_daily_quote_t)));
+		FAILURE;
+
+	}
+	for ( i = 0; i < reused; i++ ) {
+
+		c[i] = (pfish_bovespa_daily_quote_t *) &(previous->daily_quotes[i]);
+
+	}
+	quote = (pfish_bovespa_daily_quote_t *) &(c[daily_quotes_size]);
+
+#define ADJUST(PRICE) ((pfish_uint64_t) (((double) (PRICE) * scale) + 0.5))
+
+	ratio = 1;
+	j = xplits->xplit_list_size;
+	for ( i = daily_quotes_size; i > reused; i-- ) {
+
+		while ((j > 0) && (xplits->xplit_list[j - 1].daily_quote_index >= i)) {
+
+			ratio *= xplits->xplit_list[--j].price_ratio;
+
+		}
+		scale = ratio * PFISH_BOVESPA_ADJUSTED_PRICE_FACTOR / ((daily_quotes[i - 1]->price_factor != 0) ? daily_quotes[i - 1]->price_factor : 1);
+		memcpy (quote, daily_quotes[i - 1], sizeof (pfish_bovespa_daily_quote_t));
+		quote->price_factor = PFISH_BOVESPA_ADJUSTED_PRICE_FACTOR;
+		quote->opening_price = ADJUST (daily_quotes[i - 1]->opening_price);
+		quote->closing_price = ADJUST (daily_quotes[i - 1]->closing_price);
+		quote->minimum_price = ADJUST (daily_quotes[i - 1]->minimum_price);
+		quote->maximum_price = ADJUST (daily_quotes[i - 1]->maximum_price);
+		quote->average_price = ADJUST (daily_quotes[i - 1]->average_price);
+		c[i - 1] = quote++;
+
+	}
+
+#undef ADJUST
+
+	*answer = c;
+	SUCCESS;
+
+}
+
+
+long pfish_bovespa_period_key (time_t trading_date, unsigned int period) {
+
+	struct tm calendar;	// Time components of the trading date.
+
+	switch (period) {
+
+		case PFISH_BOVESPA_VIEW_WEEKLY:
+
+			// Day 0 (1970-01-01) was a Thursday; weeks start on Mondays.
+
+			return (((long) (trading_date / 86400) + 3) / 7);
+
+		default:
+
+			gmtime_r (&trading_date, &calendar);
+			return (((long) calendar.tm_year * 12) + calendar.tm_mon);
+
+	}
+
+}
+
+
+int pfish_bovespa_rollup_daily_quotes (pfish_bovespa_daily_quote_t **daily_quotes, size_t daily_quotes_size, size_t last_xplit, unsigned int period, const pfish_bovespa_stock_history_t *previous, size_t first_changed, pfish_bovespa_daily_quote_t ***answer, size_t *answer_size, size_t *answer_last_xplit) {
+
+	pfish_bovespa_daily_quote_t **c;	// The answer; rollups are stored right after the array of pointers.
+	pfish_bovespa_daily_quote_t *quote;	// Rollup being built.
+	size_t c_size;	// How many elements in 'c'.
+	size_t reused;	// How many rollups are taken from 'previous'.
+	size_t start;	// Index of 'daily_quotes' of the first daily quote to be rolled up.
+	size_t periods_size;	// How many periods to be rolled up.
+	long key;	// Period key.
+	long changed_key;	// Period key of the first changed daily quote.
+	double average;	// Sum of average prices weighted by total stocks.
+	size_t i, j, k;
+
+	/*
+	 * Find out how many previous rollups are still valid:
+	 * those of periods before the period of the first changed daily quote.
+	 */
+
+	reused = 0;
+	start = 0;
+	if ((previous != NULL) && (first_changed > 0)) {
+
+		changed_key = (first_changed < daily_quotes_size) ? pfish_bovespa_period_key (daily_quotes[first_changed]->trading_date, period) : LONG_MAX;
+		while ((reused < previous->daily_quotes_size) && ((pfish_bovespa_period_key (previous->daily_quotes[reused].trading_date, period)) < changed_key)) {
+
+			reused++;
+
+		}
+		for ( start = first_changed; (start > 0) && ((pfish_bovespa_period_key (daily_quotes[start - 1]->trading_date, period)) >= changed_key); start-- );
+
+	}
+	DEBUG ("%u rollups reused; rolling up from array position %u.", reused, start);
+
+	/*
+	 * Count periods to be rolled up.
+	 */
+
+	periods_size = 0;
+	key = 0;
+	for ( i = start; i < daily_quotes_size; i++ ) {
+
+		if ((i == start) || ((pfish_bovespa_period_key (daily_quotes[i]->trading_date, period)) != key)) {
+
+			key = pfish_bovespa_period_key (daily_quotes[i]->trading_date, period);
+			periods_size++;
+
+		}
+
+	}
+	c_size = reused + periods_size;
+	if ((c = (pfish_bovespa_daily_quote_t **) malloc ((c_size * sizeof (pfish_bovespa_daily_quote_t *)) + (periods_size * sizeof (pfish_bovespa_daily_quote_t)))) == NULL) {
+
+		ALERT ("cannot allocate %u bytes of heap space.", (c_size * sizeof (pfish_bovespa_daily_quote_t *)) + (periods_size * sizeof (pfish_bovespa_daily_quote_t)));
+		FAILURE;
+
+	}
+	for ( k = 0; k < reused; k++ ) {
+
+		c[k] = (pfish_bovespa_daily_quote_t *) &(previous->daily_quotes[k]);
+
+	}
+	quote = (pfish_bovespa_daily_quote_t *) &(c[c_size]);
+
+	/*
+	 * Roll up each period.
+	 * Prices are rescaled to the price factor of the last trading day of the period.
+	 */
+
+#define RESCALE(QUOTE,FIELD) \
+	((((QUOTE)->price_factor == quote->price_factor) || ((QUOTE)->price_factor == 0)) ? \
+		(QUOTE)->FIELD : \
+		(pfish_uint64_t) (((double) (QUOTE)->FIELD * quote->price_factor / (QUOTE)->price_factor) + 0.5))
+
+	for ( i = start; i < daily_quotes_size; i = j ) {
+
+		key = pfish_bovespa_period_key (daily_quotes[i]->trading_date, period);
+		for ( j = i + 1; (j < daily_quotes_size) && ((pfish_bovespa_period_key (daily_quotes[j]->trading_date, period)) == key); j++ );
+		memcpy (quote, daily_quotes[j - 1], sizeof (pfish_bovespa_daily_quote_t));
+		quote->trading_date = daily_quotes[i]->trading_date;
+		quote->opening_price = RESCALE (daily_quotes[i], opening_price);
+		quote->total_trades = 0;
+		quote->total_stocks = 0;
+		quote->total_volume = 0;
+		average = 0;
+		for ( k = i; k < j; k++ ) {
+
+			if ((RESCALE (daily_quotes[k], maximum_price)) > quote->maximum_price) {
+
+				quote->maximum_price = RESCALE (daily_quotes[k], maximum_price);
+
+			}
+			if ((RESCALE (daily_quotes[k], minimum_price)) < quote->minimum_price) {
+
+				quote->minimum_price = RESCALE (daily_quotes[k], minimum_price);
+
+			}
+			average += (double) RESCALE (daily_quotes[k], average_price) * daily_quotes[k]->total_stocks;
+			quote->total_trades += daily_quotes[k]->total_trades;
+			quote->total_stocks += daily_quotes[k]->total_stocks;
+			quote->total_volume += daily_quotes[k]->total_volume;
+
+		}
+		if (quote->total_stocks != 0) {
+
+			quote->average_price = (pfish_uint64_t) ((average / quote->total_stocks) + 0.5);
+
+		}
+		c[reused++] = quote++;
+
+	}
+
+#undef RESCALE
+
+	assert (reused == c_size);
+
+	/*
+	 * Find the period of the most recent inplit or split.
+	 */
+
+	*answer_last_xplit = 0;
+	if (last_xplit != 0) {
+
+		key = pfish_bovespa_period_key (daily_quotes[last_xplit]->trading_date, period);
+		for ( k = c_size; k > 0; k-- ) {
+
+			if ((pfish_bovespa_period_key (c[k - 1]->trading_date, period)) == key) {
+
+				*answer_last_xplit = k - 1;
+				break;
+
+			}
+
+		}
+
+	}
+	*answer = c;
+	*answer_size = c_size;
+	SUCCESS;
+
+}
+
+#undef FAILURE
+#undef SUCCESS
@@ -0,0 +1,70 @@
+/*
+ * view_kernel.h
+ * Kernels of derived views of stock histories: adjusted daily quotes, and weekly / monthly rollups.
+ * Shared by imports (which store the views) and stitched histories (which derive them on request).
+ */
+
+#ifndef FILE_PFISH_BOVESPA_VIEW_KERNEL_SEEN
+#define FILE_PFISH_BOVESPA_VIEW_KERNEL_SEEN
+
+#include <stddef.h>
+#include <time.h>
+
+#include <pilot_fish/bovespa.h>
+
+
+/*
+ * Build the adjusted view of daily quotes of a stock.
+ * Prices of each daily quote are multiplied by the price ratios of all inplits and splits after it,
+ * and normalized to PFISH_BOVESPA_ADJUSTED_PRICE_FACTOR.
+ * Adjusted daily quotes before 'first_changed' are taken from the previous adjusted view
+ * if inplits and splits since then did not change; otherwise all daily quotes are adjusted again.
+ *
+ * @param[in] daily_quotes array of pointers to raw daily quotes, ordered by trading date.
+ * @param[in] daily_quotes_size how many elements in 'daily_quotes'.
+ * @param[in] xplits inplit / split list of 'daily_quotes'.
+ * @param[in] previous adjusted stock history currently in the database, NULL if none.
+ * @param[in] previous_xplits inplit / split list currently in the database, NULL if none.
+ * @param[in] first_changed index of 'daily_quotes' of the first daily quote not in the database.
+ * @param[out] answer dynamically allocated array of pointers to adjusted daily quotes; release it with free().
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_adjust_daily_quotes (pfish_bovespa_daily_quote_t **daily_quotes, size_t daily_quotes_size, const pfish_bovespa_xplit_list_t *xplits, const pfish_bovespa_stock_history_t *previous, const pfish_bovespa_xplit_list_t *previous_xplits, size_t first_changed, pfish_bovespa_daily_quote_t ***answer);
+
+
+/*
+ * Find out the period of a trading date.
+ *
+ * @param[in] trading_date trading date.
+ * @param[in] period PFISH_BOVESPA_VIEW_WEEKLY or PFISH_BOVESPA_VIEW_MONTHLY.
+ *
+ * @return a key that orders periods and is equal for trading dates of the same period.
+ */
+
+long pfish_bovespa_period_key (time_t trading_date, unsigned int period);
+
+
+/*
+ * Build the weekly or monthly rollups of daily quotes of a stock (see PFISH_BOVESPA_VIEW_WEEKLY).
+ * Rollups of periods before the period of 'first_changed' are taken from the previous rollups;
+ * only the remaining periods are rolled up again.
+ *
+ * @param[in] daily_quotes array of pointers to daily quotes, ordered by trading date.
+ * @param[in] daily_quotes_size how many elements in 'daily_quotes'.
+ * @param[in] last_xplit index of 'daily_quotes' of the most recent inplit or split, 0 if none.
+ * @param[in] period PFISH_BOVESPA_VIEW_WEEKLY or PFISH_BOVESPA_VIEW_MONTHLY.
+ * @param[in] previous rollup history currently in the database, NULL if none.
+ * @param[in] first_changed index of 'daily_quotes' of the first daily quote not in the database.
+ * @param[out] answer dynamically allocated array of pointers to rollups; release it with free().
+ * @param[out] answer_size how many elements in 'answer'.
+ * @param[out] answer_last_xplit index of 'answer' of the period of the most recent inplit or split, 0 if none.
+ *
+ * @return 0 on success, negative on failure.
+ */
+
+int pfish_bovespa_rollup_daily_quotes (pfish_bovespa_daily_quote_t **daily_quotes, size_t daily_quotes_size, size_t last_xplit, unsigned int period, const pfish_bovespa_stock_history_t *previous, size_t first_changed, pfish_bovespa_daily_quote_t ***answer, size_t *answer_size, size_t *answer_last_xplit);
+
+
+#endif	// FILE_PFISH_BOVESPA_VIEW_KERNEL_SEEN